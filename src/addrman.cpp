@@ -65,29 +65,124 @@ double CAddrInfo::GetChance(int64_t nNow) const
     return fChance;
 }
 
+int CAddrMan::FindId(const CNetAddr& addr) const
+{
+    size_t nMask = vAddrTable.size() - 1;
+    for (size_t nPos = addr.GetSaltedHash(nAddrTableKey0, nAddrTableKey1) & nMask; vAddrTable[nPos] != -1; nPos = (nPos + 1) & nMask) {
+        if ((const CNetAddr&)vInfo[vAddrTable[nPos]] == addr)
+            return vAddrTable[nPos];
+    }
+    return -1;
+}
+
+void CAddrMan::InsertAddr(int nId)
+{
+    // Keep the table at most half full. Rehashing inserts nId too, as it is in vRandom already.
+    if (vRandom.size() * 2 > vAddrTable.size()) {
+        RehashAddrTable(vAddrTable.size() * 2);
+        return;
+    }
+    size_t nMask = vAddrTable.size() - 1;
+    size_t nPos = vInfo[nId].GetSaltedHash(nAddrTableKey0, nAddrTableKey1) & nMask;
+    while (vAddrTable[nPos] != -1)
+        nPos = (nPos + 1) & nMask;
+    vAddrTable[nPos] = nId;
+}
+
+void CAddrMan::EraseAddr(int nId)
+{
+    size_t nMask = vAddrTable.size() - 1;
+    size_t nPos = vInfo[nId].GetSaltedHash(nAddrTableKey0, nAddrTableKey1) & nMask;
+    while (vAddrTable[nPos] != nId) {
+        assert(vAddrTable[nPos] != -1);
+        nPos = (nPos + 1) & nMask;
+    }
+    // Move later entries of the probe sequence back into the gap, so lookups need no tombstones
+    size_t nNext = nPos;
+    while (true) {
+        nNext = (nNext + 1) & nMask;
+        if (vAddrTable[nNext] == -1)
+            break;
+        size_t nHome = vInfo[vAddrTable[nNext]].GetSaltedHash(nAddrTableKey0, nAddrTableKey1) & nMask;
+        // Leave the entry if its home position lies cyclically in (nPos, nNext]
+        if (((nNext - nHome) & nMask) < ((nNext - nPos) & nMask))
+            continue;
+        vAddrTable[nPos] = vAddrTable[nNext];
+        nPos = nNext;
+    }
+    vAddrTable[nPos] = -1;
+}
+
+void CAddrMan::RehashAddrTable(size_t nSize)
+{
+    vAddrTable.assign(nSize, -1);
+    size_t nMask = nSize - 1;
+    for (int nId : vRandom) {
+        size_t nPos = vInfo[nId].GetSaltedHash(nAddrTableKey0, nAddrTableKey1) & nMask;
+        while (vAddrTable[nPos] != -1)
+            nPos = (nPos + 1) & nMask;
+        vAddrTable[nPos] = nId;
+    }
+}
+
+/**
+ * Store nId at position nSlot of a bucket table (-1 to empty it), adding or
+ * removing the position in the list of occupied positions vSlots. vSlotIndex
+ * holds the index in vSlots of every occupied position.
+ */
+static void SetSlot(int* vEntries, int* vSlotIndex, std::vector<int>& vSlots, int nSlot, int nId)
+{
+    bool fOccupied = vEntries[nSlot] != -1;
+    vEntries[nSlot] = nId;
+    if (nId != -1 && !fOccupied) {
+        vSlotIndex[nSlot] = vSlots.size();
+        vSlots.push_back(nSlot);
+    } else if (nId == -1 && fOccupied) {
+        int nIndex = vSlotIndex[nSlot];
+        vSlots[nIndex] = vSlots.back();
+        vSlotIndex[vSlots[nIndex]] = nIndex;
+        vSlots.pop_back();
+        vSlotIndex[nSlot] = -1;
+    }
+}
+
+void CAddrMan::SetTried(int nKBucket, int nKBucketPos, int nId)
+{
+    SetSlot(&vvTried[0][0], &vvTriedSlotIndex[0][0], vTriedSlots, nKBucket * ADDRMAN_BUCKET_SIZE + nKBucketPos, nId);
+}
+
+void CAddrMan::SetNew(int nUBucket, int nUBucketPos, int nId)
+{
+    SetSlot(&vvNew[0][0], &vvNewSlotIndex[0][0], vNewSlots, nUBucket * ADDRMAN_BUCKET_SIZE + nUBucketPos, nId);
+}
+
 CAddrInfo* CAddrMan::Find(const CNetAddr& addr, int* pnId)
 {
-    std::map<CNetAddr, int>::iterator it = mapAddr.find(addr);
-    if (it == mapAddr.end())
+    int nId = FindId(addr);
+    if (nId == -1)
         return NULL;
     if (pnId)
-        *pnId = (*it).second;
-    std::map<int, CAddrInfo>::iterator it2 = mapInfo.find((*it).second);
-    if (it2 != mapInfo.end())
-        return &(*it2).second;
-    return NULL;
+        *pnId = nId;
+    return &vInfo[nId];
 }
 
 CAddrInfo* CAddrMan::Create(const CAddress& addr, const CNetAddr& addrSource, int* pnId)
 {
-    int nId = nIdCount++;
-    mapInfo[nId] = CAddrInfo(addr, addrSource);
-    mapAddr[addr] = nId;
-    mapInfo[nId].nRandomPos = vRandom.size();
+    int nId;
+    if (!vFreeIds.empty()) {
+        nId = vFreeIds.back();
+        vFreeIds.pop_back();
+        vInfo[nId] = CAddrInfo(addr, addrSource);
+    } else {
+        nId = vInfo.size();
+        vInfo.push_back(CAddrInfo(addr, addrSource));
+    }
+    vInfo[nId].nRandomPos = vRandom.size();
     vRandom.push_back(nId);
+    InsertAddr(nId);
     if (pnId)
         *pnId = nId;
-    return &mapInfo[nId];
+    return &vInfo[nId];
 }
 
 void CAddrMan::SwapRandom(unsigned int nRndPos1, unsigned int nRndPos2)
@@ -100,11 +195,8 @@ void CAddrMan::SwapRandom(unsigned int nRndPos1, unsigned int nRndPos2)
     int nId1 = vRandom[nRndPos1];
     int nId2 = vRandom[nRndPos2];
 
-    assert(mapInfo.count(nId1) == 1);
-    assert(mapInfo.count(nId2) == 1);
-
-    mapInfo[nId1].nRandomPos = nRndPos2;
-    mapInfo[nId2].nRandomPos = nRndPos1;
+    vInfo[nId1].nRandomPos = nRndPos2;
+    vInfo[nId2].nRandomPos = nRndPos1;
 
     vRandom[nRndPos1] = nId2;
     vRandom[nRndPos2] = nId1;
@@ -112,15 +204,16 @@ void CAddrMan::SwapRandom(unsigned int nRndPos1, unsigned int nRndPos2)
 
 void CAddrMan::Delete(int nId)
 {
-    assert(mapInfo.count(nId) != 0);
-    CAddrInfo& info = mapInfo[nId];
+    CAddrInfo& info = vInfo[nId];
+    assert(info.nRandomPos != -1);
     assert(!info.fInTried);
     assert(info.nRefCount == 0);
 
+    EraseAddr(nId);
     SwapRandom(info.nRandomPos, vRandom.size() - 1);
     vRandom.pop_back();
-    mapAddr.erase(info);
-    mapInfo.erase(nId);
+    info = CAddrInfo();
+    vFreeIds.push_back(nId);
     nNew--;
 }
 
@@ -129,10 +222,10 @@ void CAddrMan::ClearNew(int nUBucket, int nUBucketPos)
     // if there is an entry in the specified bucket, delete it.
     if (vvNew[nUBucket][nUBucketPos] != -1) {
         int nIdDelete = vvNew[nUBucket][nUBucketPos];
-        CAddrInfo& infoDelete = mapInfo[nIdDelete];
+        CAddrInfo& infoDelete = vInfo[nIdDelete];
         assert(infoDelete.nRefCount > 0);
         infoDelete.nRefCount--;
-        vvNew[nUBucket][nUBucketPos] = -1;
+        SetNew(nUBucket, nUBucketPos, -1);
         if (infoDelete.nRefCount == 0) {
             Delete(nIdDelete);
         }
@@ -145,7 +238,7 @@ void CAddrMan::MakeTried(CAddrInfo& info, int nId)
     for (int bucket = 0; bucket < ADDRMAN_NEW_BUCKET_COUNT; bucket++) {
         int pos = info.GetBucketPosition(nKey, true, bucket);
         if (vvNew[bucket][pos] == nId) {
-            vvNew[bucket][pos] = -1;
+            SetNew(bucket, pos, -1);
             info.nRefCount--;
         }
     }
@@ -161,12 +254,11 @@ void CAddrMan::MakeTried(CAddrInfo& info, int nId)
     if (vvTried[nKBucket][nKBucketPos] != -1) {
         // find an item to evict
         int nIdEvict = vvTried[nKBucket][nKBucketPos];
-        assert(mapInfo.count(nIdEvict) == 1);
-        CAddrInfo& infoOld = mapInfo[nIdEvict];
+        CAddrInfo& infoOld = vInfo[nIdEvict];
 
         // Remove the to-be-evicted item from the tried set.
         infoOld.fInTried = false;
-        vvTried[nKBucket][nKBucketPos] = -1;
+        SetTried(nKBucket, nKBucketPos, -1);
         nTried--;
 
         // find which new bucket it belongs to
@@ -177,12 +269,12 @@ void CAddrMan::MakeTried(CAddrInfo& info, int nId)
 
         // Enter it into the new set again.
         infoOld.nRefCount = 1;
-        vvNew[nUBucket][nUBucketPos] = nIdEvict;
+        SetNew(nUBucket, nUBucketPos, nIdEvict);
         nNew++;
     }
     assert(vvTried[nKBucket][nKBucketPos] == -1);
 
-    vvTried[nKBucket][nKBucketPos] = nId;
+    SetTried(nKBucket, nKBucketPos, nId);
     nTried++;
     info.fInTried = true;
 }
@@ -293,7 +385,7 @@ bool CAddrMan::Add_(const CAddress& addr, const CNetAddr& source, int64_t nTimeP
     if (vvNew[nUBucket][nUBucketPos] != nId) {
         bool fInsert = vvNew[nUBucket][nUBucketPos] == -1;
         if (!fInsert) {
-            CAddrInfo& infoExisting = mapInfo[vvNew[nUBucket][nUBucketPos]];
+            CAddrInfo& infoExisting = vInfo[vvNew[nUBucket][nUBucketPos]];
             if (infoExisting.IsTerrible() || (infoExisting.nRefCount > 1 && pinfo->nRefCount == 0)) {
                 // Overwrite the existing new table entry.
                 fInsert = true;
@@ -302,7 +394,7 @@ bool CAddrMan::Add_(const CAddress& addr, const CNetAddr& source, int64_t nTimeP
         if (fInsert) {
             ClearNew(nUBucket, nUBucketPos);
             pinfo->nRefCount++;
-            vvNew[nUBucket][nUBucketPos] = nId;
+            SetNew(nUBucket, nUBucketPos, nId);
         } else {
             if (pinfo->nRefCount == 0) {
                 Delete(nId);
@@ -345,35 +437,23 @@ CAddrInfo CAddrMan::Select_(bool newOnly)
     // Use a 50% chance for choosing between tried and new table entries.
     if (!newOnly &&
        (nTried > 0 && (nNew == 0 || RandomInt(2) == 0))) { 
-        // use a tried node
+        // use a tried node, picking one of the occupied positions directly
         double fChanceFactor = 1.0;
         while (1) {
-            int nKBucket = RandomInt(ADDRMAN_TRIED_BUCKET_COUNT);
-            int nKBucketPos = RandomInt(ADDRMAN_BUCKET_SIZE);
-            while (vvTried[nKBucket][nKBucketPos] == -1) {
-                nKBucket = (nKBucket + insecure_rand.rand32()) % ADDRMAN_TRIED_BUCKET_COUNT;
-                nKBucketPos = (nKBucketPos + insecure_rand.rand32()) % ADDRMAN_BUCKET_SIZE;
-            }
-            int nId = vvTried[nKBucket][nKBucketPos];
-            assert(mapInfo.count(nId) == 1);
-            CAddrInfo& info = mapInfo[nId];
+            int nSlot = vTriedSlots[RandomInt(vTriedSlots.size())];
+            int nId = vvTried[nSlot / ADDRMAN_BUCKET_SIZE][nSlot % ADDRMAN_BUCKET_SIZE];
+            CAddrInfo& info = vInfo[nId];
             if (RandomInt(1 << 30) < fChanceFactor * info.GetChance() * (1 << 30))
                 return info;
             fChanceFactor *= 1.2;
         }
     } else {
-        // use a new node
+        // use a new node, picking one of the occupied positions directly
         double fChanceFactor = 1.0;
         while (1) {
-            int nUBucket = RandomInt(ADDRMAN_NEW_BUCKET_COUNT);
-            int nUBucketPos = RandomInt(ADDRMAN_BUCKET_SIZE);
-            while (vvNew[nUBucket][nUBucketPos] == -1) {
-                nUBucket = (nUBucket + insecure_rand.rand32()) % ADDRMAN_NEW_BUCKET_COUNT;
-                nUBucketPos = (nUBucketPos + insecure_rand.rand32()) % ADDRMAN_BUCKET_SIZE;
-            }
-            int nId = vvNew[nUBucket][nUBucketPos];
-            assert(mapInfo.count(nId) == 1);
-            CAddrInfo& info = mapInfo[nId];
+            int nSlot = vNewSlots[RandomInt(vNewSlots.size())];
+            int nId = vvNew[nSlot / ADDRMAN_BUCKET_SIZE][nSlot % ADDRMAN_BUCKET_SIZE];
+            CAddrInfo& info = vInfo[nId];
             if (RandomInt(1 << 30) < fChanceFactor * info.GetChance() * (1 << 30))
                 return info;
             fChanceFactor *= 1.2;
@@ -390,9 +470,10 @@ int CAddrMan::Check_()
     if (vRandom.size() != nTried + nNew)
         return -7;
 
-    for (std::map<int, CAddrInfo>::iterator it = mapInfo.begin(); it != mapInfo.end(); it++) {
-        int n = (*it).first;
-        CAddrInfo& info = (*it).second;
+    for (int n = 0; n < (int)vInfo.size(); n++) {
+        CAddrInfo& info = vInfo[n];
+        if (info.nRandomPos == -1)
+            continue;
         if (info.fInTried) {
             if (!info.nLastSuccess)
                 return -1;
@@ -406,7 +487,7 @@ int CAddrMan::Check_()
                 return -4;
             mapNew[n] = info.nRefCount;
         }
-        if (mapAddr[info] != n)
+        if (FindId(info) != n)
             return -5;
         if (info.nRandomPos < 0 || info.nRandomPos >= vRandom.size() || vRandom[info.nRandomPos] != n)
             return -14;
@@ -426,10 +507,12 @@ int CAddrMan::Check_()
              if (vvTried[n][i] != -1) {
                  if (!setTried.count(vvTried[n][i]))
                      return -11;
-                 if (mapInfo[vvTried[n][i]].GetTriedBucket(nKey) != n)
+                 if (vInfo[vvTried[n][i]].GetTriedBucket(nKey) != n)
                      return -17;
-                 if (mapInfo[vvTried[n][i]].GetBucketPosition(nKey, false, n) != i)
+                 if (vInfo[vvTried[n][i]].GetBucketPosition(nKey, false, n) != i)
                      return -18;
+                 if (vTriedSlots[vvTriedSlotIndex[n][i]] != n * ADDRMAN_BUCKET_SIZE + i)
+                     return -20;
                  setTried.erase(vvTried[n][i]);
              }
         }
@@ -440,14 +523,18 @@ int CAddrMan::Check_()
             if (vvNew[n][i] != -1) {
                 if (!mapNew.count(vvNew[n][i]))
                     return -12;
-                if (mapInfo[vvNew[n][i]].GetBucketPosition(nKey, true, n) != i)
+                if (vInfo[vvNew[n][i]].GetBucketPosition(nKey, true, n) != i)
                     return -19;
+                if (vNewSlots[vvNewSlotIndex[n][i]] != n * ADDRMAN_BUCKET_SIZE + i)
+                    return -21;
                 if (--mapNew[vvNew[n][i]] == 0)
                     mapNew.erase(vvNew[n][i]);
             }
         }
     }
 
+    if (vTriedSlots.size() != (size_t)nTried)
+        return -22;
     if (setTried.size())
         return -13;
     if (mapNew.size())
@@ -472,9 +559,8 @@ void CAddrMan::GetAddr_(std::vector<CAddress>& vAddr)
 
         int nRndPos = RandomInt(vRandom.size() - n) + n;
         SwapRandom(n, nRndPos);
-        assert(mapInfo.count(vRandom[n]) == 1);
 
-        const CAddrInfo& ai = mapInfo[vRandom[n]];
+        const CAddrInfo& ai = vInfo[vRandom[n]];
         if (!ai.IsTerrible())
             vAddr.push_back(ai);
     }
@@ -13,6 +13,7 @@
 #include "timedata.h"
 #include "util.h"
 
+#include <limits>
 #include <map>
 #include <set>
 #include <stdint.h>
@@ -171,6 +172,9 @@ public:
 //! the maximum number of nodes to return in a getaddr call
 #define ADDRMAN_GETADDR_MAX 2500
 
+//! initial number of positions in the address lookup table (a power of two)
+#define ADDRMAN_MIN_ADDR_TABLE_SIZE 1024
+
 /**
  * Stochastical (IP) address manager
  */
@@ -180,14 +184,18 @@ private:
     //! critical section to protect the inner data structures
     mutable CCriticalSection cs;
 
-    //! last used nId
-    int nIdCount;
+    //! information about all nIds, indexed by nId; unused entries have nRandomPos -1
+    std::vector<CAddrInfo> vInfo;
+
+    //! unused nIds in vInfo, reused before vInfo grows
+    std::vector<int> vFreeIds;
 
-    //! table with information about all nIds
-    std::map<int, CAddrInfo> mapInfo;
+    //! find an nId based on its network address: open addressing table of nIds, linear probing, -1 when empty.
+    //! Its size is a power of two.
+    std::vector<int> vAddrTable;
 
-    //! find an nId based on its network address
-    std::map<CNetAddr, int> mapAddr;
+    //! SipHash key of vAddrTable, so peers cannot craft colliding addresses
+    uint64_t nAddrTableKey0, nAddrTableKey1;
 
     //! randomly-ordered vector of all nIds
     std::vector<int> vRandom;
@@ -204,6 +212,14 @@ private:
     //! list of "new" buckets
     int vvNew[ADDRMAN_NEW_BUCKET_COUNT][ADDRMAN_BUCKET_SIZE];
 
+    //! occupied positions (bucket * ADDRMAN_BUCKET_SIZE + position) in vvTried and vvNew, to select from in constant time
+    std::vector<int> vTriedSlots;
+    std::vector<int> vNewSlots;
+
+    //! index of every occupied position in vTriedSlots or vNewSlots
+    int vvTriedSlotIndex[ADDRMAN_TRIED_BUCKET_COUNT][ADDRMAN_BUCKET_SIZE];
+    int vvNewSlotIndex[ADDRMAN_NEW_BUCKET_COUNT][ADDRMAN_BUCKET_SIZE];
+
     //! last time Good was called (memory only)
     int64_t nLastGood;
 
@@ -214,6 +230,22 @@ protected:
     //! Source of random numbers for randomization in inner loops
     FastRandomContext insecure_rand;
 
+    //! Find the nId of an address in vAddrTable, or -1.
+    int FindId(const CNetAddr& addr) const;
+
+    //! Add an nId, which must be in vRandom already, to vAddrTable, growing it if needed.
+    void InsertAddr(int nId);
+
+    //! Remove an nId from vAddrTable.
+    void EraseAddr(int nId);
+
+    //! Resize vAddrTable to nSize positions and insert all entries again.
+    void RehashAddrTable(size_t nSize);
+
+    //! Store nId at a position in a "tried" or "new" bucket (-1 to empty it), keeping vTriedSlots and vNewSlots in sync.
+    void SetTried(int nKBucket, int nKBucketPos, int nId);
+    void SetNew(int nUBucket, int nUBucketPos, int nId);
+
     //! Find an entry.
     CAddrInfo* Find(const CNetAddr& addr, int *pnId = NULL);
 
@@ -280,7 +312,7 @@ public:
      * as incompatible. This is necessary because it did not check the version number on
      * deserialization.
      *
-     * Notice that vvTried, mapAddr and vVector are never encoded explicitly;
+     * Notice that vvTried, vAddrTable and vRandom are never encoded explicitly;
      * they are instead reconstructed from the other information.
      *
      * vvNew is serialized, but only used if ADDRMAN_UNKNOWN_BUCKET_COUNT didn't change,
@@ -306,20 +338,19 @@ public:
 
         int nUBuckets = ADDRMAN_NEW_BUCKET_COUNT ^ (1 << 30);
         s << nUBuckets;
-        std::map<int, int> mapUnkIds;
+        std::vector<int> vUnkIds(vInfo.size(), -1);
         int nIds = 0;
-        for (std::map<int, CAddrInfo>::const_iterator it = mapInfo.begin(); it != mapInfo.end(); it++) {
-            mapUnkIds[(*it).first] = nIds;
-            const CAddrInfo &info = (*it).second;
+        for (size_t n = 0; n < vInfo.size(); n++) {
+            const CAddrInfo &info = vInfo[n];
             if (info.nRefCount) {
                 assert(nIds != nNew); // this means nNew was wrong, oh ow
                 s << info;
+                vUnkIds[n] = nIds;
                 nIds++;
             }
         }
         nIds = 0;
-        for (std::map<int, CAddrInfo>::const_iterator it = mapInfo.begin(); it != mapInfo.end(); it++) {
-            const CAddrInfo &info = (*it).second;
+        for (const CAddrInfo &info : vInfo) {
             if (info.fInTried) {
                 assert(nIds != nTried); // this means nTried was wrong, oh ow
                 s << info;
@@ -335,7 +366,7 @@ public:
             s << nSize;
             for (int i = 0; i < ADDRMAN_BUCKET_SIZE; i++) {
                 if (vvNew[bucket][i] != -1) {
-                    int nIndex = mapUnkIds[vvNew[bucket][i]];
+                    int nIndex = vUnkIds[vvNew[bucket][i]];
                     s << nIndex;
                 }
             }
@@ -363,33 +394,40 @@ public:
             nUBuckets ^= (1 << 30);
         }
 
-        if (nNew > ADDRMAN_NEW_BUCKET_COUNT * ADDRMAN_BUCKET_SIZE) {
+        if (nNew < 0 || nNew > ADDRMAN_NEW_BUCKET_COUNT * ADDRMAN_BUCKET_SIZE) {
             throw std::ios_base::failure("Corrupt CAddrMan serialization, nNew exceeds limit.");
         }
 
-        if (nTried > ADDRMAN_TRIED_BUCKET_COUNT * ADDRMAN_BUCKET_SIZE) {
+        if (nTried < 0 || nTried > ADDRMAN_TRIED_BUCKET_COUNT * ADDRMAN_BUCKET_SIZE) {
             throw std::ios_base::failure("Corrupt CAddrMan serialization, nTried exceeds limit.");
         }
 
+        vInfo.reserve(nNew + nTried);
+        vRandom.reserve(nNew + nTried);
+        size_t nAddrTableSize = vAddrTable.size();
+        while (nAddrTableSize < 2 * (size_t)(nNew + nTried))
+            nAddrTableSize *= 2;
+        RehashAddrTable(nAddrTableSize);
+
         // Deserialize entries from the new table.
+        vInfo.resize(nNew);
         for (int n = 0; n < nNew; n++) {
-            CAddrInfo &info = mapInfo[n];
+            CAddrInfo &info = vInfo[n];
             s >> info;
-            mapAddr[info] = n;
             info.nRandomPos = vRandom.size();
             vRandom.push_back(n);
+            InsertAddr(n);
             if (nVersion != 1 || nUBuckets != ADDRMAN_NEW_BUCKET_COUNT) {
                 // In case the new table data cannot be used (nVersion unknown, or bucket count wrong),
                 // immediately try to give them a reference based on their primary source address.
                 int nUBucket = info.GetNewBucket(nKey);
                 int nUBucketPos = info.GetBucketPosition(nKey, true, nUBucket);
                 if (vvNew[nUBucket][nUBucketPos] == -1) {
-                    vvNew[nUBucket][nUBucketPos] = n;
+                    SetNew(nUBucket, nUBucketPos, n);
                     info.nRefCount++;
                 }
             }
         }
-        nIdCount = nNew;
 
         // Deserialize entries from the tried table.
         int nLost = 0;
@@ -399,13 +437,13 @@ public:
             int nKBucket = info.GetTriedBucket(nKey);
             int nKBucketPos = info.GetBucketPosition(nKey, false, nKBucket);
             if (vvTried[nKBucket][nKBucketPos] == -1) {
+                int nId = vInfo.size();
                 info.nRandomPos = vRandom.size();
                 info.fInTried = true;
-                vRandom.push_back(nIdCount);
-                mapInfo[nIdCount] = info;
-                mapAddr[info] = nIdCount;
-                vvTried[nKBucket][nKBucketPos] = nIdCount;
-                nIdCount++;
+                vRandom.push_back(nId);
+                vInfo.push_back(info);
+                InsertAddr(nId);
+                SetTried(nKBucket, nKBucketPos, nId);
             } else {
                 nLost++;
             }
@@ -420,11 +458,11 @@ public:
                 int nIndex = 0;
                 s >> nIndex;
                 if (nIndex >= 0 && nIndex < nNew) {
-                    CAddrInfo &info = mapInfo[nIndex];
+                    CAddrInfo &info = vInfo[nIndex];
                     int nUBucketPos = info.GetBucketPosition(nKey, true, bucket);
                     if (nVersion == 1 && nUBuckets == ADDRMAN_NEW_BUCKET_COUNT && vvNew[bucket][nUBucketPos] == -1 && info.nRefCount < ADDRMAN_NEW_BUCKETS_PER_ADDRESS) {
                         info.nRefCount++;
-                        vvNew[bucket][nUBucketPos] = nIndex;
+                        SetNew(bucket, nUBucketPos, nIndex);
                     }
                 }
             }
@@ -432,13 +470,10 @@ public:
 
         // Prune new entries with refcount 0 (as a result of collisions).
         int nLostUnk = 0;
-        for (std::map<int, CAddrInfo>::const_iterator it = mapInfo.begin(); it != mapInfo.end(); ) {
-            if (it->second.fInTried == false && it->second.nRefCount == 0) {
-                std::map<int, CAddrInfo>::const_iterator itCopy = it++;
-                Delete(itCopy->first);
+        for (size_t n = 0; n < vInfo.size(); n++) {
+            if (vInfo[n].nRandomPos != -1 && vInfo[n].fInTried == false && vInfo[n].nRefCount == 0) {
+                Delete(n);
                 nLostUnk++;
-            } else {
-                it++;
             }
         }
         if (nLost + nLostUnk > 0) {
@@ -450,20 +485,28 @@ public:
 
     void Clear()
     {
+        std::vector<CAddrInfo>().swap(vInfo);
+        std::vector<int>().swap(vFreeIds);
         std::vector<int>().swap(vRandom);
+        std::vector<int>().swap(vTriedSlots);
+        std::vector<int>().swap(vNewSlots);
         nKey = GetRandHash();
+        nAddrTableKey0 = GetRand(std::numeric_limits<uint64_t>::max());
+        nAddrTableKey1 = GetRand(std::numeric_limits<uint64_t>::max());
+        vAddrTable.assign(ADDRMAN_MIN_ADDR_TABLE_SIZE, -1);
         for (size_t bucket = 0; bucket < ADDRMAN_NEW_BUCKET_COUNT; bucket++) {
             for (size_t entry = 0; entry < ADDRMAN_BUCKET_SIZE; entry++) {
                 vvNew[bucket][entry] = -1;
+                vvNewSlotIndex[bucket][entry] = -1;
             }
         }
         for (size_t bucket = 0; bucket < ADDRMAN_TRIED_BUCKET_COUNT; bucket++) {
             for (size_t entry = 0; entry < ADDRMAN_BUCKET_SIZE; entry++) {
                 vvTried[bucket][entry] = -1;
+                vvTriedSlotIndex[bucket][entry] = -1;
             }
         }
 
-        nIdCount = 0;
         nTried = 0;
         nNew = 0;
         nLastGood = 1; //Initially at 1 so that "never" is strictly worse.
@@ -0,0 +1,53 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "bloom.h"
+#include "hash.h"
+#include "primitives/transaction.h"
+#include "script/script.h"
+#include "uint256.h"
+#include "utilstrencodings.h"
+
+#include <vector>
+
+static uint256 BenchHash(uint32_t n)
+{
+    return Hash(BEGIN(n), END(n));
+}
+
+// Match the transactions of a block against the filter of an SPV wallet
+// with a few hundred keys, as done for every MSG_FILTERED_BLOCK request.
+static void BloomMatchBlock(benchmark::State& state)
+{
+    CBloomFilter filterWallet(500, 0.0001, 0, BLOOM_UPDATE_NONE);
+    for (uint32_t i = 0; i < 500; i++)
+        filterWallet.insert(std::vector<unsigned char>(BenchHash(i).begin(), BenchHash(i).begin() + 20));
+
+    std::vector<CTransactionRef> vtx;
+    for (uint32_t i = 0; i < 2000; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(2);
+        for (uint32_t j = 0; j < tx.vin.size(); j++) {
+            tx.vin[j].prevout = COutPoint(BenchHash(1000000 + 2 * i + j), j);
+            std::vector<unsigned char> vchSig(72, i), vchPubKey(33, j);
+            tx.vin[j].scriptSig << vchSig << vchPubKey;
+        }
+        tx.vout.resize(2);
+        for (uint32_t j = 0; j < tx.vout.size(); j++) {
+            uint256 hashKey = BenchHash(2000000 + 2 * i + j);
+            tx.vout[j].scriptPubKey << OP_DUP << OP_HASH160 << std::vector<unsigned char>(hashKey.begin(), hashKey.begin() + 20) << OP_EQUALVERIFY << OP_CHECKSIG;
+        }
+        vtx.push_back(MakeTransactionRef(std::move(tx)));
+    }
+
+    std::vector<bool> vMatch;
+    while (state.KeepRunning()) {
+        CBloomFilter filter(filterWallet);
+        filter.IsRelevantAndUpdate(vtx, vMatch);
+    }
+}
+
+BENCHMARK(BloomMatchBlock);
@@ -40,13 +40,16 @@ static void DeserializeAndCheckBlockTest(benchmark::State& state)
     char a;
     stream.write(&a, 1); // Prevent compaction
 
+    SelectParams(CBaseChainParams::MAIN);
+
     while (state.KeepRunning()) {
         CBlock block; // Note that CBlock caches its checked state, so we need to recreate it here
         stream >> block;
         assert(stream.Rewind(sizeof(block_bench::block413567)));
 
         CValidationState validationState;
-        assert(CheckBlock(block, validationState));
+        // The block comes from a chain with a different proof of work
+        assert(CheckBlock(block, validationState, false));
     }
 }
 
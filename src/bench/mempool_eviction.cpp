@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "bench.h"
+#include "crypto/common.h"
 #include "policy/policy.h"
 #include "txmempool.h"
 
@@ -22,9 +23,8 @@ static void AddTx(const CTransaction& tx, const CAmount& nFee, CTxMemPool& pool)
                                         tx.GetValueOut(), spendsCoinbase, sigOpCount, lp));
 }
 
-// Right now this is only testing eviction performance in an extremely small
-// mempool. Code needs to be written to generate a much wider variety of
-// unique transactions for a more meaningful performance measurement.
+// Eviction performance in an extremely small mempool; see
+// MempoolEvictionLarge for a full size one.
 static void MempoolEviction(benchmark::State& state)
 {
     CMutableTransaction tx1 = CMutableTransaction();
@@ -113,3 +113,55 @@ static void MempoolEviction(benchmark::State& state)
 }
 
 BENCHMARK(MempoolEviction);
+
+// Number of transactions in the pool for MempoolEvictionLarge
+static const int LARGE_POOL_TXS = 1000000;
+// Transactions added (and the same amount evicted) per iteration
+static const int LARGE_POOL_BATCH = 1000;
+
+// Transaction number n, in clusters of one to four chained transactions
+static CMutableTransaction MakeClusterTx(uint64_t n, const uint256& parent)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    if (n % 4 == 0 || (n % 4) > (n / 4) % 4) {
+        // Starts a new cluster, spending something outside the pool
+        uint256 prev;
+        WriteLE64(prev.begin(), n);
+        tx.vin[0].prevout = COutPoint(prev, 0);
+    } else {
+        tx.vin[0].prevout = COutPoint(parent, 0);
+    }
+    tx.vin[0].scriptSig = CScript() << OP_1;
+    tx.vout.resize(1);
+    tx.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+    tx.vout[0].nValue = COIN;
+    return tx;
+}
+
+// Eviction in a full pool of a million transactions, as seen when spam keeps
+// the mempool at its size limit: every batch of new transactions pushes out
+// the same number of low fee packages.
+static void MempoolEvictionLarge(benchmark::State& state)
+{
+    CTxMemPool pool(CFeeRate(1000));
+    uint64_t n = 0;
+    uint256 parent;
+    for (; n < LARGE_POOL_TXS; n++) {
+        CMutableTransaction tx = MakeClusterTx(n, parent);
+        AddTx(tx, 1000 + (n * 7919) % 100000, pool);
+        parent = tx.GetHash();
+    }
+    const size_t nLimit = pool.DynamicMemoryUsage();
+
+    while (state.KeepRunning()) {
+        for (int i = 0; i < LARGE_POOL_BATCH; i++, n++) {
+            CMutableTransaction tx = MakeClusterTx(n, parent);
+            AddTx(tx, 1000 + (n * 7919) % 100000, pool);
+            parent = tx.GetHash();
+        }
+        pool.TrimToSize(nLimit);
+    }
+}
+
+BENCHMARK(MempoolEvictionLarge);
@@ -0,0 +1,52 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockdownload.h"
+
+#include <algorithm>
+#include <cmath>
+
+//! Weight of a new sample in the averages
+static const double BLOCK_DOWNLOAD_SAMPLE_WEIGHT = 0.25;
+
+void CBlockDownloadEstimator::AddSample(size_t nBytes, int64_t nElapsed)
+{
+    if (nBytes == 0)
+        return;
+    // Deliveries faster than the clock resolution still take some time
+    double dSample = (double)nBytes / std::max<int64_t>(nElapsed, 1);
+    if (dThroughput == 0) {
+        dThroughput = dSample;
+        dBlockSize = nBytes;
+    } else {
+        dThroughput += BLOCK_DOWNLOAD_SAMPLE_WEIGHT * (dSample - dThroughput);
+        dBlockSize += BLOCK_DOWNLOAD_SAMPLE_WEIGHT * (nBytes - dBlockSize);
+    }
+}
+
+int CBlockDownloadEstimator::GetTargetBlocksInFlight(int nDefault) const
+{
+    if (!HasEstimate())
+        return nDefault;
+    double dBlocks = std::ceil(dThroughput * nLatency / dBlockSize) + 1;
+    return std::max<double>(MIN_ADAPTIVE_BLOCKS_IN_TRANSIT_PER_PEER, std::min<double>(dBlocks, MAX_ADAPTIVE_BLOCKS_IN_TRANSIT_PER_PEER));
+}
+
+int64_t CBlockDownloadEstimator::EstimateDeliveryTime(size_t nBytes) const
+{
+    if (!HasEstimate())
+        return -1;
+    return nLatency + (int64_t)(nBytes / dThroughput);
+}
+
+bool ShouldTakeOverBlock(const CBlockDownloadEstimator& estimator, const CBlockDownloadEstimator& staller, int64_t nStallerElapsed)
+{
+    if (!estimator.HasEstimate())
+        return false;
+    size_t nBytes = estimator.GetAverageBlockSize();
+    int64_t nDeliveryTime = estimator.EstimateDeliveryTime(nBytes);
+    if (!staller.HasEstimate())
+        return nStallerElapsed > nDeliveryTime;
+    return nDeliveryTime * BLOCK_DOWNLOAD_TAKEOVER_SPEEDUP < staller.EstimateDeliveryTime(nBytes);
+}
@@ -0,0 +1,74 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef NOVO_BLOCKDOWNLOAD_H
+#define NOVO_BLOCKDOWNLOAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Minimum number of blocks in flight from a peer whose throughput is known, so the next request overlaps a transfer */
+static const int MIN_ADAPTIVE_BLOCKS_IN_TRANSIT_PER_PEER = 2;
+/** Maximum number of blocks in flight from a peer whose throughput is known */
+static const int MAX_ADAPTIVE_BLOCKS_IN_TRANSIT_PER_PEER = 64;
+/** Round trip time assumed for peers we have not pinged yet, in microseconds */
+static const int64_t DEFAULT_BLOCK_DOWNLOAD_LATENCY = 500000;
+/** How many times faster than the staller a peer must be expected to deliver a block to take it over */
+static const int BLOCK_DOWNLOAD_TAKEOVER_SPEEDUP = 2;
+
+/**
+ * Estimates how fast a peer delivers the blocks we request from it.
+ *
+ * Blocks requested from a peer are delivered back to back, so the time
+ * between a block becoming the first one in flight and its arrival is spent
+ * transferring it. Exponentially weighted averages of the resulting
+ * throughput and of the block size, together with the ping round trip time,
+ * give the bandwidth-delay product of the connection: the number of blocks
+ * that keeps it busy without queueing more at a slow peer than needed.
+ */
+class CBlockDownloadEstimator
+{
+private:
+    //! Average throughput in bytes per microsecond, 0 while unknown
+    double dThroughput;
+    //! Average size in bytes of the delivered blocks
+    double dBlockSize;
+    //! Round trip time in microseconds
+    int64_t nLatency;
+
+public:
+    CBlockDownloadEstimator() : dThroughput(0), dBlockSize(0), nLatency(DEFAULT_BLOCK_DOWNLOAD_LATENCY) {}
+
+    /** Record the delivery of a block of nBytes that took nElapsed microseconds */
+    void AddSample(size_t nBytes, int64_t nElapsed);
+    /** Set the round trip time to the peer, in microseconds */
+    void SetLatency(int64_t nLatencyIn) { nLatency = nLatencyIn; }
+
+    bool HasEstimate() const { return dThroughput > 0; }
+    /** Throughput in bytes per second, or 0 while unknown */
+    double GetThroughput() const { return dThroughput * 1000000; }
+    /** Average size of the delivered blocks */
+    size_t GetAverageBlockSize() const { return dBlockSize; }
+
+    /**
+     * Number of blocks to keep in flight from the peer: its bandwidth-delay
+     * product in blocks, plus the block being transferred. Returns nDefault
+     * while the throughput is unknown.
+     */
+    int GetTargetBlocksInFlight(int nDefault) const;
+
+    /** Expected time in microseconds to receive nBytes when requested now, or -1 while unknown */
+    int64_t EstimateDeliveryTime(size_t nBytes) const;
+};
+
+/**
+ * Whether the block that holds up the download window at a stalling peer
+ * should be requested from another peer instead. The other peer must be
+ * expected to deliver a block BLOCK_DOWNLOAD_TAKEOVER_SPEEDUP times faster,
+ * or, while the staller's speed is unknown, faster than the nStallerElapsed
+ * microseconds the staller has been downloading already.
+ */
+bool ShouldTakeOverBlock(const CBlockDownloadEstimator& estimator, const CBlockDownloadEstimator& staller, int64_t nStallerElapsed);
+
+#endif // NOVO_BLOCKDOWNLOAD_H
@@ -13,6 +13,8 @@
 #include "validation.h"
 #include "util.h"
 
+#include <algorithm>
+#include <math.h>
 #include <unordered_map>
 
 #define MIN_TRANSACTION_BASE_SIZE (::GetSerializeSize(CTransaction(), SER_NETWORK, PROTOCOL_VERSION))
@@ -47,6 +49,126 @@ uint64_t CBlockHeaderAndShortTxIDs::GetShortID(const uint256& txhash) const {
 
 
 
+//! Highest false positive rate of a graphene block's filter, which keeps it at two or more bits per transaction
+static const double GRAPHENE_MAX_FP_RATE = 0.25;
+//! Serialized size of an IBLT per key in the difference it decodes
+static const double GRAPHENE_IBLT_BYTES_PER_TX = 1.5 * 16;
+//! Fraction of the block the receiver is expected to lack, which the IBLT is sized for on top of the false positives
+static const size_t GRAPHENE_MISSING_TX_DIVISOR = 50;
+
+/**
+ * Choose the false positive rate of the filter of a graphene block with
+ * nBlockTx transactions for a receiver with nPoolTx mempool transactions,
+ * and the number of false positives the IBLT must be able to list.
+ */
+static void GetGrapheneFilterParams(size_t nBlockTx, uint64_t nPoolTx, double& nFPRate, size_t& nFalsePositives)
+{
+    static const double LN2SQUARED = 0.4804530139182014246671025263266649717305529515945455;
+    const double nTx = std::max(nBlockTx, (size_t)1);
+    // A filter below one byte is rounded down to none, which everything passes
+    const double nMaxFPRate = std::min(GRAPHENE_MAX_FP_RATE, exp(-8 * LN2SQUARED / nTx));
+    // The receiver's count is not checked, so do not size for more than any
+    // mempool could hold
+    nPoolTx = std::min(nPoolTx, MAX_GRAPHENE_RECEIVER_POOL_TX);
+    if (nPoolTx <= nBlockTx) {
+        nFPRate = nMaxFPRate;
+        nFalsePositives = 0;
+        return;
+    }
+    double nExcess = nPoolTx - nBlockTx;
+    // The filter takes n * -ln(f) / (8 * ln(2)^2) bytes and the IBLT c bytes
+    // per false positive, a = f * (m - n). Their sum is smallest for
+    // a = n / (8 * c * ln(2)^2).
+    double nOptimal = nTx / (8 * GRAPHENE_IBLT_BYTES_PER_TX * LN2SQUARED);
+    nFPRate = std::min(nOptimal / nExcess, nMaxFPRate);
+    // The protocol limit on the filter size bounds how low the rate can go
+    double nMinFPRate = exp(-(double)MAX_BLOOM_FILTER_SIZE * 8 * LN2SQUARED / nTx);
+    nFPRate = std::max(nFPRate, nMinFPRate);
+    // Allow for two standard deviations more false positives than expected
+    double nExpected = nFPRate * nExcess;
+    nFalsePositives = ceil(nExpected + 2 * sqrt(nExpected));
+}
+
+//! Number of bits per transaction in the order of a graphene block with nTx non-coinbase transactions
+static unsigned int GetGrapheneOrderBits(size_t nTx)
+{
+    unsigned int nBits = 0;
+    while (((size_t)1 << nBits) < nTx)
+        nBits++;
+    return nBits;
+}
+
+static size_t GetGrapheneOrderSize(size_t nTx)
+{
+    return (nTx * GetGrapheneOrderBits(nTx) + 7) / 8;
+}
+
+//! Number of cells of the IBLT of a graphene block with nTx non-coinbase transactions
+static size_t GetGrapheneIBLTCells(size_t nTx, uint64_t nReceiverPoolTx)
+{
+    double nFPRate;
+    size_t nFalsePositives;
+    GetGrapheneFilterParams(nTx, nReceiverPoolTx, nFPRate, nFalsePositives);
+    return CIBLT::CellsForDifference(nFalsePositives + nTx / GRAPHENE_MISSING_TX_DIVISOR + 1);
+}
+
+bool CGrapheneBlock::IsEncodable(size_t nBlockTx, uint64_t nReceiverPoolTx)
+{
+    return GetGrapheneIBLTCells(std::max(nBlockTx, (size_t)1) - 1, nReceiverPoolTx) <= MAX_GRAPHENE_IBLT_CELLS;
+}
+
+CGrapheneBlock::CGrapheneBlock(const CBlock& block, uint64_t nReceiverPoolTx) :
+        nonce(GetRand(std::numeric_limits<uint64_t>::max())),
+        nBlockTx(block.vtx.size()), coinbase(block.vtx[0]), header(block) {
+    FillShortTxIDSelector();
+    const size_t nTx = block.vtx.size() - 1;
+
+    double nFPRate;
+    size_t nFalsePositives;
+    GetGrapheneFilterParams(nTx, nReceiverPoolTx, nFPRate, nFalsePositives);
+    filter = CBloomFilter(std::max(nTx, (size_t)1), nFPRate, GetRand(std::numeric_limits<uint32_t>::max()), BLOOM_UPDATE_NONE);
+    // Callers check IsEncodable first, so this only bounds the allocation
+    iblt = CIBLT(std::min(GetGrapheneIBLTCells(nTx, nReceiverPoolTx), MAX_GRAPHENE_IBLT_CELLS));
+
+    std::vector<uint64_t> vShortIds(nTx);
+    for (size_t i = 0; i < nTx; i++) {
+        const uint256& txhash = block.vtx[i + 1]->GetHash();
+        filter.insert(txhash);
+        vShortIds[i] = GetShortID(txhash);
+        iblt.Insert(vShortIds[i]);
+    }
+
+    std::vector<uint64_t> vSorted(vShortIds);
+    std::sort(vSorted.begin(), vSorted.end());
+    const unsigned int nBits = GetGrapheneOrderBits(nTx);
+    vOrder.assign(GetGrapheneOrderSize(nTx), 0);
+    for (size_t i = 0; i < nTx; i++) {
+        uint64_t nRank = std::lower_bound(vSorted.begin(), vSorted.end(), vShortIds[i]) - vSorted.begin();
+        for (unsigned int j = 0; j < nBits; j++) {
+            size_t nPos = i * nBits + j;
+            if ((nRank >> j) & 1)
+                vOrder[nPos / 8] |= 1 << (nPos % 8);
+        }
+    }
+}
+
+void CGrapheneBlock::FillShortTxIDSelector() const {
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << header << nonce;
+    CSHA256 hasher;
+    hasher.Write((unsigned char*)&(*stream.begin()), stream.end() - stream.begin());
+    uint256 shorttxidhash;
+    hasher.Finalize(shorttxidhash.begin());
+    shorttxidk0 = shorttxidhash.GetUint64(0);
+    shorttxidk1 = shorttxidhash.GetUint64(1);
+}
+
+uint64_t CGrapheneBlock::GetShortID(const uint256& txhash) const {
+    return SipHashUint256(shorttxidk0, shorttxidk1, txhash);
+}
+
+
+
 ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& cmpctblock, const std::vector<std::pair<uint256, CTransactionRef>>& extra_txn) {
     if (cmpctblock.header.IsNull() || (cmpctblock.shorttxids.empty() && cmpctblock.prefilledtxn.empty()))
         return READ_STATUS_INVALID;
@@ -175,6 +297,100 @@ bool PartiallyDownloadedBlock::IsTxAvailable(size_t index) const {
     return txn_available[index] ? true : false;
 }
 
+ReadStatus PartiallyDownloadedBlock::InitData(const CGrapheneBlock& grapheneblock, const std::vector<std::pair<uint256, CTransactionRef>>& extra_txn) {
+    if (grapheneblock.header.IsNull() || grapheneblock.nBlockTx == 0 || !grapheneblock.coinbase || grapheneblock.coinbase->IsNull())
+        return READ_STATUS_INVALID;
+    if (grapheneblock.nBlockTx > MAX_BLOCK_BASE_SIZE / MIN_TRANSACTION_BASE_SIZE)
+        return READ_STATUS_INVALID;
+    const size_t nTx = grapheneblock.nBlockTx - 1;
+    if (!grapheneblock.filter.IsWithinSizeConstraints() || !grapheneblock.iblt.IsValid() ||
+            grapheneblock.vOrder.size() != GetGrapheneOrderSize(nTx))
+        return READ_STATUS_INVALID;
+
+    assert(header.IsNull() && txn_available.empty());
+
+    // Transactions we have that pass the filter are the candidates for the block
+    std::unordered_map<uint64_t, CTransactionRef> mapCandidates;
+    CIBLT candidates(grapheneblock.iblt.size());
+    bool fCollision = false;
+    auto AddCandidate = [&](const uint256& txhash, const CTransactionRef& tx) {
+        if (!grapheneblock.filter.contains(txhash))
+            return;
+        uint64_t shortid = grapheneblock.GetShortID(txhash);
+        auto ret = mapCandidates.emplace(shortid, tx);
+        if (ret.second)
+            candidates.Insert(shortid);
+        else if (ret.first->second->GetHash() != txhash)
+            fCollision = true;
+    };
+    {
+    LOCK(pool->cs);
+    for (const auto& entry : pool->vTxHashes)
+        AddCandidate(entry.first, entry.second->GetSharedTx());
+    }
+    for (const auto& entry : extra_txn) {
+        if (entry.second)
+            AddCandidate(entry.first, entry.second);
+    }
+    if (fCollision)
+        return READ_STATUS_FAILED;
+
+    // The difference holds the block transactions we lack and our false positives
+    CIBLT difference(grapheneblock.iblt);
+    difference -= candidates;
+    std::vector<uint64_t> vMissing, vFalsePositives;
+    if (!difference.Decode(vMissing, vFalsePositives))
+        return READ_STATUS_FAILED;
+    for (uint64_t shortid : vFalsePositives) {
+        if (!mapCandidates.erase(shortid))
+            return READ_STATUS_FAILED;
+    }
+
+    std::vector<uint64_t> vShortIds;
+    vShortIds.reserve(mapCandidates.size() + vMissing.size());
+    for (const auto& entry : mapCandidates)
+        vShortIds.push_back(entry.first);
+    for (uint64_t shortid : vMissing) {
+        if (mapCandidates.count(shortid))
+            return READ_STATUS_FAILED;
+        vShortIds.push_back(shortid);
+    }
+    if (vShortIds.size() != nTx)
+        return READ_STATUS_FAILED;
+    std::sort(vShortIds.begin(), vShortIds.end());
+
+    header = grapheneblock.header;
+    txn_available.resize(grapheneblock.nBlockTx);
+    txn_available[0] = grapheneblock.coinbase;
+    prefilled_count = 1;
+
+    const unsigned int nBits = GetGrapheneOrderBits(nTx);
+    std::vector<bool> vRankUsed(nTx);
+    for (size_t i = 0; i < nTx; i++) {
+        uint64_t nRank = 0;
+        for (unsigned int j = 0; j < nBits; j++) {
+            size_t nPos = i * nBits + j;
+            if ((grapheneblock.vOrder[nPos / 8] >> (nPos % 8)) & 1)
+                nRank |= (uint64_t)1 << j;
+        }
+        if (nRank >= nTx || vRankUsed[nRank]) {
+            header.SetNull();
+            txn_available.clear();
+            return READ_STATUS_FAILED;
+        }
+        vRankUsed[nRank] = true;
+        auto it = mapCandidates.find(vShortIds[nRank]);
+        if (it != mapCandidates.end()) {
+            txn_available[i + 1] = it->second;
+            mempool_count++;
+        }
+    }
+
+    LogPrint("cmpctblock", "Initialized PartiallyDownloadedBlock for block %s using a graphene block of size %lu (%lu false positives, %lu txn missing)\n", grapheneblock.header.GetHash().ToString(), GetSerializeSize(grapheneblock, SER_NETWORK, PROTOCOL_VERSION), vFalsePositives.size(), vMissing.size());
+
+    return READ_STATUS_OK;
+}
+
 ReadStatus PartiallyDownloadedBlock::FillBlock(CBlock& block, const std::vector<CTransactionRef>& vtx_missing) {
     assert(!header.IsNull());
     uint256 hash = header.GetHash();
@@ -5,10 +5,25 @@
 #ifndef NOVO_BLOCK_ENCODINGS_H
 #define NOVO_BLOCK_ENCODINGS_H
 
+#include "bloom.h"
+#include "iblt.h"
 #include "primitives/block.h"
 
 #include <memory>
 
+/** Default for -graphene, requesting graphene blocks from peers that support them */
+static const bool DEFAULT_GRAPHENE = false;
+/** Version of the graphene block protocol announced in "sendgraphene" */
+static const uint64_t GRAPHENE_VERSION = 1;
+/**
+ * Mempool size a graphene block is encoded for at most, whatever the
+ * receiver reports: four times the transactions of 60 bytes or more that fit
+ * in a default 300MB mempool.
+ */
+static const uint64_t MAX_GRAPHENE_RECEIVER_POOL_TX = 4 * 300 * 1000 * 1000 / 60;
+/** Maximum number of IBLT cells in a graphene block, 2MB serialized */
+static const size_t MAX_GRAPHENE_IBLT_CELLS = 2 * 1000 * 1000 / 16;
+
 class CTxMemPool;
 
 // Dumb helper to handle CTransaction compression at serialize-time
@@ -191,6 +206,73 @@ public:
     }
 };
 
+/**
+ * A block encoded against the receiver's mempool, after Graphene (Ozisik et
+ * al., 2017).
+ *
+ * Besides the header and coinbase it holds a Bloom filter of the other
+ * transactions' txids, sized for the number of transactions in the
+ * receiver's mempool, and an IBLT of their short ids. The receiver inserts
+ * the short ids of the transactions passing the filter into an IBLT of its
+ * own and subtracts it, which leaves the filter's false positives and the
+ * block transactions it lacks. The order of the transactions is sent as the
+ * rank of each short id among the sorted short ids of the block.
+ */
+class CGrapheneBlock {
+private:
+    mutable uint64_t shorttxidk0, shorttxidk1;
+    uint64_t nonce;
+
+    void FillShortTxIDSelector() const;
+
+    friend class PartiallyDownloadedBlock;
+
+protected:
+    uint64_t nBlockTx;
+    CTransactionRef coinbase;
+    CBloomFilter filter;
+    CIBLT iblt;
+    std::vector<unsigned char> vOrder;
+
+public:
+    CBlockHeader header;
+
+    // Dummy for deserialization
+    CGrapheneBlock() {}
+
+    /** Encode a block for a receiver with nReceiverPoolTx transactions in its mempool */
+    CGrapheneBlock(const CBlock& block, uint64_t nReceiverPoolTx);
+
+    /**
+     * Whether a block of nBlockTx transactions can be encoded for a receiver
+     * with nReceiverPoolTx mempool transactions within MAX_GRAPHENE_IBLT_CELLS.
+     * Blocks that cannot are sent some other way.
+     */
+    static bool IsEncodable(size_t nBlockTx, uint64_t nReceiverPoolTx);
+
+    uint64_t GetShortID(const uint256& txhash) const;
+
+    size_t BlockTxCount() const { return nBlockTx; }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(header);
+        READWRITE(nonce);
+        READWRITE(COMPACTSIZE(nBlockTx));
+        READWRITE(coinbase);
+        READWRITE(filter);
+        READWRITE(iblt);
+        READWRITE(vOrder);
+
+        if (ser_action.ForRead()) {
+            filter.UpdateEmptyFull();
+            FillShortTxIDSelector();
+        }
+    }
+};
+
 class PartiallyDownloadedBlock {
 protected:
     std::vector<CTransactionRef> txn_available;
@@ -202,6 +284,7 @@ public:
 
     // extra_txn is a list of extra transactions to look at, in <txhash, reference> form
     ReadStatus InitData(const CBlockHeaderAndShortTxIDs& cmpctblock, const std::vector<std::pair<uint256, CTransactionRef>>& extra_txn);
+    ReadStatus InitData(const CGrapheneBlock& grapheneblock, const std::vector<std::pair<uint256, CTransactionRef>>& extra_txn);
     bool IsTxAvailable(size_t index) const;
     ReadStatus FillBlock(CBlock& block, const std::vector<CTransactionRef>& vtx_missing);
 };
@@ -0,0 +1,84 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilecache.h"
+
+#include "chain.h"
+#include "util.h"
+#include "validation.h"
+
+CBlockFileCache::CBlockFileCache(size_t nMaxIdleIn) : nMaxIdle(nMaxIdleIn)
+{
+}
+
+CBlockFileCache::~CBlockFileCache()
+{
+    Clear();
+}
+
+FILE* CBlockFileCache::Acquire(const CDiskBlockPos& pos)
+{
+    if (pos.IsNull())
+        return NULL;
+
+    FILE* file = NULL;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (FileList::iterator it = listIdle.begin(); it != listIdle.end(); ++it) {
+            if (it->first == pos.nFile) {
+                file = it->second;
+                listIdle.erase(it);
+                break;
+            }
+        }
+    }
+
+    if (!file)
+        return OpenBlockFile(pos, true);
+
+    // Block files are preallocated and then filled in, so data buffered by an
+    // earlier read may be stale. fflush on an input stream discards the
+    // buffer, and makes fseek read from the file again.
+    if (fflush(file) || fseek(file, pos.nPos, SEEK_SET)) {
+        LogPrintf("Unable to seek to position %u of block file %d\n", pos.nPos, pos.nFile);
+        fclose(file);
+        return NULL;
+    }
+    return file;
+}
+
+void CBlockFileCache::Release(int nFile, FILE* file)
+{
+    if (!file)
+        return;
+
+    FILE* fileEvicted = NULL;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        listIdle.push_front(std::make_pair(nFile, file));
+        if (listIdle.size() > nMaxIdle) {
+            fileEvicted = listIdle.back().second;
+            listIdle.pop_back();
+        }
+    }
+    if (fileEvicted)
+        fclose(fileEvicted);
+}
+
+void CBlockFileCache::Clear()
+{
+    FileList listClose;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        listClose.swap(listIdle);
+    }
+    for (const auto& entry : listClose)
+        fclose(entry.second);
+}
+
+size_t CBlockFileCache::GetIdleCount()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return listIdle.size();
+}
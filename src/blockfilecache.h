@@ -0,0 +1,53 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef NOVO_BLOCKFILECACHE_H
+#define NOVO_BLOCKFILECACHE_H
+
+#include <stdio.h>
+
+#include <list>
+#include <mutex>
+#include <utility>
+
+struct CDiskBlockPos;
+
+/** Default number of idle block file descriptors kept open for lookups */
+static const size_t DEFAULT_BLOCKFILE_CACHE_SIZE = 16;
+
+/**
+ * Least recently used cache of block file descriptors for random reads.
+ *
+ * A descriptor is used by one reader at a time: Acquire takes an idle
+ * descriptor for the file out of the cache, or opens a new one, and Release
+ * hands it back. Concurrent readers of the same file therefore never share
+ * a file position and need no lock while seeking and deserializing. Once
+ * more than nMaxIdle descriptors are idle the least recently used one is
+ * closed.
+ */
+class CBlockFileCache
+{
+public:
+    explicit CBlockFileCache(size_t nMaxIdleIn = DEFAULT_BLOCKFILE_CACHE_SIZE);
+    ~CBlockFileCache();
+
+    /** Return a descriptor for pos.nFile positioned at pos.nPos, or NULL on failure */
+    FILE* Acquire(const CDiskBlockPos& pos);
+    /** Return a descriptor obtained from Acquire to the cache */
+    void Release(int nFile, FILE* file);
+    /** Close all idle descriptors */
+    void Clear();
+
+    size_t GetIdleCount();
+
+private:
+    typedef std::list<std::pair<int, FILE*> > FileList;
+
+    std::mutex mutex;
+    //! Idle descriptors, most recently used first
+    FileList listIdle;
+    const size_t nMaxIdle;
+};
+
+#endif // NOVO_BLOCKFILECACHE_H
@@ -0,0 +1,67 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockindexmap.h"
+
+#include "memusage.h"
+
+const CBlockIndexMap::id_type CBlockIndexMap::NO_ID;
+const size_t CBlockIndexMap::CHUNK_SIZE;
+
+//! Initial number of table slots
+static const size_t BLOCKINDEXMAP_INITIAL_TABLE_SIZE = 1024;
+
+CBlockIndexMap::CBlockIndexMap() : nSize(0), vTable(BLOCKINDEXMAP_INITIAL_TABLE_SIZE, NO_ID)
+{
+}
+
+CBlockIndexMap::~CBlockIndexMap()
+{
+    clear();
+}
+
+CBlockIndexMap::id_type CBlockIndexMap::FindId(const uint256& hash) const
+{
+    for (size_t nBucket = Bucket(hash); vTable[nBucket] != NO_ID; nBucket = (nBucket + 1) & (vTable.size() - 1)) {
+        id_type id = vTable[nBucket];
+        if (GetEntry(id).value.first == hash)
+            return id;
+    }
+    return NO_ID;
+}
+
+void CBlockIndexMap::Rehash(size_t nTableSize)
+{
+    vTable.assign(nTableSize, NO_ID);
+    for (id_type id = 0; id < nSize; id++) {
+        size_t nBucket = Bucket(GetEntry(id).value.first);
+        while (vTable[nBucket] != NO_ID)
+            nBucket = (nBucket + 1) & (vTable.size() - 1);
+        vTable[nBucket] = id;
+    }
+}
+
+void CBlockIndexMap::reserve(size_type n)
+{
+    size_t nTableSize = vTable.size();
+    while (n * 2 > nTableSize)
+        nTableSize *= 2;
+    if (nTableSize != vTable.size())
+        Rehash(nTableSize);
+}
+
+void CBlockIndexMap::clear()
+{
+    for (id_type id = 0; id < nSize; id++)
+        GetEntry(id).~Entry();
+    vChunks.clear();
+    nSize = 0;
+    vTable.assign(BLOCKINDEXMAP_INITIAL_TABLE_SIZE, NO_ID);
+}
+
+size_t CBlockIndexMap::DynamicMemoryUsage() const
+{
+    return memusage::DynamicUsage(vChunks) + vChunks.size() * memusage::MallocUsage(CHUNK_SIZE * sizeof(Slot)) +
+           memusage::DynamicUsage(vTable);
+}
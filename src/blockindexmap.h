@@ -0,0 +1,176 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef NOVO_BLOCKINDEXMAP_H
+#define NOVO_BLOCKINDEXMAP_H
+
+#include "chain.h"
+#include "uint256.h"
+
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Owning map from block hash to CBlockIndex, used for mapBlockIndex.
+ *
+ * Entries are constructed in place in an arena of fixed size chunks and
+ * identified by their 32-bit position in it, so they never move and are
+ * laid out in insertion order, which during sync is close to height order.
+ * Lookups go through a flat open addressing table of entry ids. Compared to
+ * a node based hash map holding separately allocated CBlockIndex objects this
+ * saves two heap allocations and the node and bucket overhead per block.
+ *
+ * Entries are never removed individually. Iteration visits them in
+ * insertion order. The interface follows the parts of std::unordered_map
+ * that callers of mapBlockIndex rely on; the CBlockIndex of an entry is
+ * owned by the map and its phashBlock points at the entry's key.
+ */
+class CBlockIndexMap
+{
+public:
+    typedef std::pair<const uint256, CBlockIndex*> value_type;
+    typedef uint32_t id_type;
+    typedef size_t size_type;
+
+    static const id_type NO_ID = 0xffffffff;
+    /** Number of entries per arena chunk */
+    static const size_t CHUNK_SIZE = 4096;
+
+private:
+    struct Entry
+    {
+        value_type value;
+        CBlockIndex index;
+
+        template <typename... Args>
+        Entry(const uint256& hash, Args&&... args) : value(hash, &index), index(std::forward<Args>(args)...)
+        {
+            index.phashBlock = &value.first;
+        }
+    };
+    typedef typename std::aligned_storage<sizeof(Entry), alignof(Entry)>::type Slot;
+
+    std::vector<std::unique_ptr<Slot[]> > vChunks;
+    size_t nSize;
+    //! Open addressing table of entry ids, linear probing. Size is a power of two.
+    std::vector<id_type> vTable;
+
+    Entry& GetEntry(id_type id) const
+    {
+        return *reinterpret_cast<Entry*>(&vChunks[id / CHUNK_SIZE][id % CHUNK_SIZE]);
+    }
+
+    size_t Bucket(const uint256& hash) const { return hash.GetCheapHash() & (vTable.size() - 1); }
+    /** Id of the entry for hash, or NO_ID */
+    id_type FindId(const uint256& hash) const;
+    void Rehash(size_t nTableSize);
+
+public:
+    template <typename Map, typename Value>
+    class iterator_base : public std::iterator<std::forward_iterator_tag, Value>
+    {
+        friend class CBlockIndexMap;
+        Map* map;
+        id_type id;
+
+        iterator_base(Map* mapIn, id_type idIn) : map(mapIn), id(idIn) {}
+
+    public:
+        iterator_base() : map(NULL), id(0) {}
+        // Allow conversion from iterator to const_iterator
+        template <typename OtherMap, typename OtherValue>
+        iterator_base(const iterator_base<OtherMap, OtherValue>& other) : map(other.map), id(other.id) {}
+
+        Value& operator*() const { return map->GetEntry(id).value; }
+        Value* operator->() const { return &map->GetEntry(id).value; }
+        iterator_base& operator++() { id++; return *this; }
+        iterator_base operator++(int) { iterator_base ret = *this; id++; return ret; }
+        bool operator==(const iterator_base& other) const { return id == other.id && map == other.map; }
+        bool operator!=(const iterator_base& other) const { return !(*this == other); }
+
+        template <typename OtherMap, typename OtherValue>
+        friend class iterator_base;
+    };
+    typedef iterator_base<CBlockIndexMap, value_type> iterator;
+    typedef iterator_base<const CBlockIndexMap, const value_type> const_iterator;
+
+    CBlockIndexMap();
+    ~CBlockIndexMap();
+
+    CBlockIndexMap(const CBlockIndexMap&) = delete;
+    CBlockIndexMap& operator=(const CBlockIndexMap&) = delete;
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, nSize); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, nSize); }
+
+    size_type size() const { return nSize; }
+    bool empty() const { return nSize == 0; }
+
+    iterator find(const uint256& hash)
+    {
+        id_type id = FindId(hash);
+        return id == NO_ID ? end() : iterator(this, id);
+    }
+    const_iterator find(const uint256& hash) const
+    {
+        id_type id = FindId(hash);
+        return id == NO_ID ? end() : const_iterator(this, id);
+    }
+    size_type count(const uint256& hash) const { return FindId(hash) == NO_ID ? 0 : 1; }
+
+    /** The block index for hash, or NULL. Unlike std::unordered_map, never inserts. */
+    CBlockIndex* operator[](const uint256& hash) const
+    {
+        id_type id = FindId(hash);
+        return id == NO_ID ? NULL : &GetEntry(id).index;
+    }
+
+    /**
+     * Construct the block index for hash from args, unless there already is
+     * one. Returns the entry and whether it was inserted.
+     */
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(const uint256& hash, Args&&... args)
+    {
+        id_type id = FindId(hash);
+        if (id != NO_ID)
+            return std::make_pair(iterator(this, id), false);
+
+        assert(nSize < NO_ID);
+        // Keep the table at most half full
+        if ((nSize + 1) * 2 > vTable.size())
+            Rehash(vTable.size() * 2);
+        if (nSize % CHUNK_SIZE == 0 && nSize / CHUNK_SIZE == vChunks.size())
+            vChunks.emplace_back(new Slot[CHUNK_SIZE]);
+
+        id = nSize;
+        new (&vChunks[id / CHUNK_SIZE][id % CHUNK_SIZE]) Entry(hash, std::forward<Args>(args)...);
+        nSize++;
+
+        size_t nBucket = Bucket(hash);
+        while (vTable[nBucket] != NO_ID)
+            nBucket = (nBucket + 1) & (vTable.size() - 1);
+        vTable[nBucket] = id;
+        return std::make_pair(iterator(this, id), true);
+    }
+
+    /** Grow the table ahead of inserting up to n entries in total */
+    void reserve(size_type n);
+
+    /** The block index with the given id, which must be less than size() */
+    CBlockIndex* GetById(id_type id) const { return &GetEntry(id).index; }
+
+    /** Destroy all block index entries */
+    void clear();
+
+    /** Memory used by the map and its entries */
+    size_t DynamicMemoryUsage() const;
+};
+
+#endif // NOVO_BLOCKINDEXMAP_H
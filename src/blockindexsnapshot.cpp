@@ -0,0 +1,213 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockindexsnapshot.h"
+
+#include "arith_uint256.h"
+#include "chain.h"
+#include "crypto/common.h"
+#include "crypto/sha256.h"
+#include "uint256.h"
+#include "util.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+#include <boost/filesystem.hpp>
+
+static const unsigned char SNAPSHOT_MAGIC[8] = {'n', 'o', 'v', 'o', 'b', 'i', 'd', 'x'};
+static const uint32_t SNAPSHOT_VERSION = 1;
+//! Marks a missing pprev or pskip
+static const uint32_t SNAPSHOT_NO_ENTRY = 0xffffffff;
+
+//! magic, version, entry count, best block of the chainstate
+static const size_t SNAPSHOT_HEADER_SIZE = 8 + 4 + 4 + 32;
+//! hash, prev, skip, height, file, data pos, undo pos, chain work, tx, chain tx, status,
+//! version, merkle root, time, bits, nonce, time max
+static const size_t SNAPSHOT_RECORD_SIZE = 32 + 4 * 6 + 32 + 4 * 3 + 4 + 32 + 4 * 4;
+//! Number of records read or written per I/O call
+static const size_t SNAPSHOT_BATCH = 4096;
+
+namespace {
+
+void EncodeRecord(unsigned char* p, const CBlockIndex* pindex, uint32_t nPrev, uint32_t nSkip)
+{
+    memcpy(p, pindex->GetBlockHash().begin(), 32); p += 32;
+    WriteLE32(p, nPrev); p += 4;
+    WriteLE32(p, nSkip); p += 4;
+    WriteLE32(p, pindex->nHeight); p += 4;
+    WriteLE32(p, pindex->nFile); p += 4;
+    WriteLE32(p, pindex->nDataPos); p += 4;
+    WriteLE32(p, pindex->nUndoPos); p += 4;
+    uint256 chainWork = ArithToUint256(pindex->nChainWork);
+    memcpy(p, chainWork.begin(), 32); p += 32;
+    WriteLE32(p, pindex->nTx); p += 4;
+    WriteLE32(p, pindex->nChainTx); p += 4;
+    WriteLE32(p, pindex->nStatus); p += 4;
+    WriteLE32(p, pindex->nVersion); p += 4;
+    memcpy(p, pindex->hashMerkleRoot.begin(), 32); p += 32;
+    WriteLE32(p, pindex->nTime); p += 4;
+    WriteLE32(p, pindex->nBits); p += 4;
+    WriteLE32(p, pindex->nNonce); p += 4;
+    WriteLE32(p, pindex->nTimeMax);
+}
+
+/** Fill in pindex from a record, returning its prev and skip positions */
+void DecodeRecord(const unsigned char* p, CBlockIndex* pindex, uint32_t& nPrev, uint32_t& nSkip)
+{
+    p += 32; // hash, already used as the key
+    nPrev = ReadLE32(p); p += 4;
+    nSkip = ReadLE32(p); p += 4;
+    pindex->nHeight = ReadLE32(p); p += 4;
+    pindex->nFile = ReadLE32(p); p += 4;
+    pindex->nDataPos = ReadLE32(p); p += 4;
+    pindex->nUndoPos = ReadLE32(p); p += 4;
+    uint256 chainWork;
+    memcpy(chainWork.begin(), p, 32); p += 32;
+    pindex->nChainWork = UintToArith256(chainWork);
+    pindex->nTx = ReadLE32(p); p += 4;
+    pindex->nChainTx = ReadLE32(p); p += 4;
+    pindex->nStatus = ReadLE32(p); p += 4;
+    pindex->nVersion = ReadLE32(p); p += 4;
+    memcpy(pindex->hashMerkleRoot.begin(), p, 32); p += 32;
+    pindex->nTime = ReadLE32(p); p += 4;
+    pindex->nBits = ReadLE32(p); p += 4;
+    pindex->nNonce = ReadLE32(p); p += 4;
+    pindex->nTimeMax = ReadLE32(p);
+}
+
+} // anon namespace
+
+bool WriteBlockIndexSnapshot(const boost::filesystem::path& path, const CBlockIndexMap& mapIndex, const uint256& hashBestChain)
+{
+    // Parents have a lower height than their children, so they are written first
+    std::vector<std::pair<int, const CBlockIndex*> > vSorted;
+    vSorted.reserve(mapIndex.size());
+    for (const CBlockIndexMap::value_type& item : mapIndex)
+        vSorted.push_back(std::make_pair(item.second->nHeight, item.second));
+    std::sort(vSorted.begin(), vSorted.end());
+    std::unordered_map<const CBlockIndex*, uint32_t> mapPos;
+    mapPos.reserve(vSorted.size());
+    for (size_t i = 0; i < vSorted.size(); i++)
+        mapPos[vSorted[i].second] = i;
+
+    boost::filesystem::path pathTmp = path;
+    pathTmp += ".new";
+    FILE* file = fopen(pathTmp.string().c_str(), "wb");
+    if (!file)
+        return error("%s: Failed to open %s", __func__, pathTmp.string());
+
+    CSHA256 hasher;
+    std::vector<unsigned char> buf(std::max(SNAPSHOT_HEADER_SIZE, SNAPSHOT_BATCH * SNAPSHOT_RECORD_SIZE));
+    memcpy(&buf[0], SNAPSHOT_MAGIC, 8);
+    WriteLE32(&buf[8], SNAPSHOT_VERSION);
+    WriteLE32(&buf[12], vSorted.size());
+    memcpy(&buf[16], hashBestChain.begin(), 32);
+    bool fOk = fwrite(&buf[0], 1, SNAPSHOT_HEADER_SIZE, file) == SNAPSHOT_HEADER_SIZE;
+    hasher.Write(&buf[0], SNAPSHOT_HEADER_SIZE);
+
+    for (size_t nStart = 0; fOk && nStart < vSorted.size(); nStart += SNAPSHOT_BATCH) {
+        size_t nCount = std::min(SNAPSHOT_BATCH, vSorted.size() - nStart);
+        for (size_t i = 0; i < nCount; i++) {
+            const CBlockIndex* pindex = vSorted[nStart + i].second;
+            uint32_t nPrev = pindex->pprev ? mapPos[pindex->pprev] : SNAPSHOT_NO_ENTRY;
+            uint32_t nSkip = pindex->pskip ? mapPos[pindex->pskip] : SNAPSHOT_NO_ENTRY;
+            EncodeRecord(&buf[i * SNAPSHOT_RECORD_SIZE], pindex, nPrev, nSkip);
+        }
+        size_t nBytes = nCount * SNAPSHOT_RECORD_SIZE;
+        fOk = fwrite(&buf[0], 1, nBytes, file) == nBytes;
+        hasher.Write(&buf[0], nBytes);
+    }
+
+    unsigned char checksum[CSHA256::OUTPUT_SIZE];
+    hasher.Finalize(checksum);
+    fOk = fOk && fwrite(checksum, 1, sizeof(checksum), file) == sizeof(checksum);
+    if (fOk)
+        FileCommit(file);
+    fOk = fclose(file) == 0 && fOk;
+    if (!fOk || !RenameOver(pathTmp, path)) {
+        boost::system::error_code ec;
+        boost::filesystem::remove(pathTmp, ec);
+        return error("%s: Failed to write %s", __func__, path.string());
+    }
+    LogPrint("bench", "Wrote block index snapshot with %u entries\n", vSorted.size());
+    return true;
+}
+
+bool ReadBlockIndexSnapshot(const boost::filesystem::path& path, CBlockIndexMap& mapIndex, const uint256& hashBestChain,
+                            std::vector<CBlockIndex*>& vSortedByHeight)
+{
+    assert(mapIndex.empty());
+    vSortedByHeight.clear();
+
+    FILE* file = fopen(path.string().c_str(), "rb");
+    if (!file)
+        return false;
+
+    CSHA256 hasher;
+    std::vector<unsigned char> buf(std::max(SNAPSHOT_HEADER_SIZE, SNAPSHOT_BATCH * SNAPSHOT_RECORD_SIZE));
+    bool fOk = fread(&buf[0], 1, SNAPSHOT_HEADER_SIZE, file) == SNAPSHOT_HEADER_SIZE &&
+               memcmp(&buf[0], SNAPSHOT_MAGIC, 8) == 0 && ReadLE32(&buf[8]) == SNAPSHOT_VERSION &&
+               memcmp(&buf[16], hashBestChain.begin(), 32) == 0;
+    const uint32_t nEntries = fOk ? ReadLE32(&buf[12]) : 0;
+    hasher.Write(&buf[0], SNAPSHOT_HEADER_SIZE);
+    if (!fOk) {
+        LogPrintf("%s: %s does not match the chainstate, ignoring it\n", __func__, path.string());
+        fclose(file);
+        return false;
+    }
+
+    // Check the size before trusting the entry count
+    if (fseek(file, 0, SEEK_END) != 0 ||
+        (uint64_t)ftell(file) != SNAPSHOT_HEADER_SIZE + (uint64_t)nEntries * SNAPSHOT_RECORD_SIZE + CSHA256::OUTPUT_SIZE ||
+        fseek(file, SNAPSHOT_HEADER_SIZE, SEEK_SET) != 0) {
+        LogPrintf("%s: %s is corrupt, ignoring it\n", __func__, path.string());
+        fclose(file);
+        return false;
+    }
+    vSortedByHeight.reserve(nEntries);
+    for (uint32_t nStart = 0; fOk && nStart < nEntries; nStart += SNAPSHOT_BATCH) {
+        size_t nCount = std::min<size_t>(SNAPSHOT_BATCH, nEntries - nStart);
+        size_t nBytes = nCount * SNAPSHOT_RECORD_SIZE;
+        if (fread(&buf[0], 1, nBytes, file) != nBytes) {
+            fOk = false;
+            break;
+        }
+        hasher.Write(&buf[0], nBytes);
+        for (size_t i = 0; i < nCount; i++) {
+            const unsigned char* p = &buf[i * SNAPSHOT_RECORD_SIZE];
+            uint256 hash;
+            memcpy(hash.begin(), p, 32);
+            std::pair<CBlockIndexMap::iterator, bool> ret = mapIndex.emplace(hash);
+            uint32_t nPrev, nSkip;
+            CBlockIndex* pindex = ret.first->second;
+            DecodeRecord(p, pindex, nPrev, nSkip);
+            // Links may only point back to entries that were already loaded
+            uint32_t nPos = vSortedByHeight.size();
+            if (!ret.second || (nPrev != SNAPSHOT_NO_ENTRY && nPrev >= nPos) || (nSkip != SNAPSHOT_NO_ENTRY && nSkip >= nPos)) {
+                fOk = false;
+                break;
+            }
+            pindex->pprev = nPrev == SNAPSHOT_NO_ENTRY ? NULL : vSortedByHeight[nPrev];
+            pindex->pskip = nSkip == SNAPSHOT_NO_ENTRY ? NULL : vSortedByHeight[nSkip];
+            vSortedByHeight.push_back(pindex);
+        }
+    }
+
+    if (fOk) {
+        unsigned char checksum[CSHA256::OUTPUT_SIZE], checksumFile[CSHA256::OUTPUT_SIZE];
+        hasher.Finalize(checksum);
+        fOk = fread(checksumFile, 1, sizeof(checksumFile), file) == sizeof(checksumFile) &&
+              memcmp(checksum, checksumFile, sizeof(checksum)) == 0 && fgetc(file) == EOF;
+    }
+    fclose(file);
+
+    if (!fOk) {
+        LogPrintf("%s: %s is corrupt, ignoring it\n", __func__, path.string());
+        mapIndex.clear();
+        vSortedByHeight.clear();
+        return false;
+    }
+    return true;
+}
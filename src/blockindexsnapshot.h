@@ -0,0 +1,44 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef NOVO_BLOCKINDEXSNAPSHOT_H
+#define NOVO_BLOCKINDEXSNAPSHOT_H
+
+#include "blockindexmap.h"
+
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+
+class CBlockIndex;
+class uint256;
+
+/** Default for -blockindexsnapshot */
+static const bool DEFAULT_BLOCKINDEX_SNAPSHOT = true;
+
+/**
+ * Block index snapshots let a node that was shut down cleanly skip reading
+ * and linking the block tree database at startup.
+ *
+ * The snapshot holds every block index entry as a fixed size little endian
+ * record, including the memory-only chain work, transaction count and skip
+ * pointer, in height order so that parents precede children and refer to
+ * them by position. Loading is a sequential read with no per-entry
+ * deserialization or recomputation. The file is protected by a checksum and
+ * tied to the chainstate's best block; a node loading it removes it right
+ * away, as the block tree database moves on from there.
+ */
+
+/** Write the entries of mapIndex to path, for a chainstate at hashBestChain. */
+bool WriteBlockIndexSnapshot(const boost::filesystem::path& path, const CBlockIndexMap& mapIndex, const uint256& hashBestChain);
+
+/**
+ * Load the snapshot at path into the empty mapIndex, if it was written for
+ * a chainstate at hashBestChain. vSortedByHeight receives the loaded entries
+ * in height order. On failure mapIndex is left empty.
+ */
+bool ReadBlockIndexSnapshot(const boost::filesystem::path& path, CBlockIndexMap& mapIndex, const uint256& hashBestChain,
+                            std::vector<CBlockIndex*>& vSortedByHeight);
+
+#endif // NOVO_BLOCKINDEXSNAPSHOT_H
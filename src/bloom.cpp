@@ -5,6 +5,7 @@
 #include "bloom.h"
 
 #include "primitives/transaction.h"
+#include "crypto/common.h"
 #include "hash.h"
 #include "script/script.h"
 #include "script/standard.h"
@@ -19,6 +20,11 @@
 #define LN2SQUARED 0.4804530139182014246671025263266649717305529515945455
 #define LN2 0.6931471805599453094172321214581765680755001343602552
 
+//! Number of hash functions computed together for a key; contains() stops after the first batch with a bit unset
+static const unsigned int BLOOM_HASH_BATCH = 8;
+//! Size of a serialized COutPoint
+static const size_t OUTPOINT_KEY_SIZE = 36;
+
 CBloomFilter::CBloomFilter(unsigned int nElements, double nFPRate, unsigned int nTweakIn, unsigned char nFlagsIn) :
     /**
      * The ideal size for a bloom filter with a given number of elements and false positive rate is:
@@ -50,67 +56,95 @@ CBloomFilter::CBloomFilter(unsigned int nElements, double nFPRate, unsigned int
 {
 }
 
-inline unsigned int CBloomFilter::Hash(unsigned int nHashNum, const std::vector<unsigned char>& vDataToHash) const
+void CBloomFilter::Hash(unsigned int nFirst, unsigned int nCount, const unsigned char* pch, size_t nLen, uint32_t* pnIndexes) const
 {
-    // 0xFBA4C795 chosen as it guarantees a reasonable bit difference between nHashNum values.
-    return MurmurHash3(nHashNum * 0xFBA4C795 + nTweak, vDataToHash) % (vData.size() * 8);
+    uint32_t vSeeds[BLOOM_HASH_BATCH];
+    assert(nCount <= BLOOM_HASH_BATCH);
+    for (unsigned int i = 0; i < nCount; i++) {
+        // 0xFBA4C795 chosen as it guarantees a reasonable bit difference between nHashNum values.
+        vSeeds[i] = (nFirst + i) * 0xFBA4C795 + nTweak;
+    }
+    MurmurHash3Multi(vSeeds, nCount, pch, nLen, pnIndexes);
+    for (unsigned int i = 0; i < nCount; i++)
+        pnIndexes[i] %= vData.size() * 8;
 }
 
-void CBloomFilter::insert(const std::vector<unsigned char>& vKey)
+void CBloomFilter::InsertKey(const unsigned char* pch, size_t nLen)
 {
     if (isFull)
         return;
-    for (unsigned int i = 0; i < nHashFuncs; i++)
+    uint32_t vIndexes[BLOOM_HASH_BATCH];
+    for (unsigned int i = 0; i < nHashFuncs; i += BLOOM_HASH_BATCH)
     {
-        unsigned int nIndex = Hash(i, vKey);
-        // Sets bit nIndex of vData
-        vData[nIndex >> 3] |= (1 << (7 & nIndex));
+        unsigned int nCount = std::min(nHashFuncs - i, BLOOM_HASH_BATCH);
+        Hash(i, nCount, pch, nLen, vIndexes);
+        for (unsigned int j = 0; j < nCount; j++) {
+            // Sets bit nIndex of vData
+            vData[vIndexes[j] >> 3] |= (1 << (7 & vIndexes[j]));
+        }
     }
     isEmpty = false;
 }
 
+bool CBloomFilter::ContainsKey(const unsigned char* pch, size_t nLen) const
+{
+    if (isFull)
+        return true;
+    if (isEmpty)
+        return false;
+    uint32_t vIndexes[BLOOM_HASH_BATCH];
+    for (unsigned int i = 0; i < nHashFuncs; i += BLOOM_HASH_BATCH)
+    {
+        unsigned int nCount = std::min(nHashFuncs - i, BLOOM_HASH_BATCH);
+        Hash(i, nCount, pch, nLen, vIndexes);
+        for (unsigned int j = 0; j < nCount; j++) {
+            // Checks bit nIndex of vData
+            if (!(vData[vIndexes[j] >> 3] & (1 << (7 & vIndexes[j]))))
+                return false;
+        }
+    }
+    return true;
+}
+
+/** Serialize outpoint as the bloom filter key for it, the same as CDataStream would */
+static inline void OutPointKey(const COutPoint& outpoint, unsigned char* pch)
+{
+    memcpy(pch, outpoint.hash.begin(), 32);
+    WriteLE32(pch + 32, outpoint.n);
+}
+
+void CBloomFilter::insert(const std::vector<unsigned char>& vKey)
+{
+    InsertKey(vKey.data(), vKey.size());
+}
+
 void CBloomFilter::insert(const COutPoint& outpoint)
 {
-    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
-    stream << outpoint;
-    std::vector<unsigned char> data(stream.begin(), stream.end());
-    insert(data);
+    unsigned char key[OUTPOINT_KEY_SIZE];
+    OutPointKey(outpoint, key);
+    InsertKey(key, sizeof(key));
 }
 
 void CBloomFilter::insert(const uint256& hash)
 {
-    std::vector<unsigned char> data(hash.begin(), hash.end());
-    insert(data);
+    InsertKey(hash.begin(), hash.size());
 }
 
 bool CBloomFilter::contains(const std::vector<unsigned char>& vKey) const
 {
-    if (isFull)
-        return true;
-    if (isEmpty)
-        return false;
-    for (unsigned int i = 0; i < nHashFuncs; i++)
-    {
-        unsigned int nIndex = Hash(i, vKey);
-        // Checks bit nIndex of vData
-        if (!(vData[nIndex >> 3] & (1 << (7 & nIndex))))
-            return false;
-    }
-    return true;
+    return ContainsKey(vKey.data(), vKey.size());
 }
 
 bool CBloomFilter::contains(const COutPoint& outpoint) const
 {
-    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
-    stream << outpoint;
-    std::vector<unsigned char> data(stream.begin(), stream.end());
-    return contains(data);
+    unsigned char key[OUTPOINT_KEY_SIZE];
+    OutPointKey(outpoint, key);
+    return ContainsKey(key, sizeof(key));
 }
 
 bool CBloomFilter::contains(const uint256& hash) const
 {
-    std::vector<unsigned char> data(hash.begin(), hash.end());
-    return contains(data);
+    return ContainsKey(hash.begin(), hash.size());
 }
 
 void CBloomFilter::clear()
@@ -133,13 +167,30 @@ bool CBloomFilter::IsWithinSizeConstraints() const
 
 bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
 {
-    bool fFound = false;
-    // Match if the filter contains the hash of tx
-    //  for finding tx when they appear in a block
     if (isFull)
         return true;
     if (isEmpty)
         return false;
+    std::vector<unsigned char> data;
+    return MatchAndUpdate(tx, data);
+}
+
+void CBloomFilter::IsRelevantAndUpdate(const std::vector<CTransactionRef>& vtx, std::vector<bool>& vMatch)
+{
+    // Matching never empties or fills the filter, so check that once
+    vMatch.assign(vtx.size(), isFull);
+    if (isFull || isEmpty)
+        return;
+    std::vector<unsigned char> data;
+    for (size_t i = 0; i < vtx.size(); i++)
+        vMatch[i] = MatchAndUpdate(*vtx[i], data);
+}
+
+bool CBloomFilter::MatchAndUpdate(const CTransaction& tx, std::vector<unsigned char>& data)
+{
+    bool fFound = false;
+    // Match if the filter contains the hash of tx
+    //  for finding tx when they appear in a block
     const uint256& hash = tx.GetHash();
     if (contains(hash))
         fFound = true;
@@ -152,7 +203,6 @@ bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
         // This means clients don't have to update the filter themselves when a new relevant tx 
         // is discovered in order to find spending transactions, which avoids round-tripping and race conditions.
         CScript::const_iterator pc = txout.scriptPubKey.begin();
-        std::vector<unsigned char> data;
         while (pc < txout.scriptPubKey.end())
         {
             opcodetype opcode;
@@ -187,7 +237,6 @@ bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
 
         // Match if the filter contains any arbitrary script data element in any scriptSig in tx
         CScript::const_iterator pc = txin.scriptSig.begin();
-        std::vector<unsigned char> data;
         while (pc < txin.scriptSig.end())
         {
             opcodetype opcode;
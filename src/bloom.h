@@ -5,12 +5,11 @@
 #ifndef NOVO_BLOOM_H
 #define NOVO_BLOOM_H
 
+#include "primitives/transaction.h"
 #include "serialize.h"
 
 #include <vector>
 
-class COutPoint;
-class CTransaction;
 class uint256;
 
 //! 20,000 items with fp rate < 0.1% or 10,000 items and <0.0001%
@@ -51,7 +50,12 @@ private:
     unsigned int nTweak;
     unsigned char nFlags;
 
-    unsigned int Hash(unsigned int nHashNum, const std::vector<unsigned char>& vDataToHash) const;
+    //! Bit positions in vData of hash functions nFirst to nFirst + nCount - 1 for the nLen byte key at pch
+    void Hash(unsigned int nFirst, unsigned int nCount, const unsigned char* pch, size_t nLen, uint32_t* pnIndexes) const;
+    void InsertKey(const unsigned char* pch, size_t nLen);
+    bool ContainsKey(const unsigned char* pch, size_t nLen) const;
+    //! IsRelevantAndUpdate for a filter that is neither empty nor full. data is scratch space for script pushes.
+    bool MatchAndUpdate(const CTransaction& tx, std::vector<unsigned char>& data);
 
     // Private constructor for CRollingBloomFilter, no restrictions on size
     CBloomFilter(unsigned int nElements, double nFPRate, unsigned int nTweak);
@@ -98,6 +102,13 @@ public:
     //! Also adds any outputs which match the filter to the filter (to match their spending txes)
     bool IsRelevantAndUpdate(const CTransaction& tx);
 
+    /**
+     * IsRelevantAndUpdate for all transactions of a block, in order, setting
+     * vMatch to the results. Outputs added by a transaction are seen by the
+     * ones after it, like with one call per transaction.
+     */
+    void IsRelevantAndUpdate(const std::vector<CTransactionRef>& vtx, std::vector<bool>& vMatch);
+
     //! Checks for empty and full filters to avoid wasting cpu
     void UpdateEmptyFull();
 };
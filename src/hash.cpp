@@ -7,6 +7,10 @@
 #include "crypto/hmac_sha512.h"
 #include "pubkey.h"
 
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define HAVE_MURMURHASH3_AVX2 1
+#endif
 
 inline uint32_t ROTL32(uint32_t x, int8_t r)
 {
@@ -74,6 +78,114 @@ unsigned int MurmurHash3(unsigned int nHashSeed, const std::vector<unsigned char
     return h1;
 }
 
+namespace {
+
+const uint32_t MURMUR_C1 = 0xcc9e2d51;
+const uint32_t MURMUR_C2 = 0x1b873593;
+
+/** The part of the MurmurHash3 mixing of a 4-byte block that is independent of the seed */
+inline uint32_t MurmurMixK1(uint32_t k1)
+{
+    k1 *= MURMUR_C1;
+    k1 = ROTL32(k1, 15);
+    k1 *= MURMUR_C2;
+    return k1;
+}
+
+/** The seed independent value of the tail bytes, 0 if there are none */
+inline uint32_t MurmurTailK1(const unsigned char* pch, size_t nLen)
+{
+    const unsigned char* tail = pch + (nLen & ~(size_t)3);
+    uint32_t k1 = 0;
+    switch (nLen & 3) {
+    case 3:
+        k1 ^= tail[2] << 16;
+        // Falls through
+    case 2:
+        k1 ^= tail[1] << 8;
+        // Falls through
+    case 1:
+        k1 ^= tail[0];
+        return MurmurMixK1(k1);
+    }
+    return 0;
+}
+
+void MurmurHash3MultiGeneric(const uint32_t* pnSeeds, unsigned int nHashes, const unsigned char* pch, size_t nLen, uint32_t* pnHashes)
+{
+    for (unsigned int i = 0; i < nHashes; i++)
+        pnHashes[i] = pnSeeds[i];
+    for (size_t nPos = 0; nPos + 4 <= nLen; nPos += 4) {
+        uint32_t k1 = MurmurMixK1(ReadLE32(pch + nPos));
+        for (unsigned int i = 0; i < nHashes; i++) {
+            uint32_t h1 = pnHashes[i] ^ k1;
+            h1 = ROTL32(h1, 13);
+            pnHashes[i] = h1 * 5 + 0xe6546b64;
+        }
+    }
+    uint32_t k1 = MurmurTailK1(pch, nLen);
+    for (unsigned int i = 0; i < nHashes; i++) {
+        uint32_t h1 = pnHashes[i] ^ k1 ^ (uint32_t)nLen;
+        h1 ^= h1 >> 16;
+        h1 *= 0x85ebca6b;
+        h1 ^= h1 >> 13;
+        h1 *= 0xc2b2ae35;
+        h1 ^= h1 >> 16;
+        pnHashes[i] = h1;
+    }
+}
+
+#ifdef HAVE_MURMURHASH3_AVX2
+/** MurmurHash3 under eight seeds at once, one per 32-bit lane */
+__attribute__((target("avx2")))
+void MurmurHash3x8AVX2(const uint32_t* pnSeeds, const unsigned char* pch, size_t nLen, uint32_t* pnHashes)
+{
+    __m256i h1 = _mm256_loadu_si256((const __m256i*)pnSeeds);
+    const __m256i n = _mm256_set1_epi32(0xe6546b64);
+    for (size_t nPos = 0; nPos + 4 <= nLen; nPos += 4) {
+        h1 = _mm256_xor_si256(h1, _mm256_set1_epi32(MurmurMixK1(ReadLE32(pch + nPos))));
+        h1 = _mm256_or_si256(_mm256_slli_epi32(h1, 13), _mm256_srli_epi32(h1, 19));
+        // h1 * 5 + n
+        h1 = _mm256_add_epi32(_mm256_add_epi32(_mm256_slli_epi32(h1, 2), h1), n);
+    }
+    h1 = _mm256_xor_si256(h1, _mm256_set1_epi32(MurmurTailK1(pch, nLen) ^ (uint32_t)nLen));
+    h1 = _mm256_xor_si256(h1, _mm256_srli_epi32(h1, 16));
+    h1 = _mm256_mullo_epi32(h1, _mm256_set1_epi32(0x85ebca6b));
+    h1 = _mm256_xor_si256(h1, _mm256_srli_epi32(h1, 13));
+    h1 = _mm256_mullo_epi32(h1, _mm256_set1_epi32(0xc2b2ae35));
+    h1 = _mm256_xor_si256(h1, _mm256_srli_epi32(h1, 16));
+    _mm256_storeu_si256((__m256i*)pnHashes, h1);
+}
+
+bool HaveAVX2()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+} // anon namespace
+
+void MurmurHash3Multi(const uint32_t* pnSeeds, unsigned int nHashes, const unsigned char* pch, size_t nLen, uint32_t* pnHashes)
+{
+#ifdef HAVE_MURMURHASH3_AVX2
+    static const bool fAVX2 = HaveAVX2();
+    if (fAVX2) {
+        for (; nHashes >= 8; nHashes -= 8, pnSeeds += 8, pnHashes += 8)
+            MurmurHash3x8AVX2(pnSeeds, pch, nLen, pnHashes);
+        if (nHashes > 1) {
+            // Hashing unused lanes costs less than hashing the rest one seed at a time
+            uint32_t vSeeds[8] = {0}, vHashes[8];
+            memcpy(vSeeds, pnSeeds, nHashes * sizeof(uint32_t));
+            MurmurHash3x8AVX2(vSeeds, pch, nLen, vHashes);
+            memcpy(pnHashes, vHashes, nHashes * sizeof(uint32_t));
+            return;
+        }
+    }
+#endif
+    MurmurHash3MultiGeneric(pnSeeds, nHashes, pch, nLen, pnHashes);
+}
+
 void BIP32Hash(const ChainCode &chainCode, unsigned int nChild, unsigned char header, const unsigned char data[32], unsigned char output[64])
 {
     unsigned char num[4];
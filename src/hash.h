@@ -185,6 +185,14 @@ uint256 SerializeHash(const T& obj, int nType=SER_GETHASH, int nVersion=PROTOCOL
 
 unsigned int MurmurHash3(unsigned int nHashSeed, const std::vector<unsigned char>& vDataToHash);
 
+/**
+ * MurmurHash3 of the nLen bytes at pch under each of the nHashes seeds in
+ * pnSeeds, written to pnHashes. The block mixing does not depend on the seed,
+ * so it is done once for all of them, and on CPUs with AVX2 eight seeds are
+ * hashed at a time.
+ */
+void MurmurHash3Multi(const uint32_t* pnSeeds, unsigned int nHashes, const unsigned char* pch, size_t nLen, uint32_t* pnHashes);
+
 void BIP32Hash(const ChainCode &chainCode, unsigned int nChild, unsigned char header, const unsigned char data[32], unsigned char output[64]);
 
 /** Return a CHashWriter primed for tagged hashes (as specified in BIP 340).
@@ -0,0 +1,160 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "headerssync.h"
+
+CCheckpointHeadersSync::CCheckpointHeadersSync(const MapCheckpoints& checkpoints)
+{
+    MapCheckpoints::const_iterator it = checkpoints.begin();
+    while (it != checkpoints.end()) {
+        MapCheckpoints::const_iterator itNext = it;
+        if (++itNext == checkpoints.end())
+            break;
+        if (itNext->first - it->first <= MAX_HEADERS_RANGE_LENGTH) {
+            Range range;
+            range.nStartHeight = it->first;
+            range.hashStart = it->second;
+            range.nEndHeight = itNext->first;
+            range.hashEnd = itNext->second;
+            Reset(range);
+            vRanges.push_back(range);
+        }
+        it = itNext;
+    }
+}
+
+void CCheckpointHeadersSync::Reset(Range& range)
+{
+    range.node = -1;
+    range.fAssigned = false;
+    range.nLastProgress = 0;
+    range.vHeaders.clear();
+    range.vHeaders.shrink_to_fit();
+    range.hashLast = range.hashStart;
+}
+
+CCheckpointHeadersSync::Range* CCheckpointHeadersSync::Find(NodeId node)
+{
+    for (Range& range : vRanges) {
+        if (range.fAssigned && range.node == node)
+            return &range;
+    }
+    return NULL;
+}
+
+const CCheckpointHeadersSync::Range* CCheckpointHeadersSync::Find(NodeId node) const
+{
+    return const_cast<CCheckpointHeadersSync*>(this)->Find(node);
+}
+
+bool CCheckpointHeadersSync::AssignRange(NodeId node, int nBestHeaderHeight, int nPeerHeight, int64_t nNow, uint256& hashLocator, uint256& hashStop)
+{
+    if (HasRange(node) || CountAssigned() >= MAX_HEADERS_RANGE_PEERS)
+        return false;
+    for (Range& range : vRanges) {
+        if (range.fAssigned || range.IsComplete() || range.nStartHeight <= nBestHeaderHeight || range.nEndHeight > nPeerHeight)
+            continue;
+        range.node = node;
+        range.fAssigned = true;
+        range.nLastProgress = nNow;
+        hashLocator = range.hashLast;
+        hashStop = range.hashEnd;
+        return true;
+    }
+    return false;
+}
+
+bool CCheckpointHeadersSync::HasRange(NodeId node) const
+{
+    return Find(node) != NULL;
+}
+
+int CCheckpointHeadersSync::CountAssigned() const
+{
+    int nCount = 0;
+    for (const Range& range : vRanges)
+        nCount += range.fAssigned;
+    return nCount;
+}
+
+bool CCheckpointHeadersSync::IsStalling(NodeId node, int64_t nNow) const
+{
+    const Range* range = Find(node);
+    return range && nNow > range->nLastProgress + HEADERS_RANGE_TIMEOUT;
+}
+
+bool CCheckpointHeadersSync::IsRangeResponse(NodeId node, const uint256& hashPrevBlock) const
+{
+    const Range* range = Find(node);
+    return range && range->hashLast == hashPrevBlock;
+}
+
+CCheckpointHeadersSync::Result CCheckpointHeadersSync::ReceiveHeaders(NodeId node, const std::vector<CBlockHeader>& headers, const std::vector<uint256>& vHashes, int64_t nNow, uint256& hashLocator, uint256& hashStop)
+{
+    assert(headers.size() == vHashes.size());
+    Range* range = Find(node);
+    if (!range)
+        return NOT_RANGE;
+    if (headers.empty()) {
+        Reset(*range);
+        return MISSING;
+    }
+    if (headers[0].hashPrevBlock != range->hashLast)
+        return NOT_RANGE;
+
+    for (size_t i = 0; i < headers.size(); i++) {
+        // Only the closing checkpoint may come last, at exactly its height
+        int nHeight = range->nStartHeight + range->vHeaders.size() + 1;
+        bool fLast = i + 1 == headers.size();
+        if (headers[i].hashPrevBlock != range->hashLast || nHeight > range->nEndHeight ||
+            (nHeight == range->nEndHeight) != (vHashes[i] == range->hashEnd) ||
+            (nHeight == range->nEndHeight && !fLast)) {
+            Reset(*range);
+            return INVALID;
+        }
+        range->vHeaders.push_back(headers[i]);
+        range->hashLast = vHashes[i];
+    }
+    range->nLastProgress = nNow;
+
+    if (range->IsComplete()) {
+        // Keep node as the source of the headers
+        range->fAssigned = false;
+        return COMPLETE;
+    }
+    hashLocator = range->hashLast;
+    hashStop = range->hashEnd;
+    return PARTIAL;
+}
+
+void CCheckpointHeadersSync::ReleaseRange(NodeId node)
+{
+    Range* range = Find(node);
+    if (range)
+        Reset(*range);
+}
+
+bool CCheckpointHeadersSync::PopConnectable(const std::function<bool(const uint256&)>& fHaveBlock, std::vector<CBlockHeader>& headers, NodeId& node)
+{
+    for (std::vector<Range>::iterator it = vRanges.begin(); it != vRanges.end(); ++it) {
+        if (it->IsComplete() && fHaveBlock(it->hashStart)) {
+            headers.swap(it->vHeaders);
+            node = it->node;
+            vRanges.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+void CCheckpointHeadersSync::Prune(int nHeight)
+{
+    std::vector<Range>::iterator it = vRanges.begin();
+    while (it != vRanges.end()) {
+        if (it->nEndHeight <= nHeight)
+            it = vRanges.erase(it);
+        else
+            ++it;
+    }
+}
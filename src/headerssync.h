@@ -0,0 +1,110 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef NOVO_HEADERSSYNC_H
+#define NOVO_HEADERSSYNC_H
+
+#include "chainparams.h"
+#include "net.h"
+#include "primitives/block.h"
+#include "uint256.h"
+
+#include <functional>
+#include <vector>
+
+/** Maximum number of peers downloading checkpoint ranges next to the headers sync peer */
+static const int MAX_HEADERS_RANGE_PEERS = 4;
+/** Checkpoint ranges with more headers than this are left to the headers sync peer */
+static const int MAX_HEADERS_RANGE_LENGTH = 50000;
+/** Time in microseconds a peer gets to deliver the next part of its range */
+static const int64_t HEADERS_RANGE_TIMEOUT = 2 * 60 * 1000000;
+
+/**
+ * Downloads the headers between consecutive checkpoints from several peers
+ * at once during initial headers sync, next to the regular headers sync
+ * peer.
+ *
+ * A range starts right after one checkpoint and ends at the next. The peer
+ * it is assigned to is asked for it with a locator holding only the last
+ * header received so far and the closing checkpoint as stop hash. Headers
+ * are buffered until the range reaches its closing checkpoint at the
+ * expected height, which anchors every header in it, and until the opening
+ * checkpoint is in the block index. From then on the range connects and can
+ * be handed to ProcessNewBlockHeaders.
+ *
+ * Not thread safe: net_processing only uses it with cs_main held.
+ */
+class CCheckpointHeadersSync
+{
+public:
+    enum Result {
+        NOT_RANGE, //!< Not a continuation of the range assigned to the peer
+        PARTIAL,   //!< Stored; the rest of the range is still missing
+        COMPLETE,  //!< The range reached its closing checkpoint
+        INVALID,   //!< The headers contradict the closing checkpoint; the range was released
+        MISSING,   //!< No headers, the peer does not have the range; the range was released
+    };
+
+private:
+    struct Range {
+        int nStartHeight;
+        uint256 hashStart;
+        int nEndHeight;
+        uint256 hashEnd;
+        //! Peer downloading the range, or the peer that completed it
+        NodeId node;
+        bool fAssigned;
+        //! When the peer last delivered headers for the range (in microseconds)
+        int64_t nLastProgress;
+        std::vector<CBlockHeader> vHeaders;
+        //! Hash of the last buffered header, or hashStart
+        uint256 hashLast;
+
+        bool IsComplete() const { return nStartHeight + (int)vHeaders.size() == nEndHeight; }
+    };
+    std::vector<Range> vRanges;
+
+    Range* Find(NodeId node);
+    const Range* Find(NodeId node) const;
+    static void Reset(Range& range);
+
+public:
+    explicit CCheckpointHeadersSync(const MapCheckpoints& checkpoints);
+
+    /**
+     * Assign the lowest range that opens above nBestHeaderHeight, ends at or
+     * below nPeerHeight and nobody is downloading yet to node. Returns the
+     * locator and stop hash of the getheaders request to send.
+     */
+    bool AssignRange(NodeId node, int nBestHeaderHeight, int nPeerHeight, int64_t nNow, uint256& hashLocator, uint256& hashStop);
+    /** Whether node is downloading a range */
+    bool HasRange(NodeId node) const;
+    /** Number of peers downloading a range */
+    int CountAssigned() const;
+    /** Whether node is downloading a range and made no progress since nNow - HEADERS_RANGE_TIMEOUT */
+    bool IsStalling(NodeId node, int64_t nNow) const;
+    /** Whether a headers message starting at hashPrevBlock continues the range of node */
+    bool IsRangeResponse(NodeId node, const uint256& hashPrevBlock) const;
+
+    /**
+     * Buffer headers received from node, whose hashes are vHashes. On
+     * PARTIAL, hashLocator and hashStop describe the next request.
+     */
+    Result ReceiveHeaders(NodeId node, const std::vector<CBlockHeader>& headers, const std::vector<uint256>& vHashes, int64_t nNow, uint256& hashLocator, uint256& hashStop);
+
+    /** Stop downloading the range of node, dropping what it delivered */
+    void ReleaseRange(NodeId node);
+
+    /**
+     * Remove a complete range whose opening checkpoint is known according to
+     * fHaveBlock, moving its headers to headers and the peer that delivered
+     * them to node.
+     */
+    bool PopConnectable(const std::function<bool(const uint256&)>& fHaveBlock, std::vector<CBlockHeader>& headers, NodeId& node);
+
+    /** Forget the ranges that end at or below nHeight, which we already have */
+    void Prune(int nHeight);
+};
+
+#endif // NOVO_HEADERSSYNC_H
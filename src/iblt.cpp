@@ -0,0 +1,101 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "iblt.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <math.h>
+
+//! Odd multipliers deriving the cell of a key in each subtable, and its checksum
+static const uint64_t IBLT_CELL_MULTIPLIERS[IBLT_HASH_COUNT] = {0x9e3779b97f4a7c15ULL, 0xc2b2ae3d27d4eb4fULL, 0x165667b19e3779f9ULL};
+static const uint64_t IBLT_CHECKSUM_MULTIPLIER = 0xd6e8feb86659fd93ULL;
+//! Tables from CellsForDifference fail to decode about once in this many times
+static const double IBLT_PAIR_FAILURE_INVERSE = 240;
+
+static inline uint32_t GetKeyCheckSum(uint64_t nKey)
+{
+    return (nKey * IBLT_CHECKSUM_MULTIPLIER) >> 32;
+}
+
+CIBLT::CIBLT(size_t nCells) : vCells((nCells + IBLT_HASH_COUNT - 1) / IBLT_HASH_COUNT * IBLT_HASH_COUNT) {}
+
+size_t CIBLT::CellsForDifference(size_t nDiff)
+{
+    // Peeling a table with three cells per key succeeds with high probability
+    // from about 1.23 cells per key on; small tables need a larger margin.
+    size_t nCells = nDiff + nDiff / 2 + 4 * IBLT_HASH_COUNT;
+    // In small tables peeling mostly fails on two keys sharing all their
+    // cells, which happens with probability about d^2 / 2 * (k / n)^k. Keep
+    // that below one in IBLT_PAIR_FAILURE_INVERSE.
+    double nPairCells = IBLT_HASH_COUNT * pow(IBLT_PAIR_FAILURE_INVERSE / 2.0 * nDiff * nDiff, 1.0 / IBLT_HASH_COUNT);
+    return std::max(nCells, (size_t)ceil(nPairCells));
+}
+
+size_t CIBLT::GetCellIndex(uint64_t nKey, unsigned int nHash) const
+{
+    size_t nSubtable = vCells.size() / IBLT_HASH_COUNT;
+    uint32_t nMixed = (nKey * IBLT_CELL_MULTIPLIERS[nHash]) >> 32;
+    return nHash * nSubtable + (((uint64_t)nMixed * nSubtable) >> 32);
+}
+
+void CIBLT::Update(uint64_t nKey, int32_t nDelta)
+{
+    assert(IsValid());
+    uint32_t nCheckSum = GetKeyCheckSum(nKey);
+    for (unsigned int i = 0; i < IBLT_HASH_COUNT; i++) {
+        Cell& cell = vCells[GetCellIndex(nKey, i)];
+        cell.nCount += nDelta;
+        cell.nKeySum ^= nKey;
+        cell.nCheckSum ^= nCheckSum;
+    }
+}
+
+CIBLT& CIBLT::operator-=(const CIBLT& other)
+{
+    assert(vCells.size() == other.vCells.size());
+    for (size_t i = 0; i < vCells.size(); i++) {
+        vCells[i].nCount -= other.vCells[i].nCount;
+        vCells[i].nKeySum ^= other.vCells[i].nKeySum;
+        vCells[i].nCheckSum ^= other.vCells[i].nCheckSum;
+    }
+    return *this;
+}
+
+bool CIBLT::Decode(std::vector<uint64_t>& vPositive, std::vector<uint64_t>& vNegative) const
+{
+    vPositive.clear();
+    vNegative.clear();
+    if (!IsValid())
+        return false;
+
+    // Repeatedly remove a key from a cell that holds only that key, which
+    // may leave other cells with a single key.
+    CIBLT table(*this);
+    std::vector<size_t> vPure;
+    for (size_t i = 0; i < table.vCells.size(); i++)
+        vPure.push_back(i);
+    while (!vPure.empty()) {
+        const Cell& cell = table.vCells[vPure.back()];
+        vPure.pop_back();
+        if ((cell.nCount != 1 && cell.nCount != -1) || GetKeyCheckSum(cell.nKeySum) != cell.nCheckSum)
+            continue;
+        uint64_t nKey = cell.nKeySum;
+        int32_t nCount = cell.nCount;
+        (nCount > 0 ? vPositive : vNegative).push_back(nKey);
+        // Checksum collisions can list bogus keys, so give up once more
+        // keys came out than the table can hold
+        if (vPositive.size() + vNegative.size() > table.vCells.size())
+            return false;
+        table.Update(nKey, -nCount);
+        for (unsigned int i = 0; i < IBLT_HASH_COUNT; i++)
+            vPure.push_back(table.GetCellIndex(nKey, i));
+    }
+
+    for (const Cell& cell : table.vCells) {
+        if (!cell.IsEmpty())
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,87 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef NOVO_IBLT_H
+#define NOVO_IBLT_H
+
+#include "serialize.h"
+
+#include <stdint.h>
+#include <vector>
+
+/** Number of cells every key is added to */
+static const unsigned int IBLT_HASH_COUNT = 3;
+
+/**
+ * Invertible Bloom lookup table over 64-bit keys.
+ *
+ * Every key is XORed into one cell of each of IBLT_HASH_COUNT equally sized
+ * subtables, together with a checksum of the key, and changes the cell's
+ * count by one. Subtracting the table of one set from the table of another
+ * cancels the keys they have in common, and the remaining difference can be
+ * listed from the result as long as it is small compared to the number of
+ * cells. Keys must be uniformly distributed, e.g. salted hashes.
+ */
+class CIBLT
+{
+public:
+    struct Cell
+    {
+        int32_t nCount;
+        uint64_t nKeySum;
+        uint32_t nCheckSum;
+
+        Cell() : nCount(0), nKeySum(0), nCheckSum(0) {}
+
+        bool IsEmpty() const { return nCount == 0 && nKeySum == 0 && nCheckSum == 0; }
+
+        ADD_SERIALIZE_METHODS;
+
+        template <typename Stream, typename Operation>
+        inline void SerializationOp(Stream& s, Operation ser_action) {
+            READWRITE(nCount);
+            READWRITE(nKeySum);
+            READWRITE(nCheckSum);
+        }
+    };
+
+private:
+    std::vector<Cell> vCells;
+
+    void Update(uint64_t nKey, int32_t nDelta);
+    size_t GetCellIndex(uint64_t nKey, unsigned int nHash) const;
+
+public:
+    CIBLT() {}
+    /** Create a table of at least nCells cells, rounded up to a multiple of IBLT_HASH_COUNT */
+    explicit CIBLT(size_t nCells);
+
+    /** Number of cells needed to list a difference of nDiff keys with high probability */
+    static size_t CellsForDifference(size_t nDiff);
+
+    size_t size() const { return vCells.size(); }
+    bool IsValid() const { return !vCells.empty() && vCells.size() % IBLT_HASH_COUNT == 0; }
+
+    void Insert(uint64_t nKey) { Update(nKey, 1); }
+    void Erase(uint64_t nKey) { Update(nKey, -1); }
+
+    /** Subtract the table of another set, which must have the same size */
+    CIBLT& operator-=(const CIBLT& other);
+
+    /**
+     * List the keys in the table: those inserted more often than erased in
+     * vPositive, the others in vNegative. Returns false if the table holds
+     * too many keys to list them all; the output is incomplete then.
+     */
+    bool Decode(std::vector<uint64_t>& vPositive, std::vector<uint64_t>& vNegative) const;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(vCells);
+    }
+};
+
+#endif // NOVO_IBLT_H
@@ -0,0 +1,174 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "index/addrindex.h"
+
+#include "chain.h"
+#include "crypto/common.h"
+#include "crypto/sha256.h"
+#include "primitives/block.h"
+#include "script/script.h"
+#include "util.h"
+
+static const char DB_ADDR_OUTPUT = 'a';
+static const char DB_ADDR_SPEND = 's';
+
+std::unique_ptr<CAddrIndex> g_addrindex;
+
+namespace {
+
+/**
+ * Key of an output entry. Height and output index are stored big endian so
+ * that LevelDB keeps the outputs of a script in chain order.
+ */
+struct CAddrOutputKey
+{
+    char chType;
+    uint256 hashScript;
+    uint32_t nHeight;
+    uint256 txid;
+    uint32_t n;
+
+    CAddrOutputKey() : chType(0), nHeight(0), n(0) {}
+    CAddrOutputKey(const uint256& hashScriptIn, uint32_t nHeightIn, const uint256& txidIn, uint32_t nIn) :
+        chType(DB_ADDR_OUTPUT), hashScript(hashScriptIn), nHeight(nHeightIn), txid(txidIn), n(nIn) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        unsigned char buf[4];
+        ser_writedata8(s, chType);
+        s << hashScript;
+        WriteBE32(buf, nHeight);
+        s.write((const char*)buf, sizeof(buf));
+        s << txid;
+        WriteBE32(buf, n);
+        s.write((const char*)buf, sizeof(buf));
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        unsigned char buf[4];
+        chType = ser_readdata8(s);
+        s >> hashScript;
+        s.read((char*)buf, sizeof(buf));
+        nHeight = ReadBE32(buf);
+        s >> txid;
+        s.read((char*)buf, sizeof(buf));
+        n = ReadBE32(buf);
+    }
+};
+
+} // anon namespace
+
+class CAddrIndex::DB : public CBaseIndex::DB
+{
+public:
+    DB(size_t nCacheSize, bool fMemory, bool fWipe) :
+        CBaseIndex::DB(GetDataDir() / "indexes" / "addrindex", nCacheSize, fMemory, fWipe)
+    {
+    }
+};
+
+CAddrIndex::CAddrIndex(size_t nCacheSize, bool fMemory, bool fWipe) : db(new CAddrIndex::DB(nCacheSize, fMemory, fWipe))
+{
+}
+
+CAddrIndex::~CAddrIndex()
+{
+    // Stop callbacks before the database goes away
+    Stop();
+}
+
+CBaseIndex::DB& CAddrIndex::GetDB() const
+{
+    return *db;
+}
+
+uint256 CAddrIndex::GetScriptHash(const CScript& script)
+{
+    uint256 hash;
+    CSHA256().Write(script.data(), script.size()).Finalize(hash.begin());
+    return hash;
+}
+
+bool CAddrIndex::WriteBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex)
+{
+    for (const auto& tx : block.vtx) {
+        const uint256& txid = tx->GetHash();
+        for (uint32_t i = 0; i < tx->vout.size(); i++) {
+            const CScript& scriptPubKey = tx->vout[i].scriptPubKey;
+            if (scriptPubKey.IsUnspendable())
+                continue;
+            batch.Write(CAddrOutputKey(GetScriptHash(scriptPubKey), pindex->nHeight, txid, i), tx->vout[i].nValue);
+        }
+        if (tx->IsCoinBase())
+            continue;
+        for (uint32_t i = 0; i < tx->vin.size(); i++) {
+            CAddrIndexSpend spend;
+            spend.txid = txid;
+            spend.nIn = i;
+            spend.nHeight = pindex->nHeight;
+            batch.Write(std::make_pair(DB_ADDR_SPEND, tx->vin[i].prevout), spend);
+        }
+    }
+    return true;
+}
+
+bool CAddrIndex::RewindBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex)
+{
+    for (const auto& tx : block.vtx) {
+        const uint256& txid = tx->GetHash();
+        for (uint32_t i = 0; i < tx->vout.size(); i++) {
+            const CScript& scriptPubKey = tx->vout[i].scriptPubKey;
+            if (scriptPubKey.IsUnspendable())
+                continue;
+            batch.Erase(CAddrOutputKey(GetScriptHash(scriptPubKey), pindex->nHeight, txid, i));
+        }
+        if (tx->IsCoinBase())
+            continue;
+        for (const CTxIn& txin : tx->vin)
+            batch.Erase(std::make_pair(DB_ADDR_SPEND, txin.prevout));
+    }
+    return true;
+}
+
+bool CAddrIndex::FindOutputs(const CScript& script, CAddrIndexPosition& pos, size_t nCount, bool fUnspentOnly,
+                             std::vector<CAddrIndexOutput>& vOutputs, bool& fMore)
+{
+    const uint256 hashScript = GetScriptHash(script);
+    vOutputs.clear();
+    fMore = false;
+
+    // Spends are read separately from the iterator, so they may include
+    // blocks indexed after it was created.
+    std::unique_ptr<CDBIterator> pcursor(db->NewIterator());
+    pcursor->Seek(CAddrOutputKey(hashScript, std::max(pos.nHeight, 0), pos.txid, pos.n));
+    for (; pcursor->Valid(); pcursor->Next()) {
+        CAddrOutputKey key;
+        if (!pcursor->GetKey(key) || key.chType != DB_ADDR_OUTPUT || key.hashScript != hashScript)
+            break;
+
+        CAddrIndexOutput output;
+        output.nHeight = key.nHeight;
+        output.txid = key.txid;
+        output.n = key.n;
+        if (!pcursor->GetValue(output.nValue))
+            return error("%s: failed to read output %s:%u", __func__, key.txid.ToString(), key.n);
+        output.fSpent = db->Read(std::make_pair(DB_ADDR_SPEND, COutPoint(key.txid, key.n)), output.spend);
+        if (fUnspentOnly && output.fSpent)
+            continue;
+
+        if (vOutputs.size() == nCount) {
+            fMore = true;
+            pos.nHeight = key.nHeight;
+            pos.txid = key.txid;
+            pos.n = key.n;
+            break;
+        }
+        vOutputs.push_back(output);
+    }
+    return true;
+}
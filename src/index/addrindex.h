@@ -0,0 +1,98 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef NOVO_INDEX_ADDRINDEX_H
+#define NOVO_INDEX_ADDRINDEX_H
+
+#include "amount.h"
+#include "index/base.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <memory>
+#include <vector>
+
+class CScript;
+
+/** Default for -addrindex */
+static const bool DEFAULT_ADDRINDEX = false;
+
+/** The transaction input that spends an indexed output */
+struct CAddrIndexSpend
+{
+    uint256 txid;
+    uint32_t nIn;
+    int nHeight;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(txid);
+        READWRITE(VARINT(nIn));
+        READWRITE(VARINT(nHeight));
+    }
+};
+
+/** An output paying to an indexed scriptPubKey */
+struct CAddrIndexOutput
+{
+    int nHeight;
+    uint256 txid;
+    uint32_t n;
+    CAmount nValue;
+    bool fSpent;
+    CAddrIndexSpend spend;
+};
+
+/** Position in the outputs of a script, which are ordered by height, txid and output number */
+struct CAddrIndexPosition
+{
+    int nHeight;
+    uint256 txid;
+    uint32_t n;
+
+    explicit CAddrIndexPosition(int nHeightIn = 0) : nHeight(nHeightIn), n(0) {}
+};
+
+/**
+ * Address index (-addrindex). Maps the hash of a scriptPubKey to every
+ * output paying to it, ordered by height, and each spent outpoint to the
+ * input spending it. Stored in indexes/addrindex/ and built in the
+ * background.
+ */
+class CAddrIndex : public CBaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> db;
+
+protected:
+    bool WriteBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex) override;
+    bool RewindBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex) override;
+    CBaseIndex::DB& GetDB() const override;
+    const char* GetName() const override { return "addrindex"; }
+
+public:
+    CAddrIndex(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    ~CAddrIndex();
+
+    /** The key entries are stored under: the SHA256 of the script */
+    static uint256 GetScriptHash(const CScript& script);
+
+    /**
+     * Return at most nCount outputs paying to script, in order, starting at
+     * pos. If there are further matches, fMore is set and pos is moved to the
+     * first of them, where the next call resumes. Needs no cs_main.
+     */
+    bool FindOutputs(const CScript& script, CAddrIndexPosition& pos, size_t nCount, bool fUnspentOnly,
+                     std::vector<CAddrIndexOutput>& vOutputs, bool& fMore);
+};
+
+/** The global address index, used by getaddressoutputs. May be null. */
+extern std::unique_ptr<CAddrIndex> g_addrindex;
+
+#endif // NOVO_INDEX_ADDRINDEX_H
@@ -0,0 +1,231 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "index/base.h"
+
+#include "chain.h"
+#include "chainparams.h"
+#include "init.h"
+#include "util.h"
+#include "utiltime.h"
+#include "validation.h"
+
+#include <functional>
+
+static const char DB_BEST_BLOCK = 'B';
+
+//! Commit the sync thread's batch once it grows beyond this many bytes
+static const size_t INDEX_SYNC_BATCH_SIZE = 16 << 20;
+//! Seconds between progress messages while catching up
+static const int64_t INDEX_SYNC_LOG_INTERVAL = 30;
+
+CBaseIndex::DB::DB(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory, bool fWipe) :
+    CDBWrapper(path, nCacheSize, fMemory, fWipe)
+{
+}
+
+bool CBaseIndex::DB::ReadBestBlock(CBlockLocator& locator) const
+{
+    if (!Read(DB_BEST_BLOCK, locator)) {
+        locator.SetNull();
+        return false;
+    }
+    return true;
+}
+
+void CBaseIndex::DB::WriteBestBlock(CDBBatch& batch, const CBlockLocator& locator)
+{
+    batch.Write(DB_BEST_BLOCK, locator);
+}
+
+/**
+ * Like CChain::GetLocator, but only follows the skiplist, so that validation
+ * callbacks can use it without cs_main.
+ */
+static CBlockLocator GetLocator(const CBlockIndex* pindex)
+{
+    int nStep = 1;
+    std::vector<uint256> vHave;
+    vHave.reserve(32);
+
+    while (pindex) {
+        vHave.push_back(pindex->GetBlockHash());
+        // Stop when we have added the genesis block.
+        if (pindex->nHeight == 0)
+            break;
+        // Exponentially larger steps back, plus the genesis block.
+        pindex = pindex->GetAncestor(std::max(pindex->nHeight - nStep, 0));
+        if (vHave.size() > 10)
+            nStep *= 2;
+    }
+
+    return CBlockLocator(vHave);
+}
+
+CBaseIndex::CBaseIndex() : fSynced(false), pbestBlockIndex(NULL), fInterrupt(false)
+{
+}
+
+CBaseIndex::~CBaseIndex()
+{
+    Stop();
+}
+
+bool CBaseIndex::Start()
+{
+    CBlockLocator locator;
+    GetDB().ReadBestBlock(locator);
+    {
+        LOCK(cs_main);
+        const CBlockIndex* pindex = NULL;
+        if (!locator.IsNull()) {
+            // The best block may be on a stale branch; the sync thread rewinds it
+            BlockMap::const_iterator it = mapBlockIndex.find(locator.vHave[0]);
+            if (it != mapBlockIndex.end())
+                pindex = it->second;
+            else
+                pindex = FindForkInGlobalIndex(chainActive, locator);
+        }
+        pbestBlockIndex = pindex;
+    }
+
+    fInterrupt = false;
+    RegisterValidationInterfaceAsync(this);
+    threadSync = std::thread(&TraceThread<std::function<void()> >, GetName(), std::function<void()>(std::bind(&CBaseIndex::ThreadSync, this)));
+    return true;
+}
+
+void CBaseIndex::Stop()
+{
+    UnregisterValidationInterface(this);
+    fInterrupt = true;
+    if (threadSync.joinable())
+        threadSync.join();
+}
+
+bool CBaseIndex::Commit(CDBBatch& batch, const CBlockIndex* pindex)
+{
+    if (pindex)
+        GetDB().WriteBestBlock(batch, GetLocator(pindex));
+    if (!GetDB().WriteBatch(batch))
+        return error("%s: Failed to commit %s", __func__, GetName());
+    batch.Clear();
+    pbestBlockIndex = pindex;
+    return true;
+}
+
+bool CBaseIndex::Rewind(CDBBatch& batch, const CBlockIndex* pindexFrom, const CBlockIndex* pindexTo)
+{
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    for (const CBlockIndex* pindex = pindexFrom; pindex != pindexTo; pindex = pindex->pprev) {
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex, consensusParams))
+            return error("%s: Failed to read block %s from disk", __func__, pindex->GetBlockHash().ToString());
+        if (!RewindBlock(batch, block, pindex))
+            return error("%s: Failed to rewind %s past block %s", __func__, GetName(), pindex->GetBlockHash().ToString());
+    }
+    return true;
+}
+
+void CBaseIndex::ThreadSync()
+{
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    CDBBatch batch(GetDB());
+    // Last block whose entries are either committed or in batch
+    const CBlockIndex* pindex = pbestBlockIndex;
+    int64_t nLastLog = 0;
+
+    while (!fInterrupt && !ShutdownRequested()) {
+        const CBlockIndex* pindexNext = NULL;
+        const CBlockIndex* pindexFork = NULL;
+        {
+            LOCK(cs_main);
+            if (!pindex) {
+                pindexNext = chainActive.Genesis();
+            } else if (chainActive.Contains(pindex)) {
+                pindexNext = chainActive.Next(pindex);
+            } else {
+                pindexFork = chainActive.FindFork(pindex);
+            }
+        }
+
+        if (!pindexNext && !pindexFork) {
+            // Caught up with the tip. Write the batch without holding cs_main,
+            // then check that no block was connected in the meantime: blocks
+            // connected from the moment fSynced is set are announced after
+            // it, so BlockConnected takes over.
+            if (!Commit(batch, pindex))
+                return;
+            LOCK(cs_main);
+            if (chainActive.Tip() == pindex) {
+                fSynced = true;
+                LogPrintf("%s is enabled at height %d\n", GetName(), pindex ? pindex->nHeight : -1);
+                return;
+            }
+            continue;
+        }
+
+        if (pindexFork) {
+            // Commit right away, so that indexes building on the entries of
+            // earlier blocks can read those of the fork point.
+            if (!Rewind(batch, pindex, pindexFork) || !Commit(batch, pindexFork))
+                return;
+            pindex = pindexFork;
+            continue;
+        }
+
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindexNext, consensusParams)) {
+            LogPrintf("%s: Failed to read block %s from disk\n", __func__, pindexNext->GetBlockHash().ToString());
+            return;
+        }
+        if (!WriteBlock(batch, block, pindexNext)) {
+            LogPrintf("%s: Failed to write block %s to %s\n", __func__, pindexNext->GetBlockHash().ToString(), GetName());
+            return;
+        }
+        pindex = pindexNext;
+
+        if (batch.SizeEstimate() > INDEX_SYNC_BATCH_SIZE && !Commit(batch, pindex))
+            return;
+
+        int64_t nNow = GetTime();
+        if (nNow - nLastLog >= INDEX_SYNC_LOG_INTERVAL) {
+            LogPrintf("Syncing %s with block chain from height %d\n", GetName(), pindex->nHeight);
+            nLastLog = nNow;
+        }
+    }
+
+    // Keep the progress made so far
+    Commit(batch, pindex);
+}
+
+void CBaseIndex::BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex)
+{
+    if (!fSynced)
+        return;
+
+    const CBlockIndex* pbest = pbestBlockIndex;
+    // Connected while the sync thread was catching up, and already indexed by it
+    if (pbest && pbest->GetAncestor(pindex->nHeight) == pindex)
+        return;
+    if (pindex->pprev != pbest) {
+        LogPrintf("WARNING: %s: Block %s does not connect to the best block of %s (%s), not updating index\n",
+                  __func__, pindex->GetBlockHash().ToString(), GetName(), pbest ? pbest->GetBlockHash().ToString() : "none");
+        return;
+    }
+
+    CDBBatch batch(GetDB());
+    if (!WriteBlock(batch, *block, pindex) || !Commit(batch, pindex))
+        LogPrintf("%s: Failed to write block %s to %s\n", __func__, pindex->GetBlockHash().ToString(), GetName());
+}
+
+void CBaseIndex::BlockDisconnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex)
+{
+    if (!fSynced || pindex != pbestBlockIndex)
+        return;
+
+    CDBBatch batch(GetDB());
+    if (!RewindBlock(batch, *block, pindex) || !Commit(batch, pindex->pprev))
+        LogPrintf("%s: Failed to rewind %s past block %s\n", __func__, GetName(), pindex->GetBlockHash().ToString());
+}
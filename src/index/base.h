@@ -0,0 +1,83 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef NOVO_INDEX_BASE_H
+#define NOVO_INDEX_BASE_H
+
+#include "dbwrapper.h"
+#include "primitives/block.h"
+#include "validationinterface.h"
+
+#include <atomic>
+#include <thread>
+
+class CBlockIndex;
+
+/**
+ * Base class for optional indexes of blockchain data.
+ *
+ * Each index keeps its own database together with a locator of the last
+ * block it has processed. Start() launches a background thread that
+ * catches up from the block files to the active chain; once it reaches the
+ * tip the index follows BlockConnected/BlockDisconnected through the
+ * asynchronous validation interface queue. Building or enabling an index
+ * therefore needs no reindex, and maintaining it adds nothing to tip
+ * validation.
+ *
+ * Validation callbacks run on the queue's thread and must not take cs_main.
+ */
+class CBaseIndex : public CValidationInterface
+{
+protected:
+    class DB : public CDBWrapper
+    {
+    public:
+        DB(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+        /** Read the locator of the last block the index has processed */
+        bool ReadBestBlock(CBlockLocator& locator) const;
+        /** Add the locator of the last processed block to batch */
+        void WriteBestBlock(CDBBatch& batch, const CBlockLocator& locator);
+    };
+
+    void BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex) override;
+    void BlockDisconnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex) override;
+
+    /** Add the entries for a newly connected block to batch */
+    virtual bool WriteBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex) = 0;
+    /** Add what undoes WriteBlock to batch, for a block leaving the active chain. By default entries are kept. */
+    virtual bool RewindBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex) { return true; }
+
+    virtual DB& GetDB() const = 0;
+    /** Name used in log messages and for the sync thread */
+    virtual const char* GetName() const = 0;
+
+private:
+    /** Whether the sync thread has caught up and validation callbacks are processed */
+    std::atomic<bool> fSynced;
+    /** Last block whose entries have been committed to the database */
+    std::atomic<const CBlockIndex*> pbestBlockIndex;
+    std::atomic<bool> fInterrupt;
+    std::thread threadSync;
+
+    /** Write batch together with the locator of pindex, and make pindex the best block */
+    bool Commit(CDBBatch& batch, const CBlockIndex* pindex);
+    /** Add the rewinds for the blocks between pindexFrom (inclusive) and its ancestor pindexTo to batch */
+    bool Rewind(CDBBatch& batch, const CBlockIndex* pindexFrom, const CBlockIndex* pindexTo);
+    void ThreadSync();
+
+public:
+    CBaseIndex();
+    virtual ~CBaseIndex();
+
+    /** Load the best block, subscribe to validation callbacks and start catching up with the active chain */
+    bool Start();
+    /** Stop the sync thread and validation callbacks. Committed entries stay valid. */
+    void Stop();
+
+    bool IsSynced() const { return fSynced; }
+    const CBlockIndex* GetBestBlockIndex() const { return pbestBlockIndex; }
+};
+
+#endif // NOVO_INDEX_BASE_H
@@ -0,0 +1,160 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "index/blockfilterindex.h"
+
+#include "chain.h"
+#include "undo.h"
+#include "util.h"
+#include "validation.h"
+
+static const char DB_FILTER = 'f';
+static const char DB_FILTER_HEADER = 'h';
+
+std::unique_ptr<CBlockFilterIndex> g_blockfilterindex;
+
+namespace {
+
+/** Filter hash and header of a block, read separately from the filter itself */
+struct CFilterHeaderEntry
+{
+    uint256 hash;
+    uint256 header;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(hash);
+        READWRITE(header);
+    }
+};
+
+} // anon namespace
+
+class CBlockFilterIndex::DB : public CBaseIndex::DB
+{
+public:
+    DB(const std::string& strName, size_t nCacheSize, bool fMemory, bool fWipe) :
+        CBaseIndex::DB(GetDataDir() / "indexes" / "blockfilter" / strName, nCacheSize, fMemory, fWipe)
+    {
+    }
+
+    bool ReadFilter(const uint256& hashBlock, std::vector<unsigned char>& vchFilter) const
+    {
+        return Read(std::make_pair(DB_FILTER, hashBlock), vchFilter);
+    }
+
+    bool ReadHeaderEntry(const uint256& hashBlock, CFilterHeaderEntry& entry) const
+    {
+        return Read(std::make_pair(DB_FILTER_HEADER, hashBlock), entry);
+    }
+
+    void WriteFilter(CDBBatch& batch, const BlockFilter& filter, const CFilterHeaderEntry& entry)
+    {
+        batch.Write(std::make_pair(DB_FILTER, filter.GetBlockHash()), filter.GetEncodedFilter());
+        batch.Write(std::make_pair(DB_FILTER_HEADER, filter.GetBlockHash()), entry);
+    }
+};
+
+CBlockFilterIndex::CBlockFilterIndex(BlockFilterType filterTypeIn, size_t nCacheSize, bool fMemory, bool fWipe) :
+    filterType(filterTypeIn), strName(BlockFilterTypeName(filterTypeIn) + " block filter index"),
+    db(new CBlockFilterIndex::DB(BlockFilterTypeName(filterTypeIn), nCacheSize, fMemory, fWipe))
+{
+    assert(!BlockFilterTypeName(filterType).empty());
+}
+
+CBlockFilterIndex::~CBlockFilterIndex()
+{
+    // Stop callbacks before the database goes away
+    Stop();
+}
+
+CBaseIndex::DB& CBlockFilterIndex::GetDB() const
+{
+    return *db;
+}
+
+bool CBlockFilterIndex::WriteBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex)
+{
+    CBlockUndo blockundo;
+    uint256 prevHeader;
+
+    if (pindex->nHeight > 0) {
+        if (!UndoReadFromDisk(blockundo, pindex->GetUndoPos(), pindex->pprev->GetBlockHash()))
+            return error("%s: Failed to read undo data of block %s", __func__, pindex->GetBlockHash().ToString());
+
+        const uint256& hashPrev = pindex->pprev->GetBlockHash();
+        if (hashPrev == hashLastBlock) {
+            prevHeader = lastHeader;
+        } else {
+            CFilterHeaderEntry prevEntry;
+            if (!db->ReadHeaderEntry(hashPrev, prevEntry))
+                return error("%s: Missing filter header of block %s", __func__, hashPrev.ToString());
+            prevHeader = prevEntry.header;
+        }
+    }
+
+    BlockFilter filter(filterType, block, blockundo);
+    CFilterHeaderEntry entry;
+    entry.hash = filter.GetHash();
+    entry.header = filter.ComputeHeader(prevHeader);
+    db->WriteFilter(batch, filter, entry);
+
+    hashLastBlock = pindex->GetBlockHash();
+    lastHeader = entry.header;
+    return true;
+}
+
+bool CBlockFilterIndex::LookupFilter(const CBlockIndex* pindex, BlockFilter& filter) const
+{
+    std::vector<unsigned char> vchFilter;
+    if (!db->ReadFilter(pindex->GetBlockHash(), vchFilter))
+        return false;
+    try {
+        filter = BlockFilter(filterType, pindex->GetBlockHash(), std::move(vchFilter));
+    } catch (const std::exception& e) {
+        return error("%s: Invalid filter for block %s: %s", __func__, pindex->GetBlockHash().ToString(), e.what());
+    }
+    return true;
+}
+
+bool CBlockFilterIndex::LookupFilterHeader(const CBlockIndex* pindex, uint256& header) const
+{
+    CFilterHeaderEntry entry;
+    if (!db->ReadHeaderEntry(pindex->GetBlockHash(), entry))
+        return false;
+    header = entry.header;
+    return true;
+}
+
+bool CBlockFilterIndex::LookupFilterRange(int nStartHeight, const CBlockIndex* pindexStop, std::vector<BlockFilter>& vFilters) const
+{
+    if (nStartHeight < 0 || nStartHeight > pindexStop->nHeight)
+        return false;
+
+    vFilters.resize(pindexStop->nHeight - nStartHeight + 1);
+    const CBlockIndex* pindex = pindexStop;
+    for (size_t i = vFilters.size(); i > 0; i--, pindex = pindex->pprev) {
+        if (!LookupFilter(pindex, vFilters[i - 1]))
+            return false;
+    }
+    return true;
+}
+
+bool CBlockFilterIndex::LookupFilterHashRange(int nStartHeight, const CBlockIndex* pindexStop, std::vector<uint256>& vHashes) const
+{
+    if (nStartHeight < 0 || nStartHeight > pindexStop->nHeight)
+        return false;
+
+    vHashes.resize(pindexStop->nHeight - nStartHeight + 1);
+    const CBlockIndex* pindex = pindexStop;
+    for (size_t i = vHashes.size(); i > 0; i--, pindex = pindex->pprev) {
+        CFilterHeaderEntry entry;
+        if (!db->ReadHeaderEntry(pindex->GetBlockHash(), entry))
+            return false;
+        vHashes[i - 1] = entry.hash;
+    }
+    return true;
+}
@@ -0,0 +1,72 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef NOVO_INDEX_BLOCKFILTERINDEX_H
+#define NOVO_INDEX_BLOCKFILTERINDEX_H
+
+#include "blockfilter.h"
+#include "index/base.h"
+#include "uint256.h"
+
+#include <memory>
+#include <vector>
+
+/** Default for -blockfilterindex */
+static const bool DEFAULT_BLOCKFILTERINDEX = false;
+
+/**
+ * Index of BIP 158 compact block filters (-blockfilterindex). For every
+ * block it stores the encoded filter, the filter hash and the filter
+ * header, keyed by block hash, so serving a light client is a database
+ * read. Stored in indexes/blockfilter/<type>/ and built in the background.
+ *
+ * Entries are kept when a block is disconnected; they stay valid for the
+ * block and are simply not reachable from the active chain.
+ */
+class CBlockFilterIndex : public CBaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const BlockFilterType filterType;
+    const std::string strName;
+    const std::unique_ptr<DB> db;
+
+    /**
+     * Filter header of the block WriteBlock last processed. The sync thread
+     * may not have committed it yet, so the next block takes its parent's
+     * header from here. WriteBlock calls never overlap.
+     */
+    uint256 hashLastBlock;
+    uint256 lastHeader;
+
+protected:
+    bool WriteBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex) override;
+    CBaseIndex::DB& GetDB() const override;
+    const char* GetName() const override { return strName.c_str(); }
+
+public:
+    CBlockFilterIndex(BlockFilterType filterTypeIn, size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    ~CBlockFilterIndex();
+
+    BlockFilterType GetFilterType() const { return filterType; }
+
+    /** Get the filter of a block. Needs no cs_main. */
+    bool LookupFilter(const CBlockIndex* pindex, BlockFilter& filter) const;
+
+    /** Get the filter header of a block. Needs no cs_main. */
+    bool LookupFilterHeader(const CBlockIndex* pindex, uint256& header) const;
+
+    /** Get the filters of pindexStop and its ancestors from nStartHeight on, in height order */
+    bool LookupFilterRange(int nStartHeight, const CBlockIndex* pindexStop, std::vector<BlockFilter>& vFilters) const;
+
+    /** Get the filter hashes of pindexStop and its ancestors from nStartHeight on, in height order */
+    bool LookupFilterHashRange(int nStartHeight, const CBlockIndex* pindexStop, std::vector<uint256>& vHashes) const;
+};
+
+/** The global basic block filter index, used for serving filters. May be null. */
+extern std::unique_ptr<CBlockFilterIndex> g_blockfilterindex;
+
+#endif // NOVO_INDEX_BLOCKFILTERINDEX_H
@@ -0,0 +1,132 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "index/txindex.h"
+
+#include "chain.h"
+#include "streams.h"
+#include "txdb.h"
+#include "util.h"
+
+#include <boost/thread.hpp>
+
+static const char DB_TXINDEX = 't';
+
+//! Number of entries moved per batch by CTxIndex::MigrateData
+static const size_t TXINDEX_MIGRATE_BATCH = 100000;
+
+std::unique_ptr<CTxIndex> g_txindex;
+
+class CTxIndex::DB : public CBaseIndex::DB
+{
+public:
+    DB(size_t nCacheSize, bool fMemory, bool fWipe) :
+        CBaseIndex::DB(GetDataDir() / "indexes" / "txindex", nCacheSize, fMemory, fWipe)
+    {
+    }
+
+    bool ReadTxPos(const uint256& txid, CDiskTxPos& pos) const
+    {
+        return Read(std::make_pair(DB_TXINDEX, txid), pos);
+    }
+
+    void WriteTxPos(CDBBatch& batch, const uint256& txid, const CDiskTxPos& pos)
+    {
+        batch.Write(std::make_pair(DB_TXINDEX, txid), pos);
+    }
+};
+
+CTxIndex::CTxIndex(size_t nCacheSize, bool fMemory, bool fWipe) : db(new CTxIndex::DB(nCacheSize, fMemory, fWipe))
+{
+}
+
+CTxIndex::~CTxIndex()
+{
+    // Stop callbacks before the database goes away
+    Stop();
+}
+
+CBaseIndex::DB& CTxIndex::GetDB() const
+{
+    return *db;
+}
+
+bool CTxIndex::WriteBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex)
+{
+    CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()));
+    for (const auto& tx : block.vtx) {
+        db->WriteTxPos(batch, tx->GetHash(), pos);
+        pos.nTxOffset += ::GetSerializeSize(*tx, SER_DISK, CLIENT_VERSION);
+    }
+    return true;
+}
+
+bool CTxIndex::MigrateData(CBlockTreeDB& blocktreedb, const CBlockLocator& locatorTip)
+{
+    std::unique_ptr<CDBIterator> pcursor(blocktreedb.NewIterator());
+    std::pair<char, uint256> key;
+    pcursor->Seek(std::make_pair(DB_TXINDEX, uint256()));
+    if (!pcursor->Valid() || !pcursor->GetKey(key) || key.first != DB_TXINDEX)
+        return true;
+
+    LogPrintf("Moving transaction index out of the block tree database...\n");
+    size_t nMoved = 0;
+    while (true) {
+        boost::this_thread::interruption_point();
+        CDBBatch batchNew(*db);
+        CDBBatch batchOld(blocktreedb);
+        size_t nBatch = 0;
+        while (nBatch < TXINDEX_MIGRATE_BATCH && pcursor->Valid()) {
+            if (!pcursor->GetKey(key) || key.first != DB_TXINDEX)
+                break;
+            CDiskTxPos pos;
+            if (!pcursor->GetValue(pos))
+                return error("%s: failed to read txindex entry", __func__);
+            db->WriteTxPos(batchNew, key.second, pos);
+            batchOld.Erase(key);
+            nBatch++;
+            pcursor->Next();
+        }
+        if (nBatch == 0)
+            break;
+        // Write the new entries first, so an interrupted migration is resumed
+        // rather than losing entries.
+        if (!db->WriteBatch(batchNew, true) || !blocktreedb.WriteBatch(batchOld))
+            return error("%s: failed to write txindex batch", __func__);
+        nMoved += nBatch;
+        LogPrint("txindex", "Moved %u txindex entries\n", nMoved);
+    }
+
+    CDBBatch batch(*db);
+    db->WriteBestBlock(batch, locatorTip);
+    if (!db->WriteBatch(batch, true))
+        return error("%s: failed to write txindex best block", __func__);
+    LogPrintf("Moved %u transaction index entries\n", nMoved);
+    return true;
+}
+
+bool CTxIndex::FindTx(const uint256& txid, uint256& hashBlock, CTransactionRef& tx)
+{
+    CDiskTxPos postx;
+    if (!db->ReadTxPos(txid, postx))
+        return false;
+
+    CAutoFile file(blockFileCache.Acquire(postx), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull())
+        return error("%s: OpenBlockFile failed", __func__);
+    CBlockHeader header;
+    try {
+        file >> header;
+        if (fseek(file.Get(), postx.nTxOffset, SEEK_CUR))
+            return error("%s: fseek failed", __func__);
+        file >> tx;
+    } catch (const std::exception& e) {
+        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    }
+    blockFileCache.Release(postx.nFile, file.release());
+    if (tx->GetHash() != txid)
+        return error("%s: txid mismatch", __func__);
+    hashBlock = header.GetHash();
+    return true;
+}
@@ -0,0 +1,53 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef NOVO_INDEX_TXINDEX_H
+#define NOVO_INDEX_TXINDEX_H
+
+#include "blockfilecache.h"
+#include "index/base.h"
+#include "primitives/transaction.h"
+
+#include <memory>
+
+class CBlockTreeDB;
+
+/**
+ * Transaction index (-txindex), mapping txids to their position in the block
+ * files. Stored in indexes/txindex/ and built in the background.
+ */
+class CTxIndex : public CBaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> db;
+    /** Open block files for lookups, shared by all threads calling FindTx */
+    CBlockFileCache blockFileCache;
+
+protected:
+    bool WriteBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex) override;
+    CBaseIndex::DB& GetDB() const override;
+    const char* GetName() const override { return "txindex"; }
+
+public:
+    CTxIndex(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    ~CTxIndex();
+
+    /**
+     * Move entries written by versions that kept the index in the block tree
+     * database. Those were complete up to the chain tip, which locatorTip
+     * describes.
+     */
+    bool MigrateData(CBlockTreeDB& blocktreedb, const CBlockLocator& locatorTip);
+
+    /** Look up a transaction by hash. Needs no cs_main. */
+    bool FindTx(const uint256& txid, uint256& hashBlock, CTransactionRef& tx);
+};
+
+/** The global transaction index, used by GetTransaction. May be null. */
+extern std::unique_ptr<CTxIndex> g_txindex;
+
+#endif // NOVO_INDEX_TXINDEX_H
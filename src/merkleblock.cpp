@@ -16,19 +16,14 @@ CMerkleBlock::CMerkleBlock(const CBlock& block, CBloomFilter& filter)
     std::vector<bool> vMatch;
     std::vector<uint256> vHashes;
 
-    vMatch.reserve(block.vtx.size());
+    filter.IsRelevantAndUpdate(block.vtx, vMatch);
     vHashes.reserve(block.vtx.size());
 
     for (unsigned int i = 0; i < block.vtx.size(); i++)
     {
         const uint256& hash = block.vtx[i]->GetHash();
-        if (filter.IsRelevantAndUpdate(*block.vtx[i]))
-        {
-            vMatch.push_back(true);
+        if (vMatch[i])
             vMatchedTxn.push_back(std::make_pair(i, hash));
-        }
-        else
-            vMatch.push_back(false);
         vHashes.push_back(hash);
     }
 
@@ -0,0 +1,63 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "msgstats.h"
+
+#include <algorithm>
+#include <string.h>
+
+CLatencyHistogram::CLatencyHistogram() : nCount(0), nTotal(0)
+{
+    memset(vBuckets, 0, sizeof(vBuckets));
+}
+
+void CLatencyHistogram::Add(int64_t nMicros)
+{
+    // Clocks are not monotonic
+    nMicros = std::max(nMicros, (int64_t)0);
+    int nBucket = 0;
+    for (uint64_t n = nMicros >> 1; n != 0 && nBucket < LATENCY_HISTOGRAM_BUCKETS - 1; n >>= 1)
+        nBucket++;
+    vBuckets[nBucket]++;
+    nCount++;
+    nTotal += nMicros;
+}
+
+CLatencyHistogram& CLatencyHistogram::operator+=(const CLatencyHistogram& other)
+{
+    for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++)
+        vBuckets[i] += other.vBuckets[i];
+    nCount += other.nCount;
+    nTotal += other.nTotal;
+    return *this;
+}
+
+int64_t CLatencyHistogram::GetPercentile(double dFraction) const
+{
+    if (nCount == 0)
+        return 0;
+    uint64_t nRank = std::max((uint64_t)1, (uint64_t)(dFraction * nCount + 0.5));
+    uint64_t nSeen = 0;
+    for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+        nSeen += vBuckets[i];
+        if (nSeen >= nRank)
+            return (int64_t)2 << i;
+    }
+    return (int64_t)2 << (LATENCY_HISTOGRAM_BUCKETS - 1);
+}
+
+void CMessageProcessingStats::Add(int64_t nQueued, int64_t nElapsed, int64_t nLockWaitIn)
+{
+    queueing.Add(nQueued);
+    processing.Add(nElapsed);
+    nLockWait += nLockWaitIn;
+}
+
+CMessageProcessingStats& CMessageProcessingStats::operator+=(const CMessageProcessingStats& other)
+{
+    processing += other.processing;
+    queueing += other.queueing;
+    nLockWait += other.nLockWait;
+    return *this;
+}
@@ -0,0 +1,62 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef NOVO_MSGSTATS_H
+#define NOVO_MSGSTATS_H
+
+#include <map>
+#include <stdint.h>
+#include <string>
+
+/** Number of buckets of a CLatencyHistogram, the last one collecting everything from about 36 minutes on */
+static const int LATENCY_HISTOGRAM_BUCKETS = 32;
+
+/**
+ * Histogram of durations in microseconds with power of two buckets: bucket 0
+ * counts durations below 2, bucket i those from 2^i to 2^(i+1). Adding a
+ * duration takes a few instructions, and percentiles come out within a
+ * factor of two, which is enough to tell what is slow.
+ */
+class CLatencyHistogram
+{
+private:
+    uint64_t vBuckets[LATENCY_HISTOGRAM_BUCKETS];
+    uint64_t nCount;
+    int64_t nTotal;
+
+public:
+    CLatencyHistogram();
+
+    void Add(int64_t nMicros);
+    CLatencyHistogram& operator+=(const CLatencyHistogram& other);
+
+    uint64_t GetCount() const { return nCount; }
+    /** Sum of all durations in microseconds */
+    int64_t GetTotal() const { return nTotal; }
+    /**
+     * Upper bound of the bucket holding the given fraction of the durations,
+     * rounded up to a power of two, in microseconds. 0 if there are none.
+     */
+    int64_t GetPercentile(double dFraction) const;
+};
+
+/** How the messages of one type were processed */
+struct CMessageProcessingStats
+{
+    //! Time spent in ProcessMessage
+    CLatencyHistogram processing;
+    //! Time from receiving the message to processing it
+    CLatencyHistogram queueing;
+    //! Time spent waiting for contended locks while processing, in microseconds
+    int64_t nLockWait;
+
+    CMessageProcessingStats() : nLockWait(0) {}
+
+    void Add(int64_t nQueued, int64_t nElapsed, int64_t nLockWaitIn);
+    CMessageProcessingStats& operator+=(const CMessageProcessingStats& other);
+};
+
+typedef std::map<std::string, CMessageProcessingStats> mapMsgCmdStats;
+
+#endif // NOVO_MSGSTATS_H
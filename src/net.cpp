@@ -26,6 +26,7 @@
 #include <string.h>
 #else
 #include <fcntl.h>
+#include <sys/uio.h>
 #endif
 
 #ifdef USE_UPNP
@@ -44,6 +45,17 @@
 // We add a random period time (0 to 1 seconds) to feeler connections to prevent synchronization.
 #define FEELER_SLEEP_WINDOW 1
 
+#ifndef WIN32
+// Maximum number of queued messages passed to a single sendmsg() call
+#if defined(IOV_MAX) && IOV_MAX < 1024
+#define MAX_SEND_IOVECS IOV_MAX
+#else
+#define MAX_SEND_IOVECS 1024
+#endif
+// Stop adding messages to a sendmsg() call at this many bytes, more than a socket buffer takes at once
+#define MAX_SEND_BATCH_SIZE (16 * 1024 * 1024)
+#endif
+
 #if !defined(HAVE_MSG_NOSIGNAL) && !defined(MSG_NOSIGNAL)
 #define MSG_NOSIGNAL 0
 #endif
@@ -657,6 +669,10 @@ void CNode::copyStats(CNodeStats &stats)
         X(mapRecvBytesPerMsgCmd);
         X(nRecvBytes);
     }
+    {
+        LOCK(cs_msgStats);
+        X(mapProcessStatsPerMsgCmd);
+    }
     X(fWhitelisted);
     X(minFeeFilter);
 
@@ -691,10 +707,22 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete
     nRecvBytes += nBytes;
     while (nBytes > 0) {
 
-        // get current incomplete message, or create a new one
+        // get current incomplete message, or reuse a processed one, or create a new one
         if (vRecvMsg.empty() ||
-            vRecvMsg.back().complete())
-            vRecvMsg.push_back(CNetMessage(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION));
+            vRecvMsg.back().complete()) {
+            bool fPooled = false;
+            {
+                LOCK(cs_vRecvMsgPool);
+                if (!vRecvMsgPool.empty()) {
+                    vRecvMsg.splice(vRecvMsg.end(), vRecvMsgPool, vRecvMsgPool.begin());
+                    fPooled = true;
+                }
+            }
+            if (fPooled)
+                vRecvMsg.back().Reset(INIT_PROTO_VERSION);
+            else
+                vRecvMsg.push_back(CNetMessage(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION));
+        }
 
         CNetMessage& msg = vRecvMsg.back();
 
@@ -734,6 +762,17 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete
     return true;
 }
 
+void CNode::RecycleRecvMsg(std::list<CNetMessage>& msgs)
+{
+    assert(!msgs.empty());
+    // A buffer never grows beyond the largest message it received
+    if (msgs.front().hdr.nMessageSize > MAX_POOLED_RECV_MSG_SIZE)
+        return;
+    LOCK(cs_vRecvMsgPool);
+    if (vRecvMsgPool.size() < RECV_MSG_POOL_SIZE)
+        vRecvMsgPool.splice(vRecvMsgPool.end(), msgs, msgs.begin());
+}
+
 void CNode::SetSendVersion(int nVersionIn)
 {
     // Send version may only be changed in the version message, and
@@ -761,26 +800,36 @@ int CNode::GetSendVersion() const
 }
 
 
+void CNetMessage::Reset(int nVersionIn)
+{
+    hasher.Reset();
+    data_hash.SetNull();
+    in_data = false;
+    nHdrPos = 0;
+    vRecv.clear();
+    vRecv.SetVersion(nVersionIn);
+    nDataPos = 0;
+    nTime = 0;
+}
+
 int CNetMessage::readHeader(const char *pch, unsigned int nBytes)
 {
     // copy data to temporary parsing buffer
-    unsigned int nRemaining = 24 - nHdrPos;
+    unsigned int nRemaining = CMessageHeader::HEADER_SIZE - nHdrPos;
     unsigned int nCopy = std::min(nRemaining, nBytes);
 
     memcpy(&hdrbuf[nHdrPos], pch, nCopy);
     nHdrPos += nCopy;
 
     // if header incomplete, exit
-    if (nHdrPos < 24)
+    if (nHdrPos < CMessageHeader::HEADER_SIZE)
         return nCopy;
 
     // deserialize to CMessageHeader
-    try {
-        hdrbuf >> hdr;
-    }
-    catch (const std::exception&) {
-        return -1;
-    }
+    memcpy(hdr.pchMessageStart, hdrbuf, CMessageHeader::MESSAGE_START_SIZE);
+    memcpy(hdr.pchCommand, hdrbuf + CMessageHeader::MESSAGE_START_SIZE, CMessageHeader::COMMAND_SIZE);
+    hdr.nMessageSize = ReadLE32((const unsigned char*)hdrbuf + CMessageHeader::MESSAGE_SIZE_OFFSET);
+    memcpy(hdr.pchChecksum, hdrbuf + CMessageHeader::CHECKSUM_OFFSET, CMessageHeader::CHECKSUM_SIZE);
 
     // reject messages larger than MAX_SIZE
     if (hdr.nMessageSize > MAX_SIZE)
@@ -797,13 +846,15 @@ int CNetMessage::readData(const char *pch, unsigned int nBytes)
     unsigned int nRemaining = hdr.nMessageSize - nDataPos;
     unsigned int nCopy = std::min(nRemaining, nBytes);
 
-    if (vRecv.size() < nDataPos + nCopy) {
-        // Allocate up to 256 KiB ahead, but never more than the total message size.
-        vRecv.resize(std::min(hdr.nMessageSize, nDataPos + nCopy + 256 * 1024));
+    if (vRecv.capacity() < nDataPos + nCopy) {
+        // A recycled buffer usually has room for the whole message already.
+        // Otherwise allocate up to 256 KiB ahead, but never more than the total
+        // message size, so a peer cannot make us allocate for data it does not send.
+        vRecv.reserve(std::min(hdr.nMessageSize, nDataPos + nCopy + 256 * 1024));
     }
 
     hasher.Write((const unsigned char*)pch, nCopy);
-    memcpy(&vRecv[nDataPos], pch, nCopy);
+    vRecv.write(pch, nCopy);
     nDataPos += nCopy;
 
     return nCopy;
@@ -832,27 +883,55 @@ size_t CConnman::SocketSendData(CNode *pnode) const
     size_t nSentSize = 0;
 
     while (it != pnode->vSendMsg.end()) {
-        const auto &data = *it;
-        assert(data.size() > pnode->nSendOffset);
+        assert(it->size() > pnode->nSendOffset);
         int nBytes = 0;
+        size_t nBatchSize = 0;
         {
             LOCK(pnode->cs_hSocket);
             if (pnode->hSocket == INVALID_SOCKET)
                 break;
-            nBytes = send(pnode->hSocket, reinterpret_cast<const char*>(data.data()) + pnode->nSendOffset, data.size() - pnode->nSendOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
+#ifdef WIN32
+            nBatchSize = it->size() - pnode->nSendOffset;
+            nBytes = send(pnode->hSocket, reinterpret_cast<const char*>(it->data()) + pnode->nSendOffset, nBatchSize, MSG_NOSIGNAL | MSG_DONTWAIT);
+#else
+            // Hand the kernel as many queued messages as possible in one
+            // call, as headers and payloads are separate entries
+            struct iovec vIov[MAX_SEND_IOVECS];
+            size_t nIov = 0;
+            size_t nOffset = pnode->nSendOffset;
+            for (auto itBatch = it; itBatch != pnode->vSendMsg.end() && nIov < MAX_SEND_IOVECS && nBatchSize < MAX_SEND_BATCH_SIZE; ++itBatch) {
+                vIov[nIov].iov_base = const_cast<unsigned char*>(itBatch->data()) + nOffset;
+                vIov[nIov].iov_len = itBatch->size() - nOffset;
+                nBatchSize += vIov[nIov].iov_len;
+                nIov++;
+                nOffset = 0;
+            }
+            struct msghdr msg = {};
+            msg.msg_iov = vIov;
+            msg.msg_iovlen = nIov;
+            nBytes = sendmsg(pnode->hSocket, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+#endif
         }
         if (nBytes > 0) {
             pnode->nLastSend = GetSystemTimeInSeconds();
             pnode->nSendBytes += nBytes;
-            pnode->nSendOffset += nBytes;
             nSentSize += nBytes;
-            if (pnode->nSendOffset == data.size()) {
+            // Drop the messages that were sent completely
+            size_t nRemaining = nBytes;
+            while (nRemaining > 0) {
+                size_t nLeft = it->size() - pnode->nSendOffset;
+                if (nRemaining < nLeft) {
+                    pnode->nSendOffset += nRemaining;
+                    break;
+                }
+                nRemaining -= nLeft;
                 pnode->nSendOffset = 0;
-                pnode->nSendSize -= data.size();
+                pnode->nSendSize -= it->size();
                 pnode->fPauseSend = pnode->nSendSize > nSendBufferMaxSize;
                 it++;
-            } else {
-                // could not send full message; stop sending more
+            }
+            if ((size_t)nBytes < nBatchSize) {
+                // could not send everything; stop sending more
                 break;
             }
         } else {
@@ -2317,6 +2396,9 @@ bool CConnman::Start(CScheduler& scheduler, std::string& strNodeError, Options c
     // Dump network addresses
     scheduler.scheduleEvery(boost::bind(&CConnman::DumpData, this), DUMP_ADDRESSES_INTERVAL);
 
+    if (connOptions.nMsgStatsLogInterval > 0)
+        scheduler.scheduleEvery(boost::bind(&CConnman::LogMessageStats, this), connOptions.nMsgStatsLogInterval);
+
     return true;
 }
 
@@ -2615,6 +2697,47 @@ uint64_t CConnman::GetOutboundTargetBytesLeft()
     return (nMaxOutboundTotalBytesSentInCycle >= nMaxOutboundLimit) ? 0 : nMaxOutboundLimit - nMaxOutboundTotalBytesSentInCycle;
 }
 
+void CConnman::RecordMessageProcessing(CNode* pnode, const std::string& strCommand, int64_t nQueued, int64_t nElapsed, int64_t nLockWait)
+{
+    // to prevent a memory DOS, only allow valid commands
+    const std::vector<std::string>& vTypes = getAllNetMessageTypes();
+    const std::string& strKey = std::find(vTypes.begin(), vTypes.end(), strCommand) != vTypes.end() ? strCommand : NET_MESSAGE_COMMAND_OTHER;
+    {
+        LOCK(pnode->cs_msgStats);
+        pnode->mapProcessStatsPerMsgCmd[strKey].Add(nQueued, nElapsed, nLockWait);
+    }
+    LOCK(cs_msgStats);
+    mapMsgStats[strKey].Add(nQueued, nElapsed, nLockWait);
+    mapMsgStatsToLog[strKey].Add(nQueued, nElapsed, nLockWait);
+}
+
+void CConnman::GetMessageStats(mapMsgCmdStats& mapStats)
+{
+    LOCK(cs_msgStats);
+    mapStats = mapMsgStats;
+}
+
+void CConnman::LogMessageStats()
+{
+    mapMsgCmdStats mapStats;
+    {
+        LOCK(cs_msgStats);
+        mapStats.swap(mapMsgStatsToLog);
+    }
+    // Most time consuming first
+    std::vector<std::pair<int64_t, std::string> > vByTime;
+    for (const mapMsgCmdStats::value_type& i : mapStats)
+        vByTime.push_back(std::make_pair(i.second.processing.GetTotal(), i.first));
+    std::sort(vByTime.rbegin(), vByTime.rend());
+    for (const std::pair<int64_t, std::string>& i : vByTime) {
+        const CMessageProcessingStats& stats = mapStats[i.second];
+        LogPrintf("Processed %u %s messages in %.2fms (p50 %dus, p99 %dus), queued p50 %dus, p99 %dus, waited %.2fms for locks\n",
+            stats.processing.GetCount(), SanitizeString(i.second), stats.processing.GetTotal() * 0.001,
+            stats.processing.GetPercentile(0.5), stats.processing.GetPercentile(0.99),
+            stats.queueing.GetPercentile(0.5), stats.queueing.GetPercentile(0.99), stats.nLockWait * 0.001);
+    }
+}
+
 uint64_t CConnman::GetTotalBytesRecv()
 {
     LOCK(cs_totalBytesRecv);
@@ -13,6 +13,7 @@
 #include "compat.h"
 #include "hash.h"
 #include "limitedmap.h"
+#include "msgstats.h"
 #include "netaddress.h"
 #include "protocol.h"
 #include "random.h"
@@ -20,6 +21,7 @@
 #include "sync.h"
 #include "uint256.h"
 #include "threadinterrupt.h"
+#include "txreconciliation.h"
 
 #include <atomic>
 #include <deque>
@@ -56,6 +58,10 @@ static const unsigned int MAX_INV_SZ = 50000;
 static const unsigned int MAX_ADDR_TO_SEND = 1000;
 /** Maximum length of incoming protocol messages (no message over 4 MB is currently acceptable). */
 static const unsigned int MAX_PROTOCOL_MESSAGE_LENGTH = 4 * 1000 * 1000;
+/** Number of processed messages per peer kept around to receive the next ones into */
+static const size_t RECV_MSG_POOL_SIZE = 4;
+/** Maximum payload size of a processed message that is kept for reuse */
+static const unsigned int MAX_POOLED_RECV_MSG_SIZE = 16 * 1024;
 /** Maximum length of strSubVer in `version` message */
 static const unsigned int MAX_SUBVERSION_LENGTH = 256;
 /** Maximum number of automatic outgoing nodes */
@@ -86,6 +92,8 @@ static const bool DEFAULT_BLOCKSONLY = false;
 static const bool DEFAULT_FORCEDNSSEED = false;
 static const size_t DEFAULT_MAXRECEIVEBUFFER = 5 * 1000;
 static const size_t DEFAULT_MAXSENDBUFFER    = 1 * 1000;
+/** Default for -logmsgstats, the interval in seconds between logs of message processing statistics, 0 for none */
+static const int64_t DEFAULT_LOG_MSG_STATS_INTERVAL = 0;
 
 static const ServiceFlags REQUIRED_SERVICES = NODE_NETWORK;
 
@@ -145,6 +153,7 @@ public:
         unsigned int nReceiveFloodSize = 0;
         uint64_t nMaxOutboundTimeframe = 0;
         uint64_t nMaxOutboundLimit = 0;
+        int64_t nMsgStatsLogInterval = 0;
     };
     CConnman(uint64_t seed0, uint64_t seed1);
     ~CConnman();
@@ -277,6 +286,15 @@ public:
     uint64_t GetTotalBytesRecv();
     uint64_t GetTotalBytesSent();
 
+    /**
+     * Record that a message from pnode waited nQueued microseconds after
+     * its receipt, then took nElapsed microseconds to process, nLockWait of
+     * which were spent waiting for locks.
+     */
+    void RecordMessageProcessing(CNode* pnode, const std::string& strCommand, int64_t nQueued, int64_t nElapsed, int64_t nLockWait);
+    /** Get processing statistics per message type over all peers since startup */
+    void GetMessageStats(mapMsgCmdStats& mapStats);
+
     void SetBestHeight(int height);
     int GetBestHeight() const;
 
@@ -327,6 +345,7 @@ private:
     void DumpAddresses();
     void DumpData();
     void DumpBanlist();
+    void LogMessageStats();
 
     // Network stats
     void RecordBytesRecv(uint64_t bytes);
@@ -341,6 +360,11 @@ private:
     uint64_t nTotalBytesRecv;
     uint64_t nTotalBytesSent;
 
+    // Message processing totals, since startup and since they were last logged
+    CCriticalSection cs_msgStats;
+    mapMsgCmdStats mapMsgStats;
+    mapMsgCmdStats mapMsgStatsToLog;
+
     // outbound limit & stats
     uint64_t nMaxOutboundTotalBytesSentInCycle;
     uint64_t nMaxOutboundCycleStartTime;
@@ -503,6 +527,7 @@ public:
     mapMsgCmdSize mapSendBytesPerMsgCmd;
     uint64_t nRecvBytes;
     mapMsgCmdSize mapRecvBytesPerMsgCmd;
+    mapMsgCmdStats mapProcessStatsPerMsgCmd;
     bool fWhitelisted;
     double dPingTime;
     double dPingWait;
@@ -522,7 +547,7 @@ private:
 public:
     bool in_data;                   // parsing header (false) or data (true)
 
-    CDataStream hdrbuf;             // partially received header
+    char hdrbuf[CMessageHeader::HEADER_SIZE]; // partially received header
     CMessageHeader hdr;             // complete header
     unsigned int nHdrPos;
 
@@ -531,8 +556,7 @@ public:
 
     int64_t nTime;                  // time (in microseconds) of message receipt.
 
-    CNetMessage(const CMessageHeader::MessageStartChars& pchMessageStartIn, int nTypeIn, int nVersionIn) : hdrbuf(nTypeIn, nVersionIn), hdr(pchMessageStartIn), vRecv(nTypeIn, nVersionIn) {
-        hdrbuf.resize(24);
+    CNetMessage(const CMessageHeader::MessageStartChars& pchMessageStartIn, int nTypeIn, int nVersionIn) : hdr(pchMessageStartIn), vRecv(nTypeIn, nVersionIn) {
         in_data = false;
         nHdrPos = 0;
         nDataPos = 0;
@@ -550,10 +574,12 @@ public:
 
     void SetVersion(int nVersionIn)
     {
-        hdrbuf.SetVersion(nVersionIn);
         vRecv.SetVersion(nVersionIn);
     }
 
+    /** Prepare a processed message for receiving the next one, keeping its buffer */
+    void Reset(int nVersionIn);
+
     int readHeader(const char *pch, unsigned int nBytes);
     int readData(const char *pch, unsigned int nBytes);
 };
@@ -580,6 +606,10 @@ public:
     std::list<CNetMessage> vProcessMsg;
     size_t nProcessQueueSize;
 
+    // Processed messages whose buffers are reused by ReceiveMsgBytes
+    CCriticalSection cs_vRecvMsgPool;
+    std::list<CNetMessage> vRecvMsgPool;
+
     CCriticalSection cs_sendProcessing;
 
     std::deque<CInv> vRecvGetData;
@@ -625,6 +655,8 @@ protected:
 
     mapMsgCmdSize mapSendBytesPerMsgCmd;
     mapMsgCmdSize mapRecvBytesPerMsgCmd;
+    CCriticalSection cs_msgStats;
+    mapMsgCmdStats mapProcessStatsPerMsgCmd;
 
 public:
     uint256 hashContinue;
@@ -656,6 +688,8 @@ public:
     std::vector<uint256> vBlockHashesToAnnounce;
     // Used for BIP35 mempool sending, also protected by cs_inventory
     bool fSendMempool;
+    // Reconciliation of transaction announcements, also protected by cs_inventory
+    CTxReconciliationState txrecon;
 
     // Last time a "MEMPOOL" request was serviced.
     std::atomic<int64_t> timeLastMempoolReq;
@@ -725,6 +759,8 @@ public:
     }
 
     bool ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete);
+    /** Hand the first of msgs back for receiving into, unless its buffer is large or enough are pooled */
+    void RecycleRecvMsg(std::list<CNetMessage>& msgs);
 
     void SetRecvVersion(int nVersionIn)
     {
@@ -7,10 +7,13 @@
 
 #include "addrman.h"
 #include "arith_uint256.h"
+#include "blockdownload.h"
 #include "blockencodings.h"
 #include "chainparams.h"
 #include "consensus/validation.h"
 #include "hash.h"
+#include "headerssync.h"
+#include "index/blockfilterindex.h"
 #include "init.h"
 #include "validation.h"
 #include "merkleblock.h"
@@ -24,6 +27,8 @@
 #include "random.h"
 #include "tinyformat.h"
 #include "txmempool.h"
+#include "txorphanage.h"
+#include "txreconciliation.h"
 #include "ui_interface.h"
 #include "util.h"
 #include "utilmoneystr.h"
@@ -38,35 +43,29 @@
 
 std::atomic<int64_t> nTimeBestReceived(0); // Used only to inform the wallet of when we last received a block
 
-struct IteratorComparator
-{
-    template<typename I>
-    bool operator()(const I& a, const I& b)
-    {
-        return &(*a) < &(*b);
-    }
-};
-
-struct COrphanTx {
-    // When modifying, adapt the copy of this definition in tests/DoS_tests.
-    CTransactionRef tx;
-    NodeId fromPeer;
-    int64_t nTimeExpire;
-};
-std::map<uint256, COrphanTx> mapOrphanTransactions GUARDED_BY(cs_main);
-std::map<COutPoint, std::set<std::map<uint256, COrphanTx>::iterator, IteratorComparator>> mapOrphanTransactionsByPrev GUARDED_BY(cs_main);
-void EraseOrphansFor(NodeId peer) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+/** Orphan transactions, see CTxOrphanage */
+static CTxOrphanage orphanage;
 
 static size_t vExtraTxnForCompactIt = 0;
 static std::vector<std::pair<uint256, CTransactionRef>> vExtraTxnForCompact GUARDED_BY(cs_main);
 
 static const uint64_t RANDOMIZER_ID_ADDRESS_RELAY = 0x3cac0035b5866b90ULL; // SHA256("main address relay")[0:8]
 
+/** Maximum number of compact filters that may be requested with one getcfilters. See BIP 157. */
+static const uint32_t MAX_GETCFILTERS_SIZE = 1000;
+/** Maximum number of cf hashes that may be requested with one getcfheaders. See BIP 157. */
+static const uint32_t MAX_GETCFHEADERS_SIZE = 2000;
+/** Interval between compact filter checkpoints. See BIP 157. */
+static const int CFCHECKPT_INTERVAL = 1000;
+
 // Internal stuff
 namespace {
     /** Number of nodes with fSyncStarted. */
     int nSyncStarted = 0;
 
+    /** Checkpoint ranges downloaded from other peers during initial headers sync. Protected by cs_main. */
+    std::unique_ptr<CCheckpointHeadersSync> headersRangeSync;
+
     /**
      * Sources of received blocks, saved to be able to send them reject
      * messages or ban them when processing happens afterwards. Protected by
@@ -170,11 +169,15 @@ struct CNodeState {
     bool fSyncStarted;
     //! When to potentially disconnect peer for stalling headers download
     int64_t nHeadersSyncTimeout;
+    //! Whether this peer failed to deliver a checkpoint range, so that it gets no other
+    bool fHeadersRangeFailed;
     //! Since when we're stalling block download progress (in microseconds), or 0.
     int64_t nStallingSince;
     std::list<QueuedBlock> vBlocksInFlight;
     //! When the first entry in vBlocksInFlight started downloading. Don't care when vBlocksInFlight is empty.
     int64_t nDownloadingSince;
+    //! How fast this peer delivers the blocks we request, which sizes its share of the download.
+    CBlockDownloadEstimator blockDownload;
     int nBlocksInFlight;
     int nBlocksInFlightValidHeaders;
     //! Whether we consider this a preferred download peer.
@@ -194,6 +197,10 @@ struct CNodeState {
      * otherwise: whether this peer sends non-witnesses in cmpctblocks/blocktxns.
      */
     bool fSupportsDesiredCmpctVersion;
+    //! Whether this peer will send us graphene blocks if we request them.
+    bool fSupportsGraphene;
+    //! Whether we relay blocks from this peer before they are fully validated.
+    bool fFastRelay;
 
     CNodeState(CAddress addrIn, std::string addrNameIn) : address(addrIn), name(addrNameIn) {
         fCurrentlyConnected = false;
@@ -206,6 +213,7 @@ struct CNodeState {
         nUnconnectingHeaders = 0;
         fSyncStarted = false;
         nHeadersSyncTimeout = 0;
+        fHeadersRangeFailed = false;
         nStallingSince = 0;
         nDownloadingSince = 0;
         nBlocksInFlight = 0;
@@ -215,6 +223,8 @@ struct CNodeState {
         fPreferHeaderAndIDs = false;
         fProvidesHeaderAndIDs = false;
         fSupportsDesiredCmpctVersion = false;
+        fSupportsGraphene = false;
+        fFastRelay = true;
     }
 };
 
@@ -278,6 +288,7 @@ void FinalizeNode(NodeId nodeid, bool& fUpdateConnectionTime) {
 
     if (state->fSyncStarted)
         nSyncStarted--;
+    headersRangeSync->ReleaseRange(nodeid);
 
     if (state->nMisbehavior == 0 && state->fCurrentlyConnected) {
         fUpdateConnectionTime = true;
@@ -286,7 +297,7 @@ void FinalizeNode(NodeId nodeid, bool& fUpdateConnectionTime) {
     BOOST_FOREACH(const QueuedBlock& entry, state->vBlocksInFlight) {
         mapBlocksInFlight.erase(entry.hash);
     }
-    EraseOrphansFor(nodeid);
+    orphanage.EraseForPeer(nodeid);
     nPreferredDownload -= state->fPreferredDownload;
     nPeersWithValidatedDownloads -= (state->nBlocksInFlightValidHeaders != 0);
     assert(nPeersWithValidatedDownloads >= 0);
@@ -326,6 +337,18 @@ bool MarkBlockAsReceived(const uint256& hash) {
     return false;
 }
 
+// Requires cs_main.
+// Feed the delivery of a block we requested from nodeid into its estimator. Call before MarkBlockAsReceived.
+void RecordBlockDelivery(NodeId nodeid, const uint256& hash, size_t nBytes, int64_t nTimeReceived) {
+    std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> >::iterator itInFlight = mapBlocksInFlight.find(hash);
+    if (itInFlight == mapBlocksInFlight.end() || itInFlight->second.first != nodeid)
+        return;
+    CNodeState *state = State(nodeid);
+    // Only the first block in flight was being transferred all the time since nDownloadingSince
+    if (state->vBlocksInFlight.begin() == itInFlight->second.second)
+        state->blockDownload.AddSample(nBytes, nTimeReceived - state->nDownloadingSince);
+}
+
 // Requires cs_main.
 // returns false, still setting pit, if the block was already in flight from the same peer
 // pit will only be valid as long as the same cs_main lock is being held
@@ -393,10 +416,17 @@ void UpdateBlockAvailability(NodeId nodeid, const uint256 &hash) {
     }
 }
 
+// Requires cs_main
+static bool RequestGrapheneBlocks(const CNodeState* nodestate) {
+    return nodestate->fSupportsGraphene && GetBoolArg("-graphene", DEFAULT_GRAPHENE);
+}
+
 void MaybeSetPeerAsAnnouncingHeaderAndIDs(NodeId nodeid, CConnman& connman) {
     AssertLockHeld(cs_main);
     CNodeState* nodestate = State(nodeid);
-    if (nodestate->fProvidesHeaderAndIDs) {
+    // Peers we get graphene blocks from keep announcing blocks with headers,
+    // which we answer with getgraphene
+    if (nodestate->fProvidesHeaderAndIDs && !RequestGrapheneBlocks(nodestate)) {
         for (std::list<NodeId>::iterator it = lNodesAnnouncingHeaderAndIDs.begin(); it != lNodesAnnouncingHeaderAndIDs.end(); it++) {
             if (*it == nodeid) {
                 lNodesAnnouncingHeaderAndIDs.erase(it);
@@ -460,8 +490,9 @@ const CBlockIndex* LastCommonAncestor(const CBlockIndex* pa, const CBlockIndex*
 }
 
 /** Update pindexLastCommonBlock and add not-in-flight missing successors to vBlocks, until it has
- *  at most count entries. */
-void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<const CBlockIndex*>& vBlocks, NodeId& nodeStaller, const Consensus::Params& consensusParams) {
+ *  at most count entries. If the download window keeps this peer from fetching anything, nodeStaller
+ *  is set to the peer holding up the window and pindexStalling to the block it holds it up with. */
+void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<const CBlockIndex*>& vBlocks, NodeId& nodeStaller, const CBlockIndex*& pindexStalling, const Consensus::Params& consensusParams) {
     if (count == 0)
         return;
 
@@ -497,6 +528,7 @@ void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<con
     int nWindowEnd = state->pindexLastCommonBlock->nHeight + BLOCK_DOWNLOAD_WINDOW;
     int nMaxHeight = std::min<int>(state->pindexBestKnownBlock->nHeight, nWindowEnd + 1);
     NodeId waitingfor = -1;
+    const CBlockIndex* pindexWaitingFor = NULL;
     while (pindexWalk->nHeight < nMaxHeight) {
         // Read up to 128 (or more, if more blocks than that are needed) successors of pindexWalk (towards
         // pindexBestKnownBlock) into vToFetch. We fetch 128, because CBlockIndex::GetAncestor may be as expensive
@@ -528,6 +560,7 @@ void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<con
                     if (vBlocks.size() == 0 && waitingfor != nodeid) {
                         // We aren't able to fetch anything, but we would be if the download window was one larger.
                         nodeStaller = waitingfor;
+                        pindexStalling = pindexWaitingFor;
                     }
                     return;
                 }
@@ -538,6 +571,7 @@ void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<con
             } else if (waitingfor == -1) {
                 // This is the first already-in-flight block.
                 waitingfor = mapBlocksInFlight[pindex->GetBlockHash()].first;
+                pindexWaitingFor = pindex;
             }
         }
     }
@@ -562,6 +596,10 @@ bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats) {
 
 void RegisterNodeSignals(CNodeSignals& nodeSignals)
 {
+    {
+        LOCK(cs_main);
+        headersRangeSync.reset(new CCheckpointHeadersSync(Params().Checkpoints().mapCheckpoints));
+    }
     nodeSignals.ProcessMessages.connect(&ProcessMessages);
     nodeSignals.SendMessages.connect(&SendMessages);
     nodeSignals.InitializeNode.connect(&InitializeNode);
@@ -578,7 +616,7 @@ void UnregisterNodeSignals(CNodeSignals& nodeSignals)
 
 //////////////////////////////////////////////////////////////////////////////
 //
-// mapOrphanTransactions
+// orphan transactions
 //
 
 void AddToCompactExtraTransactions(const CTransactionRef& tx)
@@ -592,109 +630,6 @@ void AddToCompactExtraTransactions(const CTransactionRef& tx)
     vExtraTxnForCompactIt = (vExtraTxnForCompactIt + 1) % max_extra_txn;
 }
 
-bool AddOrphanTx(const CTransactionRef& tx, NodeId peer) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
-{
-    const uint256& hash = tx->GetHash();
-    if (mapOrphanTransactions.count(hash))
-        return false;
-
-    // Ignore big transactions, to avoid a
-    // send-big-orphans memory exhaustion attack. If a peer has a legitimate
-    // large transaction with a missing parent then we assume
-    // it will rebroadcast it later, after the parent transaction(s)
-    // have been mined or received.
-    // 100 orphans, each of which is at most 99,999 bytes big is
-    // at most 10 megabytes of orphans and somewhat more byprev index (in the worst case):
-    unsigned int sz = GetTransactionSize(*tx);
-    if (sz < MIN_STANDARD_TX_SIZE || sz >= MAX_STANDARD_TX_SIZE)
-    {
-        LogPrint("mempool", "ignoring large orphan tx (size: %u, hash: %s)\n", sz, hash.ToString());
-        return false;
-    }
-
-    auto ret = mapOrphanTransactions.emplace(hash, COrphanTx{tx, peer, GetTime() + ORPHAN_TX_EXPIRE_TIME});
-    assert(ret.second);
-    BOOST_FOREACH(const CTxIn& txin, tx->vin) {
-        mapOrphanTransactionsByPrev[txin.prevout].insert(ret.first);
-    }
-
-    AddToCompactExtraTransactions(tx);
-
-    LogPrint("mempool", "stored orphan tx %s (mapsz %u outsz %u)\n", hash.ToString(),
-             mapOrphanTransactions.size(), mapOrphanTransactionsByPrev.size());
-    return true;
-}
-
-int static EraseOrphanTx(uint256 hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
-{
-    std::map<uint256, COrphanTx>::iterator it = mapOrphanTransactions.find(hash);
-    if (it == mapOrphanTransactions.end())
-        return 0;
-    BOOST_FOREACH(const CTxIn& txin, it->second.tx->vin)
-    {
-        auto itPrev = mapOrphanTransactionsByPrev.find(txin.prevout);
-        if (itPrev == mapOrphanTransactionsByPrev.end())
-            continue;
-        itPrev->second.erase(it);
-        if (itPrev->second.empty())
-            mapOrphanTransactionsByPrev.erase(itPrev);
-    }
-    mapOrphanTransactions.erase(it);
-    return 1;
-}
-
-void EraseOrphansFor(NodeId peer)
-{
-    int nErased = 0;
-    std::map<uint256, COrphanTx>::iterator iter = mapOrphanTransactions.begin();
-    while (iter != mapOrphanTransactions.end())
-    {
-        std::map<uint256, COrphanTx>::iterator maybeErase = iter++; // increment to avoid iterator becoming invalid
-        if (maybeErase->second.fromPeer == peer)
-        {
-            nErased += EraseOrphanTx(maybeErase->second.tx->GetHash());
-        }
-    }
-    if (nErased > 0) LogPrint("mempool", "Erased %d orphan tx from peer=%d\n", nErased, peer);
-}
-
-
-unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
-{
-    unsigned int nEvicted = 0;
-    static int64_t nNextSweep;
-    int64_t nNow = GetTime();
-    if (nNextSweep <= nNow) {
-        // Sweep out expired orphan pool entries:
-        int nErased = 0;
-        int64_t nMinExpTime = nNow + ORPHAN_TX_EXPIRE_TIME - ORPHAN_TX_EXPIRE_INTERVAL;
-        std::map<uint256, COrphanTx>::iterator iter = mapOrphanTransactions.begin();
-        while (iter != mapOrphanTransactions.end())
-        {
-            std::map<uint256, COrphanTx>::iterator maybeErase = iter++;
-            if (maybeErase->second.nTimeExpire <= nNow) {
-                nErased += EraseOrphanTx(maybeErase->second.tx->GetHash());
-            } else {
-                nMinExpTime = std::min(maybeErase->second.nTimeExpire, nMinExpTime);
-            }
-        }
-        // Sweep again 5 minutes after the next entry that expires in order to batch the linear scan.
-        nNextSweep = nMinExpTime + ORPHAN_TX_EXPIRE_INTERVAL;
-        if (nErased > 0) LogPrint("mempool", "Erased %d orphan tx due to expiration\n", nErased);
-    }
-    while (mapOrphanTransactions.size() > nMaxOrphans)
-    {
-        // Evict a random orphan:
-        uint256 randomhash = GetRandHash();
-        std::map<uint256, COrphanTx>::iterator it = mapOrphanTransactions.lower_bound(randomhash);
-        if (it == mapOrphanTransactions.end())
-            it = mapOrphanTransactions.begin();
-        EraseOrphanTx(it->first);
-        ++nEvicted;
-    }
-    return nEvicted;
-}
-
 // Requires cs_main.
 void Misbehaving(NodeId pnode, int howmuch)
 {
@@ -736,6 +671,101 @@ void RequestHeadersFrom(CNode* pto, CConnman& connman, const CBlockIndex* pindex
 
 }
 
+/** Request the next part of a checkpoint range, following hashLocator up to hashStop */
+void RequestHeadersRange(CNode* pto, CConnman& connman, const uint256& hashLocator, const uint256& hashStop)
+{
+    const CNetMsgMaker msgMaker(pto->GetSendVersion());
+    connman.PushMessage(pto, msgMaker.Make(NetMsgType::GETHEADERS, CBlockLocator(std::vector<uint256>(1, hashLocator)), hashStop));
+    pto->nPendingHeaderRequests += 1;
+}
+
+/**
+ * Hand the checkpoint ranges that now connect to the block index to
+ * ProcessNewBlockHeaders, in batches so that cs_main is released in between.
+ */
+void ConnectHeadersRanges(const CChainParams& chainparams)
+{
+    while (true) {
+        std::vector<CBlockHeader> headers;
+        NodeId nodeSource;
+        {
+            LOCK(cs_main);
+            headersRangeSync->Prune(pindexBestHeader->nHeight);
+            if (!headersRangeSync->PopConnectable([](const uint256& hash) { return mapBlockIndex.count(hash) > 0; }, headers, nodeSource))
+                return;
+        }
+        LogPrint("net", "connecting %u headers of a checkpoint range from peer=%d\n", headers.size(), nodeSource);
+        for (size_t nStart = 0; nStart < headers.size(); nStart += MAX_HEADERS_RESULTS) {
+            std::vector<CBlockHeader> vBatch(headers.begin() + nStart, headers.begin() + std::min(headers.size(), nStart + MAX_HEADERS_RESULTS));
+            CValidationState state;
+            if (!ProcessNewBlockHeaders(vBatch, state, chainparams)) {
+                int nDoS;
+                if (state.IsInvalid(nDoS) && nDoS > 0) {
+                    LOCK(cs_main);
+                    Misbehaving(nodeSource, nDoS);
+                }
+                LogPrint("net", "invalid header in checkpoint range from peer=%d\n", nodeSource);
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * Buffer a response to a checkpoint range request. Only the context-free
+ * checks happen now; the rest follows when the range connects.
+ */
+bool ProcessHeadersRange(CNode* pfrom, CConnman& connman, const std::vector<CBlockHeader>& headers, const CChainParams& chainparams)
+{
+    CValidationState state;
+    std::vector<uint256> vHashes;
+    bool fValid = CheckBlockHeaders(headers, vHashes, state, chainparams.GetConsensus());
+
+    {
+    LOCK(cs_main);
+    CNodeState *nodestate = State(pfrom->GetId());
+    if (!fValid) {
+        int nDoS;
+        if (state.IsInvalid(nDoS))
+            Misbehaving(pfrom->GetId(), nDoS);
+        headersRangeSync->ReleaseRange(pfrom->GetId());
+        nodestate->fHeadersRangeFailed = true;
+        return error("invalid header received");
+    }
+
+    uint256 hashLocator, hashStop;
+    switch (headersRangeSync->ReceiveHeaders(pfrom->GetId(), headers, vHashes, GetTimeMicros(), hashLocator, hashStop)) {
+    case CCheckpointHeadersSync::NOT_RANGE:
+        // The range was pruned in the meantime
+        return true;
+    case CCheckpointHeadersSync::INVALID:
+        nodestate->fHeadersRangeFailed = true;
+        Misbehaving(pfrom->GetId(), 100);
+        return error("headers contradict a checkpoint");
+    case CCheckpointHeadersSync::MISSING:
+        LogPrint("net", "peer=%d does not have its checkpoint range\n", pfrom->id);
+        nodestate->fHeadersRangeFailed = true;
+        return true;
+    case CCheckpointHeadersSync::PARTIAL:
+        if (headers.size() < MAX_HEADERS_RESULTS) {
+            // The peer does not have the rest of the range
+            LogPrint("net", "peer=%d cannot complete its checkpoint range\n", pfrom->id);
+            headersRangeSync->ReleaseRange(pfrom->GetId());
+            nodestate->fHeadersRangeFailed = true;
+        } else {
+            RequestHeadersRange(pfrom, connman, hashLocator, hashStop);
+        }
+        return true;
+    case CCheckpointHeadersSync::COMPLETE:
+        LogPrint("net", "completed checkpoint range up to %s from peer=%d\n", vHashes.back().ToString(), pfrom->id);
+        break;
+    }
+    }
+
+    ConnectHeadersRanges(chainparams);
+    return true;
+}
+
 
 
 
@@ -751,32 +781,11 @@ PeerLogicValidation::PeerLogicValidation(CConnman* connmanIn) : connman(connmanI
     recentRejects.reset(new CRollingBloomFilter(120000, 0.000001));
 }
 
-void PeerLogicValidation::SyncTransaction(const CTransaction& tx, const CBlockIndex* pindex, int nPosInBlock) {
+void PeerLogicValidation::SyncTransaction(const CTransactionRef& ptx, const CBlockIndex* pindex, int nPosInBlock) {
     if (nPosInBlock == CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK)
         return;
 
-    LOCK(cs_main);
-
-    std::vector<uint256> vOrphanErase;
-    // Which orphan pool entries must we evict?
-    for (size_t j = 0; j < tx.vin.size(); j++) {
-        auto itByPrev = mapOrphanTransactionsByPrev.find(tx.vin[j].prevout);
-        if (itByPrev == mapOrphanTransactionsByPrev.end()) continue;
-        for (auto mi = itByPrev->second.begin(); mi != itByPrev->second.end(); ++mi) {
-            const CTransaction& orphanTx = *(*mi)->second.tx;
-            const uint256& orphanHash = orphanTx.GetHash();
-            vOrphanErase.push_back(orphanHash);
-        }
-    }
-
-    // Erase orphan transactions include or precluded by this block
-    if (vOrphanErase.size()) {
-        int nErased = 0;
-        BOOST_FOREACH(uint256 &orphanHash, vOrphanErase) {
-            nErased += EraseOrphanTx(orphanHash);
-        }
-        LogPrint("mempool", "Erased %d orphan tx included or conflicted by block\n", nErased);
-    }
+    orphanage.EraseForBlock(*ptx);
 }
 
 static CCriticalSection cs_most_recent_block;
@@ -784,13 +793,19 @@ static std::shared_ptr<const CBlock> most_recent_block;
 static std::shared_ptr<const CBlockHeaderAndShortTxIDs> most_recent_compact_block;
 static uint256 most_recent_block_hash;
 
-void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock) {
-    std::shared_ptr<const CBlockHeaderAndShortTxIDs> pcmpctblock = std::make_shared<const CBlockHeaderAndShortTxIDs>(*pblock);
-    const CNetMsgMaker msgMaker(PROTOCOL_VERSION);
+//! Height of the last block announced before it was connected. Requires cs_main.
+static int nHighestFastAnnounce = 0;
 
-    LOCK(cs_main);
+/**
+ * Announce a block that builds on our tip before it is connected: its compact
+ * block goes to the peers that asked for high-bandwidth relay, and its header
+ * to graphene peers, which fetch it right away. Both are served from
+ * most_recent_block until the block is stored.
+ */
+static void AnnounceNewBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock, const std::shared_ptr<const CBlockHeaderAndShortTxIDs>& pcmpctblock, CConnman& connman) {
+    AssertLockHeld(cs_main);
+    const CNetMsgMaker msgMaker(PROTOCOL_VERSION);
 
-    static int nHighestFastAnnounce = 0;
     if (pindex->nHeight <= nHighestFastAnnounce)
         return;
     nHighestFastAnnounce = pindex->nHeight;
@@ -804,7 +819,7 @@ void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std:
         most_recent_compact_block = pcmpctblock;
     }
 
-    connman->ForEachNode([this, &pcmpctblock, pindex, &msgMaker, &hashBlock](CNode* pnode) {
+    connman.ForEachNode([&connman, &pcmpctblock, pindex, &msgMaker, &hashBlock](CNode* pnode) {
         // TODO: Avoid the repeated-serialization here
         if (pnode->nVersion < INVALID_CB_NO_BAN_VERSION || pnode->fDisconnect)
             return;
@@ -812,17 +827,73 @@ void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std:
         CNodeState &state = *State(pnode->GetId());
         // If the peer has, or we announced to them the previous block already,
         // but we don't think they have this one, go ahead and announce it
-        if (state.fPreferHeaderAndIDs &&
-                !PeerHasHeader(&state, pindex) && PeerHasHeader(&state, pindex->pprev)) {
-
-            LogPrint("net", "%s sending header-and-ids %s to peer=%d\n", "PeerLogicValidation::NewPoWValidBlock",
+        if (PeerHasHeader(&state, pindex) || !PeerHasHeader(&state, pindex->pprev))
+            return;
+        if (state.fPreferHeaderAndIDs) {
+            LogPrint("net", "%s sending header-and-ids %s to peer=%d\n", "AnnounceNewBlock",
                     hashBlock.ToString(), pnode->id);
-            connman->PushMessage(pnode, msgMaker.Make(NetMsgType::CMPCTBLOCK, *pcmpctblock));
+            connman.PushMessage(pnode, msgMaker.Make(NetMsgType::CMPCTBLOCK, *pcmpctblock));
+            state.pindexBestHeaderSent = pindex;
+        } else if (state.fPreferHeaders && RequestGrapheneBlocks(&state)) {
+            LogPrint("net", "%s sending header %s to graphene peer=%d\n", "AnnounceNewBlock",
+                    hashBlock.ToString(), pnode->id);
+            std::vector<CBlock> vHeaders(1, pindex->GetBlockHeader());
+            connman.PushMessage(pnode, msgMaker.Make(NetMsgType::HEADERS, vHeaders));
             state.pindexBestHeaderSent = pindex;
         }
     });
 }
 
+void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock) {
+    std::shared_ptr<const CBlockHeaderAndShortTxIDs> pcmpctblock = std::make_shared<const CBlockHeaderAndShortTxIDs>(*pblock);
+
+    LOCK(cs_main);
+    // Blocks from peers that sent us an invalid one wait until they are connected
+    std::map<uint256, std::pair<NodeId, bool>>::iterator it = mapBlockSource.find(pblock->GetHash());
+    if (it != mapBlockSource.end() && State(it->second.first) && !State(it->second.first)->fFastRelay)
+        return;
+    AnnounceNewBlock(pindex, pblock, pcmpctblock, *connman);
+}
+
+/**
+ * Relay a block pfrom sent us while ProcessNewBlock connects it, as soon as
+ * its header connects to our tip and the checks that need no UTXOs, CheckBlock
+ * and ContextualCheckBlock, pass. Peers that sent an invalid block lose this
+ * treatment for the rest of the connection.
+ */
+static void FastRelayBlock(CNode* pfrom, const std::shared_ptr<const CBlock>& pblock, CConnman& connman) {
+    if (!GetBoolArg("-fastblockrelay", DEFAULT_FAST_BLOCK_RELAY))
+        return;
+
+    const uint256 hash(pblock->GetHash());
+    {
+        LOCK(cs_main);
+        if (IsInitialBlockDownload() || !State(pfrom->GetId())->fFastRelay)
+            return;
+        BlockMap::iterator it = mapBlockIndex.find(hash);
+        if (it == mapBlockIndex.end() || it->second->pprev != chainActive.Tip() || it->second->nHeight <= nHighestFastAnnounce ||
+                (it->second->nStatus & (BLOCK_HAVE_DATA | BLOCK_FAILED_MASK)))
+            return;
+    }
+
+    // The result is cached in the block, so ProcessNewBlock does not check it again
+    CValidationState state;
+    if (!CheckBlock(*pblock, state))
+        return;
+    std::shared_ptr<const CBlockHeaderAndShortTxIDs> pcmpctblock = std::make_shared<const CBlockHeaderAndShortTxIDs>(*pblock);
+
+    LOCK(cs_main);
+    // Our tip may have moved on meanwhile
+    BlockMap::iterator it = mapBlockIndex.find(hash);
+    if (it->second->pprev != chainActive.Tip() || (it->second->nStatus & BLOCK_FAILED_MASK))
+        return;
+    // Cheap next to connecting the block, and catches malleated witnesses
+    if (!ContextualCheckBlock(*pblock, state, it->second->pprev))
+        return;
+    LogPrint("net", "fast relaying block %s from peer=%d\n", hash.ToString(), pfrom->id);
+    AnnounceNewBlock(it->second, pblock, pcmpctblock, connman);
+}
+
 void PeerLogicValidation::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) {
     const int nNewHeight = pindexNew->nHeight;
     connman->SetBestHeight(nNewHeight);
@@ -866,6 +937,10 @@ void PeerLogicValidation::BlockChecked(const CBlock& block, const CValidationSta
             assert (state.GetRejectCode() < REJECT_INTERNAL); // Blocks are never rejected with internal reject codes
             CBlockReject reject = {(unsigned char)state.GetRejectCode(), state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), hash};
             State(it->second.first)->rejects.push_back(reject);
+            if (State(it->second.first)->fFastRelay && !state.CorruptionPossible()) {
+                LogPrint("net", "no longer relaying blocks from peer=%d before validating them\n", it->second.first);
+                State(it->second.first)->fFastRelay = false;
+            }
             if (nDoS > 0 && it->second.second)
                 Misbehaving(it->second.first, nDoS);
         }
@@ -914,7 +989,7 @@ bool static AlreadyHave(const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
             // requesting or processing some txs which have already been included in a block
             return recentRejects->contains(inv.hash) ||
                    mempool.exists(inv.hash) ||
-                   mapOrphanTransactions.count(inv.hash) ||
+                   orphanage.HaveTx(inv.hash) ||
                    pcoinsTip->HaveCoinsInCache(inv.hash);
         }
     case MSG_BLOCK:
@@ -933,6 +1008,28 @@ static void RelayTransaction(const CTransaction& tx, CConnman& connman)
     });
 }
 
+/** Whether we offer a peer to reconcile transaction announcements, see "sendrecon" */
+static bool OfferTxReconciliation(CNode* pnode)
+{
+    if (!fRelayTxes || !GetBoolArg("-txreconciliation", DEFAULT_TXRECONCILIATION))
+        return false;
+    LOCK(pnode->cs_filter);
+    return pnode->fRelayTxes;
+}
+
+/** Take the transactions to announce to a reconciling peer, except those it knows or that left the mempool */
+static std::set<uint256> TakeReconciliationSet(CNode* pnode)
+{
+    AssertLockHeld(pnode->cs_inventory);
+    std::set<uint256> setTx;
+    for (const uint256& hash : pnode->setInventoryTxToSend) {
+        if (!pnode->filterInventoryKnown.contains(hash) && mempool.exists(hash))
+            setTx.insert(hash);
+    }
+    pnode->setInventoryTxToSend.clear();
+    return setTx;
+}
+
 static void RelayAddress(const CAddress& addr, bool fReachable, CConnman& connman)
 {
     unsigned int nRelayNodes = fReachable ? 2 : 1; // limited relaying of addresses outside our network(s)
@@ -1165,6 +1262,237 @@ inline void static SendBlockTransactions(const CBlock& block, const BlockTransac
     connman.PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::BLOCKTXN, resp));
 }
 
+static void SendGrapheneBlock(const CBlock& block, uint64_t nReceiverPoolTx, CNode* pfrom, CConnman& connman) {
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    if (CGrapheneBlock::IsEncodable(block.vtx.size(), nReceiverPoolTx)) {
+        CGrapheneBlock grapheneblock(block, nReceiverPoolTx);
+        unsigned int nSize = GetSerializeSize(grapheneblock, SER_NETWORK, PROTOCOL_VERSION);
+        if (nSize <= MAX_PROTOCOL_MESSAGE_LENGTH) {
+            LogPrint("net", "sending graphene block %s with %u txn for a mempool of %u txn (%u bytes) peer=%d\n", block.GetHash().ToString(),
+                     block.vtx.size(), nReceiverPoolTx, nSize, pfrom->id);
+            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::GRAPHENEBLK, grapheneblock));
+            return;
+        }
+    }
+
+    // Too large to send as a graphene block. The peer keeps the block in
+    // flight, as when it falls back after failing to decode one.
+    LogPrint("net", "graphene block %s for a mempool of %u txn is too large, sending a compact or full block peer=%d\n", block.GetHash().ToString(),
+             nReceiverPoolTx, pfrom->id);
+    bool fSupportsCmpct;
+    {
+        LOCK(cs_main);
+        fSupportsCmpct = State(pfrom->GetId())->fSupportsDesiredCmpctVersion;
+    }
+    if (fSupportsCmpct)
+        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::CMPCTBLOCK, CBlockHeaderAndShortTxIDs(block)));
+    else
+        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, block));
+}
+
+/**
+ * Validate a getcfilters, getcfheaders or getcfcheckpt request. Peers
+ * sending malformed requests, or requests we did not advertise support for,
+ * are disconnected. Returns false if no response should be sent; that
+ * includes requests for blocks the filter index has not processed yet.
+ *
+ * @param[in]   pfrom           The peer that sent the request
+ * @param[in]   filter_type     The filter type the request is for. Must be basic filters.
+ * @param[in]   start_height    The start height for the request
+ * @param[in]   stop_hash       The stop_hash for the request
+ * @param[in]   max_height_diff The maximum number of items permitted to request, as specified in BIP 157
+ * @param[out]  stop_index      The CBlockIndex for the stop_hash block, if the request can be serviced.
+ */
+static bool PrepareBlockFilterRequest(CNode* pfrom, uint8_t filter_type, uint32_t start_height, const uint256& stop_hash,
+                                      uint32_t max_height_diff, const CBlockIndex*& stop_index)
+{
+    if (!(pfrom->GetLocalServices() & NODE_COMPACT_FILTERS) || !g_blockfilterindex ||
+        filter_type != g_blockfilterindex->GetFilterType()) {
+        LogPrint("net", "peer %d requested unsupported block filter type: %d\n", pfrom->id, filter_type);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+
+    {
+        LOCK(cs_main);
+        BlockMap::const_iterator it = mapBlockIndex.find(stop_hash);
+        // Only serve the active chain, so peers cannot probe for stale blocks we know of
+        if (it == mapBlockIndex.end() || !chainActive.Contains(it->second)) {
+            LogPrint("net", "peer %d requested invalid block hash: %s\n", pfrom->id, stop_hash.ToString());
+            pfrom->fDisconnect = true;
+            return false;
+        }
+        stop_index = it->second;
+    }
+
+    uint32_t stop_height = stop_index->nHeight;
+    if (start_height > stop_height) {
+        LogPrint("net", "peer %d sent invalid getcfilters/getcfheaders with start height %d and stop height %d\n",
+                 pfrom->id, start_height, stop_height);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+    if (stop_height - start_height >= max_height_diff) {
+        LogPrint("net", "peer %d requested too many cfilters/cfheaders: %d / %d\n",
+                 pfrom->id, stop_height - start_height + 1, max_height_diff);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+
+    const CBlockIndex* pindexBest = g_blockfilterindex->GetBestBlockIndex();
+    if (!pindexBest || pindexBest->GetAncestor(stop_index->nHeight) != stop_index) {
+        LogPrint("net", "Ignoring block filter request from peer %d, index is still syncing\n", pfrom->id);
+        return false;
+    }
+    return true;
+}
+
+/** Handle a getcfilters request: send one cfilter message per block in the range */
+static void ProcessGetCFilters(CNode* pfrom, CDataStream& vRecv, CConnman& connman)
+{
+    uint8_t filter_type;
+    uint32_t start_height;
+    uint256 stop_hash;
+    vRecv >> filter_type >> start_height >> stop_hash;
+
+    const CBlockIndex* stop_index;
+    if (!PrepareBlockFilterRequest(pfrom, filter_type, start_height, stop_hash, MAX_GETCFILTERS_SIZE, stop_index))
+        return;
+
+    std::vector<BlockFilter> filters;
+    if (!g_blockfilterindex->LookupFilterRange(start_height, stop_index, filters)) {
+        LogPrint("net", "Failed to find block filter in index: filter_type=%s, start_height=%d, stop_hash=%s\n",
+                 BlockFilterTypeName(g_blockfilterindex->GetFilterType()), start_height, stop_hash.ToString());
+        return;
+    }
+
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    for (const BlockFilter& filter : filters)
+        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::CFILTER, filter));
+}
+
+/** Handle a getcfheaders request: send the filter hashes of the range and the header preceding it */
+static void ProcessGetCFHeaders(CNode* pfrom, CDataStream& vRecv, CConnman& connman)
+{
+    uint8_t filter_type;
+    uint32_t start_height;
+    uint256 stop_hash;
+    vRecv >> filter_type >> start_height >> stop_hash;
+
+    const CBlockIndex* stop_index;
+    if (!PrepareBlockFilterRequest(pfrom, filter_type, start_height, stop_hash, MAX_GETCFHEADERS_SIZE, stop_index))
+        return;
+
+    uint256 prev_header;
+    if (start_height > 0) {
+        const CBlockIndex* prev_block = stop_index->GetAncestor(static_cast<int>(start_height - 1));
+        if (!g_blockfilterindex->LookupFilterHeader(prev_block, prev_header)) {
+            LogPrint("net", "Failed to find block filter header in index: filter_type=%s, block_hash=%s\n",
+                     BlockFilterTypeName(g_blockfilterindex->GetFilterType()), prev_block->GetBlockHash().ToString());
+            return;
+        }
+    }
+
+    std::vector<uint256> filter_hashes;
+    if (!g_blockfilterindex->LookupFilterHashRange(start_height, stop_index, filter_hashes)) {
+        LogPrint("net", "Failed to find block filter hashes in index: filter_type=%s, start_height=%d, stop_hash=%s\n",
+                 BlockFilterTypeName(g_blockfilterindex->GetFilterType()), start_height, stop_hash.ToString());
+        return;
+    }
+
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::CFHEADERS, filter_type, stop_index->GetBlockHash(),
+                                             prev_header, filter_hashes));
+}
+
+/** Handle a getcfcheckpt request: send the filter headers of every CFCHECKPT_INTERVAL-th block up to the stop block */
+static void ProcessGetCFCheckPt(CNode* pfrom, CDataStream& vRecv, CConnman& connman)
+{
+    uint8_t filter_type;
+    uint256 stop_hash;
+    vRecv >> filter_type >> stop_hash;
+
+    const CBlockIndex* stop_index;
+    if (!PrepareBlockFilterRequest(pfrom, filter_type, 0, stop_hash, std::numeric_limits<uint32_t>::max(), stop_index))
+        return;
+
+    std::vector<uint256> headers(stop_index->nHeight / CFCHECKPT_INTERVAL);
+    for (size_t i = 0; i < headers.size(); i++) {
+        const CBlockIndex* pindex = stop_index->GetAncestor((i + 1) * CFCHECKPT_INTERVAL);
+        if (!g_blockfilterindex->LookupFilterHeader(pindex, headers[i])) {
+            LogPrint("net", "Failed to find block filter header in index: filter_type=%s, block_hash=%s\n",
+                     BlockFilterTypeName(g_blockfilterindex->GetFilterType()), pindex->GetBlockHash().ToString());
+            return;
+        }
+    }
+
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::CFCHECKPT, filter_type, stop_index->GetBlockHash(), headers));
+}
+
+/**
+ * Reconsider up to MAX_ORPHAN_RECONSIDER_BATCH orphans from a peer's work set,
+ * whose missing inputs may have arrived since. Returns whether work is left.
+ *
+ * This runs on the message handler thread, like the rest of transaction
+ * processing: AcceptToMemoryPool needs cs_main wherever it is called from, and
+ * relaying or punishing on behalf of pfrom needs the node to stay referenced.
+ * What keeps a long orphan chain from stalling other peers is the batch limit,
+ * after which ProcessMessages moves on to the next peer.
+ */
+static bool ProcessOrphanTx(CNode* pfrom, CConnman& connman) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    std::list<CTransactionRef> lRemovedTxn;
+    CTransactionRef porphanTx;
+    unsigned int nReconsidered = 0;
+    while (nReconsidered < MAX_ORPHAN_RECONSIDER_BATCH && orphanage.GetTxToReconsider(pfrom->GetId(), porphanTx)) {
+        nReconsidered++;
+        const CTransaction& orphanTx = *porphanTx;
+        const uint256 orphanHash = orphanTx.GetHash();
+        bool fMissingInputs = false;
+        // Use a dummy CValidationState so someone can't setup nodes to counter-DoS based on orphan
+        // resolution (that is, feeding people an invalid transaction based on LegitTxX in order to get
+        // anyone relaying LegitTxX banned)
+        CValidationState stateDummy;
+
+        if (AcceptToMemoryPool(mempool, stateDummy, porphanTx, true, &fMissingInputs, &lRemovedTxn)) {
+            LogPrint("mempool", "   accepted orphan tx %s\n", orphanHash.ToString());
+            RelayTransaction(orphanTx, connman);
+            orphanage.AddChildrenToWorkSet(orphanTx);
+            orphanage.EraseTx(orphanHash);
+        }
+        else if (!fMissingInputs)
+        {
+            int nDos = 0;
+            if (stateDummy.IsInvalid(nDos) && nDos > 0)
+            {
+                // Punish peer that gave us an invalid orphan tx
+                Misbehaving(pfrom->GetId(), nDos);
+                LogPrint("mempool", "   invalid orphan tx %s\n", orphanHash.ToString());
+            }
+            // Has inputs but not accepted to mempool
+            // Probably non-standard or insufficient fee/priority
+            LogPrint("mempool", "   removed orphan tx %s\n", orphanHash.ToString());
+            orphanage.EraseTx(orphanHash);
+            if (!stateDummy.CorruptionPossible()) {
+                // Do not use rejection cache for witness transactions or
+                // witness-stripped transactions, as they can have been malleated.
+                // See https://github.com/bitcoin/bitcoin/issues/8279 for details.
+                assert(recentRejects);
+                recentRejects->insert(orphanHash);
+            }
+            if (nDos > 0)
+                break;
+        }
+        mempool.check(pcoinsTip);
+    }
+
+    for (const CTransactionRef& removedTx : lRemovedTxn)
+        AddToCompactExtraTransactions(removedTx);
+
+    return orphanage.HaveTxToReconsider(pfrom->GetId());
+}
+
 bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, int64_t nTimeReceived, const CChainParams& chainparams, CConnman& connman, const std::atomic<bool>& interruptMsgProc)
 {
     LogPrint("net", "received: %s (%u bytes) peer=%d\n", SanitizeString(strCommand), vRecv.size(), pfrom->id);
@@ -1415,6 +1743,14 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             uint64_t nCMPCTBLOCKVersion = 1;
             connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::SENDCMPCT, fAnnounceUsingCMPCTBLOCK, nCMPCTBLOCKVersion));
         }
+        if (GetBoolArg("-graphene", DEFAULT_GRAPHENE)) {
+            // Unknown messages are ignored, so no version check is needed
+            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::SENDGRAPHENE, GRAPHENE_VERSION));
+        }
+        if (OfferTxReconciliation(pfrom)) {
+            // Unknown messages are ignored, so no version check is needed
+            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::SENDRECON, TXRECONCILIATION_VERSION, pfrom->txrecon.nLocalSalt));
+        }
         pfrom->fSuccessfullyConnected = true;
     }
 
@@ -1498,6 +1834,130 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         }
     }
 
+    else if (strCommand == NetMsgType::SENDGRAPHENE)
+    {
+        uint64_t nGrapheneVersion = 0;
+        vRecv >> nGrapheneVersion;
+        if (nGrapheneVersion == GRAPHENE_VERSION) {
+            LOCK(cs_main);
+            State(pfrom->GetId())->fSupportsGraphene = true;
+        }
+    }
+
+
+    else if (strCommand == NetMsgType::SENDRECON)
+    {
+        uint32_t nReconVersion = 0;
+        uint64_t nRemoteSalt = 0;
+        vRecv >> nReconVersion >> nRemoteSalt;
+        // Later versions must stay compatible with ours
+        if (nReconVersion >= TXRECONCILIATION_VERSION && OfferTxReconciliation(pfrom)) {
+            LOCK(pfrom->cs_inventory);
+            if (!pfrom->txrecon.fEnabled) {
+                pfrom->txrecon.Enable(nRemoteSalt);
+                LogPrint("net", "reconciling transaction announcements with peer=%d\n", pfrom->id);
+            }
+        }
+    }
+
+    else if (strCommand == NetMsgType::REQRECON)
+    {
+        // Only inbound peers request reconciliations, one at a time
+        uint32_t nRemoteSize = 0;
+        vRecv >> nRemoteSize;
+        CIBLT sketch;
+        {
+            LOCK(pfrom->cs_inventory);
+            CTxReconciliationState& recon = pfrom->txrecon;
+            if (!recon.fEnabled || !pfrom->fInbound || recon.fSketched) {
+                LogPrint("net", "unexpected reqrecon from peer=%d\n", pfrom->id);
+                return true;
+            }
+            std::set<uint256> setTx = TakeReconciliationSet(pfrom);
+            if (!setTx.empty())
+                sketch = recon.ComputeSketch(setTx, GetReconSketchCells(setTx.size(), nRemoteSize));
+            for (const uint256& hash : setTx)
+                recon.mapSketched.emplace(recon.GetShortId(hash), hash);
+            recon.fSketched = true;
+            recon.nSketchTime = GetTimeMicros();
+        }
+        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::SKETCH, sketch));
+    }
+
+    else if (strCommand == NetMsgType::SKETCH)
+    {
+        CIBLT sketch;
+        vRecv >> sketch;
+        bool fDecoded = false;
+        std::vector<uint64_t> vLocal, vRemote;
+        {
+            LOCK(pfrom->cs_inventory);
+            CTxReconciliationState& recon = pfrom->txrecon;
+            if (!recon.fEnabled || !recon.fRequested) {
+                LogPrint("net", "unexpected sketch from peer=%d\n", pfrom->id);
+                return true;
+            }
+            recon.fRequested = false;
+            std::set<uint256> setTx = TakeReconciliationSet(pfrom);
+            if (sketch.size() == 0) {
+                // The peer has nothing to announce, so it lacks all we have
+                fDecoded = true;
+                for (const uint256& hash : setTx)
+                    vLocal.push_back(recon.GetShortId(hash));
+            } else if (sketch.IsValid() && sketch.size() <= MAX_RECON_SKETCH_CELLS) {
+                CIBLT diff = recon.ComputeSketch(setTx, sketch.size());
+                diff -= sketch;
+                fDecoded = diff.Decode(vLocal, vRemote);
+            }
+            if (fDecoded) {
+                // Announce what the peer is missing; drop what it has
+                std::map<uint64_t, uint256> mapShortIds;
+                for (const uint256& hash : setTx)
+                    mapShortIds.emplace(recon.GetShortId(hash), hash);
+                for (uint64_t nShortId : vLocal) {
+                    auto it = mapShortIds.find(nShortId);
+                    if (it == mapShortIds.end()) {
+                        fDecoded = false;
+                        break;
+                    }
+                    recon.setTxToAnnounce.insert(it->second);
+                }
+            }
+            if (!fDecoded) {
+                recon.setTxToAnnounce.insert(setTx.begin(), setTx.end());
+                vRemote.clear();
+            }
+            LogPrint("net", "reconciled %u transactions with peer=%d: %s, %u to announce, %u to request\n",
+                setTx.size(), pfrom->id, fDecoded ? "decoded" : "failed", fDecoded ? vLocal.size() : setTx.size(), vRemote.size());
+        }
+        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::RECONCILDIFF, fDecoded, vRemote));
+    }
+
+    else if (strCommand == NetMsgType::RECONCILDIFF)
+    {
+        bool fDecoded = false;
+        std::vector<uint64_t> vShortIds;
+        vRecv >> fDecoded >> vShortIds;
+        LOCK(pfrom->cs_inventory);
+        CTxReconciliationState& recon = pfrom->txrecon;
+        if (!recon.fEnabled || !recon.fSketched) {
+            LogPrint("net", "unexpected reconcildiff from peer=%d\n", pfrom->id);
+            return true;
+        }
+        if (fDecoded) {
+            for (uint64_t nShortId : vShortIds) {
+                auto it = recon.mapSketched.find(nShortId);
+                if (it != recon.mapSketched.end())
+                    recon.setTxToAnnounce.insert(it->second);
+            }
+        } else {
+            for (const auto& entry : recon.mapSketched)
+                recon.setTxToAnnounce.insert(entry.second);
+        }
+        recon.mapSketched.clear();
+        recon.fSketched = false;
+    }
+
 
     else if (strCommand == NetMsgType::INV)
     {
@@ -1700,6 +2160,55 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
     }
 
 
+    else if (strCommand == NetMsgType::GETGRAPHENE)
+    {
+        // Only peers we sent "sendgraphene" to may ask for graphene blocks
+        if (!GetBoolArg("-graphene", DEFAULT_GRAPHENE)) {
+            LogPrint("net", "getgraphene from peer=%d ignored, graphene blocks are disabled\n", pfrom->id);
+            return true;
+        }
+
+        uint256 hash;
+        uint64_t nReceiverPoolTx;
+        vRecv >> hash >> nReceiverPoolTx;
+
+        std::shared_ptr<const CBlock> recent_block;
+        {
+            LOCK(cs_most_recent_block);
+            if (most_recent_block_hash == hash)
+                recent_block = most_recent_block;
+            // Unlock cs_most_recent_block to avoid cs_main lock inversion
+        }
+        if (recent_block) {
+            SendGrapheneBlock(*recent_block, nReceiverPoolTx, pfrom, connman);
+            return true;
+        }
+
+        LOCK(cs_main);
+
+        BlockMap::iterator it = mapBlockIndex.find(hash);
+        if (it == mapBlockIndex.end() || !(it->second->nStatus & BLOCK_HAVE_DATA)) {
+            LogPrint("net", "Peer %d sent us a getgraphene for a block we don't have\n", pfrom->id);
+            return true;
+        }
+
+        if (it->second->nHeight < chainActive.Height() - MAX_CMPCTBLOCK_DEPTH) {
+            // As with getblocktxn, answer requests for old blocks with the
+            // full block rather than encoding blocks read from disk
+            LogPrint("net", "Peer %d sent us a getgraphene for a block > %i deep\n", pfrom->id, MAX_CMPCTBLOCK_DEPTH);
+            pfrom->vRecvGetData.push_back(CInv(MSG_BLOCK, hash));
+            ProcessGetData(pfrom, chainparams.GetConsensus(), connman, interruptMsgProc);
+            return true;
+        }
+
+        CBlock block;
+        bool ret = ReadBlockFromDisk(block, it->second, chainparams.GetConsensus(), false);
+        assert(ret);
+
+        SendGrapheneBlock(block, nReceiverPoolTx, pfrom, connman);
+    }
+
+
     else if (strCommand == NetMsgType::GETHEADERS)
     {
         CBlockLocator locator;
@@ -1757,6 +2266,24 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
     }
 
 
+    else if (strCommand == NetMsgType::GETCFILTERS)
+    {
+        ProcessGetCFilters(pfrom, vRecv, connman);
+    }
+
+
+    else if (strCommand == NetMsgType::GETCFHEADERS)
+    {
+        ProcessGetCFHeaders(pfrom, vRecv, connman);
+    }
+
+
+    else if (strCommand == NetMsgType::GETCFCHECKPT)
+    {
+        ProcessGetCFCheckPt(pfrom, vRecv, connman);
+    }
+
+
     else if (strCommand == NetMsgType::TX)
     {
         // Stop processing the transaction early if
@@ -1767,8 +2294,6 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             return true;
         }
 
-        std::deque<COutPoint> vWorkQueue;
-        std::vector<uint256> vEraseQueue;
         CTransactionRef ptx;
         vRecv >> ptx;
         const CTransaction& tx = *ptx;
@@ -1789,9 +2314,6 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         if (!AlreadyHave(inv) && AcceptToMemoryPool(mempool, state, ptx, true, &fMissingInputs, &lRemovedTxn)) {
             mempool.check(pcoinsTip);
             RelayTransaction(tx, connman);
-            for (unsigned int i = 0; i < tx.vout.size(); i++) {
-                vWorkQueue.emplace_back(inv.hash, i);
-            }
 
             pfrom->nLastTXTime = GetTime();
 
@@ -1800,66 +2322,10 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 tx.GetHash().ToString(),
                 mempool.size(), mempool.DynamicMemoryUsage() / 1000);
 
-            // Recursively process any orphan transactions that depended on this one
-            std::set<NodeId> setMisbehaving;
-            while (!vWorkQueue.empty()) {
-                auto itByPrev = mapOrphanTransactionsByPrev.find(vWorkQueue.front());
-                vWorkQueue.pop_front();
-                if (itByPrev == mapOrphanTransactionsByPrev.end())
-                    continue;
-                for (auto mi = itByPrev->second.begin();
-                     mi != itByPrev->second.end();
-                     ++mi)
-                {
-                    const CTransactionRef& porphanTx = (*mi)->second.tx;
-                    const CTransaction& orphanTx = *porphanTx;
-                    const uint256& orphanHash = orphanTx.GetHash();
-                    NodeId fromPeer = (*mi)->second.fromPeer;
-                    bool fMissingInputs2 = false;
-                    // Use a dummy CValidationState so someone can't setup nodes to counter-DoS based on orphan
-                    // resolution (that is, feeding people an invalid transaction based on LegitTxX in order to get
-                    // anyone relaying LegitTxX banned)
-                    CValidationState stateDummy;
-
-
-                    if (setMisbehaving.count(fromPeer))
-                        continue;
-                    if (AcceptToMemoryPool(mempool, stateDummy, porphanTx, true, &fMissingInputs2, &lRemovedTxn)) {
-                        LogPrint("mempool", "   accepted orphan tx %s\n", orphanHash.ToString());
-                        RelayTransaction(orphanTx, connman);
-                        for (unsigned int i = 0; i < orphanTx.vout.size(); i++) {
-                            vWorkQueue.emplace_back(orphanHash, i);
-                        }
-                        vEraseQueue.push_back(orphanHash);
-                    }
-                    else if (!fMissingInputs2)
-                    {
-                        int nDos = 0;
-                        if (stateDummy.IsInvalid(nDos) && nDos > 0)
-                        {
-                            // Punish peer that gave us an invalid orphan tx
-                            Misbehaving(fromPeer, nDos);
-                            setMisbehaving.insert(fromPeer);
-                            LogPrint("mempool", "   invalid orphan tx %s\n", orphanHash.ToString());
-                        }
-                        // Has inputs but not accepted to mempool
-                        // Probably non-standard or insufficient fee/priority
-                        LogPrint("mempool", "   removed orphan tx %s\n", orphanHash.ToString());
-                        vEraseQueue.push_back(orphanHash);
-                        if (!stateDummy.CorruptionPossible()) {
-                            // Do not use rejection cache for witness transactions or
-                            // witness-stripped transactions, as they can have been malleated.
-                            // See https://github.com/bitcoin/bitcoin/issues/8279 for details.
-                            assert(recentRejects);
-                            recentRejects->insert(orphanHash);
-                        }
-                    }
-                    mempool.check(pcoinsTip);
-                }
-            }
-
-            BOOST_FOREACH(uint256 hash, vEraseQueue)
-                EraseOrphanTx(hash);
+            // Orphans that depended on this one are reconsidered by the
+            // peers that sent them, between their own messages
+            if (orphanage.AddChildrenToWorkSet(tx))
+                connman.WakeMessageHandler();
         }
         else if (fMissingInputs)
         {
@@ -1877,11 +2343,12 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                     pfrom->AddInventoryKnown(_inv);
                     if (!AlreadyHave(_inv)) pfrom->AskFor(_inv);
                 }
-                AddOrphanTx(ptx, pfrom->GetId());
+                if (orphanage.AddTx(ptx, pfrom->GetId()))
+                    AddToCompactExtraTransactions(ptx);
 
-                // DoS prevention: do not allow mapOrphanTransactions to grow unbounded
+                // DoS prevention: do not allow the orphan pool to grow unbounded
                 unsigned int nMaxOrphanTx = (unsigned int)std::max((int64_t)0, GetArg("-maxorphantx", DEFAULT_MAX_ORPHAN_TRANSACTIONS));
-                unsigned int nEvicted = LimitOrphanTxSize(nMaxOrphanTx);
+                unsigned int nEvicted = orphanage.LimitOrphans(nMaxOrphanTx);
                 if (nEvicted > 0)
                     LogPrint("mempool", "mapOrphan overflow, removed %u tx\n", nEvicted);
             } else {
@@ -2115,6 +2582,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 LOCK(cs_main);
                 mapBlockSource.emplace(pblock->GetHash(), std::make_pair(pfrom->GetId(), false));
             }
+            FastRelayBlock(pfrom, pblock, connman);
             bool fNewBlock = false;
             ProcessNewBlock(chainparams, pblock, true, &fNewBlock);
             if (fNewBlock)
@@ -2132,6 +2600,68 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
 
     }
 
+    else if (strCommand == NetMsgType::GRAPHENEBLK && !fImporting && !fReindex) // Ignore blocks received while importing
+    {
+        CGrapheneBlock grapheneblock;
+        vRecv >> grapheneblock;
+        const uint256 hash = grapheneblock.header.GetHash();
+
+        // When all transactions are available we jump to the BLOCKTXN
+        // handling code, like with cmpctblock messages.
+        bool fProcessBLOCKTXN = false;
+        CDataStream blockTxnMsg(SER_NETWORK, PROTOCOL_VERSION);
+
+        {
+        LOCK(cs_main);
+
+        std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> >::iterator it = mapBlocksInFlight.find(hash);
+        if (it == mapBlocksInFlight.end() || it->second.first != pfrom->GetId() || it->second.second->partialBlock) {
+            LogPrint("net", "Peer %d sent us a graphene block we weren't expecting\n", pfrom->id);
+            return true;
+        }
+
+        std::unique_ptr<PartiallyDownloadedBlock>& partialBlock = it->second.second->partialBlock;
+        partialBlock.reset(new PartiallyDownloadedBlock(&mempool));
+        ReadStatus status = partialBlock->InitData(grapheneblock, vExtraTxnForCompact);
+        if (status == READ_STATUS_INVALID) {
+            MarkBlockAsReceived(hash); // Reset in-flight state in case of whitelist
+            Misbehaving(pfrom->GetId(), 100);
+            LogPrintf("Peer %d sent us invalid graphene block\n", pfrom->id);
+            return true;
+        } else if (status == READ_STATUS_FAILED) {
+            // The IBLT could not be decoded, fall back to a compact block,
+            // which the block stays in flight for
+            partialBlock.reset();
+            LogPrint("net", "Failed to decode graphene block %s from peer=%d, requesting it again\n", hash.ToString(), pfrom->id);
+            std::vector<CInv> vInv(1);
+            if (State(pfrom->GetId())->fSupportsDesiredCmpctVersion)
+                vInv[0] = CInv(MSG_CMPCT_BLOCK, hash);
+            else
+                vInv[0] = CInv(MSG_BLOCK | GetFetchFlags(pfrom, chainActive.Tip(), chainparams.GetConsensus()), hash);
+            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::GETDATA, vInv));
+            return true;
+        }
+
+        BlockTransactionsRequest req;
+        for (size_t i = 0; i < grapheneblock.BlockTxCount(); i++) {
+            if (!partialBlock->IsTxAvailable(i))
+                req.indexes.push_back(i);
+        }
+        if (req.indexes.empty()) {
+            BlockTransactions txn;
+            txn.blockhash = hash;
+            blockTxnMsg << txn;
+            fProcessBLOCKTXN = true;
+        } else {
+            req.blockhash = hash;
+            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::GETBLOCKTXN, req));
+        }
+        } // cs_main
+
+        if (fProcessBLOCKTXN)
+            return ProcessMessage(pfrom, NetMsgType::BLOCKTXN, blockTxnMsg, nTimeReceived, chainparams, connman, interruptMsgProc);
+    }
+
     else if (strCommand == NetMsgType::BLOCKTXN && !fImporting && !fReindex) // Ignore blocks received while importing
     {
         BlockTransactions resp;
@@ -2190,6 +2720,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             }
         } // Don't hold cs_main when we call into ProcessNewBlock
         if (fBlockRead) {
+            FastRelayBlock(pfrom, pblock, connman);
             bool fNewBlock = false;
             // Since we requested this block (it was in mapBlocksInFlight), force it to be processed,
             // even if it would not be a candidate for new tip (missing previous block, chain not long enough, etc)
@@ -2220,6 +2751,17 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             ReadCompactSize(vRecv); // ignore tx count; assume it is 0.
         }
 
+        bool fRange;
+        {
+            LOCK(cs_main);
+            // An empty reply from a peer downloading a checkpoint range means
+            // it does not have the range, which another peer can take over
+            fRange = nCount == 0 ? headersRangeSync->HasRange(pfrom->GetId()) :
+                                   headersRangeSync->IsRangeResponse(pfrom->GetId(), headers[0].hashPrevBlock);
+        }
+        if (fRange)
+            return ProcessHeadersRange(pfrom, connman, headers, chainparams);
+
         if (nCount == 0) {
             // Nothing interesting. Stop asking this peers for more headers.
             return true;
@@ -2257,17 +2799,9 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             }
             return true;
         }
-
-        uint256 hashLastBlock;
-        for (const CBlockHeader& header : headers) {
-            if (!hashLastBlock.IsNull() && header.hashPrevBlock != hashLastBlock) {
-                Misbehaving(pfrom->GetId(), 20);
-                return error("non-continuous headers sequence");
-            }
-            hashLastBlock = header.GetHash();
-        }
         }
 
+        // ProcessNewBlockHeaders also rejects non-continuous sequences
         CValidationState state;
         if (!ProcessNewBlockHeaders(headers, state, chainparams, &pindexLast)) {
             int nDoS;
@@ -2280,6 +2814,9 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             }
         }
 
+        // Checkpoint ranges downloaded from other peers may connect now
+        ConnectHeadersRanges(chainparams);
+
         {
         LOCK(cs_main);
         CNodeState *nodestate = State(pfrom->GetId());
@@ -2293,14 +2830,15 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
 
         if (nCount == MAX_HEADERS_RESULTS) {
             // Headers message had its maximum size; the peer may have more headers.
-            // TODO: optimize: if pindexLast is an ancestor of chainActive.Tip or pindexBestHeader, continue
-            // from there instead.
+            // If pindexLast is an ancestor of pindexBestHeader, for instance
+            // because a checkpoint range connected, continue from there instead.
             //
             // Novo: do not allow multiple getheader queries in parallel at
             // this point - makes sure that any parallel queries will end here,
             // preventing "getheaders" spam.
-            LogPrint("net", "more getheaders (%d) to end to peer=%d (startheight:%d)\n", pindexLast->nHeight, pfrom->id, pfrom->nStartingHeight);
-            RequestHeadersFrom(pfrom, connman, pindexLast, uint256(), false);
+            const CBlockIndex *pindexContinue = pindexBestHeader->GetAncestor(pindexLast->nHeight) == pindexLast ? pindexBestHeader : pindexLast;
+            LogPrint("net", "more getheaders (%d) to end to peer=%d (startheight:%d)\n", pindexContinue->nHeight, pfrom->id, pfrom->nStartingHeight);
+            RequestHeadersFrom(pfrom, connman, pindexContinue, uint256(), false);
         }
 
         bool fCanDirectFetch = CanDirectFetch(chainparams.GetConsensus());
@@ -2344,11 +2882,18 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                     LogPrint("net", "Downloading blocks toward %s (%d) via headers direct fetch\n",
                             pindexLast->GetBlockHash().ToString(), pindexLast->nHeight);
                 }
-                if (vGetData.size() > 0) {
-                    if (nodestate->fSupportsDesiredCmpctVersion && vGetData.size() == 1 && mapBlocksInFlight.size() == 1 && pindexLast->pprev->IsValid(BLOCK_VALID_CHAIN)) {
+                if (vGetData.size() == 1 && mapBlocksInFlight.size() == 1 && pindexLast->pprev->IsValid(BLOCK_VALID_CHAIN)) {
+                    if (RequestGrapheneBlocks(nodestate)) {
+                        // Request a graphene block, falling back to a compact
+                        // block if we fail to decode it
+                        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::GETGRAPHENE, vGetData[0].hash, (uint64_t)mempool.size()));
+                        vGetData.clear();
+                    } else if (nodestate->fSupportsDesiredCmpctVersion) {
                         // In any case, we want to download using a compact block, not a regular one
                         vGetData[0] = CInv(MSG_CMPCT_BLOCK, vGetData[0].hash);
                     }
+                }
+                if (vGetData.size() > 0) {
                     connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::GETDATA, vGetData));
                 }
             }
@@ -2359,6 +2904,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
     else if (strCommand == NetMsgType::BLOCK && !fImporting && !fReindex) // Ignore blocks received while importing
     {
         std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+        const size_t nBlockSize = vRecv.size();
         vRecv >> *pblock;
 
         LogPrint("net", "received block %s peer=%d\n", pblock->GetHash().ToString(), pfrom->id);
@@ -2373,11 +2919,13 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             LOCK(cs_main);
             // Also always process if we requested the block explicitly, as we may
             // need it even though it is not a candidate for a new best tip.
+            RecordBlockDelivery(pfrom->GetId(), hash, nBlockSize, nTimeReceived);
             forceProcessing |= MarkBlockAsReceived(hash);
             // mapBlockSource is only used for sending reject messages and DoS scores,
             // so the race between here and cs_main in ProcessNewBlock is fine.
             mapBlockSource.emplace(hash, std::make_pair(pfrom->GetId(), true));
         }
+        FastRelayBlock(pfrom, pblock, connman);
         bool fNewBlock = false;
         ProcessNewBlock(chainparams, pblock, forceProcessing, &fNewBlock);
         if (fNewBlock)
@@ -2643,12 +3191,21 @@ bool ProcessMessages(CNode* pfrom, CConnman& connman, const std::atomic<bool>& i
     if (!pfrom->vRecvGetData.empty())
         ProcessGetData(pfrom, chainparams.GetConsensus(), connman, interruptMsgProc);
 
+    bool fMoreOrphans = false;
+    if (orphanage.HaveTxToReconsider(pfrom->GetId())) {
+        LOCK(cs_main);
+        fMoreOrphans = ProcessOrphanTx(pfrom, connman);
+    }
+
     if (pfrom->fDisconnect)
         return false;
 
     // this maintains the order of responses
     if (!pfrom->vRecvGetData.empty()) return true;
 
+    // resolve the peer's orphans before its next transaction
+    if (fMoreOrphans) return true;
+
         // Don't bother if send buffer is too full to respond anyway
         if (pfrom->fPauseSend)
             return false;
@@ -2700,6 +3257,8 @@ bool ProcessMessages(CNode* pfrom, CConnman& connman, const std::atomic<bool>& i
 
         // Process message
         bool fRet = false;
+        const int64_t nProcessStart = GetTimeMicros();
+        const int64_t nLockWaitStart = GetThreadLockWait();
         try
         {
             fRet = ProcessMessage(pfrom, strCommand, vRecv, msg.nTime, chainparams, connman, interruptMsgProc);
@@ -2736,11 +3295,14 @@ bool ProcessMessages(CNode* pfrom, CConnman& connman, const std::atomic<bool>& i
         } catch (...) {
             PrintExceptionContinue(NULL, "ProcessMessages()");
         }
+        connman.RecordMessageProcessing(pfrom, strCommand, nProcessStart - msg.nTime, GetTimeMicros() - nProcessStart, GetThreadLockWait() - nLockWaitStart);
 
         if (!fRet) {
             LogPrintf("%s(%s, %u bytes) FAILED peer=%d\n", __func__, SanitizeString(strCommand), nMessageSize, pfrom->id);
         }
 
+        pfrom->RecycleRecvMsg(msgs);
+
         LOCK(cs_main);
         SendRejectsAndCheckIfBanned(pfrom, connman);
 
@@ -2852,7 +3414,7 @@ bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interr
         if (pindexBestHeader == NULL)
             pindexBestHeader = chainActive.Tip();
         bool fFetch = state.fPreferredDownload || (nPreferredDownload == 0 && !pto->fClient && !pto->fOneShot); // Download if this is a nice peer, or we have no nice peers and this one might do.
-        if (!state.fSyncStarted && !pto->fClient && !fImporting && !fReindex) {
+        if (!state.fSyncStarted && !pto->fClient && !fImporting && !fReindex && !headersRangeSync->HasRange(pto->GetId())) {
             // Only actively request headers from a single peer, unless we're close to today.
             if ((nSyncStarted == 0 && fFetch) || pindexBestHeader->GetBlockTime() > GetAdjustedTime() - 24 * 60 * 60) {
                 state.fSyncStarted = true;
@@ -2875,6 +3437,16 @@ bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interr
                 RequestHeadersFrom(pto, connman, pindexStart, uint256(), false);
             }
         }
+        // While the headers sync peer works its way up, let the other peers
+        // download the ranges between the checkpoints ahead of it.
+        if (nSyncStarted > 0 && !state.fSyncStarted && !state.fHeadersRangeFailed && !pto->fClient && !fImporting && !fReindex &&
+            pto->nPendingHeaderRequests == 0 && pindexBestHeader->GetBlockTime() <= GetAdjustedTime() - 24 * 60 * 60) {
+            uint256 hashLocator, hashStop;
+            if (headersRangeSync->AssignRange(pto->GetId(), pindexBestHeader->nHeight, pto->nStartingHeight, GetTimeMicros(), hashLocator, hashStop)) {
+                LogPrint("net", "getheaders for checkpoint range up to %s to peer=%d\n", hashStop.ToString(), pto->id);
+                RequestHeadersRange(pto, connman, hashLocator, hashStop);
+            }
+        }
 
         // Resend wallet transactions that haven't gotten in a block yet
         // Except during reindex, importing and IBD, when old wallet
@@ -3039,6 +3611,23 @@ bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interr
             }
             pto->vInventoryBlockToSend.clear();
 
+            // Transactions to a reconciling peer are only announced once a
+            // reconciliation shows it lacks them
+            CTxReconciliationState& recon = pto->txrecon;
+            if (recon.fEnabled && recon.IsStalled(nNow)) {
+                LogPrint("net", "reconciliation with peer=%d timed out, announcing transactions with inv\n", pto->id);
+                recon.Disable(pto->setInventoryTxToSend);
+            }
+            if (recon.fEnabled)
+                recon.LimitPending(pto->setInventoryTxToSend);
+            std::set<uint256>& setTxToSend = recon.fEnabled ? recon.setTxToAnnounce : pto->setInventoryTxToSend;
+            if (recon.fEnabled && !pto->fInbound && !recon.fRequested && recon.nNextRequest < nNow) {
+                recon.nNextRequest = PoissonNextSend(nNow, RECON_REQUEST_INTERVAL);
+                recon.fRequested = true;
+                recon.nRequestTime = nNow;
+                connman.PushMessage(pto, msgMaker.Make(NetMsgType::REQRECON, (uint32_t)pto->setInventoryTxToSend.size()));
+            }
+
             // Check whether periodic sends should happen
             bool fSendTrickle = pto->fWhitelisted;
             if (pto->nNextInvSend < nNow) {
@@ -3046,11 +3635,14 @@ bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interr
                 // Use half the delay for outbound peers, as there is less privacy concern for them.
                 pto->nNextInvSend = PoissonNextSend(nNow, INVENTORY_BROADCAST_INTERVAL >> !pto->fInbound);
             }
+            // Reconciliation results have been delayed enough already
+            if (recon.fEnabled && !recon.setTxToAnnounce.empty())
+                fSendTrickle = true;
 
             // Time to send but the peer has requested we not relay transactions.
             if (fSendTrickle) {
                 LOCK(pto->cs_filter);
-                if (!pto->fRelayTxes) pto->setInventoryTxToSend.clear();
+                if (!pto->fRelayTxes) setTxToSend.clear();
             }
 
             // Respond to BIP35 mempool requests
@@ -3068,7 +3660,7 @@ bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interr
                 for (const auto& txinfo : vtxinfo) {
                     const uint256& hash = txinfo.tx->GetHash();
                     CInv inv(MSG_TX, hash);
-                    pto->setInventoryTxToSend.erase(hash);
+                    setTxToSend.erase(hash);
                     if (filterrate) {
                         if (txinfo.feeRate.GetFeePerK() < filterrate)
                             continue;
@@ -3090,8 +3682,8 @@ bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interr
             if (fSendTrickle) {
                 // Produce a vector with all candidates for sending
                 std::vector<std::set<uint256>::iterator> vInvTx;
-                vInvTx.reserve(pto->setInventoryTxToSend.size());
-                for (std::set<uint256>::iterator it = pto->setInventoryTxToSend.begin(); it != pto->setInventoryTxToSend.end(); it++) {
+                vInvTx.reserve(setTxToSend.size());
+                for (std::set<uint256>::iterator it = setTxToSend.begin(); it != setTxToSend.end(); it++) {
                     vInvTx.push_back(it);
                 }
                 CAmount filterrate = 0;
@@ -3114,7 +3706,7 @@ bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interr
                     vInvTx.pop_back();
                     uint256 hash = *it;
                     // Remove it from the to-be-sent set
-                    pto->setInventoryTxToSend.erase(it);
+                    setTxToSend.erase(it);
                     // Check if not in the filter already
                     if (pto->filterInventoryKnown.contains(hash)) {
                         continue;
@@ -3183,6 +3775,12 @@ bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interr
                 return true;
             }
         }
+        // Check for checkpoint range timeouts
+        if (headersRangeSync->IsStalling(pto->GetId(), nNow)) {
+            LogPrint("net", "Timeout downloading checkpoint range from peer=%d\n", pto->id);
+            headersRangeSync->ReleaseRange(pto->GetId());
+            state.fHeadersRangeFailed = true;
+        }
         // Check for headers sync timeouts
         if (state.fSyncStarted && state.nHeadersSyncTimeout < std::numeric_limits<int64_t>::max()) {
             // Detect whether this is a stalling initial-headers-sync peer
@@ -3219,10 +3817,15 @@ bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interr
         // Message: getdata (blocks)
         //
         std::vector<CInv> vGetData;
-        if (!pto->fClient && (fFetch || !IsInitialBlockDownload()) && state.nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+        // Keep as many blocks in flight as cover the peer's bandwidth-delay product
+        if (pto->nMinPingUsecTime != std::numeric_limits<int64_t>::max())
+            state.blockDownload.SetLatency(pto->nMinPingUsecTime);
+        int nMaxBlocksInFlight = state.blockDownload.GetTargetBlocksInFlight(MAX_BLOCKS_IN_TRANSIT_PER_PEER);
+        if (!pto->fClient && (fFetch || !IsInitialBlockDownload()) && state.nBlocksInFlight < nMaxBlocksInFlight) {
             std::vector<const CBlockIndex*> vToDownload;
             NodeId staller = -1;
-            FindNextBlocksToDownload(pto->GetId(), MAX_BLOCKS_IN_TRANSIT_PER_PEER - state.nBlocksInFlight, vToDownload, staller, consensusParams);
+            const CBlockIndex *pindexStalling = NULL;
+            FindNextBlocksToDownload(pto->GetId(), nMaxBlocksInFlight - state.nBlocksInFlight, vToDownload, staller, pindexStalling, consensusParams);
             BOOST_FOREACH(const CBlockIndex *pindex, vToDownload) {
                 uint32_t nFetchFlags = GetFetchFlags(pto, pindex->pprev, consensusParams);
                 vGetData.push_back(CInv(MSG_BLOCK | nFetchFlags, pindex->GetBlockHash()));
@@ -3231,8 +3834,17 @@ bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interr
                     pindex->nHeight, pto->id);
             }
             if (state.nBlocksInFlight == 0 && staller != -1) {
-                if (State(staller)->nStallingSince == 0) {
-                    State(staller)->nStallingSince = nNow;
+                CNodeState *stateStaller = State(staller);
+                if (ShouldTakeOverBlock(state.blockDownload, stateStaller->blockDownload, nNow - stateStaller->nDownloadingSince)) {
+                    // This peer is faster: fetch the block holding up the window from it
+                    // instead of waiting for the staller to time out.
+                    uint32_t nFetchFlags = GetFetchFlags(pto, pindexStalling->pprev, consensusParams);
+                    vGetData.push_back(CInv(MSG_BLOCK | nFetchFlags, pindexStalling->GetBlockHash()));
+                    MarkBlockAsInFlight(pto->GetId(), pindexStalling->GetBlockHash(), consensusParams, pindexStalling);
+                    LogPrint("net", "Taking over block %s (%d) from stalling peer=%d, peer=%d\n", pindexStalling->GetBlockHash().ToString(),
+                        pindexStalling->nHeight, staller, pto->id);
+                } else if (stateStaller->nStallingSince == 0) {
+                    stateStaller->nStallingSince = nNow;
                     LogPrint("net", "Stall started peer=%d\n", staller);
                 }
             }
@@ -3294,14 +3906,3 @@ bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interr
     }
     return true;
 }
-
-class CNetProcessingCleanup
-{
-public:
-    CNetProcessingCleanup() {}
-    ~CNetProcessingCleanup() {
-        // orphan transactions
-        mapOrphanTransactions.clear();
-        mapOrphanTransactionsByPrev.clear();
-    }
-} instance_of_cnetprocessingcleanup;
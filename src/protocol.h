@@ -240,6 +240,80 @@ extern const char *GETBLOCKTXN;
  * @since protocol version 70014 as described by BIP 152
  */
 extern const char *BLOCKTXN;
+/**
+ * Contains a 1-byte filter type, 4-byte start height and 32-byte stop hash.
+ * Peer should respond with a "cfilter" message for each block in the range.
+ * Only available with service bit NODE_COMPACT_FILTERS, as described by BIP 157.
+ */
+extern const char *GETCFILTERS;
+/**
+ * Contains a BlockFilter.
+ * Sent in response to a "getcfilters" message.
+ */
+extern const char *CFILTER;
+/**
+ * Contains a 1-byte filter type, 4-byte start height and 32-byte stop hash.
+ * Peer should respond with a "cfheaders" message.
+ * Only available with service bit NODE_COMPACT_FILTERS, as described by BIP 157.
+ */
+extern const char *GETCFHEADERS;
+/**
+ * Contains the filter type, stop hash, the filter header preceding the
+ * range and the filter hashes of the blocks in the range.
+ * Sent in response to a "getcfheaders" message.
+ */
+extern const char *CFHEADERS;
+/**
+ * Contains a 1-byte filter type and 32-byte stop hash.
+ * Peer should respond with a "cfcheckpt" message.
+ * Only available with service bit NODE_COMPACT_FILTERS, as described by BIP 157.
+ */
+extern const char *GETCFCHECKPT;
+/**
+ * Contains the filter type, stop hash and the filter headers of every
+ * 1000th block up to the stop hash.
+ * Sent in response to a "getcfcheckpt" message.
+ */
+extern const char *CFCHECKPT;
+/**
+ * Contains a 4-byte protocol version and 8-byte salt.
+ * Indicates that a node is willing to reconcile transaction announcements
+ * instead of sending them with "inv". Sent after "verack".
+ */
+extern const char *SENDRECON;
+/**
+ * Contains the 4-byte size of the sender's set of transactions to announce.
+ * Peer should respond with a "sketch" message.
+ */
+extern const char *REQRECON;
+/**
+ * Contains a CIBLT of the short ids of the sender's transactions to announce.
+ * Sent in response to a "reqrecon" message.
+ */
+extern const char *SKETCH;
+/**
+ * Contains a 1-byte success flag and the short ids of the transactions in
+ * the last sketch that the sender is missing.
+ * Sent in response to a "sketch" message.
+ */
+extern const char *RECONCILDIFF;
+/**
+ * Contains an 8-byte graphene block protocol version.
+ * Indicates that a node can send and decode graphene blocks. Sent after
+ * "verack".
+ */
+extern const char *SENDGRAPHENE;
+/**
+ * Contains a block hash and the 8-byte number of transactions in the
+ * sender's mempool.
+ * Peer should respond with a "grapheneblk" message.
+ */
+extern const char *GETGRAPHENE;
+/**
+ * Contains a CGrapheneBlock.
+ * Sent in response to a "getgraphene" message.
+ */
+extern const char *GRAPHENEBLK;
 };
 
 /* Get a vector of all valid message types (see above) */
@@ -264,6 +338,9 @@ enum ServiceFlags : uint64_t {
     // NODE_XTHIN means the node supports Xtreme Thinblocks
     // If this is turned off then the node will not service nor make xthin requests
     NODE_XTHIN = (1 << 4),
+    // NODE_COMPACT_FILTERS means the node will service basic block filter
+    // requests. See BIP157 and BIP158 for details on how this is implemented.
+    NODE_COMPACT_FILTERS = (1 << 6),
 
     // Bits 24-31 are reserved for temporary experiments. Just pick a bit that
     // isn't getting used, or one not being used much, and notify the
@@ -299,6 +299,56 @@ static bool rest_chaininfo(HTTPRequest* req, const std::string& strURIPart)
     return true; // continue to process further HTTP reqs on this cxn
 }
 
+UniValue getaddressoutputs(const JSONRPCRequest& request);
+
+static bool rest_addressoutputs(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    if (path.empty() || path.size() > 4 || path[0].empty())
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid URI format. Expected /rest/addressoutputs/<address>[/<minheight>[/<count>[/<start>]]].json");
+
+    JSONRPCRequest jsonRequest;
+    jsonRequest.params = UniValue(UniValue::VARR);
+    jsonRequest.params.push_back(path[0]);
+    for (size_t i = 1; i < path.size(); i++) {
+        if (i == 3) {
+            jsonRequest.params.push_back(path[i]);
+            break;
+        }
+        int32_t n;
+        if (!ParseInt32(path[i], &n))
+            return RESTERR(req, HTTP_BAD_REQUEST, "Invalid number: " + path[i]);
+        jsonRequest.params.push_back(n);
+    }
+
+    switch (rf) {
+    case RF_JSON: {
+        UniValue outputs;
+        try {
+            outputs = getaddressoutputs(jsonRequest);
+        } catch (const UniValue& objError) {
+            return RESTERR(req, HTTP_BAD_REQUEST, find_value(objError, "message").get_str());
+        }
+        std::string strJSON = outputs.write() + "\n";
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, strJSON);
+        return true;
+    }
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: json)");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
 static bool rest_mempool_info(HTTPRequest* req, const std::string& strURIPart)
 {
     if (!CheckWarmup(req))
@@ -613,6 +663,7 @@ static const struct {
       {"/rest/mempool/contents", rest_mempool_contents},
       {"/rest/headers/", rest_headers},
       {"/rest/getutxos", rest_getutxos},
+      {"/rest/addressoutputs/", rest_addressoutputs},
 };
 
 bool StartREST()
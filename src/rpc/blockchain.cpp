@@ -4,14 +4,18 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "amount.h"
+#include "base58.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "coins.h"
 #include "consensus/validation.h"
+#include "index/addrindex.h"
+#include "index/blockfilterindex.h"
 #include "validation.h"
 #include "policy/policy.h"
 #include "primitives/transaction.h"
+#include "script/standard.h"
 #include "rpc/server.h"
 #include "streams.h"
 #include "sync.h"
@@ -24,6 +28,7 @@
 
 #include <univalue.h>
 
+#include <boost/algorithm/string.hpp>
 #include <boost/thread/thread.hpp> // boost::thread::interrupt
 
 #include <mutex>
@@ -985,6 +990,182 @@ UniValue gettxout(const JSONRPCRequest& request)
     return ret;
 }
 
+/** Maximum number of outputs returned by one getaddressoutputs call */
+static const int MAX_ADDRESS_OUTPUTS = 1000;
+
+/** Parse a position returned as "next" by getaddressoutputs */
+static bool ParseAddrIndexPosition(const std::string& str, CAddrIndexPosition& pos)
+{
+    std::vector<std::string> vParts;
+    boost::split(vParts, str, boost::is_any_of(":"));
+    if (vParts.size() != 3 || vParts[1].size() != 64 || !IsHex(vParts[1]))
+        return false;
+    if (!ParseInt32(vParts[0], &pos.nHeight) || pos.nHeight < 0 || !ParseUInt32(vParts[2], &pos.n))
+        return false;
+    pos.txid.SetHex(vParts[1]);
+    return true;
+}
+
+UniValue getaddressoutputs(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 5)
+        throw runtime_error(
+            "getaddressoutputs \"address\" ( minheight count \"start\" unspentonly )\n"
+            "\nReturns the confirmed outputs paying to an address or script, in order of height and txid,\n"
+            "and the inputs spending them. Requires -addrindex.\n"
+            "\nArguments:\n"
+            "1. \"address\"      (string, required) The address, or a hex-encoded scriptPubKey\n"
+            "2. minheight      (numeric, optional, default=0) Only return outputs confirmed at this height or later\n"
+            "3. count          (numeric, optional, default=100) The number of outputs to return, at most " + strprintf("%d", MAX_ADDRESS_OUTPUTS) + "\n"
+            "4. \"start\"        (string, optional) Resume from the \"next\" position returned by an earlier call, instead of minheight\n"
+            "5. unspentonly    (boolean, optional, default=false) Only return outputs that have not been spent\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"bestblock\" : \"hash\",    (string) the block the index has processed up to\n"
+            "  \"height\" : n,            (numeric) the height of that block\n"
+            "  \"outputs\" : [\n"
+            "    {\n"
+            "      \"txid\" : \"hash\",      (string) The transaction id\n"
+            "      \"vout\" : n,           (numeric) The output number\n"
+            "      \"height\" : n,         (numeric) The height of the block containing the transaction\n"
+            "      \"value\" : x.xxx,      (numeric) The output value in " + CURRENCY_UNIT + "\n"
+            "      \"spent\" : {           (json object, only if spent) The input spending the output\n"
+            "        \"txid\" : \"hash\",    (string) The spending transaction id\n"
+            "        \"vin\" : n,          (numeric) The input number\n"
+            "        \"height\" : n        (numeric) The height of the block containing the spending transaction\n"
+            "      }\n"
+            "    }\n"
+            "    ,...\n"
+            "  ],\n"
+            "  \"more\" : true|false,    (boolean) Whether there are more outputs\n"
+            "  \"next\" : \"position\"    (string, only if more) The start to pass to fetch them\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getaddressoutputs", "\"1PSSGeFHDnKNxiEyFrD1wcEaHr9hrQDDWc\"")
+            + HelpExampleCli("getaddressoutputs", "\"1PSSGeFHDnKNxiEyFrD1wcEaHr9hrQDDWc\" 450000 100 \"\" true")
+            + HelpExampleRpc("getaddressoutputs", "\"1PSSGeFHDnKNxiEyFrD1wcEaHr9hrQDDWc\", 450000")
+        );
+
+    if (!g_addrindex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Address index not enabled, use -addrindex");
+
+    CScript script;
+    const std::string strAddress = request.params[0].get_str();
+    CNovoAddress address(strAddress);
+    if (address.IsValid()) {
+        script = GetScriptForDestination(address.Get());
+    } else if (!strAddress.empty() && IsHex(strAddress)) {
+        std::vector<unsigned char> data(ParseHex(strAddress));
+        script = CScript(data.begin(), data.end());
+    } else {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address or script");
+    }
+
+    int nMinHeight = 0;
+    if (request.params.size() > 1)
+        nMinHeight = request.params[1].get_int();
+    int nCount = 100;
+    if (request.params.size() > 2)
+        nCount = request.params[2].get_int();
+    if (nCount < 0 || nCount > MAX_ADDRESS_OUTPUTS)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Count out of range");
+    CAddrIndexPosition pos(nMinHeight);
+    if (request.params.size() > 3 && !request.params[3].get_str().empty()) {
+        if (!ParseAddrIndexPosition(request.params[3].get_str(), pos))
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid start, expected <height>:<txid>:<vout>");
+    }
+    bool fUnspentOnly = false;
+    if (request.params.size() > 4)
+        fUnspentOnly = request.params[4].get_bool();
+
+    // Read the best block first, so the outputs returned are at least as recent
+    const CBlockIndex* pindexBest = g_addrindex->GetBestBlockIndex();
+    std::vector<CAddrIndexOutput> vOutputs;
+    bool fMore;
+    if (!g_addrindex->FindOutputs(script, pos, nCount, fUnspentOnly, vOutputs, fMore))
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read the address index");
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("bestblock", pindexBest ? pindexBest->GetBlockHash().GetHex() : uint256().GetHex());
+    ret.pushKV("height", pindexBest ? pindexBest->nHeight : -1);
+    UniValue outputs(UniValue::VARR);
+    for (const CAddrIndexOutput& output : vOutputs) {
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("txid", output.txid.GetHex());
+        entry.pushKV("vout", (int64_t)output.n);
+        entry.pushKV("height", output.nHeight);
+        entry.pushKV("value", ValueFromAmount(output.nValue));
+        if (output.fSpent) {
+            UniValue spent(UniValue::VOBJ);
+            spent.pushKV("txid", output.spend.txid.GetHex());
+            spent.pushKV("vin", (int64_t)output.spend.nIn);
+            spent.pushKV("height", output.spend.nHeight);
+            entry.pushKV("spent", spent);
+        }
+        outputs.push_back(entry);
+    }
+    ret.pushKV("outputs", outputs);
+    ret.pushKV("more", fMore);
+    if (fMore)
+        ret.pushKV("next", strprintf("%d:%s:%u", pos.nHeight, pos.txid.GetHex(), pos.n));
+    return ret;
+}
+
+UniValue getblockfilter(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        throw runtime_error(
+            "getblockfilter \"blockhash\" ( \"filtertype\" )\n"
+            "\nRetrieve a BIP 157 content filter for a particular block. Requires -blockfilterindex.\n"
+            "\nArguments:\n"
+            "1. \"blockhash\"      (string, required) The hash of the block\n"
+            "2. \"filtertype\"     (string, optional, default=basic) The type name of the filter\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"filter\" : \"hex\",    (string) the hex-encoded filter data\n"
+            "  \"header\" : \"hash\"    (string) the hex-encoded filter header\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getblockfilter", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\" \"basic\"")
+            + HelpExampleRpc("getblockfilter", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\", \"basic\"")
+        );
+
+    uint256 hashBlock = ParseHashV(request.params[0], "blockhash");
+    BlockFilterType filterType = BLOCK_FILTER_BASIC;
+    if (request.params.size() > 1) {
+        if (!BlockFilterTypeByName(request.params[1].get_str(), filterType))
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown filtertype");
+    }
+
+    if (!g_blockfilterindex || g_blockfilterindex->GetFilterType() != filterType)
+        throw JSONRPCError(RPC_MISC_ERROR, "Index is not enabled for filtertype " + BlockFilterTypeName(filterType) + ", use -blockfilterindex");
+
+    const CBlockIndex* pindex;
+    {
+        LOCK(cs_main);
+        BlockMap::const_iterator it = mapBlockIndex.find(hashBlock);
+        if (it == mapBlockIndex.end())
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        pindex = it->second;
+    }
+
+    BlockFilter filter;
+    uint256 header;
+    if (!g_blockfilterindex->LookupFilter(pindex, filter) || !g_blockfilterindex->LookupFilterHeader(pindex, header)) {
+        std::string strError = "Filter not found.";
+        if (!g_blockfilterindex->IsSynced())
+            strError += " Block filters are still in the process of being indexed.";
+        else
+            strError += " This error is unexpected and indicates index corruption.";
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("filter", HexStr(filter.GetEncodedFilter()));
+    ret.pushKV("header", header.GetHex());
+    return ret;
+}
+
 UniValue verifychain(const JSONRPCRequest& request)
 {
     int nCheckLevel = GetArg("-checklevel", DEFAULT_CHECKLEVEL);
@@ -1522,11 +1703,13 @@ static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         okSafe argNames
   //  --------------------- ------------------------  -----------------------  ------ ----------
     { "blockchain",         "getblockchaininfo",      &getblockchaininfo,      true,  {} },
+    { "blockchain",         "getaddressoutputs",      &getaddressoutputs,      true,  {"address","minheight","count","start","unspentonly"} },
     { "blockchain",         "getbestblockhash",       &getbestblockhash,       true,  {} },
     { "blockchain",         "getblockcount",          &getblockcount,          true,  {} },
     { "blockchain",         "getblock",               &getblock,               true,  {"blockhash","verbose"} },
     { "blockchain",         "getblockhash",           &getblockhash,           true,  {"height"} },
     { "blockchain",         "getblockheader",         &getblockheader,         true,  {"blockhash","verbose"} },
+    { "blockchain",         "getblockfilter",         &getblockfilter,         true,  {"blockhash","filtertype"} },
     { "blockchain",         "getchaintips",           &getchaintips,           true,  {} },
     { "blockchain",         "getchaintxstats",        &getchaintxstats,        true,  {"nblocks", "blockhash"} },
     { "blockchain",         "getdifficulty",          &getdifficulty,          true,  {} },
@@ -496,6 +496,62 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
     return obj;
 }
 
+UniValue getlockstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 1)
+        throw runtime_error(
+            "getlockstats ( count )\n"
+            "\nReturns how the locks taken at each place in the code were acquired and held, most waited for first.\n"
+            "Requires -lockprofile. Threads report at least once a second, and times are in microseconds.\n"
+            "\nArguments:\n"
+            "1. count    (numeric, optional, default=20) The number of places to return, 0 for all\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"lock\": \"name\",     (string) The lock\n"
+            "    \"site\": \"file:line\", (string) Where it is taken\n"
+            "    \"count\": n,          (numeric) Number of acquisitions\n"
+            "    \"contended\": n,      (numeric) Number of acquisitions that waited for another thread\n"
+            "    \"wait\": n,           (numeric) Total time spent waiting\n"
+            "    \"hold\": n            (numeric) Total time it was held\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getlockstats", "")
+            + HelpExampleRpc("getlockstats", "10")
+        );
+    if (!fProfileLocks)
+        throw JSONRPCError(RPC_MISC_ERROR, "Lock profiling is disabled, start with -lockprofile");
+
+    size_t nCount = 20;
+    if (request.params.size() > 0) {
+        if (request.params[0].get_int() < 0)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative count");
+        nCount = request.params[0].get_int();
+    }
+
+    std::vector<CLockSiteStats> vStats = GetLockProfile();
+    std::sort(vStats.begin(), vStats.end(), [](const CLockSiteStats& a, const CLockSiteStats& b) {
+        return a.nWait != b.nWait ? a.nWait > b.nWait : a.nHold > b.nHold;
+    });
+    if (nCount > 0 && vStats.size() > nCount)
+        vStats.resize(nCount);
+
+    UniValue ret(UniValue::VARR);
+    for (const CLockSiteStats& stats : vStats) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("lock", stats.strName);
+        obj.pushKV("site", strprintf("%s:%d", stats.strFile, stats.nLine));
+        obj.pushKV("count", stats.nCount);
+        obj.pushKV("contended", stats.nContended);
+        obj.pushKV("wait", stats.nWait);
+        obj.pushKV("hold", stats.nHold);
+        ret.push_back(obj);
+    }
+    return ret;
+}
+
 UniValue echo(const JSONRPCRequest& request)
 {
     if (request.fHelp)
@@ -514,6 +570,7 @@ static const CRPCCommand commands[] =
   //  --------------------- ------------------------  -----------------------  ----------
     { "control",            "getinfo",                &getinfo,                true,  {} }, /* uses wallet if enabled */
     { "control",            "getmemoryinfo",          &getmemoryinfo,          true,  {} },
+    { "control",            "getlockstats",           &getlockstats,           true,  {"count"} },
     { "util",               "validateaddress",        &validateaddress,        true,  {"address"} }, /* uses wallet if enabled */
     { "util",               "createmultisig",         &createmultisig,         true,  {"nrequired","keys"} },
     { "util",               "verifymessage",          &verifymessage,          true,  {"address","signature","message"} },
@@ -68,6 +68,23 @@ UniValue ping(const JSONRPCRequest& request)
     return NullUniValue;
 }
 
+static UniValue MessageStatsToJSON(const mapMsgCmdStats& mapStats)
+{
+    UniValue ret(UniValue::VOBJ);
+    BOOST_FOREACH(const mapMsgCmdStats::value_type &i, mapStats) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("count", i.second.processing.GetCount());
+        obj.pushKV("time", i.second.processing.GetTotal());
+        obj.pushKV("p50", i.second.processing.GetPercentile(0.5));
+        obj.pushKV("p99", i.second.processing.GetPercentile(0.99));
+        obj.pushKV("queue_p50", i.second.queueing.GetPercentile(0.5));
+        obj.pushKV("queue_p99", i.second.queueing.GetPercentile(0.99));
+        obj.pushKV("lockwait", i.second.nLockWait);
+        ret.pushKV(i.first, obj);
+    }
+    return ret;
+}
+
 UniValue getpeerinfo(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 0)
@@ -112,6 +129,10 @@ UniValue getpeerinfo(const JSONRPCRequest& request)
             "    \"bytesrecv_per_msg\": {\n"
             "       \"addr\": n,              (numeric) The total bytes received aggregated by message type\n"
             "       ...\n"
+            "    },\n"
+            "    \"processing_per_msg\": {  (json object) How the messages received were processed, by message type, as in getmessagestats\n"
+            "       \"addr\": {...},\n"
+            "       ...\n"
             "    }\n"
             "  }\n"
             "  ,...\n"
@@ -185,6 +206,7 @@ UniValue getpeerinfo(const JSONRPCRequest& request)
                 recvPerMsgCmd.pushKV(i.first, i.second);
         }
         obj.pushKV("bytesrecv_per_msg", recvPerMsgCmd);
+        obj.pushKV("processing_per_msg", MessageStatsToJSON(stats.mapProcessStatsPerMsgCmd));
 
         ret.push_back(obj);
     }
@@ -373,6 +395,38 @@ UniValue getnettotals(const JSONRPCRequest& request)
     return obj;
 }
 
+UniValue getmessagestats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 0)
+        throw runtime_error(
+            "getmessagestats\n"
+            "\nReturns how the messages received from all peers since startup were processed, by message type.\n"
+            "Times are in microseconds. Percentiles are rounded up to a power of two.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"type\": {             (json object) Message type\n"
+            "    \"count\": n,          (numeric) Number of messages processed\n"
+            "    \"time\": n,           (numeric) Total time spent processing them\n"
+            "    \"p50\": n,            (numeric) Median processing time\n"
+            "    \"p99\": n,            (numeric) 99th percentile of the processing time\n"
+            "    \"queue_p50\": n,      (numeric) Median time from receipt to processing\n"
+            "    \"queue_p99\": n,      (numeric) 99th percentile of the time from receipt to processing\n"
+            "    \"lockwait\": n        (numeric) Total time spent waiting for locks held by other threads while processing\n"
+            "  },\n"
+            "  ...\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getmessagestats", "")
+            + HelpExampleRpc("getmessagestats", "")
+       );
+    if(!g_connman)
+        throw JSONRPCError(RPC_CLIENT_P2P_DISABLED, "Error: Peer-to-peer functionality missing or disabled");
+
+    mapMsgCmdStats mapStats;
+    g_connman->GetMessageStats(mapStats);
+    return MessageStatsToJSON(mapStats);
+}
+
 static UniValue GetNetworksInfo()
 {
     UniValue networks(UniValue::VARR);
@@ -619,6 +673,7 @@ static const CRPCCommand commands[] =
     { "network",            "disconnectnode",         &disconnectnode,         true,  {"address"} },
     { "network",            "getaddednodeinfo",       &getaddednodeinfo,       true,  {"node"} },
     { "network",            "getnettotals",           &getnettotals,           true,  {} },
+    { "network",            "getmessagestats",        &getmessagestats,        true,  {} },
     { "network",            "getnetworkinfo",         &getnetworkinfo,         true,  {} },
     { "network",            "setban",                 &setban,                 true,  {"subnet", "command", "bantime", "absolute"} },
     { "network",            "listbanned",             &listbanned,             true,  {} },
@@ -5,81 +5,58 @@
 
 #include "sigcache.h"
 
+#include "hash.h"
 #include "memusage.h"
 #include "pubkey.h"
 #include "random.h"
 #include "uint256.h"
 #include "util.h"
 
-#include "cuckoocache.h"
 #include <boost/thread.hpp>
 
-namespace {
+CSignatureCache::CSignatureCache()
+{
+    GetRandBytes((unsigned char*)salt, sizeof(salt));
+    GetRandBytes((unsigned char*)shardSalt, sizeof(shardSalt));
+}
 
-/**
- * We're hashing a nonce into the entries themselves, so we don't need extra
- * blinding in the set hash computation.
- *
- * This may exhibit platform endian dependent behavior but because these are
- * nonced hashes (random) and this state is only ever used locally it is safe.
- * All that matters is local consistency.
- */
-class SignatureCacheHasher
+void CSignatureCache::ComputeEntry(uint256& entry, const uint256 &hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubkey)
 {
-public:
-    template <uint8_t hash_select>
-    uint32_t operator()(const uint256& key) const
-    {
-        static_assert(hash_select <8, "SignatureCacheHasher only has 8 hashes available.");
-        uint32_t u;
-        std::memcpy(&u, key.begin()+4*hash_select, 4);
-        return u;
-    }
-};
+    uint64_t a = CSipHasher(salt[0], salt[1]).Write(hash.begin(), 32).Write(pubkey.begin(), pubkey.size()).Write(vchSig.data(), vchSig.size()).Finalize();
+    uint64_t b = CSipHasher(salt[2], salt[3]).Write(hash.begin(), 32).Write(pubkey.begin(), pubkey.size()).Write(vchSig.data(), vchSig.size()).Finalize();
+    // Spread the 128 bits over the 8 words the cuckoo tables index with
+    uint64_t words[4] = {a, b, a * 0x9E3779B97F4A7C15ULL ^ b, b * 0xC2B2AE3D27D4EB4FULL ^ a};
+    std::memcpy(entry.begin(), words, sizeof(words));
+}
 
-/**
- * Valid signature cache, to avoid doing expensive ECDSA signature checking
- * twice for every transaction (once when accepted into memory pool, and
- * again when accepted into the block chain)
- */
-class CSignatureCache
+unsigned int CSignatureCache::GetShardIndex(const uint256& entry) const
 {
-private:
-     //! Entries are SHA256(nonce || signature hash || public key || signature):
-    uint256 nonce;
-    typedef CuckooCache::cache<uint256, SignatureCacheHasher> map_type;
-    map_type setValid;
-    boost::shared_mutex cs_sigcache;
+    return SipHashUint256(shardSalt[0], shardSalt[1], entry) % SIG_CACHE_SHARDS;
+}
 
-public:
-    CSignatureCache()
-    {
-        GetRandBytes(nonce.begin(), 32);
-    }
+bool CSignatureCache::Get(const uint256& entry, const bool erase)
+{
+    Shard& shard = shards[GetShardIndex(entry)];
+    boost::shared_lock<boost::shared_mutex> lock(shard.cs_sigcache);
+    return shard.setValid.contains(entry, erase);
+}
 
-    void
-    ComputeEntry(uint256& entry, const uint256 &hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubkey)
-    {
-        CSHA256().Write(nonce.begin(), 32).Write(hash.begin(), 32).Write(&pubkey[0], pubkey.size()).Write(&vchSig[0], vchSig.size()).Finalize(entry.begin());
-    }
+void CSignatureCache::Set(const uint256& entry)
+{
+    Shard& shard = shards[GetShardIndex(entry)];
+    boost::unique_lock<boost::shared_mutex> lock(shard.cs_sigcache);
+    shard.setValid.insert(entry);
+}
 
-    bool
-    Get(const uint256& entry, const bool erase)
-    {
-        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
-        return setValid.contains(entry, erase);
-    }
+size_t CSignatureCache::setup_bytes(size_t n)
+{
+    size_t nElems = 0;
+    for (Shard& shard : shards)
+        nElems += shard.setValid.setup_bytes(n / SIG_CACHE_SHARDS);
+    return nElems;
+}
 
-    void Set(uint256& entry)
-    {
-        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
-        setValid.insert(entry);
-    }
-    uint32_t setup_bytes(size_t n)
-    {
-        return setValid.setup_bytes(n);
-    }
-};
+namespace {
 
 /* In previous versions of this code, signatureCache was a local static variable
  * in CachingTransactionSignatureChecker::VerifySignature.  We initialize
@@ -94,7 +71,7 @@ static CSignatureCache signatureCache;
 void InitSignatureCache()
 {
     // nMaxCacheSize is unsigned. If -maxsigcachesize is set to zero,
-    // setup_bytes creates the minimum possible cache (2 elements).
+    // setup_bytes creates the minimum possible cache (2 elements per shard).
     size_t nMaxCacheSize = std::min(std::max((int64_t)0, GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE)), MAX_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
     size_t nElems = signatureCache.setup_bytes(nMaxCacheSize);
     LogPrintf("Using %zu MiB out of %zu requested for signature cache, able to store %zu elements\n",
@@ -6,10 +6,14 @@
 #ifndef NOVO_SCRIPT_SIGCACHE_H
 #define NOVO_SCRIPT_SIGCACHE_H
 
+#include "cuckoocache.h"
 #include "script/interpreter.h"
+#include "uint256.h"
 
 #include <vector>
 
+#include <boost/thread/shared_mutex.hpp>
+
 // DoS prevention: limit cache size to 32MB (over 1000000 entries on 64-bit
 // systems). Due to how we count cache size, actual memory usage is slightly
 // more (~32.25 MB)
@@ -19,6 +23,73 @@ static const int64_t MAX_MAX_SIG_CACHE_SIZE = 16384;
 
 class CPubKey;
 
+/**
+ * We're hashing a nonce into the entries themselves, so we don't need extra
+ * blinding in the set hash computation.
+ *
+ * This may exhibit platform endian dependent behavior but because these are
+ * nonced hashes (random) and this state is only ever used locally it is safe.
+ * All that matters is local consistency.
+ */
+class SignatureCacheHasher
+{
+public:
+    template <uint8_t hash_select>
+    uint32_t operator()(const uint256& key) const
+    {
+        static_assert(hash_select <8, "SignatureCacheHasher only has 8 hashes available.");
+        uint32_t u;
+        std::memcpy(&u, key.begin()+4*hash_select, 4);
+        return u;
+    }
+};
+
+/** Number of independently locked tables the signature cache is split into */
+static const unsigned int SIG_CACHE_SHARDS = 16;
+
+/**
+ * Valid signature cache, to avoid doing expensive ECDSA signature checking
+ * twice for every transaction (once when accepted into memory pool, and
+ * again when accepted into the block chain)
+ *
+ * The cache is split into SIG_CACHE_SHARDS tables, each behind its own lock,
+ * so that script check threads rarely contend with each other.
+ */
+class CSignatureCache
+{
+private:
+    //! Entries are derived from two SipHash-2-4 values of (signature hash || public key || signature),
+    //! keyed with the random salt. The salt is secret, so the entries cannot be
+    //! steered into collisions; SipHash is several times cheaper than SHA256 here.
+    uint64_t salt[4];
+    //! Separate key for choosing an entry's shard
+    uint64_t shardSalt[2];
+    typedef CuckooCache::cache<uint256, SignatureCacheHasher> map_type;
+    struct Shard {
+        map_type setValid;
+        boost::shared_mutex cs_sigcache;
+    };
+    Shard shards[SIG_CACHE_SHARDS];
+
+public:
+    CSignatureCache();
+
+    void ComputeEntry(uint256& entry, const uint256 &hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubkey);
+
+    /**
+     * Index of the shard holding an entry. The cuckoo tables index on all of
+     * the entry's bits, so the shard comes from a separately keyed hash of it
+     * rather than from any of them.
+     */
+    unsigned int GetShardIndex(const uint256& entry) const;
+
+    bool Get(const uint256& entry, const bool erase);
+    void Set(const uint256& entry);
+
+    /** Size the cache to n bytes in total, returns the number of elements it can hold */
+    size_t setup_bytes(size_t n);
+};
+
 class CachingTransactionSignatureChecker : public TransactionSignatureChecker
 {
 private:
@@ -7,6 +7,8 @@
 #include "util.h"
 #include "utilstrencodings.h"
 
+#include <map>
+#include <mutex>
 #include <stdio.h>
 
 #include <boost/foreach.hpp>
@@ -20,6 +22,117 @@ void PrintLockContention(const char* pszName, const char* pszFile, int nLine)
 }
 #endif /* DEBUG_LOCKCONTENTION */
 
+static boost::thread_specific_ptr<int64_t> nThreadLockWait;
+
+int64_t GetThreadLockWait()
+{
+    return nThreadLockWait.get() ? *nThreadLockWait : 0;
+}
+
+void AddThreadLockWait(int64_t nMicros)
+{
+    // thread_specific_ptr automatically deletes the counter when the thread ends.
+    if (!nThreadLockWait.get())
+        nThreadLockWait.reset(new int64_t(0));
+    *nThreadLockWait += nMicros;
+}
+
+std::atomic<bool> fProfileLocks(false);
+
+namespace {
+
+struct LockSiteCounts {
+    const char* pszName;
+    uint64_t nCount;
+    uint64_t nContended;
+    int64_t nWait;
+    int64_t nHold;
+
+    LockSiteCounts() : pszName(""), nCount(0), nContended(0), nWait(0), nHold(0) {}
+};
+
+// Call sites by file and line. The file names are literals, compared by address.
+typedef std::map<std::pair<const char*, int>, LockSiteCounts> LockSiteMap;
+
+struct LockProfile {
+    LockSiteMap mapSites;
+    int64_t nLastMerge;
+
+    LockProfile() : nLastMerge(GetTimeMicros()) {}
+};
+
+// Plain mutex, so that merging does not itself show up in the profile.
+// Never destroyed, as threads may exit during static destruction.
+std::mutex& csLockProfile = *new std::mutex;
+LockSiteMap& mapLockProfile = *new LockSiteMap;
+
+void MergeLockProfile(LockProfile* profile)
+{
+    std::lock_guard<std::mutex> lock(csLockProfile);
+    for (const LockSiteMap::value_type& i : profile->mapSites) {
+        LockSiteCounts& counts = mapLockProfile[i.first];
+        counts.pszName = i.second.pszName;
+        counts.nCount += i.second.nCount;
+        counts.nContended += i.second.nContended;
+        counts.nWait += i.second.nWait;
+        counts.nHold += i.second.nHold;
+    }
+    profile->mapSites.clear();
+    profile->nLastMerge = GetTimeMicros();
+}
+
+void DeleteLockProfile(LockProfile* profile)
+{
+    MergeLockProfile(profile);
+    delete profile;
+}
+
+boost::thread_specific_ptr<LockProfile> lockprofile(DeleteLockProfile);
+
+} // namespace
+
+void RecordLockAcquisition(const char* pszName, const char* pszFile, int nLine, bool fContended, int64_t nWait, int64_t nHold)
+{
+    if (!lockprofile.get())
+        lockprofile.reset(new LockProfile);
+    LockSiteCounts& counts = lockprofile->mapSites[std::make_pair(pszFile, nLine)];
+    counts.pszName = pszName;
+    counts.nCount++;
+    counts.nContended += fContended;
+    counts.nWait += nWait;
+    counts.nHold += nHold;
+    if (GetTimeMicros() - lockprofile->nLastMerge >= LOCK_PROFILE_MERGE_INTERVAL)
+        MergeLockProfile(lockprofile.get());
+}
+
+std::vector<CLockSiteStats> GetLockProfile()
+{
+    if (lockprofile.get())
+        MergeLockProfile(lockprofile.get());
+
+    // A site in a header has a file name literal per translation unit
+    std::map<std::pair<std::string, int>, CLockSiteStats> mapSites;
+    {
+        std::lock_guard<std::mutex> lock(csLockProfile);
+        for (const LockSiteMap::value_type& i : mapLockProfile) {
+            CLockSiteStats& stats = mapSites[std::make_pair(std::string(i.first.first), i.first.second)];
+            if (stats.nCount == 0) {
+                stats.strName = i.second.pszName;
+                stats.strFile = i.first.first;
+                stats.nLine = i.first.second;
+            }
+            stats.nCount += i.second.nCount;
+            stats.nContended += i.second.nContended;
+            stats.nWait += i.second.nWait;
+            stats.nHold += i.second.nHold;
+        }
+    }
+    std::vector<CLockSiteStats> vStats;
+    for (const std::pair<const std::pair<std::string, int>, CLockSiteStats>& i : mapSites)
+        vStats.push_back(i.second);
+    return vStats;
+}
+
 #ifdef DEBUG_LOCKORDER
 //
 // Early deadlock detection.
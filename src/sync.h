@@ -7,6 +7,11 @@
 #define NOVO_SYNC_H
 
 #include "threadsafety.h"
+#include "utiltime.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
 
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/locks.hpp>
@@ -108,6 +113,39 @@ typedef boost::condition_variable CConditionVariable;
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine);
 #endif
 
+/** Time in microseconds the calling thread has spent waiting for locks held by other threads */
+int64_t GetThreadLockWait();
+void AddThreadLockWait(int64_t nMicros);
+
+/** Default for -lockprofile */
+static const bool DEFAULT_LOCK_PROFILE = false;
+/** Interval in microseconds at which threads merge their lock profile into the global one */
+static const int64_t LOCK_PROFILE_MERGE_INTERVAL = 1000000;
+
+/** Whether CMutexLock profiles lock acquisitions by call site, set by -lockprofile */
+extern std::atomic<bool> fProfileLocks;
+
+/** How the locks taken at one call site were acquired and held, times in microseconds */
+struct CLockSiteStats {
+    std::string strName;
+    std::string strFile;
+    int nLine;
+    uint64_t nCount;
+    //! Acquisitions that had to wait for another thread
+    uint64_t nContended;
+    int64_t nWait;
+    int64_t nHold;
+};
+
+/**
+ * Record an acquisition of pszName at pszFile:nLine. It is added to the
+ * calling thread's profile, which is merged into the global one at most
+ * every LOCK_PROFILE_MERGE_INTERVAL and when the thread exits.
+ */
+void RecordLockAcquisition(const char* pszName, const char* pszFile, int nLine, bool fContended, int64_t nWait, int64_t nHold);
+/** Get the global lock profile, after merging the calling thread's */
+std::vector<CLockSiteStats> GetLockProfile();
+
 /** Wrapper around boost::unique_lock<Mutex> */
 template <typename Mutex>
 class SCOPED_LOCKABLE CMutexLock
@@ -115,17 +153,38 @@ class SCOPED_LOCKABLE CMutexLock
 private:
     boost::unique_lock<Mutex> lock;
 
+    // Call site and timing of the acquisition, while profiling
+    const char* pszSiteName;
+    const char* pszSiteFile;
+    int nSiteLine;
+    bool fContended;
+    int64_t nWait;
+    int64_t nLockedAt;
+
+    void StartProfile(const char* pszName, const char* pszFile, int nLine)
+    {
+        if (!fProfileLocks.load(std::memory_order_relaxed))
+            return;
+        pszSiteName = pszName;
+        pszSiteFile = pszFile;
+        nSiteLine = nLine;
+        nLockedAt = GetTimeMicros();
+    }
+
     void Enter(const char* pszName, const char* pszFile, int nLine)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(lock.mutex()));
-#ifdef DEBUG_LOCKCONTENTION
         if (!lock.try_lock()) {
+#ifdef DEBUG_LOCKCONTENTION
             PrintLockContention(pszName, pszFile, nLine);
 #endif
+            int64_t nWaitStart = GetTimeMicros();
             lock.lock();
-#ifdef DEBUG_LOCKCONTENTION
+            nWait = GetTimeMicros() - nWaitStart;
+            fContended = true;
+            AddThreadLockWait(nWait);
         }
-#endif
+        StartProfile(pszName, pszFile, nLine);
     }
 
     bool TryEnter(const char* pszName, const char* pszFile, int nLine)
@@ -134,11 +193,13 @@ private:
         lock.try_lock();
         if (!lock.owns_lock())
             LeaveCritical();
+        else
+            StartProfile(pszName, pszFile, nLine);
         return lock.owns_lock();
     }
 
 public:
-    CMutexLock(Mutex& mutexIn, const char* pszName, const char* pszFile, int nLine, bool fTry = false) EXCLUSIVE_LOCK_FUNCTION(mutexIn) : lock(mutexIn, boost::defer_lock)
+    CMutexLock(Mutex& mutexIn, const char* pszName, const char* pszFile, int nLine, bool fTry = false) EXCLUSIVE_LOCK_FUNCTION(mutexIn) : lock(mutexIn, boost::defer_lock), fContended(false), nWait(0), nLockedAt(0)
     {
         if (fTry)
             TryEnter(pszName, pszFile, nLine);
@@ -146,7 +207,7 @@ public:
             Enter(pszName, pszFile, nLine);
     }
 
-    CMutexLock(Mutex* pmutexIn, const char* pszName, const char* pszFile, int nLine, bool fTry = false) EXCLUSIVE_LOCK_FUNCTION(pmutexIn)
+    CMutexLock(Mutex* pmutexIn, const char* pszName, const char* pszFile, int nLine, bool fTry = false) EXCLUSIVE_LOCK_FUNCTION(pmutexIn) : fContended(false), nWait(0), nLockedAt(0)
     {
         if (!pmutexIn) return;
 
@@ -159,8 +220,14 @@ public:
 
     ~CMutexLock() UNLOCK_FUNCTION()
     {
-        if (lock.owns_lock())
+        if (lock.owns_lock()) {
             LeaveCritical();
+            int64_t nHeld = nLockedAt != 0 ? GetTimeMicros() - nLockedAt : 0;
+            // Record after releasing, so other waiters are not held up by the profiler
+            lock.unlock();
+            if (nLockedAt != 0)
+                RecordLockAcquisition(pszSiteName, pszSiteFile, nSiteLine, fContended, nWait, nHeld);
+        }
     }
 
     operator bool()
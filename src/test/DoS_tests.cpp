@@ -11,6 +11,7 @@
 #include "pow.h"
 #include "script/sign.h"
 #include "serialize.h"
+#include "txorphanage.h"
 #include "util.h"
 #include "validation.h"
 
@@ -23,16 +24,18 @@
 #include <boost/foreach.hpp>
 #include <boost/test/unit_test.hpp>
 
-// Tests these internal-to-net_processing.cpp methods:
-extern bool AddOrphanTx(const CTransactionRef& tx, NodeId peer);
-extern void EraseOrphansFor(NodeId peer);
-extern unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans);
-struct COrphanTx {
-    CTransactionRef tx;
-    NodeId fromPeer;
-    int64_t nTimeExpire;
+class TestOrphanage : public CTxOrphanage
+{
+public:
+    CTransactionRef RandomOrphan()
+    {
+        LOCK(cs);
+        OrphanMap::iterator it = mapOrphans.lower_bound(GetRandHash());
+        if (it == mapOrphans.end())
+            it = mapOrphans.begin();
+        return it->second.tx;
+    }
 };
-extern std::map<uint256, COrphanTx> mapOrphanTransactions;
 
 CService ip(uint32_t i)
 {
@@ -126,17 +129,9 @@ BOOST_AUTO_TEST_CASE(DoS_bantime)
     BOOST_CHECK(!connman->IsBanned(addr));
 }
 
-CTransactionRef RandomOrphan()
-{
-    std::map<uint256, COrphanTx>::iterator it;
-    it = mapOrphanTransactions.lower_bound(GetRandHash());
-    if (it == mapOrphanTransactions.end())
-        it = mapOrphanTransactions.begin();
-    return it->second.tx;
-}
-
 BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
 {
+    TestOrphanage orphanage;
     CKey key;
     key.MakeNewKey(true);
     CBasicKeyStore keystore;
@@ -154,13 +149,13 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
         tx.vout[0].nValue = 1*CENT;
         tx.vout[0].scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
 
-        AddOrphanTx(MakeTransactionRef(tx), i);
+        orphanage.AddTx(MakeTransactionRef(tx), i);
     }
 
     // ... and 50 that depend on other orphans:
     for (int i = 0; i < 50; i++)
     {
-        CTransactionRef txPrev = RandomOrphan();
+        CTransactionRef txPrev = orphanage.RandomOrphan();
 
         CMutableTransaction tx;
         tx.vin.resize(1);
@@ -171,13 +166,13 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
         tx.vout[0].scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
         SignSignature(keystore, *txPrev, tx, 0, SIGHASH_ALL);
 
-        AddOrphanTx(MakeTransactionRef(tx), i);
+        orphanage.AddTx(MakeTransactionRef(tx), i);
     }
 
     // This really-big orphan should be ignored:
     for (int i = 0; i < 10; i++)
     {
-        CTransactionRef txPrev = RandomOrphan();
+        CTransactionRef txPrev = orphanage.RandomOrphan();
 
         CMutableTransaction tx;
         tx.vout.resize(1);
@@ -195,24 +190,92 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
         for (unsigned int j = 1; j < tx.vin.size(); j++)
             tx.vin[j].scriptSig = tx.vin[0].scriptSig;
 
-        BOOST_CHECK(!AddOrphanTx(MakeTransactionRef(tx), i));
+        BOOST_CHECK(!orphanage.AddTx(MakeTransactionRef(tx), i));
     }
 
-    // Test EraseOrphansFor:
+    // Test EraseForPeer:
     for (NodeId i = 0; i < 3; i++)
     {
-        size_t sizeBefore = mapOrphanTransactions.size();
-        EraseOrphansFor(i);
-        BOOST_CHECK(mapOrphanTransactions.size() < sizeBefore);
+        size_t sizeBefore = orphanage.Size();
+        orphanage.EraseForPeer(i);
+        BOOST_CHECK(orphanage.Size() < sizeBefore);
+        BOOST_CHECK_EQUAL(orphanage.GetPeerUsage(i), 0);
     }
 
-    // Test LimitOrphanTxSize() function:
-    LimitOrphanTxSize(40);
-    BOOST_CHECK(mapOrphanTransactions.size() <= 40);
-    LimitOrphanTxSize(10);
-    BOOST_CHECK(mapOrphanTransactions.size() <= 10);
-    LimitOrphanTxSize(0);
-    BOOST_CHECK(mapOrphanTransactions.empty());
+    // Test LimitOrphans() function:
+    orphanage.LimitOrphans(40);
+    BOOST_CHECK(orphanage.Size() <= 40);
+    orphanage.LimitOrphans(10);
+    BOOST_CHECK(orphanage.Size() <= 10);
+    orphanage.LimitOrphans(0);
+    BOOST_CHECK_EQUAL(orphanage.Size(), 0);
+}
+
+static CTransactionRef MakeOrphan(const uint256& hashPrev, unsigned int nOutputs)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout.n = 0;
+    tx.vin[0].prevout.hash = hashPrev;
+    tx.vin[0].scriptSig << OP_1;
+    tx.vout.resize(nOutputs);
+    for (CTxOut& txout : tx.vout) {
+        txout.nValue = 1*CENT;
+        txout.scriptPubKey = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 0) << OP_EQUALVERIFY << OP_CHECKSIG;
+    }
+    return MakeTransactionRef(tx);
+}
+
+BOOST_AUTO_TEST_CASE(DoS_orphans_per_peer)
+{
+    TestOrphanage orphanage;
+
+    // Peer 0 floods large orphans, peer 1 sends a few small ones
+    for (int i = 0; i < 20; i++)
+        BOOST_CHECK(orphanage.AddTx(MakeOrphan(GetRandHash(), 50), 0));
+    std::vector<CTransactionRef> vSmall;
+    for (int i = 0; i < 5; i++) {
+        vSmall.push_back(MakeOrphan(GetRandHash(), 1));
+        BOOST_CHECK(orphanage.AddTx(vSmall.back(), 1));
+    }
+    BOOST_CHECK(!orphanage.AddTx(vSmall[0], 2));
+    BOOST_CHECK(orphanage.GetPeerUsage(0) > orphanage.GetPeerUsage(1));
+
+    // Eviction takes from the peer using the most memory first
+    BOOST_CHECK_EQUAL(orphanage.LimitOrphans(10), 15);
+    for (const CTransactionRef& tx : vSmall)
+        BOOST_CHECK(orphanage.HaveTx(tx->GetHash()));
+
+    // Children of an accepted parent are queued for the peer that sent them
+    CTransactionRef parent = MakeOrphan(GetRandHash(), 1);
+    CTransactionRef child = MakeOrphan(parent->GetHash(), 1);
+    CTransactionRef grandchild = MakeOrphan(child->GetHash(), 1);
+    BOOST_CHECK(orphanage.AddTx(child, 2));
+    BOOST_CHECK(orphanage.AddTx(grandchild, 3));
+    BOOST_CHECK(!orphanage.HaveTxToReconsider(2));
+    BOOST_CHECK_EQUAL(orphanage.AddChildrenToWorkSet(*parent), 1);
+    BOOST_CHECK(orphanage.HaveTxToReconsider(2));
+    BOOST_CHECK(!orphanage.HaveTxToReconsider(3));
+
+    CTransactionRef tx;
+    BOOST_CHECK(!orphanage.GetTxToReconsider(3, tx));
+    BOOST_CHECK(orphanage.GetTxToReconsider(2, tx));
+    BOOST_CHECK(tx == child);
+    BOOST_CHECK(!orphanage.HaveTxToReconsider(2));
+    BOOST_CHECK(orphanage.HaveTx(child->GetHash()));
+
+    BOOST_CHECK_EQUAL(orphanage.AddChildrenToWorkSet(*child), 1);
+    BOOST_CHECK_EQUAL(orphanage.EraseTx(child->GetHash()), 1);
+    BOOST_CHECK(orphanage.HaveTxToReconsider(3));
+
+    // Orphans spending an output a block spent are removed with their work
+    CMutableTransaction blockTx;
+    blockTx.vin.resize(1);
+    blockTx.vin[0].prevout = COutPoint(child->GetHash(), 0);
+    orphanage.EraseForBlock(CTransaction(blockTx));
+    BOOST_CHECK(!orphanage.HaveTx(grandchild->GetHash()));
+    BOOST_CHECK(!orphanage.HaveTxToReconsider(3));
+    BOOST_CHECK(!orphanage.GetTxToReconsider(3, tx));
 }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,127 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chainparams.h"
+#include "consensus/validation.h"
+#include "index/addrindex.h"
+#include "key.h"
+#include "script/sign.h"
+#include "script/standard.h"
+#include "utiltime.h"
+#include "validation.h"
+#include "validationinterface.h"
+
+#include "test/test_novo.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(addrindex_tests)
+
+static std::vector<CAddrIndexOutput> FindAll(CAddrIndex& addrindex, const CScript& script, bool fUnspentOnly = false)
+{
+    std::vector<CAddrIndexOutput> vOutputs;
+    bool fMore;
+    CAddrIndexPosition pos;
+    BOOST_CHECK(addrindex.FindOutputs(script, pos, 10000, fUnspentOnly, vOutputs, fMore));
+    BOOST_CHECK(!fMore);
+    return vOutputs;
+}
+
+BOOST_FIXTURE_TEST_CASE(addrindex_outputs_and_spends, TestChain240Setup)
+{
+    CAddrIndex addrindex(1 << 20, true);
+    BOOST_REQUIRE(addrindex.Start());
+
+    int64_t nTimeStart = GetTimeMillis();
+    while (!addrindex.IsSynced()) {
+        BOOST_REQUIRE(nTimeStart + 10000 > GetTimeMillis());
+        MilliSleep(100);
+    }
+
+    // Every block of the fixture pays its coinbase to coinbaseKey
+    CScript scriptCoinbase = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    std::vector<CAddrIndexOutput> vOutputs = FindAll(addrindex, scriptCoinbase);
+    BOOST_REQUIRE_EQUAL(vOutputs.size(), coinbaseTxns.size());
+    for (size_t i = 0; i < vOutputs.size(); i++) {
+        BOOST_CHECK_EQUAL(vOutputs[i].nHeight, (int)i + 1);
+        BOOST_CHECK(vOutputs[i].txid == coinbaseTxns[i].GetHash());
+        BOOST_CHECK_EQUAL(vOutputs[i].nValue, coinbaseTxns[i].vout[0].nValue);
+        BOOST_CHECK(!vOutputs[i].fSpent);
+    }
+
+    // Pages
+    std::vector<CAddrIndexOutput> vPage;
+    bool fMore;
+    CAddrIndexPosition pos;
+    BOOST_CHECK(addrindex.FindOutputs(scriptCoinbase, pos, 100, false, vPage, fMore));
+    BOOST_CHECK_EQUAL(vPage.size(), 100U);
+    BOOST_CHECK(fMore);
+    BOOST_CHECK_EQUAL(pos.nHeight, 101);
+    BOOST_CHECK(pos.txid == coinbaseTxns[100].GetHash());
+    BOOST_CHECK(addrindex.FindOutputs(scriptCoinbase, pos, 100, false, vPage, fMore));
+    BOOST_CHECK_EQUAL(vPage.size(), 100U);
+    BOOST_CHECK(fMore);
+    BOOST_CHECK(vPage[0].txid == coinbaseTxns[100].GetHash());
+    BOOST_CHECK(addrindex.FindOutputs(scriptCoinbase, pos, 100, false, vPage, fMore));
+    BOOST_CHECK_EQUAL(vPage.size(), coinbaseTxns.size() - 200);
+    BOOST_CHECK(!fMore);
+    BOOST_CHECK(vPage[0].txid == coinbaseTxns[200].GetHash());
+    pos = CAddrIndexPosition(231);
+    BOOST_CHECK(addrindex.FindOutputs(scriptCoinbase, pos, 100, false, vPage, fMore));
+    BOOST_CHECK_EQUAL(vPage.size(), coinbaseTxns.size() - 230);
+    BOOST_CHECK_EQUAL(vPage[0].nHeight, 231);
+
+    // Spend the first coinbase to a new key
+    CKey key;
+    key.MakeNewKey(true);
+    CScript scriptDest = GetScriptForDestination(key.GetPubKey().GetID());
+    CMutableTransaction spend;
+    spend.nVersion = 1;
+    spend.vin.resize(1);
+    spend.vin[0].prevout = COutPoint(coinbaseTxns[0].GetHash(), 0);
+    spend.vout.resize(1);
+    spend.vout[0].nValue = coinbaseTxns[0].vout[0].nValue - COIN;
+    spend.vout[0].scriptPubKey = scriptDest;
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(scriptCoinbase, spend, 0, SIGHASH_ALL, coinbaseTxns[0].vout[0].nValue, SIGVERSION_BASE);
+    BOOST_REQUIRE(coinbaseKey.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    spend.vin[0].scriptSig << vchSig;
+
+    CBlock block = CreateAndProcessBlock(std::vector<CMutableTransaction>(1, spend), scriptCoinbase);
+    BOOST_REQUIRE(chainActive.Tip()->GetBlockHash() == block.GetHash());
+    SyncWithValidationInterfaceQueue();
+
+    vOutputs = FindAll(addrindex, scriptDest);
+    BOOST_REQUIRE_EQUAL(vOutputs.size(), 1U);
+    BOOST_CHECK(vOutputs[0].txid == spend.GetHash());
+    BOOST_CHECK_EQUAL(vOutputs[0].nHeight, chainActive.Height());
+    BOOST_CHECK_EQUAL(vOutputs[0].nValue, spend.vout[0].nValue);
+
+    vOutputs = FindAll(addrindex, scriptCoinbase);
+    BOOST_REQUIRE_EQUAL(vOutputs.size(), coinbaseTxns.size() + 1);
+    BOOST_CHECK(vOutputs[0].fSpent);
+    BOOST_CHECK(vOutputs[0].spend.txid == spend.GetHash());
+    BOOST_CHECK_EQUAL(vOutputs[0].spend.nIn, 0U);
+    BOOST_CHECK_EQUAL(vOutputs[0].spend.nHeight, chainActive.Height());
+    BOOST_CHECK_EQUAL(FindAll(addrindex, scriptCoinbase, true).size(), coinbaseTxns.size());
+
+    // Disconnecting the block rewinds its entries
+    {
+        LOCK(cs_main);
+        CValidationState state;
+        BOOST_REQUIRE(InvalidateBlock(state, Params(), chainActive.Tip()));
+    }
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK(addrindex.GetBestBlockIndex() == chainActive.Tip());
+    BOOST_CHECK(FindAll(addrindex, scriptDest).empty());
+    vOutputs = FindAll(addrindex, scriptCoinbase);
+    BOOST_REQUIRE_EQUAL(vOutputs.size(), coinbaseTxns.size());
+    BOOST_CHECK(!vOutputs[0].fSpent);
+
+    addrindex.Stop();
+    StopValidationInterfaceQueue();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
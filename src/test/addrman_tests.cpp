@@ -2,6 +2,8 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 #include "addrman.h"
+#include "clientversion.h"
+#include "streams.h"
 #include "test/test_novo.h"
 #include <string>
 #include <boost/test/unit_test.hpp>
@@ -203,10 +205,54 @@ BOOST_AUTO_TEST_CASE(addrman_select)
     BOOST_CHECK(addrman.size() == 7);
 
     // Test 12: Select pulls from new and tried regardless of port number.
-    BOOST_CHECK(addrman.Select().ToString() == "250.4.6.6:8333");
-    BOOST_CHECK(addrman.Select().ToString() == "250.3.2.2:9999");
-    BOOST_CHECK(addrman.Select().ToString() == "250.3.3.3:9999");
     BOOST_CHECK(addrman.Select().ToString() == "250.4.4.4:8333");
+    BOOST_CHECK(addrman.Select().ToString() == "250.4.5.5:7777");
+    BOOST_CHECK(addrman.Select().ToString() == "250.3.1.1:8333");
+    BOOST_CHECK(addrman.Select().ToString() == "250.4.4.4:8333");
+}
+
+BOOST_AUTO_TEST_CASE(addrman_many)
+{
+    CAddrManTest addrman;
+
+    // Set addrman addr placement to be deterministic.
+    addrman.MakeDeterministic();
+
+    // Enough addresses to grow the lookup table several times and collide in the buckets.
+    std::vector<CService> vAddr;
+    for (int i = 0; i < 20000; i++) {
+        vAddr.push_back(ResolveService(strprintf("250.%i.%i.%i", 1 + i % 200, (i / 200) % 256, 1 + i % 7), 8333));
+        addrman.Add(CAddress(vAddr.back(), NODE_NONE), ResolveIP(strprintf("252.%i.1.1", i % 50)));
+    }
+    for (int i = 0; i < 20000; i += 100)
+        addrman.Good(CAddress(vAddr[i], NODE_NONE));
+
+    // Every address kept in the tables can be found and selected addresses are among them.
+    size_t nFound = 0;
+    for (const CService& addr : vAddr) {
+        CAddrInfo* pinfo = addrman.Find(addr);
+        if (pinfo) {
+            BOOST_CHECK(*pinfo == addr);
+            nFound++;
+        }
+    }
+    BOOST_CHECK_EQUAL(nFound, addrman.size());
+    BOOST_CHECK(addrman.size() > 1000);
+    for (int i = 0; i < 100; i++)
+        BOOST_CHECK(addrman.Find(addrman.Select()) != NULL);
+    for (int i = 0; i < 100; i++)
+        BOOST_CHECK(addrman.Find(addrman.Select(true)) != NULL);
+
+    // The tables survive a round trip through peers.dat serialization.
+    CDataStream ssPeers(SER_DISK, CLIENT_VERSION);
+    ssPeers << addrman;
+    CAddrManTest addrman2;
+    ssPeers >> addrman2;
+    BOOST_CHECK_EQUAL(addrman2.size(), addrman.size());
+    for (const CService& addr : vAddr)
+        BOOST_CHECK((addrman2.Find(addr) != NULL) == (addrman.Find(addr) != NULL));
+    for (int i = 0; i < 100; i++)
+        BOOST_CHECK(addrman2.Find(addrman2.Select()) != NULL);
 }
 
 BOOST_AUTO_TEST_CASE(addrman_new_collisions)
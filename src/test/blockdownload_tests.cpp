@@ -0,0 +1,74 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockdownload.h"
+
+#include "test/test_novo.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockdownload_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(blockdownload_target)
+{
+    CBlockDownloadEstimator estimator;
+    BOOST_CHECK(!estimator.HasEstimate());
+    BOOST_CHECK_EQUAL(estimator.GetTargetBlocksInFlight(16), 16);
+    BOOST_CHECK_EQUAL(estimator.EstimateDeliveryTime(1000), -1);
+
+    // 8 MB blocks at 10 MB/s over a 100ms round trip: the bandwidth-delay
+    // product is 1 MB, so one block on the wire plus one more
+    estimator.SetLatency(100000);
+    estimator.AddSample(8000000, 800000);
+    BOOST_CHECK(estimator.HasEstimate());
+    BOOST_CHECK_CLOSE(estimator.GetThroughput(), 10000000, 0.001);
+    BOOST_CHECK_EQUAL(estimator.GetAverageBlockSize(), 8000000U);
+    BOOST_CHECK_EQUAL(estimator.GetTargetBlocksInFlight(16), 2);
+    BOOST_CHECK_EQUAL(estimator.EstimateDeliveryTime(8000000), 900000);
+
+    // A slow peer only gets the minimum, the block on the wire and the next one
+    CBlockDownloadEstimator slow;
+    slow.SetLatency(100000);
+    slow.AddSample(8000000, 80000000);
+    BOOST_CHECK_EQUAL(slow.GetTargetBlocksInFlight(16), MIN_ADAPTIVE_BLOCKS_IN_TRANSIT_PER_PEER);
+
+    // Small blocks over a long round trip are capped
+    CBlockDownloadEstimator small;
+    small.SetLatency(1000000);
+    small.AddSample(1000, 100);
+    BOOST_CHECK_EQUAL(small.GetTargetBlocksInFlight(16), MAX_ADAPTIVE_BLOCKS_IN_TRANSIT_PER_PEER);
+
+    // New samples move the averages gradually
+    estimator.AddSample(8000000, 8000000);
+    BOOST_CHECK(estimator.GetThroughput() < 10000000);
+    BOOST_CHECK(estimator.GetThroughput() > 1000000);
+
+    // Instant deliveries do not divide by zero
+    CBlockDownloadEstimator instant;
+    instant.AddSample(1000, 0);
+    BOOST_CHECK(instant.HasEstimate());
+    instant.AddSample(0, 1000);
+    BOOST_CHECK(instant.HasEstimate());
+}
+
+BOOST_AUTO_TEST_CASE(blockdownload_takeover)
+{
+    CBlockDownloadEstimator fast, slow, unknown;
+    fast.SetLatency(50000);
+    fast.AddSample(1000000, 100000);
+    slow.SetLatency(50000);
+    slow.AddSample(1000000, 1000000);
+
+    // Only a peer with a known speed takes over
+    BOOST_CHECK(!ShouldTakeOverBlock(unknown, slow, 10000000));
+    BOOST_CHECK(ShouldTakeOverBlock(fast, slow, 0));
+    BOOST_CHECK(!ShouldTakeOverBlock(slow, fast, 10000000));
+    BOOST_CHECK(!ShouldTakeOverBlock(fast, fast, 10000000));
+
+    // A staller of unknown speed gets as long as the other peer would take
+    BOOST_CHECK(!ShouldTakeOverBlock(fast, unknown, 100000));
+    BOOST_CHECK(ShouldTakeOverBlock(fast, unknown, 200000));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -5,6 +5,7 @@
 #include "blockencodings.h"
 #include "consensus/merkle.h"
 #include "chainparams.h"
+#include "net.h"
 #include "random.h"
 
 #include "test/test_novo.h"
@@ -314,6 +315,172 @@ BOOST_AUTO_TEST_CASE(EmptyBlockRoundTripTest)
     }
 }
 
+static CBlock BuildGrapheneTestCase(size_t nTx) {
+    CBlock block;
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig.resize(10);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 42;
+
+    block.vtx.resize(nTx);
+    block.vtx[0] = MakeTransactionRef(tx);
+    block.nVersion = 42;
+    block.hashPrevBlock = GetRandHash();
+    block.nBits = 0x207fffff;
+
+    for (size_t i = 1; i < nTx; i++) {
+        tx.vin[0].prevout.hash = GetRandHash();
+        tx.vin[0].prevout.n = 0;
+        block.vtx[i] = MakeTransactionRef(tx);
+    }
+
+    bool mutated;
+    block.hashMerkleRoot = BlockMerkleRoot(block, &mutated);
+    assert(!mutated);
+    while (!CheckProofOfWork(block.GetHash(), block.nBits, Params().GetConsensus())) ++block.nNonce;
+    return block;
+}
+
+// Decoding fails with small probability whatever the sizing, which the
+// sender's retransmission would overcome. Send the block over up to three
+// times, each with a new nonce, to keep the tests deterministic.
+static ReadStatus InitGrapheneData(PartiallyDownloadedBlock& partialBlock, CTxMemPool& pool, const CBlock& block) {
+    ReadStatus status = READ_STATUS_FAILED;
+    for (int i = 0; i < 3 && status == READ_STATUS_FAILED; i++) {
+        CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+        stream << CGrapheneBlock(block, pool.size());
+        CGrapheneBlock grapheneblock;
+        stream >> grapheneblock;
+        partialBlock = PartiallyDownloadedBlock(&pool);
+        status = partialBlock.InitData(grapheneblock, extra_txn);
+    }
+    return status;
+}
+
+BOOST_AUTO_TEST_CASE(GrapheneRoundTripTest)
+{
+    CTxMemPool pool(CFeeRate(0));
+    TestMemPoolEntryHelper entry;
+    CBlock block(BuildGrapheneTestCase(1000));
+
+    // We have all but 10 of the block's transactions, and many others
+    for (size_t i = 11; i < block.vtx.size(); i++)
+        pool.addUnchecked(block.vtx[i]->GetHash(), entry.FromTx(*block.vtx[i]));
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 7;
+    for (int i = 0; i < 3000; i++) {
+        tx.vin[0].prevout.hash = GetRandHash();
+        pool.addUnchecked(tx.GetHash(), entry.FromTx(tx));
+    }
+
+    CGrapheneBlock grapheneblock(block, pool.size());
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << grapheneblock;
+    BOOST_CHECK(stream.size() < GetSerializeSize(CBlockHeaderAndShortTxIDs(block), SER_NETWORK, PROTOCOL_VERSION));
+
+    CGrapheneBlock grapheneblock2;
+    stream >> grapheneblock2;
+    BOOST_CHECK_EQUAL(grapheneblock2.BlockTxCount(), block.vtx.size());
+
+    PartiallyDownloadedBlock partialBlock(&pool);
+    BOOST_REQUIRE(InitGrapheneData(partialBlock, pool, block) == READ_STATUS_OK);
+    std::vector<CTransactionRef> vtx_missing;
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        BOOST_CHECK_EQUAL(partialBlock.IsTxAvailable(i), i == 0 || i > 10);
+        if (!partialBlock.IsTxAvailable(i))
+            vtx_missing.push_back(block.vtx[i]);
+    }
+
+    CBlock block2;
+    BOOST_CHECK(partialBlock.FillBlock(block2, vtx_missing) == READ_STATUS_OK);
+    BOOST_CHECK_EQUAL(block.GetHash().ToString(), block2.GetHash().ToString());
+    bool mutated;
+    BOOST_CHECK_EQUAL(block.hashMerkleRoot.ToString(), BlockMerkleRoot(block2, &mutated).ToString());
+    BOOST_CHECK(!mutated);
+
+    // Lacking far more transactions than the IBLT was sized for fails,
+    // leaving the block to be fetched some other way
+    CTxMemPool pool2(CFeeRate(0));
+    for (size_t i = 500; i < block.vtx.size(); i++)
+        pool2.addUnchecked(block.vtx[i]->GetHash(), entry.FromTx(*block.vtx[i]));
+    PartiallyDownloadedBlock partialBlock2(&pool2);
+    BOOST_CHECK(partialBlock2.InitData(CGrapheneBlock(block, pool2.size()), extra_txn) == READ_STATUS_FAILED);
+}
+
+BOOST_AUTO_TEST_CASE(GrapheneSmallBlockTest)
+{
+    // Small blocks whose transactions are all the receiver has, with and
+    // without other transactions in its mempool
+    TestMemPoolEntryHelper entry;
+    for (size_t nTx : {2, 3, 5, 16, 40}) {
+        for (int nOther : {0, 100}) {
+            CTxMemPool pool(CFeeRate(0));
+            CBlock block(BuildGrapheneTestCase(nTx));
+            for (size_t i = 1; i < block.vtx.size(); i++)
+                pool.addUnchecked(block.vtx[i]->GetHash(), entry.FromTx(*block.vtx[i]));
+            CMutableTransaction tx;
+            tx.vin.resize(1);
+            tx.vout.resize(1);
+            tx.vout[0].nValue = 7;
+            for (int i = 0; i < nOther; i++) {
+                tx.vin[0].prevout.hash = GetRandHash();
+                pool.addUnchecked(tx.GetHash(), entry.FromTx(tx));
+            }
+
+            PartiallyDownloadedBlock partialBlock(&pool);
+            BOOST_REQUIRE(InitGrapheneData(partialBlock, pool, block) == READ_STATUS_OK);
+            CBlock block2;
+            std::vector<CTransactionRef> vtx_missing;
+            BOOST_CHECK(partialBlock.FillBlock(block2, vtx_missing) == READ_STATUS_OK);
+            BOOST_CHECK_EQUAL(block.GetHash().ToString(), block2.GetHash().ToString());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(GrapheneEmptyBlockRoundTripTest)
+{
+    CTxMemPool pool(CFeeRate(0));
+    CBlock block(BuildGrapheneTestCase(1));
+
+    CGrapheneBlock grapheneblock(block, 0);
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << grapheneblock;
+    CGrapheneBlock grapheneblock2;
+    stream >> grapheneblock2;
+
+    PartiallyDownloadedBlock partialBlock(&pool);
+    BOOST_CHECK(partialBlock.InitData(grapheneblock2, extra_txn) == READ_STATUS_OK);
+    BOOST_CHECK(partialBlock.IsTxAvailable(0));
+
+    CBlock block2;
+    std::vector<CTransactionRef> vtx_missing;
+    BOOST_CHECK(partialBlock.FillBlock(block2, vtx_missing) == READ_STATUS_OK);
+    BOOST_CHECK_EQUAL(block.GetHash().ToString(), block2.GetHash().ToString());
+}
+
+BOOST_AUTO_TEST_CASE(GrapheneHostilePoolSizeTest)
+{
+    // A peer claiming an absurd mempool gets a block sized for the largest
+    // mempool we expect, which still fits in a message
+    CBlock block(BuildGrapheneTestCase(20000));
+    BOOST_CHECK(CGrapheneBlock::IsEncodable(block.vtx.size(), std::numeric_limits<uint64_t>::max()));
+    CGrapheneBlock grapheneblock(block, std::numeric_limits<uint64_t>::max());
+    unsigned int nSize = GetSerializeSize(grapheneblock, SER_NETWORK, PROTOCOL_VERSION);
+    BOOST_CHECK(nSize <= MAX_PROTOCOL_MESSAGE_LENGTH);
+    BOOST_CHECK_EQUAL(nSize, GetSerializeSize(CGrapheneBlock(block, MAX_GRAPHENE_RECEIVER_POOL_TX), SER_NETWORK, PROTOCOL_VERSION));
+
+    // Blocks too large to encode for such a mempool are sent some other way,
+    // and encoding them anyway stays within bounds
+    BOOST_CHECK(!CGrapheneBlock::IsEncodable(70000, std::numeric_limits<uint64_t>::max()));
+    BOOST_CHECK(CGrapheneBlock::IsEncodable(70000, 70000));
+    CBlock largeBlock(BuildGrapheneTestCase(70000));
+    CGrapheneBlock largeGrapheneBlock(largeBlock, std::numeric_limits<uint64_t>::max());
+    BOOST_CHECK(GetSerializeSize(largeGrapheneBlock, SER_NETWORK, PROTOCOL_VERSION) <= MAX_PROTOCOL_MESSAGE_LENGTH);
+}
+
 BOOST_AUTO_TEST_CASE(TransactionsRequestSerializationTest) {
     BlockTransactionsRequest req1;
     req1.blockhash = GetRandHash();
@@ -0,0 +1,78 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilecache.h"
+#include "chain.h"
+#include "validation.h"
+
+#include "test/test_novo.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockfilecache_tests, TestingSetup)
+
+// Block file 0 holds the genesis block, so the tests use files from 1 up
+static void WriteTestFile(int nFile)
+{
+    FILE* file = OpenBlockFile(CDiskBlockPos(nFile, 0));
+    BOOST_REQUIRE(file);
+    for (int i = 0; i < 16; i++)
+        fputc(nFile * 16 + i, file);
+    fclose(file);
+}
+
+static int ReadByte(CBlockFileCache& cache, int nFile, unsigned int nPos)
+{
+    FILE* file = cache.Acquire(CDiskBlockPos(nFile, nPos));
+    BOOST_REQUIRE(file);
+    int c = fgetc(file);
+    cache.Release(nFile, file);
+    return c;
+}
+
+BOOST_AUTO_TEST_CASE(blockfilecache_reads)
+{
+    for (int nFile = 1; nFile <= 3; nFile++)
+        WriteTestFile(nFile);
+
+    CBlockFileCache cache(2);
+    BOOST_CHECK_EQUAL(cache.GetIdleCount(), 0U);
+
+    // Reused descriptors are repositioned on every acquire
+    BOOST_CHECK_EQUAL(ReadByte(cache, 1, 5), 16 + 5);
+    BOOST_CHECK_EQUAL(ReadByte(cache, 1, 2), 16 + 2);
+    BOOST_CHECK_EQUAL(cache.GetIdleCount(), 1U);
+
+    // Concurrent users of one file get separate descriptors
+    FILE* file1 = cache.Acquire(CDiskBlockPos(1, 1));
+    FILE* file2 = cache.Acquire(CDiskBlockPos(1, 3));
+    BOOST_REQUIRE(file1 && file2);
+    BOOST_CHECK(file1 != file2);
+    BOOST_CHECK_EQUAL(fgetc(file2), 16 + 3);
+    BOOST_CHECK_EQUAL(fgetc(file1), 16 + 1);
+    cache.Release(1, file1);
+    cache.Release(1, file2);
+    BOOST_CHECK_EQUAL(cache.GetIdleCount(), 2U);
+
+    // Data written after a descriptor was cached is seen by the next reader
+    FILE* fileWrite = OpenBlockFile(CDiskBlockPos(1, 6));
+    BOOST_REQUIRE(fileWrite);
+    fputc(0xff, fileWrite);
+    fclose(fileWrite);
+    BOOST_CHECK_EQUAL(ReadByte(cache, 1, 6), 0xff);
+
+    // Idle descriptors beyond the limit are closed
+    BOOST_CHECK_EQUAL(ReadByte(cache, 2, 0), 32);
+    BOOST_CHECK_EQUAL(ReadByte(cache, 3, 15), 48 + 15);
+    BOOST_CHECK_EQUAL(cache.GetIdleCount(), 2U);
+
+    // Missing files are reported, not cached
+    BOOST_CHECK(cache.Acquire(CDiskBlockPos(99, 0)) == NULL);
+    BOOST_CHECK(cache.Acquire(CDiskBlockPos()) == NULL);
+
+    cache.Clear();
+    BOOST_CHECK_EQUAL(cache.GetIdleCount(), 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
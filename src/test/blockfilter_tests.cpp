@@ -0,0 +1,152 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilter.h"
+#include "hash.h"
+#include "random.h"
+#include "script/standard.h"
+#include "streams.h"
+
+#include "test/test_novo.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockfilter_tests, BasicTestingSetup)
+
+static GCSFilter::Element RandomElement()
+{
+    uint256 hash = GetRandHash();
+    return GCSFilter::Element(hash.begin(), hash.end());
+}
+
+BOOST_AUTO_TEST_CASE(gcsfilter_test)
+{
+    GCSFilter::ElementSet included_elements, excluded_elements;
+    for (int i = 0; i < 100; ++i) {
+        included_elements.insert(RandomElement());
+        excluded_elements.insert(RandomElement());
+    }
+
+    GCSFilter filter(0, 0, 10, 1 << 10, included_elements);
+    for (const auto& element : included_elements) {
+        BOOST_CHECK(filter.Match(element));
+
+        auto insertion = excluded_elements.insert(element);
+        BOOST_CHECK(filter.MatchAny(excluded_elements));
+        excluded_elements.erase(insertion.first);
+    }
+
+    // Decoding the encoded filter gives back the same filter
+    GCSFilter decoded(0, 0, 10, 1 << 10, filter.GetEncoded());
+    BOOST_CHECK_EQUAL(decoded.GetN(), filter.GetN());
+    for (const auto& element : included_elements)
+        BOOST_CHECK(decoded.Match(element));
+
+    // Truncated or padded encodings are rejected
+    std::vector<unsigned char> encoded = filter.GetEncoded();
+    encoded.pop_back();
+    BOOST_CHECK_THROW(GCSFilter(0, 0, 10, 1 << 10, encoded), std::ios_base::failure);
+    encoded = filter.GetEncoded();
+    encoded.push_back(0);
+    BOOST_CHECK_THROW(GCSFilter(0, 0, 10, 1 << 10, encoded), std::ios_base::failure);
+}
+
+BOOST_AUTO_TEST_CASE(gcsfilter_default_constructor)
+{
+    GCSFilter filter;
+    BOOST_CHECK_EQUAL(filter.GetN(), 0U);
+    BOOST_CHECK_EQUAL(filter.GetEncoded().size(), 1U);
+    BOOST_CHECK(!filter.Match(RandomElement()));
+
+    // An empty set encodes to just the element count
+    GCSFilter empty(0, 0, BASIC_FILTER_P, BASIC_FILTER_M, GCSFilter::ElementSet());
+    BOOST_CHECK(empty.GetEncoded() == std::vector<unsigned char>(1, 0));
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_basic_test)
+{
+    CScript included_scripts[5], excluded_scripts[2];
+
+    // First two are outputs on a single transaction.
+    included_scripts[0] << std::vector<unsigned char>(0, 65) << OP_CHECKSIG;
+    included_scripts[1] << OP_DUP << OP_HASH160 << std::vector<unsigned char>(1, 20) << OP_EQUALVERIFY << OP_CHECKSIG;
+
+    // Third is an output of a second transaction.
+    included_scripts[2] << OP_1 << std::vector<unsigned char>(2, 33) << OP_1 << OP_CHECKMULTISIG;
+
+    // Last two are spent by a single transaction.
+    included_scripts[3] << OP_0 << std::vector<unsigned char>(3, 32);
+    included_scripts[4] << OP_4 << OP_ADD << OP_8 << OP_EQUAL;
+
+    // OP_RETURN output is excluded.
+    excluded_scripts[0] << OP_RETURN << std::vector<unsigned char>(4, 40);
+
+    // This script is not related to the block at all.
+    excluded_scripts[1] << std::vector<unsigned char>(5, 33) << OP_CHECKSIG;
+
+    CMutableTransaction tx_1;
+    tx_1.vout.emplace_back(100, included_scripts[0]);
+    tx_1.vout.emplace_back(200, included_scripts[1]);
+
+    CMutableTransaction tx_2;
+    tx_2.vout.emplace_back(300, included_scripts[2]);
+    tx_2.vout.emplace_back(0, excluded_scripts[0]);
+    tx_2.vout.emplace_back(400, CScript()); // Empty scripts are skipped
+
+    CBlock block;
+    block.vtx.push_back(MakeTransactionRef(tx_1));
+    block.vtx.push_back(MakeTransactionRef(tx_2));
+
+    CBlockUndo block_undo;
+    block_undo.vtxundo.emplace_back();
+    block_undo.vtxundo.back().vprevout.emplace_back(CTxOut(500, included_scripts[3]), false, 1000);
+    block_undo.vtxundo.back().vprevout.emplace_back(CTxOut(600, included_scripts[4]), false, 10000);
+    block_undo.vtxundo.back().vprevout.emplace_back(CTxOut(700, CScript()), false, 100000);
+
+    BlockFilter block_filter(BLOCK_FILTER_BASIC, block, block_undo);
+    const GCSFilter& filter = block_filter.GetFilter();
+
+    BOOST_CHECK_EQUAL(filter.GetN(), 5U);
+    for (const CScript& script : included_scripts)
+        BOOST_CHECK(filter.Match(GCSFilter::Element(script.begin(), script.end())));
+    for (const CScript& script : excluded_scripts)
+        BOOST_CHECK(!filter.Match(GCSFilter::Element(script.begin(), script.end())));
+
+    // Test serialization/unserialization.
+    BlockFilter block_filter2;
+
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << block_filter;
+    stream >> block_filter2;
+
+    BOOST_CHECK(block_filter.GetFilterType() == block_filter2.GetFilterType());
+    BOOST_CHECK(block_filter.GetBlockHash() == block_filter2.GetBlockHash());
+    BOOST_CHECK(block_filter.GetEncodedFilter() == block_filter2.GetEncodedFilter());
+    BOOST_CHECK(block_filter.GetHash() == block_filter2.GetHash());
+
+    // The header commits to both the filter and the previous header
+    uint256 prev_header = GetRandHash();
+    uint256 filter_hash = block_filter.GetHash();
+    BOOST_CHECK(block_filter.ComputeHeader(prev_header) ==
+                Hash(filter_hash.begin(), filter_hash.end(), prev_header.begin(), prev_header.end()));
+    BOOST_CHECK(block_filter.ComputeHeader(prev_header) != block_filter.ComputeHeader(uint256()));
+
+    // Filters are keyed by the block hash, so the same elements hash differently in another block
+    block.nNonce++;
+    BlockFilter block_filter3(BLOCK_FILTER_BASIC, block, block_undo);
+    BOOST_CHECK(block_filter3.GetEncodedFilter() != block_filter.GetEncodedFilter());
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_type_names)
+{
+    BOOST_CHECK_EQUAL(BlockFilterTypeName(BLOCK_FILTER_BASIC), "basic");
+    BOOST_CHECK_EQUAL(BlockFilterTypeName(static_cast<BlockFilterType>(1)), "");
+
+    BlockFilterType filter_type;
+    BOOST_CHECK(BlockFilterTypeByName("basic", filter_type));
+    BOOST_CHECK(filter_type == BLOCK_FILTER_BASIC);
+    BOOST_CHECK(!BlockFilterTypeByName("unknown", filter_type));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
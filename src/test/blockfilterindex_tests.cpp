@@ -0,0 +1,103 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilter.h"
+#include "chainparams.h"
+#include "index/blockfilterindex.h"
+#include "undo.h"
+#include "utiltime.h"
+#include "validation.h"
+#include "validationinterface.h"
+
+#include "test/test_novo.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(blockfilterindex_tests)
+
+/** Check the indexed filter of pindex against one built from the block files */
+static void CheckFilterLookups(CBlockFilterIndex& filterindex, const CBlockIndex* pindex, uint256& last_header)
+{
+    CBlock block;
+    BOOST_REQUIRE(ReadBlockFromDisk(block, pindex, Params().GetConsensus()));
+    CBlockUndo blockundo;
+    if (pindex->nHeight > 0)
+        BOOST_REQUIRE(UndoReadFromDisk(blockundo, pindex->GetUndoPos(), pindex->pprev->GetBlockHash()));
+    BlockFilter expected_filter(BLOCK_FILTER_BASIC, block, blockundo);
+
+    BlockFilter filter;
+    uint256 filter_header;
+    std::vector<BlockFilter> filters;
+    std::vector<uint256> filter_hashes;
+
+    BOOST_CHECK(filterindex.LookupFilter(pindex, filter));
+    BOOST_CHECK(filterindex.LookupFilterHeader(pindex, filter_header));
+    BOOST_CHECK(filterindex.LookupFilterRange(pindex->nHeight, pindex, filters));
+    BOOST_CHECK(filterindex.LookupFilterHashRange(pindex->nHeight, pindex, filter_hashes));
+
+    BOOST_CHECK_EQUAL(filters.size(), 1U);
+    BOOST_CHECK_EQUAL(filter_hashes.size(), 1U);
+
+    BOOST_CHECK(filter.GetHash() == expected_filter.GetHash());
+    BOOST_CHECK(filter_header == expected_filter.ComputeHeader(last_header));
+    BOOST_CHECK(filters[0].GetHash() == expected_filter.GetHash());
+    BOOST_CHECK(filter_hashes[0] == expected_filter.GetHash());
+
+    last_header = filter_header;
+}
+
+BOOST_FIXTURE_TEST_CASE(blockfilterindex_initial_sync, TestChain240Setup)
+{
+    CBlockFilterIndex filterindex(BLOCK_FILTER_BASIC, 1 << 20, true);
+
+    const CBlockIndex* tip = chainActive.Tip();
+    BlockFilter filter;
+    uint256 filter_header;
+
+    // Nothing is found before the index is started
+    BOOST_CHECK(!filterindex.LookupFilter(tip, filter));
+    BOOST_CHECK(!filterindex.LookupFilterHeader(tip, filter_header));
+
+    BOOST_REQUIRE(filterindex.Start());
+
+    // Wait for the background sync to reach the tip
+    int64_t nTimeStart = GetTimeMillis();
+    while (!filterindex.IsSynced()) {
+        BOOST_REQUIRE(nTimeStart + 10000 > GetTimeMillis());
+        MilliSleep(100);
+    }
+    BOOST_CHECK(filterindex.GetBestBlockIndex() == chainActive.Tip());
+
+    // The filter headers form a chain from the genesis block
+    uint256 last_header;
+    for (const CBlockIndex* pindex = chainActive.Genesis(); pindex; pindex = chainActive.Next(pindex))
+        CheckFilterLookups(filterindex, pindex, last_header);
+
+    // Ranges are returned in height order
+    std::vector<uint256> filter_hashes;
+    BOOST_CHECK(filterindex.LookupFilterHashRange(0, tip, filter_hashes));
+    BOOST_CHECK_EQUAL(filter_hashes.size(), (size_t)tip->nHeight + 1);
+    BOOST_CHECK(filterindex.LookupFilter(tip, filter));
+    BOOST_CHECK(filter_hashes.back() == filter.GetHash());
+    BOOST_CHECK(!filterindex.LookupFilterHashRange(tip->nHeight + 1, tip, filter_hashes));
+
+    // Blocks connected after the sync are indexed through validation callbacks
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    for (int i = 0; i < 5; i++) {
+        CreateAndProcessBlock(std::vector<CMutableTransaction>(), scriptPubKey);
+        SyncWithValidationInterfaceQueue();
+        BOOST_CHECK(filterindex.GetBestBlockIndex() == chainActive.Tip());
+        CheckFilterLookups(filterindex, chainActive.Tip(), last_header);
+    }
+
+    // The coinbase script matches every filter
+    GCSFilter::Element element(scriptPubKey.begin(), scriptPubKey.end());
+    BOOST_CHECK(filterindex.LookupFilter(chainActive.Tip(), filter));
+    BOOST_CHECK(filter.GetFilter().Match(element));
+
+    filterindex.Stop();
+    StopValidationInterfaceQueue();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
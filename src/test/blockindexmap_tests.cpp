@@ -0,0 +1,84 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockindexmap.h"
+#include "arith_uint256.h"
+
+#include "test/test_novo.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockindexmap_tests, BasicTestingSetup)
+
+static uint256 HashFromInt(uint32_t n)
+{
+    return ArithToUint256(arith_uint256(n) * arith_uint256(2654435761U));
+}
+
+BOOST_AUTO_TEST_CASE(blockindexmap_insert_find)
+{
+    CBlockIndexMap map;
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK(map.find(HashFromInt(1)) == map.end());
+    BOOST_CHECK(map[HashFromInt(1)] == NULL);
+    // Lookups never insert
+    BOOST_CHECK_EQUAL(map.size(), 0U);
+
+    // Enough entries to span several chunks and grow the table repeatedly
+    const uint32_t nEntries = 3 * CBlockIndexMap::CHUNK_SIZE + 17;
+    std::vector<CBlockIndex*> vIndexes;
+    for (uint32_t i = 0; i < nEntries; i++) {
+        CBlockHeader header;
+        header.nNonce = i;
+        std::pair<CBlockIndexMap::iterator, bool> ret = map.emplace(HashFromInt(i), header);
+        BOOST_CHECK(ret.second);
+        BOOST_CHECK(ret.first->first == HashFromInt(i));
+        CBlockIndex* pindex = ret.first->second;
+        BOOST_CHECK(pindex->GetBlockHash() == HashFromInt(i));
+        BOOST_CHECK_EQUAL(pindex->nNonce, i);
+        pindex->pprev = vIndexes.empty() ? NULL : vIndexes.back();
+        vIndexes.push_back(pindex);
+    }
+    BOOST_CHECK_EQUAL(map.size(), nEntries);
+
+    // Reserving grows the table without disturbing lookups
+    map.reserve(4 * nEntries);
+    BOOST_CHECK_EQUAL(map.size(), nEntries);
+
+    // Entries do not move as the map grows
+    for (uint32_t i = 0; i < nEntries; i++) {
+        BOOST_CHECK_EQUAL(map.count(HashFromInt(i)), 1U);
+        BOOST_CHECK(map[HashFromInt(i)] == vIndexes[i]);
+        BOOST_CHECK(map.find(HashFromInt(i))->second == vIndexes[i]);
+        BOOST_CHECK(map.GetById(i) == vIndexes[i]);
+        BOOST_CHECK(vIndexes[i]->phashBlock == &map.find(HashFromInt(i))->first);
+    }
+    BOOST_CHECK(map.find(HashFromInt(nEntries)) == map.end());
+
+    // Emplacing an existing hash returns the existing entry untouched
+    std::pair<CBlockIndexMap::iterator, bool> ret = map.emplace(HashFromInt(5));
+    BOOST_CHECK(!ret.second);
+    BOOST_CHECK(ret.first->second == vIndexes[5]);
+    BOOST_CHECK_EQUAL(ret.first->second->nNonce, 5U);
+    BOOST_CHECK_EQUAL(map.size(), nEntries);
+
+    // Iteration visits every entry once, in insertion order
+    uint32_t n = 0;
+    for (const CBlockIndexMap::value_type& item : map) {
+        BOOST_CHECK(item.second == vIndexes[n]);
+        n++;
+    }
+    BOOST_CHECK_EQUAL(n, nEntries);
+    const CBlockIndexMap& mapConst = map;
+    BOOST_CHECK(mapConst.find(HashFromInt(7)) != mapConst.end());
+    BOOST_CHECK_EQUAL(std::distance(mapConst.begin(), mapConst.end()), nEntries);
+
+    map.clear();
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK(map.find(HashFromInt(1)) == map.end());
+    BOOST_CHECK(map.emplace(HashFromInt(1)).second);
+    BOOST_CHECK_EQUAL(map.size(), 1U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
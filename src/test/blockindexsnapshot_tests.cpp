@@ -0,0 +1,143 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockindexsnapshot.h"
+#include "arith_uint256.h"
+
+#include "test/test_novo.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+struct BlockIndexSnapshotSetup : public BasicTestingSetup {
+    boost::filesystem::path path;
+
+    BlockIndexSnapshotSetup()
+    {
+        boost::filesystem::path dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+        boost::filesystem::create_directories(dir);
+        path = dir / "index.snapshot";
+    }
+    ~BlockIndexSnapshotSetup()
+    {
+        boost::filesystem::remove_all(path.parent_path());
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(blockindexsnapshot_tests, BlockIndexSnapshotSetup)
+
+static uint256 HashFromInt(uint32_t n)
+{
+    return ArithToUint256(arith_uint256(n) * arith_uint256(2654435761U) + 1);
+}
+
+/** Build a chain of nLength blocks with a fork of nFork blocks off height nLength / 2 */
+static void BuildTree(CBlockIndexMap& map, int nLength, int nFork)
+{
+    std::vector<CBlockIndex*> vChain;
+    uint32_t n = 0;
+    for (int i = 0; i < nLength + nFork; i++) {
+        CBlockIndex* pprev = NULL;
+        if (i < nLength)
+            pprev = vChain.empty() ? NULL : vChain.back();
+        else
+            pprev = i == nLength ? vChain[nLength / 2] : map[HashFromInt(n - 1)];
+        CBlockHeader header;
+        header.nNonce = n;
+        header.nTime = 1000 + n;
+        header.nBits = 0x207fffff;
+        CBlockIndex* pindex = map.emplace(HashFromInt(n++), header).first->second;
+        pindex->pprev = pprev;
+        pindex->nHeight = pprev ? pprev->nHeight + 1 : 0;
+        pindex->nChainWork = (pprev ? pprev->nChainWork : 0) + GetBlockProof(*pindex);
+        pindex->nTimeMax = pprev ? std::max(pprev->nTimeMax, pindex->nTime) : pindex->nTime;
+        pindex->nTx = 1 + n % 3;
+        pindex->nChainTx = (pprev ? pprev->nChainTx : 0) + pindex->nTx;
+        pindex->nStatus = BLOCK_VALID_SCRIPTS | BLOCK_HAVE_DATA;
+        pindex->nFile = n / 100;
+        pindex->nDataPos = n * 1000;
+        pindex->BuildSkip();
+        if (i < nLength)
+            vChain.push_back(pindex);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(blockindexsnapshot_roundtrip)
+{
+    CBlockIndexMap map;
+    BuildTree(map, 500, 20);
+    const uint256 hashBest = HashFromInt(499);
+    BOOST_CHECK(WriteBlockIndexSnapshot(path, map, hashBest));
+
+    CBlockIndexMap mapLoaded;
+    std::vector<CBlockIndex*> vSorted;
+    BOOST_CHECK(ReadBlockIndexSnapshot(path, mapLoaded, hashBest, vSorted));
+    BOOST_CHECK_EQUAL(mapLoaded.size(), map.size());
+    BOOST_CHECK_EQUAL(vSorted.size(), map.size());
+    for (size_t i = 1; i < vSorted.size(); i++)
+        BOOST_CHECK(vSorted[i - 1]->nHeight <= vSorted[i]->nHeight);
+
+    for (const CBlockIndexMap::value_type& item : map) {
+        const CBlockIndex* pindex = item.second;
+        const CBlockIndex* pindexLoaded = mapLoaded[item.first];
+        BOOST_REQUIRE(pindexLoaded != NULL);
+        BOOST_CHECK(pindexLoaded->GetBlockHash() == pindex->GetBlockHash());
+        BOOST_CHECK(pindexLoaded->GetBlockHeader().GetHash() == pindex->GetBlockHeader().GetHash());
+        BOOST_CHECK_EQUAL(pindexLoaded->nHeight, pindex->nHeight);
+        BOOST_CHECK(pindexLoaded->nChainWork == pindex->nChainWork);
+        BOOST_CHECK_EQUAL(pindexLoaded->nTimeMax, pindex->nTimeMax);
+        BOOST_CHECK_EQUAL(pindexLoaded->nTx, pindex->nTx);
+        BOOST_CHECK_EQUAL(pindexLoaded->nChainTx, pindex->nChainTx);
+        BOOST_CHECK_EQUAL(pindexLoaded->nStatus, pindex->nStatus);
+        BOOST_CHECK_EQUAL(pindexLoaded->nFile, pindex->nFile);
+        BOOST_CHECK_EQUAL(pindexLoaded->nDataPos, pindex->nDataPos);
+        // Links point into the loaded map
+        BOOST_CHECK(pindexLoaded->pprev == (pindex->pprev ? mapLoaded[pindex->pprev->GetBlockHash()] : NULL));
+        BOOST_CHECK(pindexLoaded->pskip == (pindex->pskip ? mapLoaded[pindex->pskip->GetBlockHash()] : NULL));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(blockindexsnapshot_rejects)
+{
+    CBlockIndexMap map;
+    BuildTree(map, 100, 5);
+    const uint256 hashBest = HashFromInt(99);
+    CBlockIndexMap mapLoaded;
+    std::vector<CBlockIndex*> vSorted;
+
+    // Missing file
+    BOOST_CHECK(!ReadBlockIndexSnapshot(path, mapLoaded, hashBest, vSorted));
+
+    // Written for another chainstate
+    BOOST_CHECK(WriteBlockIndexSnapshot(path, map, hashBest));
+    BOOST_CHECK(!ReadBlockIndexSnapshot(path, mapLoaded, HashFromInt(98), vSorted));
+    BOOST_CHECK(mapLoaded.empty());
+
+    // A flipped byte in a record fails the checksum
+    {
+        FILE* file = fopen(path.string().c_str(), "r+b");
+        BOOST_REQUIRE(file);
+        fseek(file, 1000, SEEK_SET);
+        int c = fgetc(file);
+        fseek(file, 1000, SEEK_SET);
+        fputc(c ^ 1, file);
+        fclose(file);
+    }
+    BOOST_CHECK(!ReadBlockIndexSnapshot(path, mapLoaded, hashBest, vSorted));
+    BOOST_CHECK(mapLoaded.empty());
+    BOOST_CHECK(vSorted.empty());
+
+    // Truncated file
+    BOOST_CHECK(WriteBlockIndexSnapshot(path, map, hashBest));
+    boost::filesystem::resize_file(path, boost::filesystem::file_size(path) - 1);
+    BOOST_CHECK(!ReadBlockIndexSnapshot(path, mapLoaded, hashBest, vSorted));
+    BOOST_CHECK(mapLoaded.empty());
+
+    // A fresh snapshot loads again
+    BOOST_CHECK(WriteBlockIndexSnapshot(path, map, hashBest));
+    BOOST_CHECK(ReadBlockIndexSnapshot(path, mapLoaded, hashBest, vSorted));
+    BOOST_CHECK_EQUAL(mapLoaded.size(), map.size());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -45,6 +45,24 @@ BOOST_AUTO_TEST_CASE(murmurhash3)
 #undef T
 }
 
+BOOST_AUTO_TEST_CASE(murmurhash3_multi)
+{
+    // All lengths around the block size and every number of seeds up to a few
+    // full batches must give the same results as one MurmurHash3 per seed.
+    std::vector<unsigned char> vData;
+    for (unsigned int nLen = 0; nLen < 80; nLen++) {
+        std::vector<uint32_t> vSeeds, vHashes(27);
+        for (unsigned int i = 0; i < vHashes.size(); i++)
+            vSeeds.push_back(i * 0xFBA4C795 + nLen);
+        for (unsigned int nHashes = 0; nHashes <= vSeeds.size(); nHashes++) {
+            MurmurHash3Multi(vSeeds.data(), nHashes, vData.data(), vData.size(), vHashes.data());
+            for (unsigned int i = 0; i < nHashes; i++)
+                BOOST_CHECK_EQUAL(vHashes[i], MurmurHash3(vSeeds[i], vData));
+        }
+        vData.push_back(nLen * 37 + 11);
+    }
+}
+
 /*
    SipHash-2-4 output with
    k = 00 01 02 ...
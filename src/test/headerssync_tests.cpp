@@ -0,0 +1,245 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "headerssync.h"
+#include "chain.h"
+#include "consensus/validation.h"
+#include "pow.h"
+#include "validation.h"
+
+#include "test/test_novo.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(headerssync_tests, BasicTestingSetup)
+
+/** A chain of nLength headers after genesis, with vHashes[i] the hash of vHeaders[i] at height i */
+static void BuildChain(int nLength, std::vector<CBlockHeader>& vHeaders, std::vector<uint256>& vHashes, uint32_t nNonce = 0)
+{
+    vHeaders.resize(nLength + 1);
+    vHashes.resize(nLength + 1);
+    for (int i = 0; i <= nLength; i++) {
+        vHeaders[i].nVersion = 1;
+        vHeaders[i].hashPrevBlock = i ? vHashes[i - 1] : uint256();
+        vHeaders[i].nTime = 1000 + i;
+        vHeaders[i].nNonce = nNonce;
+        vHashes[i] = vHeaders[i].GetHash();
+    }
+}
+
+template <typename T>
+static std::vector<T> Slice(const std::vector<T>& v, int nBegin, int nEnd)
+{
+    return std::vector<T>(v.begin() + nBegin, v.begin() + nEnd);
+}
+
+BOOST_AUTO_TEST_CASE(headerssync_ranges)
+{
+    std::vector<CBlockHeader> vHeaders;
+    std::vector<uint256> vHashes;
+    BuildChain(60, vHeaders, vHashes);
+    MapCheckpoints checkpoints;
+    checkpoints[0] = vHashes[0];
+    checkpoints[20] = vHashes[20];
+    checkpoints[50] = vHashes[50];
+    CCheckpointHeadersSync sync(checkpoints);
+
+    uint256 hashLocator, hashStop;
+    // Nothing above the best header, or too high for the peer
+    BOOST_CHECK(!sync.AssignRange(1, 20, 1000, 0, hashLocator, hashStop));
+    BOOST_CHECK(!sync.AssignRange(1, 5, 40, 0, hashLocator, hashStop));
+    // The range 20..50, as the headers sync peer downloads 0..20
+    BOOST_CHECK(sync.AssignRange(1, 5, 1000, 0, hashLocator, hashStop));
+    BOOST_CHECK(hashLocator == vHashes[20]);
+    BOOST_CHECK(hashStop == vHashes[50]);
+    BOOST_CHECK(sync.HasRange(1));
+    BOOST_CHECK_EQUAL(sync.CountAssigned(), 1);
+    BOOST_CHECK(!sync.AssignRange(1, 5, 1000, 0, hashLocator, hashStop));
+    BOOST_CHECK(!sync.AssignRange(2, 5, 1000, 0, hashLocator, hashStop));
+
+    BOOST_CHECK(sync.IsRangeResponse(1, vHashes[20]));
+    BOOST_CHECK(!sync.IsRangeResponse(1, vHashes[19]));
+    BOOST_CHECK(!sync.IsRangeResponse(2, vHashes[20]));
+    BOOST_CHECK(!sync.IsStalling(1, HEADERS_RANGE_TIMEOUT));
+    BOOST_CHECK(sync.IsStalling(1, HEADERS_RANGE_TIMEOUT + 1));
+
+    // Headers that do not continue the range
+    BOOST_CHECK_EQUAL(sync.ReceiveHeaders(1, Slice(vHeaders, 22, 30), Slice(vHashes, 22, 30), 10, hashLocator, hashStop), CCheckpointHeadersSync::NOT_RANGE);
+    BOOST_CHECK_EQUAL(sync.ReceiveHeaders(2, Slice(vHeaders, 21, 30), Slice(vHashes, 21, 30), 10, hashLocator, hashStop), CCheckpointHeadersSync::NOT_RANGE);
+
+    BOOST_CHECK_EQUAL(sync.ReceiveHeaders(1, Slice(vHeaders, 21, 30), Slice(vHashes, 21, 30), 10, hashLocator, hashStop), CCheckpointHeadersSync::PARTIAL);
+    BOOST_CHECK(hashLocator == vHashes[29]);
+    BOOST_CHECK(hashStop == vHashes[50]);
+    BOOST_CHECK(sync.IsRangeResponse(1, vHashes[29]));
+    BOOST_CHECK(!sync.IsStalling(1, HEADERS_RANGE_TIMEOUT + 1));
+
+    // Not connectable before the range is complete
+    std::vector<CBlockHeader> vPopped;
+    NodeId nodeSource = -1;
+    BOOST_CHECK(!sync.PopConnectable([](const uint256&) { return true; }, vPopped, nodeSource));
+
+    BOOST_CHECK_EQUAL(sync.ReceiveHeaders(1, Slice(vHeaders, 30, 51), Slice(vHashes, 30, 51), 20, hashLocator, hashStop), CCheckpointHeadersSync::COMPLETE);
+    BOOST_CHECK(!sync.HasRange(1));
+    BOOST_CHECK_EQUAL(sync.CountAssigned(), 0);
+    // Complete ranges are not handed out again
+    BOOST_CHECK(!sync.AssignRange(2, 5, 1000, 0, hashLocator, hashStop));
+
+    // Connects only once the opening checkpoint is known
+    BOOST_CHECK(!sync.PopConnectable([](const uint256&) { return false; }, vPopped, nodeSource));
+    const uint256 hashStart = vHashes[20];
+    BOOST_CHECK(sync.PopConnectable([&hashStart](const uint256& hash) { return hash == hashStart; }, vPopped, nodeSource));
+    BOOST_CHECK_EQUAL(nodeSource, 1);
+    BOOST_REQUIRE_EQUAL(vPopped.size(), 30U);
+    for (int i = 0; i < 30; i++)
+        BOOST_CHECK(vPopped[i].GetHash() == vHashes[21 + i]);
+    BOOST_CHECK(!sync.PopConnectable([](const uint256&) { return true; }, vPopped, nodeSource));
+}
+
+BOOST_AUTO_TEST_CASE(headerssync_empty_reply)
+{
+    std::vector<CBlockHeader> vHeaders;
+    std::vector<uint256> vHashes;
+    BuildChain(60, vHeaders, vHashes);
+    MapCheckpoints checkpoints;
+    checkpoints[0] = vHashes[0];
+    checkpoints[20] = vHashes[20];
+    checkpoints[50] = vHashes[50];
+    CCheckpointHeadersSync sync(checkpoints);
+
+    uint256 hashLocator, hashStop;
+    const std::vector<CBlockHeader> vNone;
+    const std::vector<uint256> vNoHashes;
+    // Not a range response from a peer without a range
+    BOOST_CHECK_EQUAL(sync.ReceiveHeaders(1, vNone, vNoHashes, 10, hashLocator, hashStop), CCheckpointHeadersSync::NOT_RANGE);
+
+    BOOST_CHECK(sync.AssignRange(1, 5, 1000, 0, hashLocator, hashStop));
+    BOOST_CHECK_EQUAL(sync.ReceiveHeaders(1, Slice(vHeaders, 21, 30), Slice(vHashes, 21, 30), 10, hashLocator, hashStop), CCheckpointHeadersSync::PARTIAL);
+    // The peer has nothing more: the range is released at once, without waiting for it to stall
+    BOOST_CHECK_EQUAL(sync.ReceiveHeaders(1, vNone, vNoHashes, 20, hashLocator, hashStop), CCheckpointHeadersSync::MISSING);
+    BOOST_CHECK(!sync.HasRange(1));
+    BOOST_CHECK(!sync.IsStalling(1, HEADERS_RANGE_TIMEOUT + 30));
+    BOOST_CHECK_EQUAL(sync.CountAssigned(), 0);
+
+    // Another peer gets the whole range
+    BOOST_CHECK(sync.AssignRange(2, 5, 1000, 30, hashLocator, hashStop));
+    BOOST_CHECK(hashLocator == vHashes[20]);
+    BOOST_CHECK(hashStop == vHashes[50]);
+}
+
+BOOST_AUTO_TEST_CASE(headerssync_invalid)
+{
+    std::vector<CBlockHeader> vHeaders, vFork;
+    std::vector<uint256> vHashes, vForkHashes;
+    BuildChain(60, vHeaders, vHashes);
+    BuildChain(60, vFork, vForkHashes, 1);
+    MapCheckpoints checkpoints;
+    checkpoints[0] = vHashes[0];
+    checkpoints[10] = vHashes[10];
+    checkpoints[30] = vHashes[30];
+    CCheckpointHeadersSync sync(checkpoints);
+    uint256 hashLocator, hashStop;
+
+    // A chain that misses the closing checkpoint at its height
+    BOOST_CHECK(sync.AssignRange(1, 0, 1000, 0, hashLocator, hashStop));
+    BOOST_CHECK(hashLocator == vHashes[10]);
+    std::vector<CBlockHeader> vBad = Slice(vFork, 11, 31);
+    std::vector<uint256> vBadHashes = Slice(vForkHashes, 11, 31);
+    vBad[0].hashPrevBlock = vHashes[10];
+    vBadHashes[0] = vBad[0].GetHash();
+    for (size_t i = 1; i < vBad.size(); i++) {
+        vBad[i].hashPrevBlock = vBadHashes[i - 1];
+        vBadHashes[i] = vBad[i].GetHash();
+    }
+    BOOST_CHECK_EQUAL(sync.ReceiveHeaders(1, vBad, vBadHashes, 0, hashLocator, hashStop), CCheckpointHeadersSync::INVALID);
+    BOOST_CHECK(!sync.HasRange(1));
+
+    // Headers past the closing checkpoint
+    BOOST_CHECK(sync.AssignRange(2, 0, 1000, 0, hashLocator, hashStop));
+    BOOST_CHECK(hashLocator == vHashes[10]);
+    BOOST_CHECK_EQUAL(sync.ReceiveHeaders(2, Slice(vHeaders, 11, 32), Slice(vHashes, 11, 32), 0, hashLocator, hashStop), CCheckpointHeadersSync::INVALID);
+
+    // A released range starts over for the next peer
+    BOOST_CHECK(sync.AssignRange(3, 0, 1000, 0, hashLocator, hashStop));
+    BOOST_CHECK_EQUAL(sync.ReceiveHeaders(3, Slice(vHeaders, 11, 20), Slice(vHashes, 11, 20), 0, hashLocator, hashStop), CCheckpointHeadersSync::PARTIAL);
+    sync.ReleaseRange(3);
+    BOOST_CHECK(sync.AssignRange(4, 0, 1000, 0, hashLocator, hashStop));
+    BOOST_CHECK(hashLocator == vHashes[10]);
+
+    // Ranges we already have are dropped, including their download
+    sync.Prune(30);
+    BOOST_CHECK(!sync.HasRange(4));
+    BOOST_CHECK(!sync.AssignRange(5, 0, 1000, 0, hashLocator, hashStop));
+}
+
+struct RegtestingSetup : public TestingSetup {
+    RegtestingSetup() : TestingSetup(CBaseChainParams::REGTEST) {}
+};
+
+/** Mine nLength regtest headers on top of pindexPrev */
+static std::vector<CBlockHeader> MineHeaders(const CBlockIndex* pindexPrev, int nLength)
+{
+    const Consensus::Params& params = Params().GetConsensus();
+    std::vector<CBlockHeader> headers(nLength);
+    uint256 hashPrev = pindexPrev->GetBlockHash();
+    for (int i = 0; i < nLength; i++) {
+        headers[i].nVersion = 4;
+        headers[i].hashPrevBlock = hashPrev;
+        headers[i].nTime = pindexPrev->nTime + 60 * (i + 1);
+        headers[i].nBits = pindexPrev->nBits;
+        while (!CheckProofOfWork(headers[i].GetHash(), headers[i].nBits, params))
+            headers[i].nNonce++;
+        hashPrev = headers[i].GetHash();
+    }
+    return headers;
+}
+
+BOOST_FIXTURE_TEST_CASE(headerssync_process_headers, RegtestingSetup)
+{
+    const CChainParams& chainparams = Params();
+    const CBlockIndex* pindexGenesis = chainActive.Genesis();
+    // Large enough to be checked on the header checking threads
+    std::vector<CBlockHeader> headers = MineHeaders(pindexGenesis, 300);
+
+    CValidationState state;
+    std::vector<uint256> vHashes;
+    BOOST_CHECK(CheckBlockHeaders(headers, vHashes, state, chainparams.GetConsensus()));
+    BOOST_REQUIRE_EQUAL(vHashes.size(), headers.size());
+    for (size_t i = 0; i < headers.size(); i++)
+        BOOST_CHECK(vHashes[i] == headers[i].GetHash());
+
+    // A header without valid proof of work fails the whole batch
+    std::vector<CBlockHeader> vBad = headers;
+    while (CheckProofOfWork(vBad[150].GetHash(), vBad[150].nBits, chainparams.GetConsensus()))
+        vBad[150].nNonce++;
+    BOOST_CHECK(!CheckBlockHeaders(vBad, vHashes, state, chainparams.GetConsensus()));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "high-hash");
+    state = CValidationState();
+    BOOST_CHECK(!ProcessNewBlockHeaders(vBad, state, chainparams));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "high-hash");
+
+    // So does a gap in the sequence
+    vBad = headers;
+    vBad.erase(vBad.begin() + 100);
+    state = CValidationState();
+    int nDoS = 0;
+    BOOST_CHECK(!ProcessNewBlockHeaders(vBad, state, chainparams));
+    BOOST_CHECK(state.IsInvalid(nDoS));
+    BOOST_CHECK_EQUAL(nDoS, 20);
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(mapBlockIndex.count(headers[0].GetHash()) == 0);
+    }
+
+    state = CValidationState();
+    const CBlockIndex* pindexLast = NULL;
+    BOOST_CHECK(ProcessNewBlockHeaders(headers, state, chainparams, &pindexLast));
+    BOOST_REQUIRE(pindexLast != NULL);
+    BOOST_CHECK(pindexLast->GetBlockHash() == headers.back().GetHash());
+    BOOST_CHECK_EQUAL(pindexLast->nHeight, 300);
+    LOCK(cs_main);
+    BOOST_CHECK(pindexBestHeader == pindexLast);
+    BOOST_CHECK(pindexLast->GetAncestor(1)->GetBlockHash() == headers[0].GetHash());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
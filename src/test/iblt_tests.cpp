@@ -0,0 +1,89 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "iblt.h"
+
+#include "clientversion.h"
+#include "random.h"
+#include "streams.h"
+#include "test/test_novo.h"
+
+#include <algorithm>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(iblt_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(iblt_difference)
+{
+    FastRandomContext rng(true);
+    for (size_t nDiff : {0, 1, 2, 10, 100, 1000}) {
+        // Two sets with 1000 keys in common, differing in nDiff keys
+        CIBLT a(CIBLT::CellsForDifference(nDiff)), b(CIBLT::CellsForDifference(nDiff));
+        BOOST_CHECK(a.IsValid());
+        BOOST_CHECK_EQUAL(a.size() % IBLT_HASH_COUNT, 0U);
+        for (int i = 0; i < 1000; i++) {
+            uint64_t nKey = ((uint64_t)rng.rand32() << 32) | rng.rand32();
+            a.Insert(nKey);
+            b.Insert(nKey);
+        }
+        std::vector<uint64_t> vOnlyA, vOnlyB;
+        for (size_t i = 0; i < nDiff; i++) {
+            uint64_t nKey = ((uint64_t)rng.rand32() << 32) | rng.rand32();
+            if (i % 3) {
+                a.Insert(nKey);
+                vOnlyA.push_back(nKey);
+            } else {
+                b.Insert(nKey);
+                vOnlyB.push_back(nKey);
+            }
+        }
+
+        CIBLT diff(a);
+        diff -= b;
+        std::vector<uint64_t> vPositive, vNegative;
+        BOOST_CHECK(diff.Decode(vPositive, vNegative));
+        std::sort(vOnlyA.begin(), vOnlyA.end());
+        std::sort(vOnlyB.begin(), vOnlyB.end());
+        std::sort(vPositive.begin(), vPositive.end());
+        std::sort(vNegative.begin(), vNegative.end());
+        BOOST_CHECK(vPositive == vOnlyA);
+        BOOST_CHECK(vNegative == vOnlyB);
+
+        // The full sets are far too large to list
+        if (nDiff == 0) {
+            BOOST_CHECK(!a.Decode(vPositive, vNegative));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(iblt_erase_serialize)
+{
+    CIBLT table(10);
+    BOOST_CHECK_EQUAL(table.size(), 12U);
+    table.Insert(1);
+    table.Insert(2);
+    table.Insert(3);
+    table.Erase(2);
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << table;
+    CIBLT tableRead;
+    BOOST_CHECK(!tableRead.IsValid());
+    ss >> tableRead;
+    BOOST_CHECK_EQUAL(tableRead.size(), table.size());
+
+    std::vector<uint64_t> vPositive, vNegative;
+    BOOST_CHECK(tableRead.Decode(vPositive, vNegative));
+    std::sort(vPositive.begin(), vPositive.end());
+    BOOST_CHECK(vPositive == std::vector<uint64_t>({1, 3}));
+    BOOST_CHECK(vNegative.empty());
+
+    // Removing a key that was never inserted leaves it negative
+    tableRead.Erase(4);
+    BOOST_CHECK(tableRead.Decode(vPositive, vNegative));
+    BOOST_CHECK(vNegative == std::vector<uint64_t>({4}));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
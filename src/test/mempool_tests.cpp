@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "policy/policy.h"
+#include "random.h"
 #include "txmempool.h"
 #include "util.h"
 
@@ -584,4 +585,73 @@ BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
     SetMockTime(0);
 }
 
+/** Evict one package at a time, as TrimToSize did before batching, returning the highest fee rate removed */
+static CFeeRate TrimOneAtATime(CTxMemPool& pool, size_t sizelimit)
+{
+    LOCK(pool.cs);
+    CFeeRate maxFeeRateRemoved(0);
+    while (!pool.mapTx.empty() && pool.DynamicMemoryUsage() > sizelimit) {
+        CTxMemPool::txiter it = pool.mapTx.project<0>(pool.mapTx.get<descendant_score>().begin());
+        CFeeRate removed(it->GetModFeesWithDescendants(), it->GetSizeWithDescendants());
+        removed += incrementalRelayFee;
+        maxFeeRateRemoved = std::max(maxFeeRateRemoved, removed);
+        CTxMemPool::setEntries stage;
+        pool.CalculateDescendants(it, stage);
+        pool.RemoveStaged(stage, false, MemPoolRemovalReason::SIZELIMIT);
+    }
+    return maxFeeRateRemoved;
+}
+
+BOOST_AUTO_TEST_CASE(MempoolBatchEvictionTest)
+{
+    CTxMemPool poolBatch(CFeeRate(0));
+    CTxMemPool poolSingle(CFeeRate(0));
+    TestMemPoolEntryHelper entry;
+    FastRandomContext rng(true);
+
+    // Trees of chained transactions with random fees, so that evicting a
+    // package changes the descendant scores of its ancestors
+    std::vector<COutPoint> vUnspent;
+    std::vector<uint256> vTxid;
+    for (int i = 0; i < 400; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        if (vUnspent.empty() || rng.rand32() % 4 == 0) {
+            tx.vin[0].prevout = COutPoint(uint256S(strprintf("%x", i + 1)), 0);
+        } else {
+            size_t n = rng.rand32() % vUnspent.size();
+            tx.vin[0].prevout = vUnspent[n];
+            vUnspent.erase(vUnspent.begin() + n);
+        }
+        tx.vin[0].scriptSig = CScript() << OP_1;
+        tx.vout.resize(2);
+        for (int j = 0; j < 2; j++) {
+            tx.vout[j].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+            tx.vout[j].nValue = COIN;
+        }
+        const CAmount nFee = 100 + rng.rand32() % 100000;
+        poolBatch.addUnchecked(tx.GetHash(), entry.Fee(nFee).Time(i).FromTx(tx, &poolBatch));
+        poolSingle.addUnchecked(tx.GetHash(), entry.Fee(nFee).Time(i).FromTx(tx, &poolSingle));
+        vUnspent.push_back(COutPoint(tx.GetHash(), 0));
+        vUnspent.push_back(COutPoint(tx.GetHash(), 1));
+        vTxid.push_back(tx.GetHash());
+    }
+    BOOST_REQUIRE_EQUAL(poolBatch.DynamicMemoryUsage(), poolSingle.DynamicMemoryUsage());
+
+    const size_t nUsage = poolBatch.DynamicMemoryUsage();
+    CFeeRate maxFeeRateRemoved(0);
+    for (int nPercent = 95; nPercent > 0; nPercent -= 15) {
+        const size_t nLimit = nUsage * nPercent / 100;
+        poolBatch.TrimToSize(nLimit);
+        maxFeeRateRemoved = std::max(maxFeeRateRemoved, TrimOneAtATime(poolSingle, nLimit));
+
+        BOOST_CHECK_EQUAL(poolBatch.size(), poolSingle.size());
+        BOOST_CHECK_EQUAL(poolBatch.DynamicMemoryUsage(), poolSingle.DynamicMemoryUsage());
+        for (const uint256& txid : vTxid)
+            BOOST_CHECK_EQUAL(poolBatch.exists(txid), poolSingle.exists(txid));
+        // No block in between, so the rolling minimum is the highest rate removed so far
+        BOOST_CHECK_EQUAL(poolBatch.GetMinFee(nLimit).GetFeePerK(), maxFeeRateRemoved.GetFeePerK());
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,77 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "msgstats.h"
+
+#include "sync.h"
+#include "test/test_novo.h"
+
+#include <limits>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(msgstats_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(latency_histogram)
+{
+    CLatencyHistogram histogram;
+    BOOST_CHECK_EQUAL(histogram.GetCount(), 0U);
+    BOOST_CHECK_EQUAL(histogram.GetPercentile(0.5), 0);
+
+    // 90 fast durations and 10 slow ones
+    for (int i = 0; i < 90; i++)
+        histogram.Add(100);
+    for (int i = 0; i < 10; i++)
+        histogram.Add(50000);
+    BOOST_CHECK_EQUAL(histogram.GetCount(), 100U);
+    BOOST_CHECK_EQUAL(histogram.GetTotal(), 90 * 100 + 10 * 50000);
+    // Percentiles are the upper bound of their power of two bucket
+    BOOST_CHECK_EQUAL(histogram.GetPercentile(0.5), 128);
+    BOOST_CHECK_EQUAL(histogram.GetPercentile(0.9), 128);
+    BOOST_CHECK_EQUAL(histogram.GetPercentile(0.99), 65536);
+
+    // Durations below two microseconds, negative ones and huge ones
+    CLatencyHistogram edges;
+    edges.Add(-5);
+    edges.Add(0);
+    edges.Add(1);
+    BOOST_CHECK_EQUAL(edges.GetPercentile(1), 2);
+    BOOST_CHECK_EQUAL(edges.GetTotal(), 1);
+    edges.Add(std::numeric_limits<int64_t>::max() / 2);
+    BOOST_CHECK_EQUAL(edges.GetPercentile(1), (int64_t)2 << (LATENCY_HISTOGRAM_BUCKETS - 1));
+
+    histogram += edges;
+    BOOST_CHECK_EQUAL(histogram.GetCount(), 104U);
+    BOOST_CHECK_EQUAL(histogram.GetPercentile(0.01), 2);
+}
+
+BOOST_AUTO_TEST_CASE(thread_lock_wait)
+{
+    CCriticalSection cs;
+    int64_t nWaitStart = GetThreadLockWait();
+    {
+        // Uncontended locks do not count
+        LOCK(cs);
+    }
+    BOOST_CHECK_EQUAL(GetThreadLockWait(), nWaitStart);
+
+    int64_t nWaited = 0;
+    boost::thread thread;
+    {
+        LOCK(cs);
+        thread = boost::thread([&cs, &nWaited] {
+            int64_t nStart = GetThreadLockWait();
+            LOCK(cs);
+            nWaited = GetThreadLockWait() - nStart;
+        });
+        MilliSleep(50);
+    }
+    thread.join();
+    BOOST_CHECK(nWaited >= 10000);
+    // Only the waiting thread's counter moved
+    BOOST_CHECK_EQUAL(GetThreadLockWait(), nWaitStart);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -172,4 +172,45 @@ BOOST_AUTO_TEST_CASE(cnode_simple_test)
     BOOST_CHECK(pnode2->fFeeler == false);
 }
 
+static std::vector<char> MakeWireMessage(const char* pszCommand, const std::vector<char>& payload)
+{
+    CMessageHeader hdr(Params().MessageStart(), pszCommand, payload.size());
+    uint256 hash = Hash(payload.begin(), payload.end());
+    memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
+    CDataStream ss(SER_NETWORK, INIT_PROTO_VERSION);
+    ss << hdr;
+    ss.write(payload.data(), payload.size());
+    return std::vector<char>(ss.begin(), ss.end());
+}
+
+BOOST_AUTO_TEST_CASE(cnetmessage_reuse)
+{
+    CNetMessage msg(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION);
+    for (unsigned int nChunk : {1, 7, 100000}) {
+        for (size_t nSize : {0, 1, 1000}) {
+            std::vector<char> payload(nSize);
+            for (size_t i = 0; i < nSize; i++)
+                payload[i] = i * nChunk;
+            std::vector<char> wire = MakeWireMessage("ping", payload);
+
+            // feed the message in chunks, splitting the header too
+            msg.Reset(INIT_PROTO_VERSION);
+            const char* pch = wire.data();
+            unsigned int nBytes = wire.size();
+            while (nBytes > 0) {
+                unsigned int nAvail = std::min(nBytes, nChunk);
+                int handled = msg.in_data ? msg.readData(pch, nAvail) : msg.readHeader(pch, nAvail);
+                BOOST_REQUIRE(handled > 0 || (handled == 0 && msg.complete()));
+                pch += handled;
+                nBytes -= handled;
+            }
+            BOOST_CHECK(msg.complete());
+            BOOST_CHECK_EQUAL(msg.hdr.GetCommand(), "ping");
+            BOOST_CHECK_EQUAL(msg.hdr.nMessageSize, nSize);
+            BOOST_CHECK(std::vector<char>(msg.vRecv.begin(), msg.vRecv.end()) == payload);
+            BOOST_CHECK(memcmp(msg.GetMessageHash().begin(), msg.hdr.pchChecksum, CMessageHeader::CHECKSUM_SIZE) == 0);
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,54 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "script/sigcache.h"
+
+#include "pubkey.h"
+#include "random.h"
+#include "test/test_novo.h"
+
+#include <set>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(sigcache_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(sigcache_shards)
+{
+    CSignatureCache cache;
+    cache.setup_bytes(1 << 20);
+
+    CPubKey pubkey;
+    std::vector<unsigned char> vchSig(72, 0x30);
+    std::vector<uint256> vEntries;
+    unsigned int vShardCount[SIG_CACHE_SHARDS] = {};
+    std::set<uint64_t> setTopBits;
+    for (int i = 0; i < 4000; i++) {
+        uint256 entry;
+        cache.ComputeEntry(entry, GetRandHash(), vchSig, pubkey);
+        unsigned int nShard = cache.GetShardIndex(entry);
+        BOOST_REQUIRE(nShard < SIG_CACHE_SHARDS);
+        vShardCount[nShard]++;
+        // The entries of one shard still differ in the bits the last cuckoo
+        // hash indexes on
+        if (nShard == 0)
+            setTopBits.insert(entry.GetUint64(3) >> 60);
+        cache.Set(entry);
+        vEntries.push_back(entry);
+    }
+    for (unsigned int nCount : vShardCount)
+        BOOST_CHECK(nCount > 4000 / SIG_CACHE_SHARDS / 2);
+    BOOST_CHECK(setTopBits.size() > 1);
+
+    // Every entry is found in its shard, and nothing else is
+    for (const uint256& entry : vEntries)
+        BOOST_CHECK(cache.Get(entry, false));
+    for (int i = 0; i < 1000; i++) {
+        uint256 entry;
+        cache.ComputeEntry(entry, GetRandHash(), vchSig, pubkey);
+        BOOST_CHECK(!cache.Get(entry, false));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,75 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "sync.h"
+
+#include "test/test_novo.h"
+#include "utiltime.h"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+static const CLockSiteStats* FindLockSite(const std::vector<CLockSiteStats>& vStats, int nLine)
+{
+    for (const CLockSiteStats& stats : vStats) {
+        if (stats.strFile == __FILE__ && stats.nLine == nLine)
+            return &stats;
+    }
+    return nullptr;
+}
+
+BOOST_FIXTURE_TEST_SUITE(sync_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(lock_profile)
+{
+    CCriticalSection cs;
+
+    // Nothing is recorded while profiling is off
+    int nLineOff = __LINE__; { LOCK(cs); }
+    BOOST_CHECK(!FindLockSite(GetLockProfile(), nLineOff));
+
+    fProfileLocks = true;
+    int nLineFast = __LINE__; for (int i = 0; i < 3; i++) { LOCK(cs); }
+    int nLineSlow = __LINE__; { LOCK(cs); MilliSleep(20); }
+
+    // Another thread waits for us at its own call site, and merges its
+    // profile when it exits
+    int nLineWait = __LINE__ + 4;
+    boost::thread thread;
+    {
+        LOCK(cs);
+        thread = boost::thread([&cs] { LOCK(cs); });
+        MilliSleep(50);
+    }
+    thread.join();
+
+    // Try locks only count when they succeed
+    int nLineTry = __LINE__; { TRY_LOCK(cs, lockTry); }
+    fProfileLocks = false;
+
+    std::vector<CLockSiteStats> vStats = GetLockProfile();
+    const CLockSiteStats* fast = FindLockSite(vStats, nLineFast);
+    BOOST_REQUIRE(fast);
+    BOOST_CHECK_EQUAL(fast->strName, "cs");
+    BOOST_CHECK_EQUAL(fast->nCount, 3U);
+    BOOST_CHECK_EQUAL(fast->nContended, 0U);
+    BOOST_CHECK_EQUAL(fast->nWait, 0);
+
+    const CLockSiteStats* slow = FindLockSite(vStats, nLineSlow);
+    BOOST_REQUIRE(slow);
+    BOOST_CHECK_EQUAL(slow->nCount, 1U);
+    BOOST_CHECK(slow->nHold >= 20000);
+
+    const CLockSiteStats* wait = FindLockSite(vStats, nLineWait);
+    BOOST_REQUIRE(wait);
+    BOOST_CHECK_EQUAL(wait->nCount, 1U);
+    BOOST_CHECK_EQUAL(wait->nContended, 1U);
+    BOOST_CHECK(wait->nWait >= 10000);
+
+    const CLockSiteStats* trylock = FindLockSite(vStats, nLineTry);
+    BOOST_REQUIRE(trylock);
+    BOOST_CHECK_EQUAL(trylock->nCount, 1U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
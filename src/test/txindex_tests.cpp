@@ -0,0 +1,57 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "index/txindex.h"
+#include "script/standard.h"
+#include "utiltime.h"
+#include "validation.h"
+#include "validationinterface.h"
+
+#include "test/test_novo.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(txindex_tests)
+
+BOOST_FIXTURE_TEST_CASE(txindex_initial_sync, TestChain240Setup)
+{
+    CTxIndex txindex(1 << 20, true);
+
+    CTransactionRef tx;
+    uint256 hashBlock;
+
+    // Nothing is found before the index is started
+    for (const auto& txn : coinbaseTxns)
+        BOOST_CHECK(!txindex.FindTx(txn.GetHash(), hashBlock, tx));
+
+    BOOST_REQUIRE(txindex.Start());
+
+    // Wait for the background sync to reach the tip
+    int64_t nTimeStart = GetTimeMillis();
+    while (!txindex.IsSynced()) {
+        BOOST_REQUIRE(nTimeStart + 10000 > GetTimeMillis());
+        MilliSleep(100);
+    }
+    BOOST_CHECK(txindex.GetBestBlockIndex() == chainActive.Tip());
+
+    for (const auto& txn : coinbaseTxns) {
+        BOOST_REQUIRE(txindex.FindTx(txn.GetHash(), hashBlock, tx));
+        BOOST_CHECK(tx->GetHash() == txn.GetHash());
+    }
+
+    // Blocks connected after the sync are indexed through validation callbacks
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    for (int i = 0; i < 5; i++) {
+        CBlock block = CreateAndProcessBlock(std::vector<CMutableTransaction>(), scriptPubKey);
+        SyncWithValidationInterfaceQueue();
+        BOOST_CHECK(txindex.GetBestBlockIndex() == chainActive.Tip());
+        BOOST_REQUIRE(txindex.FindTx(block.vtx[0]->GetHash(), hashBlock, tx));
+        BOOST_CHECK(hashBlock == block.GetHash());
+    }
+
+    txindex.Stop();
+    StopValidationInterfaceQueue();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,112 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "txreconciliation.h"
+
+#include "test/test_novo.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(txreconciliation_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(txreconciliation_round)
+{
+    CTxReconciliationState initiator, responder;
+    initiator.Enable(responder.nLocalSalt);
+    responder.Enable(initiator.nLocalSalt);
+    BOOST_CHECK(initiator.fEnabled && responder.fEnabled);
+
+    // Both sides agree on short ids
+    uint256 txid = GetRandHash();
+    BOOST_CHECK_EQUAL(initiator.GetShortId(txid), responder.GetShortId(txid));
+
+    // 1000 transactions on both sides, 3 only at the initiator, 2 only at the responder
+    std::set<uint256> setInitiator, setResponder;
+    for (int i = 0; i < 1000; i++) {
+        uint256 hash = GetRandHash();
+        setInitiator.insert(hash);
+        setResponder.insert(hash);
+    }
+    std::set<uint256> setOnlyInitiator, setOnlyResponder;
+    for (int i = 0; i < 3; i++)
+        setOnlyInitiator.insert(GetRandHash());
+    for (int i = 0; i < 2; i++)
+        setOnlyResponder.insert(GetRandHash());
+    setInitiator.insert(setOnlyInitiator.begin(), setOnlyInitiator.end());
+    setResponder.insert(setOnlyResponder.begin(), setOnlyResponder.end());
+
+    size_t nCells = GetReconSketchCells(setResponder.size(), setInitiator.size());
+    BOOST_CHECK(nCells < setResponder.size());
+    CIBLT sketch = responder.ComputeSketch(setResponder, nCells);
+    CIBLT diff = initiator.ComputeSketch(setInitiator, sketch.size());
+    diff -= sketch;
+    std::vector<uint64_t> vLocal, vRemote;
+    BOOST_CHECK(diff.Decode(vLocal, vRemote));
+    BOOST_CHECK_EQUAL(vLocal.size(), setOnlyInitiator.size());
+    BOOST_CHECK_EQUAL(vRemote.size(), setOnlyResponder.size());
+    for (const uint256& hash : setOnlyInitiator)
+        BOOST_CHECK(std::count(vLocal.begin(), vLocal.end(), initiator.GetShortId(hash)) == 1);
+    for (const uint256& hash : setOnlyResponder)
+        BOOST_CHECK(std::count(vRemote.begin(), vRemote.end(), responder.GetShortId(hash)) == 1);
+
+    // Sketches never exceed the protocol limit
+    BOOST_CHECK_EQUAL(GetReconSketchCells(1000000, 0), MAX_RECON_SKETCH_CELLS);
+}
+
+BOOST_AUTO_TEST_CASE(txreconciliation_stall)
+{
+    CTxReconciliationState recon;
+    recon.Enable(42);
+    const int64_t nTimeout = RECON_RESPONSE_TIMEOUT * 1000000LL;
+    int64_t nNow = 1000000000;
+    BOOST_CHECK(!recon.IsStalled(nNow + 10 * nTimeout));
+
+    // A request or sketch left unanswered stalls after the timeout
+    recon.fRequested = true;
+    recon.nRequestTime = nNow;
+    BOOST_CHECK(!recon.IsStalled(nNow + nTimeout));
+    BOOST_CHECK(recon.IsStalled(nNow + nTimeout + 1));
+    recon.fRequested = false;
+    recon.fSketched = true;
+    recon.nSketchTime = nNow;
+    BOOST_CHECK(!recon.IsStalled(nNow + nTimeout));
+    BOOST_CHECK(recon.IsStalled(nNow + nTimeout + 1));
+
+    // Giving up hands everything waiting on a reconciliation back to be
+    // announced with inv, and resets both flags
+    recon.fRequested = true;
+    uint256 hashSketched = GetRandHash(), hashToAnnounce = GetRandHash(), hashPending = GetRandHash();
+    recon.mapSketched.emplace(recon.GetShortId(hashSketched), hashSketched);
+    recon.setTxToAnnounce.insert(hashToAnnounce);
+    std::set<uint256> setInventoryTxToSend;
+    setInventoryTxToSend.insert(hashPending);
+    recon.Disable(setInventoryTxToSend);
+    BOOST_CHECK(!recon.fEnabled && !recon.fRequested && !recon.fSketched);
+    BOOST_CHECK(!recon.IsStalled(nNow + 10 * nTimeout));
+    BOOST_CHECK(recon.mapSketched.empty() && recon.setTxToAnnounce.empty());
+    BOOST_CHECK_EQUAL(setInventoryTxToSend.size(), 3U);
+    BOOST_CHECK(setInventoryTxToSend.count(hashSketched) && setInventoryTxToSend.count(hashToAnnounce) && setInventoryTxToSend.count(hashPending));
+}
+
+BOOST_AUTO_TEST_CASE(txreconciliation_limit_pending)
+{
+    CTxReconciliationState recon;
+    recon.Enable(42);
+    std::set<uint256> setInventoryTxToSend;
+    for (size_t i = 0; i < MAX_RECON_SET_SIZE; i++)
+        setInventoryTxToSend.insert(GetRandHash());
+
+    // Up to the limit, transactions wait for the next reconciliation
+    recon.LimitPending(setInventoryTxToSend);
+    BOOST_CHECK_EQUAL(setInventoryTxToSend.size(), MAX_RECON_SET_SIZE);
+    BOOST_CHECK(recon.setTxToAnnounce.empty());
+
+    // Beyond it they are all announced directly
+    setInventoryTxToSend.insert(GetRandHash());
+    recon.LimitPending(setInventoryTxToSend);
+    BOOST_CHECK(setInventoryTxToSend.empty());
+    BOOST_CHECK_EQUAL(recon.setTxToAnnounce.size(), MAX_RECON_SET_SIZE + 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,118 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "random.h"
+#include "uint256.h"
+#include "utiltime.h"
+#include "validationinterface.h"
+
+#include "test/test_novo.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(validationinterface_tests, BasicTestingSetup)
+
+namespace {
+
+class TestListener : public CValidationInterface
+{
+public:
+    std::mutex mutex;
+    std::vector<uint256> vSeen;
+    std::thread::id threadId;
+
+protected:
+    void UpdatedTransaction(const uint256 &hash)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        vSeen.push_back(hash);
+        threadId = std::this_thread::get_id();
+    }
+};
+
+/** Listener whose callbacks take a lock that the emitting thread may hold */
+class LockingListener : public CValidationInterface
+{
+public:
+    std::mutex& mutexShared;
+    std::atomic<int> nEntered;
+    std::atomic<int> nDone;
+
+    LockingListener(std::mutex& mutexIn) : mutexShared(mutexIn), nEntered(0), nDone(0) {}
+
+protected:
+    void UpdatedTransaction(const uint256 &hash)
+    {
+        nEntered++;
+        std::lock_guard<std::mutex> lock(mutexShared);
+        nDone++;
+    }
+};
+
+} // anon namespace
+
+BOOST_AUTO_TEST_CASE(async_dispatch)
+{
+    TestListener syncListener, asyncListener;
+    RegisterValidationInterface(&syncListener);
+    RegisterValidationInterfaceAsync(&asyncListener);
+
+    std::vector<uint256> vHashes;
+    for (int i = 0; i < 100; i++) {
+        vHashes.push_back(GetRandHash());
+        GetMainSignals().UpdatedTransaction(vHashes.back());
+    }
+    // The synchronous listener has seen everything by the time the signal returns
+    BOOST_CHECK(syncListener.vSeen == vHashes);
+    BOOST_CHECK(syncListener.threadId == std::this_thread::get_id());
+
+    SyncWithValidationInterfaceQueue();
+    {
+        std::lock_guard<std::mutex> lock(asyncListener.mutex);
+        BOOST_CHECK(asyncListener.vSeen == vHashes);
+        BOOST_CHECK(asyncListener.threadId != std::this_thread::get_id());
+    }
+
+    // No callbacks after unregistering
+    UnregisterValidationInterface(&asyncListener);
+    GetMainSignals().UpdatedTransaction(GetRandHash());
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK_EQUAL(asyncListener.vSeen.size(), vHashes.size());
+    BOOST_CHECK_EQUAL(syncListener.vSeen.size(), vHashes.size() + 1);
+
+    UnregisterValidationInterface(&syncListener);
+    StopValidationInterfaceQueue();
+}
+
+BOOST_AUTO_TEST_CASE(async_callback_takes_emitter_lock)
+{
+    std::mutex mutexShared;
+    LockingListener listener(mutexShared);
+    RegisterValidationInterfaceAsync(&listener);
+
+    {
+        std::lock_guard<std::mutex> lock(mutexShared);
+        GetMainSignals().UpdatedTransaction(GetRandHash());
+        // Wait until the dispatch thread is blocked inside the callback
+        while (listener.nEntered == 0)
+            MilliSleep(1);
+        // Queueing more events must not wait for that callback
+        for (int i = 0; i < 10; i++)
+            GetMainSignals().UpdatedTransaction(GetRandHash());
+        BOOST_CHECK_EQUAL(listener.nDone, 0);
+    }
+
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK_EQUAL(listener.nDone, 11);
+
+    UnregisterValidationInterface(&listener);
+    StopValidationInterfaceQueue();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -307,6 +307,14 @@ void CTxMemPool::UpdateForRemoveFromMempool(const setEntries &entriesToRemove, b
         // and it's important that we use the mapLinks[] notion of ancestor
         // transactions as the set of things to update for removal.
         CalculateMemPoolAncestors(entry, setAncestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
+        // Ancestors that are removed in the same batch are about to disappear,
+        // so don't bother (re-sorting mapTx for) updating their descendant state.
+        for (setEntries::iterator ait = setAncestors.begin(); ait != setAncestors.end(); ) {
+            if (entriesToRemove.count(*ait))
+                ait = setAncestors.erase(ait);
+            else
+                ++ait;
+        }
         // Note that UpdateAncestorsOf severs the child links that point to
         // removeIt in the entries for the parents of removeIt.
         UpdateAncestorsOf(false, removeIt, setAncestors);
@@ -458,8 +466,7 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
         vTxHashes.clear();
 
     totalTxSize -= it->GetTxSize();
-    cachedInnerUsage -= it->DynamicMemoryUsage();
-    cachedInnerUsage -= memusage::DynamicUsage(mapLinks[it].parents) + memusage::DynamicUsage(mapLinks[it].children);
+    cachedInnerUsage -= InnerUsage(it);
     mapLinks.erase(it);
     mapTx.erase(it);
     nTransactionsUpdated++;
@@ -985,10 +992,16 @@ bool CCoinsViewMemPool::HaveCoins(const uint256 &txid) const {
     return mempool.exists(txid) || base->HaveCoins(txid);
 }
 
+/** Memory mapTx uses for an entry, besides what the entry itself allocates */
+static size_t MapTxEntryUsage()
+{
+    // Estimate the overhead of mapTx to be 15 pointers + an allocation, as no exact formula for boost::multi_index_contained is implemented.
+    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 15 * sizeof(void*));
+}
+
 size_t CTxMemPool::DynamicMemoryUsage() const {
     LOCK(cs);
-    // Estimate the overhead of mapTx to be 15 pointers + an allocation, as no exact formula for boost::multi_index_contained is implemented.
-    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 15 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(mapLinks) + memusage::DynamicUsage(vTxHashes) + cachedInnerUsage;
+    return MapTxEntryUsage() * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(mapLinks) + memusage::DynamicUsage(vTxHashes) + cachedInnerUsage;
 }
 
 void CTxMemPool::RemoveStaged(setEntries &stage, bool updateDescendants, MemPoolRemovalReason reason) {
@@ -1093,25 +1106,79 @@ void CTxMemPool::trackPackageRemoved(const CFeeRate& rate) {
     }
 }
 
+size_t CTxMemPool::InnerUsage(txiter it) const
+{
+    const TxLinks& links = mapLinks.find(it)->second;
+    return it->DynamicMemoryUsage() + memusage::DynamicUsage(links.parents) + memusage::DynamicUsage(links.children);
+}
+
+size_t CTxMemPool::EvictionUsage(txiter it) const
+{
+    // The per entry parts of DynamicMemoryUsage(), plus the link to the entry
+    // in the children of each parent, which is counted twice if the parent
+    // is removed too.
+    const TxLinks& links = mapLinks.find(it)->second;
+    return MapTxEntryUsage() + InnerUsage(it) + links.parents.size() * memusage::IncrementalDynamicUsage(links.children) +
+        memusage::IncrementalDynamicUsage(mapLinks) + it->GetTx().vin.size() * memusage::IncrementalDynamicUsage(mapNextTx);
+}
+
 void CTxMemPool::TrimToSize(size_t sizelimit, std::vector<uint256>* pvNoSpendsRemaining) {
     LOCK(cs);
 
     unsigned nTxnRemoved = 0;
     CFeeRate maxFeeRateRemoved(0);
-    while (!mapTx.empty() && DynamicMemoryUsage() > sizelimit) {
-        indexed_transaction_set::index<descendant_score>::type::iterator it = mapTx.get<descendant_score>().begin();
-
-        // We set the new mempool min fee to the feerate of the removed set, plus the
-        // "minimum reasonable fee rate" (ie some value under which we consider txn
-        // to have 0 fee). This way, we don't allow txn to enter mempool with feerate
-        // equal to txn which were removed with no block in between.
-        CFeeRate removed(it->GetModFeesWithDescendants(), it->GetSizeWithDescendants());
-        removed += incrementalRelayFee;
-        trackPackageRemoved(removed);
-        maxFeeRateRemoved = std::max(maxFeeRateRemoved, removed);
-
+    size_t nUsage;
+    while (!mapTx.empty() && (nUsage = DynamicMemoryUsage()) > sizelimit) {
+        // Rather than evicting one package at a time, stage the lowest scoring
+        // packages until they account for the memory to free, and remove them
+        // in a single batch. The result is the same as evicting them one at a
+        // time: the usage staged is an upper bound, so no package is staged
+        // that would not have been evicted, and the batch ends before an entry
+        // whose descendant score still counts staged descendants. If the batch
+        // frees too little, the loop runs again on the updated scores.
+        const size_t nUsageToFree = nUsage - sizelimit;
+        size_t nUsageStaged = 0;
+        // Follow vTxHashes shrinking as it empties, see removeUnchecked()
+        size_t nHashes = vTxHashes.size();
+        size_t nHashesCapacity = vTxHashes.capacity();
         setEntries stage;
-        CalculateDescendants(mapTx.project<0>(it), stage);
+        indexed_transaction_set::index<descendant_score>::type::iterator it = mapTx.get<descendant_score>().begin();
+        while (it != mapTx.get<descendant_score>().end() && nUsageStaged < nUsageToFree) {
+            txiter packageit = mapTx.project<0>(it++);
+            if (stage.count(packageit))
+                continue; // already evicted as descendant of a lower scoring package
+
+            setEntries setPackage;
+            CalculateDescendants(packageit, setPackage);
+            bool fStaleScore = false;
+            BOOST_FOREACH(txiter iter, setPackage) {
+                if (iter != packageit && stage.count(iter)) {
+                    fStaleScore = true;
+                    break;
+                }
+            }
+            if (fStaleScore)
+                break;
+
+            // We set the new mempool min fee to the feerate of the removed set, plus the
+            // "minimum reasonable fee rate" (ie some value under which we consider txn
+            // to have 0 fee). This way, we don't allow txn to enter mempool with feerate
+            // equal to txn which were removed with no block in between.
+            CFeeRate removed(packageit->GetModFeesWithDescendants(), packageit->GetSizeWithDescendants());
+            removed += incrementalRelayFee;
+            trackPackageRemoved(removed);
+            maxFeeRateRemoved = std::max(maxFeeRateRemoved, removed);
+
+            BOOST_FOREACH(txiter iter, setPackage) {
+                if (!stage.insert(iter).second)
+                    continue;
+                nUsageStaged += EvictionUsage(iter);
+                const size_t nHashesUsage = memusage::MallocUsage(nHashesCapacity * sizeof(vTxHashes[0]));
+                if (nHashes > 1 && --nHashes * 2 < nHashesCapacity)
+                    nHashesCapacity = nHashes;
+                nUsageStaged += nHashesUsage - memusage::MallocUsage(nHashesCapacity * sizeof(vTxHashes[0]));
+            }
+        }
         nTxnRemoved += stage.size();
 
         std::vector<CTransaction> txn;
@@ -700,6 +700,14 @@ private:
      *  removal.
      */
     void removeUnchecked(txiter entry, MemPoolRemovalReason reason = MemPoolRemovalReason::UNKNOWN);
+
+    /** Memory counted in cachedInnerUsage for an entry */
+    size_t InnerUsage(txiter it) const;
+    /**
+     * Upper bound of the memory removing this entry frees, except for
+     * vTxHashes, whose shrinking TrimToSize follows itself.
+     */
+    size_t EvictionUsage(txiter it) const;
 };
 
 /**
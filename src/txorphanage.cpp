@@ -0,0 +1,228 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "txorphanage.h"
+
+#include "core_memusage.h"
+#include "memusage.h"
+#include "policy/policy.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include <assert.h>
+
+CTxOrphanage::CTxOrphanage() : nTotalUsage(0), nNextSweep(0) {}
+
+bool CTxOrphanage::AddTx(const CTransactionRef& tx, NodeId peer)
+{
+    LOCK(cs);
+    const uint256& hash = tx->GetHash();
+    if (mapOrphans.count(hash))
+        return false;
+
+    // Ignore big transactions, to avoid a
+    // send-big-orphans memory exhaustion attack. If a peer has a legitimate
+    // large transaction with a missing parent then we assume
+    // it will rebroadcast it later, after the parent transaction(s)
+    // have been mined or received.
+    // 100 orphans, each of which is at most 99,999 bytes big is
+    // at most 10 megabytes of orphans and somewhat more byprev index (in the worst case):
+    unsigned int sz = GetTransactionSize(*tx);
+    if (sz < MIN_STANDARD_TX_SIZE || sz >= MAX_STANDARD_TX_SIZE)
+    {
+        LogPrint("mempool", "ignoring large orphan tx (size: %u, hash: %s)\n", sz, hash.ToString());
+        return false;
+    }
+
+    size_t nUsage = memusage::DynamicUsage(tx) + RecursiveDynamicUsage(*tx);
+    auto ret = mapOrphans.emplace(hash, COrphanTx{tx, peer, GetTime() + ORPHAN_TX_EXPIRE_TIME, nUsage});
+    assert(ret.second);
+    for (const CTxIn& txin : tx->vin) {
+        mapOrphansByPrev[txin.prevout].insert(ret.first);
+    }
+    PeerOrphans& peerOrphans = mapPeers[peer];
+    peerOrphans.setOrphans.insert(ret.first);
+    peerOrphans.nUsage += nUsage;
+    nTotalUsage += nUsage;
+
+    LogPrint("mempool", "stored orphan tx %s from peer=%d (mapsz %u outsz %u, peer usage %u)\n", hash.ToString(), peer,
+             mapOrphans.size(), mapOrphansByPrev.size(), peerOrphans.nUsage);
+    return true;
+}
+
+bool CTxOrphanage::HaveTx(const uint256& hash) const
+{
+    LOCK(cs);
+    return mapOrphans.count(hash);
+}
+
+int CTxOrphanage::EraseTx(const uint256& hash)
+{
+    LOCK(cs);
+    return EraseTxInternal(hash);
+}
+
+int CTxOrphanage::EraseTxInternal(const uint256& hash)
+{
+    OrphanMap::iterator it = mapOrphans.find(hash);
+    if (it == mapOrphans.end())
+        return 0;
+    for (const CTxIn& txin : it->second.tx->vin) {
+        auto itPrev = mapOrphansByPrev.find(txin.prevout);
+        if (itPrev == mapOrphansByPrev.end())
+            continue;
+        itPrev->second.erase(it);
+        if (itPrev->second.empty())
+            mapOrphansByPrev.erase(itPrev);
+    }
+
+    auto itPeer = mapPeers.find(it->second.fromPeer);
+    assert(itPeer != mapPeers.end());
+    PeerOrphans& peerOrphans = itPeer->second;
+    peerOrphans.setOrphans.erase(it);
+    peerOrphans.setWorkSet.erase(hash);
+    peerOrphans.nUsage -= it->second.nUsage;
+    if (peerOrphans.setOrphans.empty())
+        mapPeers.erase(itPeer);
+
+    nTotalUsage -= it->second.nUsage;
+    mapOrphans.erase(it);
+    return 1;
+}
+
+void CTxOrphanage::EraseForPeer(NodeId peer)
+{
+    LOCK(cs);
+    auto itPeer = mapPeers.find(peer);
+    if (itPeer == mapPeers.end())
+        return;
+    std::vector<uint256> vErase;
+    for (const OrphanMap::iterator& it : itPeer->second.setOrphans)
+        vErase.push_back(it->first);
+
+    int nErased = 0;
+    for (const uint256& hash : vErase)
+        nErased += EraseTxInternal(hash);
+    if (nErased > 0) LogPrint("mempool", "Erased %d orphan tx from peer=%d\n", nErased, peer);
+}
+
+void CTxOrphanage::EraseForBlock(const CTransaction& tx)
+{
+    LOCK(cs);
+    std::vector<uint256> vOrphanErase;
+    // Which orphan pool entries must we evict?
+    for (const CTxIn& txin : tx.vin) {
+        auto itByPrev = mapOrphansByPrev.find(txin.prevout);
+        if (itByPrev == mapOrphansByPrev.end()) continue;
+        for (const OrphanMap::iterator& mi : itByPrev->second)
+            vOrphanErase.push_back(mi->first);
+    }
+
+    // Erase orphan transactions include or precluded by this block
+    if (vOrphanErase.size()) {
+        int nErased = 0;
+        for (const uint256& orphanHash : vOrphanErase)
+            nErased += EraseTxInternal(orphanHash);
+        LogPrint("mempool", "Erased %d orphan tx included or conflicted by block\n", nErased);
+    }
+}
+
+unsigned int CTxOrphanage::LimitOrphans(unsigned int nMaxOrphans)
+{
+    LOCK(cs);
+    unsigned int nEvicted = 0;
+    int64_t nNow = GetTime();
+    if (nNextSweep <= nNow) {
+        // Sweep out expired orphan pool entries:
+        int nErased = 0;
+        int64_t nMinExpTime = nNow + ORPHAN_TX_EXPIRE_TIME - ORPHAN_TX_EXPIRE_INTERVAL;
+        OrphanMap::iterator iter = mapOrphans.begin();
+        while (iter != mapOrphans.end())
+        {
+            OrphanMap::iterator maybeErase = iter++;
+            if (maybeErase->second.nTimeExpire <= nNow) {
+                nErased += EraseTxInternal(maybeErase->first);
+            } else {
+                nMinExpTime = std::min(maybeErase->second.nTimeExpire, nMinExpTime);
+            }
+        }
+        // Sweep again 5 minutes after the next entry that expires in order to batch the linear scan.
+        nNextSweep = nMinExpTime + ORPHAN_TX_EXPIRE_INTERVAL;
+        if (nErased > 0) LogPrint("mempool", "Erased %d orphan tx due to expiration\n", nErased);
+    }
+    while (mapOrphans.size() > nMaxOrphans)
+    {
+        // Evict the oldest orphan of the peer using the most memory
+        auto itPeer = mapPeers.begin();
+        for (auto it = mapPeers.begin(); it != mapPeers.end(); ++it) {
+            if (it->second.nUsage > itPeer->second.nUsage)
+                itPeer = it;
+        }
+        assert(itPeer != mapPeers.end());
+        const OrphanMap::iterator* pOldest = nullptr;
+        for (const OrphanMap::iterator& it : itPeer->second.setOrphans) {
+            if (!pOldest || it->second.nTimeExpire < (*pOldest)->second.nTimeExpire)
+                pOldest = &it;
+        }
+        assert(pOldest);
+        LogPrint("mempool", "evicting orphan tx %s from peer=%d (peer usage %u of %u)\n", (*pOldest)->first.ToString(),
+                 itPeer->first, itPeer->second.nUsage, nTotalUsage);
+        EraseTxInternal(uint256((*pOldest)->first));
+        ++nEvicted;
+    }
+    return nEvicted;
+}
+
+size_t CTxOrphanage::AddChildrenToWorkSet(const CTransaction& tx)
+{
+    LOCK(cs);
+    size_t nQueued = 0;
+    for (unsigned int i = 0; i < tx.vout.size(); i++) {
+        auto itByPrev = mapOrphansByPrev.find(COutPoint(tx.GetHash(), i));
+        if (itByPrev == mapOrphansByPrev.end())
+            continue;
+        for (const OrphanMap::iterator& mi : itByPrev->second)
+            nQueued += mapPeers[mi->second.fromPeer].setWorkSet.insert(mi->first).second;
+    }
+    return nQueued;
+}
+
+bool CTxOrphanage::GetTxToReconsider(NodeId peer, CTransactionRef& tx)
+{
+    LOCK(cs);
+    auto itPeer = mapPeers.find(peer);
+    if (itPeer == mapPeers.end())
+        return false;
+    std::set<uint256>& setWorkSet = itPeer->second.setWorkSet;
+    while (!setWorkSet.empty()) {
+        uint256 hash = *setWorkSet.begin();
+        setWorkSet.erase(setWorkSet.begin());
+        OrphanMap::iterator it = mapOrphans.find(hash);
+        if (it != mapOrphans.end()) {
+            tx = it->second.tx;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CTxOrphanage::HaveTxToReconsider(NodeId peer) const
+{
+    LOCK(cs);
+    auto itPeer = mapPeers.find(peer);
+    return itPeer != mapPeers.end() && !itPeer->second.setWorkSet.empty();
+}
+
+size_t CTxOrphanage::Size() const
+{
+    LOCK(cs);
+    return mapOrphans.size();
+}
+
+size_t CTxOrphanage::GetPeerUsage(NodeId peer) const
+{
+    LOCK(cs);
+    auto itPeer = mapPeers.find(peer);
+    return itPeer == mapPeers.end() ? 0 : itPeer->second.nUsage;
+}
@@ -0,0 +1,119 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef NOVO_TXORPHANAGE_H
+#define NOVO_TXORPHANAGE_H
+
+#include "net.h"
+#include "primitives/transaction.h"
+#include "sync.h"
+#include "uint256.h"
+
+#include <map>
+#include <set>
+#include <stdint.h>
+
+/** Expiration time for orphan transactions in seconds */
+static const int64_t ORPHAN_TX_EXPIRE_TIME = 20 * 60;
+/** Minimum time between orphan transactions expire time checks in seconds */
+static const int64_t ORPHAN_TX_EXPIRE_INTERVAL = 5 * 60;
+
+/**
+ * Transactions whose inputs are missing, kept until their parents arrive.
+ *
+ * Every orphan is accounted to the peer that sent it. When the pool is full,
+ * orphans are evicted from the peer using the most memory first, oldest
+ * first, so a single peer flooding orphans cannot push out the orphans of
+ * everyone else.
+ *
+ * When a transaction is accepted, its orphaned children are not validated
+ * right away but put in the work set of the peer that sent them, which
+ * reconsiders them a few at a time between its own messages. A long chain
+ * of orphans thus does not hold up message processing for other peers.
+ *
+ * All methods are thread safe.
+ */
+class CTxOrphanage
+{
+protected:
+    struct COrphanTx {
+        CTransactionRef tx;
+        NodeId fromPeer;
+        int64_t nTimeExpire;
+        size_t nUsage;
+    };
+
+    struct IteratorComparator
+    {
+        template<typename I>
+        bool operator()(const I& a, const I& b) const
+        {
+            return &(*a) < &(*b);
+        }
+    };
+
+    typedef std::map<uint256, COrphanTx> OrphanMap;
+
+    struct PeerOrphans {
+        //! Memory used by the orphans the peer sent
+        size_t nUsage;
+        //! Orphans the peer sent
+        std::set<OrphanMap::iterator, IteratorComparator> setOrphans;
+        //! Orphans the peer sent whose missing inputs may have arrived
+        std::set<uint256> setWorkSet;
+
+        PeerOrphans() : nUsage(0) {}
+    };
+
+    mutable CCriticalSection cs;
+    OrphanMap mapOrphans;
+    std::map<COutPoint, std::set<OrphanMap::iterator, IteratorComparator> > mapOrphansByPrev;
+    std::map<NodeId, PeerOrphans> mapPeers;
+    size_t nTotalUsage;
+    int64_t nNextSweep;
+
+    int EraseTxInternal(const uint256& hash);
+
+public:
+    CTxOrphanage();
+
+    /** Add an orphan a peer sent. Returns false if it is known or too large. */
+    bool AddTx(const CTransactionRef& tx, NodeId peer);
+
+    bool HaveTx(const uint256& hash) const;
+
+    /** Remove an orphan, returning the number of transactions removed */
+    int EraseTx(const uint256& hash);
+
+    /** Remove all orphans a peer sent and its work set */
+    void EraseForPeer(NodeId peer);
+
+    /** Remove the orphans spending an input of a transaction in a block */
+    void EraseForBlock(const CTransaction& tx);
+
+    /**
+     * Remove expired orphans, then evict orphans until at most nMaxOrphans
+     * are left. Returns the number of evicted orphans.
+     */
+    unsigned int LimitOrphans(unsigned int nMaxOrphans);
+
+    /**
+     * Queue the orphans spending outputs of tx for reconsideration by the
+     * peers that sent them. Returns the number of orphans queued.
+     */
+    size_t AddChildrenToWorkSet(const CTransaction& tx);
+
+    /**
+     * Take the next orphan in a peer's work set. Returns false if the work
+     * set is empty. The orphan stays in the pool.
+     */
+    bool GetTxToReconsider(NodeId peer, CTransactionRef& tx);
+
+    bool HaveTxToReconsider(NodeId peer) const;
+
+    size_t Size() const;
+    size_t GetPeerUsage(NodeId peer) const;
+};
+
+#endif // NOVO_TXORPHANAGE_H
@@ -0,0 +1,89 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "txreconciliation.h"
+
+#include "crypto/common.h"
+#include "crypto/sha256.h"
+#include "hash.h"
+#include "random.h"
+
+#include <algorithm>
+#include <limits>
+
+//! Fraction of the smaller set expected to be missing from the other one
+static const size_t RECON_DIFFERENCE_DIVISOR = 4;
+
+CTxReconciliationState::CTxReconciliationState() :
+    fEnabled(false),
+    nLocalSalt(GetRand(std::numeric_limits<uint64_t>::max())),
+    nShortIdK0(0),
+    nShortIdK1(0),
+    fRequested(false),
+    nRequestTime(0),
+    nNextRequest(0),
+    fSketched(false),
+    nSketchTime(0)
+{
+}
+
+void CTxReconciliationState::Enable(uint64_t nRemoteSalt)
+{
+    // Both sides derive the same keys, whichever salt is whose
+    uint64_t nSalt1 = std::min(nLocalSalt, nRemoteSalt);
+    uint64_t nSalt2 = std::max(nLocalSalt, nRemoteSalt);
+    unsigned char vchSalts[16];
+    WriteLE64(vchSalts, nSalt1);
+    WriteLE64(vchSalts + 8, nSalt2);
+    unsigned char vchHash[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(vchSalts, sizeof(vchSalts)).Finalize(vchHash);
+    nShortIdK0 = ReadLE64(vchHash);
+    nShortIdK1 = ReadLE64(vchHash + 8);
+    fEnabled = true;
+}
+
+bool CTxReconciliationState::IsStalled(int64_t nNow) const
+{
+    const int64_t nTimeout = RECON_RESPONSE_TIMEOUT * 1000000LL;
+    return (fRequested && nNow > nRequestTime + nTimeout) || (fSketched && nNow > nSketchTime + nTimeout);
+}
+
+void CTxReconciliationState::Disable(std::set<uint256>& setInventoryTxToSend)
+{
+    setInventoryTxToSend.insert(setTxToAnnounce.begin(), setTxToAnnounce.end());
+    for (const auto& entry : mapSketched)
+        setInventoryTxToSend.insert(entry.second);
+    setTxToAnnounce.clear();
+    mapSketched.clear();
+    fRequested = false;
+    fSketched = false;
+    fEnabled = false;
+}
+
+void CTxReconciliationState::LimitPending(std::set<uint256>& setInventoryTxToSend)
+{
+    if (setInventoryTxToSend.size() <= MAX_RECON_SET_SIZE)
+        return;
+    setTxToAnnounce.insert(setInventoryTxToSend.begin(), setInventoryTxToSend.end());
+    setInventoryTxToSend.clear();
+}
+
+uint64_t CTxReconciliationState::GetShortId(const uint256& txid) const
+{
+    return SipHashUint256(nShortIdK0, nShortIdK1, txid);
+}
+
+CIBLT CTxReconciliationState::ComputeSketch(const std::set<uint256>& setTx, size_t nCells) const
+{
+    CIBLT sketch(nCells);
+    for (const uint256& txid : setTx)
+        sketch.Insert(GetShortId(txid));
+    return sketch;
+}
+
+size_t GetReconSketchCells(size_t nLocal, size_t nRemote)
+{
+    size_t nDiff = std::max(nLocal, nRemote) - std::min(nLocal, nRemote) + std::min(nLocal, nRemote) / RECON_DIFFERENCE_DIVISOR + 1;
+    return std::min(CIBLT::CellsForDifference(nDiff), MAX_RECON_SKETCH_CELLS);
+}
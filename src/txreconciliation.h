@@ -0,0 +1,102 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef NOVO_TXRECONCILIATION_H
+#define NOVO_TXRECONCILIATION_H
+
+#include "iblt.h"
+#include "uint256.h"
+
+#include <map>
+#include <set>
+#include <stdint.h>
+
+/** Default for -txreconciliation, reconciling transaction announcements with peers that support it */
+static const bool DEFAULT_TXRECONCILIATION = false;
+/** Version of the reconciliation protocol announced in "sendrecon" */
+static const uint32_t TXRECONCILIATION_VERSION = 1;
+/** Average delay between reconciliations we request from an outbound peer, in seconds */
+static const int RECON_REQUEST_INTERVAL = 8;
+/** Maximum number of cells in a sketch we send or accept */
+static const size_t MAX_RECON_SKETCH_CELLS = 10000;
+/** Time to wait for a sketch or difference before giving up on reconciling with a peer, in seconds */
+static const int RECON_RESPONSE_TIMEOUT = 60;
+/** Pending transactions beyond which we announce them to a reconciling peer directly */
+static const size_t MAX_RECON_SET_SIZE = 5000;
+
+/**
+ * Set reconciliation of the transactions two peers have pending to announce
+ * to each other, instead of announcing each of them with an "inv".
+ *
+ * Both sides send "sendrecon" with a random salt after the handshake. The
+ * side that made the connection then periodically sends "reqrecon" with the
+ * size of its pending set. The other side answers with a "sketch" of its
+ * pending set: an IBLT of salted short ids. Subtracting the sketch of its own
+ * set leaves the initiator with the symmetric difference, if that is small
+ * enough to decode. The initiator announces the transactions only it has and
+ * asks for the ones only the peer has with "reconcildiff", which the peer
+ * then announces. Transactions both sides have are not announced at all. If
+ * decoding fails, both sides announce their whole sets. If a peer does not
+ * answer within RECON_RESPONSE_TIMEOUT, we stop reconciling with it and
+ * announce everything with "inv".
+ *
+ * Protected by the peer's cs_inventory.
+ */
+class CTxReconciliationState
+{
+public:
+    //! Whether both sides sent "sendrecon"
+    bool fEnabled;
+    //! Salt we sent in "sendrecon"
+    uint64_t nLocalSalt;
+    //! Keys for short ids, derived from both salts
+    uint64_t nShortIdK0, nShortIdK1;
+    //! Whether we requested a sketch and are waiting for it
+    bool fRequested;
+    //! Time of the last "reqrecon", in microseconds
+    int64_t nRequestTime;
+    //! Time of the next "reqrecon", in microseconds
+    int64_t nNextRequest;
+    //! Whether we sent a sketch and are waiting for the difference
+    bool fSketched;
+    //! Time we sent the sketch, in microseconds
+    int64_t nSketchTime;
+    //! Short ids of the transactions in the sketch we sent
+    std::map<uint64_t, uint256> mapSketched;
+    //! Transactions reconciliation decided to announce
+    std::set<uint256> setTxToAnnounce;
+
+    CTxReconciliationState();
+
+    /** Start reconciling once the peer sent its salt */
+    void Enable(uint64_t nRemoteSalt);
+
+    /** Whether the peer has not answered a request or sketch in time */
+    bool IsStalled(int64_t nNow) const;
+
+    /**
+     * Stop reconciling, moving every transaction still waiting on a
+     * reconciliation to setInventoryTxToSend to be announced with "inv".
+     */
+    void Disable(std::set<uint256>& setInventoryTxToSend);
+
+    /**
+     * Announce the pending transactions directly if there are more than
+     * MAX_RECON_SET_SIZE, too many to reconcile.
+     */
+    void LimitPending(std::set<uint256>& setInventoryTxToSend);
+
+    uint64_t GetShortId(const uint256& txid) const;
+
+    /** Compute the sketch of a set of transactions */
+    CIBLT ComputeSketch(const std::set<uint256>& setTx, size_t nCells) const;
+};
+
+/**
+ * Number of cells for a sketch between sets of nLocal and nRemote
+ * transactions, which expects most of the smaller set to be in both.
+ */
+size_t GetReconSketchCells(size_t nLocal, size_t nRemote);
+
+#endif // NOVO_TXRECONCILIATION_H
@@ -6,6 +6,7 @@
 #include "validation.h"
 
 #include "arith_uint256.h"
+#include "blockindexsnapshot.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
@@ -14,6 +15,7 @@
 #include "consensus/validation.h"
 #include "novo-fees.h"
 #include "hash.h"
+#include "index/txindex.h"
 #include "init.h"
 #include "policy/fees.h"
 #include "policy/policy.h"
@@ -209,7 +211,7 @@ public:
                                                        this, boost::placeholders::_1,
                                                        boost::placeholders::_2));
         for (const auto& tx : conflictedTxs) {
-            GetMainSignals().SyncTransaction(*tx, NULL, CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK);
+            GetMainSignals().SyncTransaction(tx, NULL, CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK);
         }
         conflictedTxs.clear();
     }
@@ -852,7 +854,7 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState& state, const C
         }
     }
 
-    GetMainSignals().SyncTransaction(tx, NULL, CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK);
+    GetMainSignals().SyncTransaction(ptx, NULL, CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK);
 
     return true;
 }
@@ -883,10 +885,9 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
 /** Return transaction in txOut, and if it was found inside a block, its hash is placed in hashBlock */
 bool GetTransaction(const uint256 &hash, CTransactionRef &txOut, const Consensus::Params& consensusParams, uint256 &hashBlock, bool fAllowSlow)
 {
-    CBlockIndex *pindexSlow = NULL;
-
-    LOCK(cs_main);
-
+    // The mempool and the transaction index are consulted without cs_main:
+    // both are internally synchronized, so lookups do not stall block
+    // validation.
     CTransactionRef ptx = mempool.get(hash);
     if (ptx)
     {
@@ -894,28 +895,15 @@ bool GetTransaction(const uint256 &hash, CTransactionRef &txOut, const Consensus
         return true;
     }
 
-    if (fTxIndex) {
-        CDiskTxPos postx;
-        if (pblocktree->ReadTxIndex(hash, postx)) {
-            CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
-            if (file.IsNull())
-                return error("%s: OpenBlockFile failed", __func__);
-            CBlockHeader header;
-            try {
-                file >> header;
-                fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-                file >> txOut;
-            } catch (const std::exception& e) {
-                return error("%s: Deserialize or I/O error - %s", __func__, e.what());
-            }
-            hashBlock = header.GetHash();
-            if (txOut->GetHash() != hash)
-                return error("%s: txid mismatch", __func__);
-            return true;
-        }
-    }
+    if (g_txindex && g_txindex->FindTx(hash, hashBlock, txOut))
+        return true;
 
+    CDiskBlockPos blockPos;
+    uint256 hashBlockSlow;
     if (fAllowSlow) { // use coin database to locate block that contains transaction, and scan it
+        // Only take a snapshot of the block location under cs_main; the
+        // block itself is read after releasing it.
+        LOCK(cs_main);
         int nHeight = -1;
         {
             const CCoinsViewCache& view = *pcoinsTip;
@@ -923,17 +911,22 @@ bool GetTransaction(const uint256 &hash, CTransactionRef &txOut, const Consensus
             if (coins)
                 nHeight = coins->nHeight;
         }
-        if (nHeight > 0)
-            pindexSlow = chainActive[nHeight];
+        if (nHeight > 0) {
+            const CBlockIndex* pindexSlow = chainActive[nHeight];
+            if (pindexSlow && (pindexSlow->nStatus & BLOCK_HAVE_DATA)) {
+                blockPos = pindexSlow->GetBlockPos();
+                hashBlockSlow = pindexSlow->GetBlockHash();
+            }
+        }
     }
 
-    if (pindexSlow) {
+    if (!blockPos.IsNull()) {
         CBlock block;
-        if (ReadBlockFromDisk(block, pindexSlow, consensusParams)) {
+        if (ReadBlockFromDisk(block, blockPos, consensusParams)) {
             for (const auto& tx : block.vtx) {
                 if (tx->GetHash() == hash) {
                     txOut = tx;
-                    hashBlock = pindexSlow->GetBlockHash();
+                    hashBlock = hashBlockSlow;
                     return true;
                 }
             }
@@ -1349,6 +1342,26 @@ bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint
     return true;
 }
 
+/** Abort with a message */
+bool AbortNode(const std::string& strMessage, const std::string& userMessage="")
+{
+    SetMiscWarning(strMessage);
+    LogPrintf("*** %s\n", strMessage);
+    uiInterface.ThreadSafeMessageBox(
+        userMessage.empty() ? _("Error: A fatal internal error occurred, see debug.log for details") : userMessage,
+        "", CClientUIInterface::MSG_ERROR);
+    StartShutdown();
+    return false;
+}
+
+bool AbortNode(CValidationState& state, const std::string& strMessage, const std::string& userMessage="")
+{
+    AbortNode(strMessage, userMessage);
+    return state.Error(strMessage);
+}
+
+} // anon namespace
+
 bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock)
 {
     // Open history file to read
@@ -1376,26 +1389,6 @@ bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uin
     return true;
 }
 
-/** Abort with a message */
-bool AbortNode(const std::string& strMessage, const std::string& userMessage="")
-{
-    SetMiscWarning(strMessage);
-    LogPrintf("*** %s\n", strMessage);
-    uiInterface.ThreadSafeMessageBox(
-        userMessage.empty() ? _("Error: A fatal internal error occurred, see debug.log for details") : userMessage,
-        "", CClientUIInterface::MSG_ERROR);
-    StartShutdown();
-    return false;
-}
-
-bool AbortNode(CValidationState& state, const std::string& strMessage, const std::string& userMessage="")
-{
-    AbortNode(strMessage, userMessage);
-    return state.Error(strMessage);
-}
-
-} // anon namespace
-
 /**
  * Apply the undo operation of a CTxInUndo to the given chain state.
  * @param undo The undo object.
@@ -1529,6 +1522,13 @@ void ThreadScriptCheck() {
     scriptcheckqueue.Thread();
 }
 
+static CCheckQueue<CHeaderCheck> headercheckqueue(128);
+
+void ThreadHeaderCheck() {
+    RenameThread("novo-headerch");
+    headercheckqueue.Thread();
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -1673,9 +1673,6 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     CAmount nFees = 0;
     int nInputs = 0;
     int64_t nSigOpsCount = 0;
-    CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()));
-    std::vector<std::pair<uint256, CDiskTxPos> > vPos;
-    vPos.reserve(block.vtx.size());
     blockundo.vtxundo.reserve(block.vtx.size() - 1);
     std::vector<PrecomputedTransactionData> txdata;
     txdata.reserve(block.vtx.size()); // Required so that pointers to individual PrecomputedTransactionData don't get invalidated
@@ -1722,9 +1719,6 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
             blockundo.vtxundo.push_back(CTxUndo());
         }
         UpdateCoins(tx, view, i == 0 ? undoDummy : blockundo.vtxundo.back(), pindex->nHeight);
-
-        vPos.push_back(std::make_pair(tx.GetHash(), pos));
-        pos.nTxOffset += ::GetSerializeSize(tx, SER_DISK, CLIENT_VERSION);
     }
     int64_t nTime3 = GetTimeMicros(); nTimeConnect += nTime3 - nTime2;
     LogPrint("bench", "      - Connect %u transactions: %.2fms (%.3fms/tx, %.3fms/txin) [%.2fs]\n", (unsigned)block.vtx.size(), 0.001 * (nTime3 - nTime2), 0.001 * (nTime3 - nTime2) / block.vtx.size(), nInputs <= 1 ? 0 : 0.001 * (nTime3 - nTime2) / (nInputs-1), nTimeConnect * 0.000001);
@@ -1764,10 +1758,6 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         setDirtyBlockIndex.insert(pindex);
     }
 
-    if (fTxIndex)
-        if (!pblocktree->WriteTxIndex(vPos))
-            return AbortNode(state, "Failed to write transaction index");
-
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
 
@@ -1977,7 +1967,8 @@ bool static DisconnectTip(CValidationState& state, const CChainParams& chainpara
     CBlockIndex *pindexDelete = chainActive.Tip();
     assert(pindexDelete);
     // Read block from disk.
-    CBlock block;
+    std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+    CBlock& block = *pblock;
     if (!ReadBlockFromDisk(block, pindexDelete, chainparams.GetConsensus()))
         return AbortNode(state, "Failed to read block");
     // Apply the block atomically to the chain state.
@@ -2020,8 +2011,9 @@ bool static DisconnectTip(CValidationState& state, const CChainParams& chainpara
     // Let wallets know transactions went from 1-confirmed to
     // 0-confirmed or conflicted:
     for (const auto& tx : block.vtx) {
-        GetMainSignals().SyncTransaction(*tx, pindexDelete->pprev, CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK);
+        GetMainSignals().SyncTransaction(tx, pindexDelete->pprev, CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK);
     }
+    GetMainSignals().BlockDisconnected(pblock, pindexDelete);
     return true;
 }
 
@@ -2325,8 +2317,14 @@ bool ActivateBestChain(CValidationState &state, const CChainParams& chainparams,
                 assert(pair.second);
                 const CBlock& block = *(pair.second);
                 for (unsigned int i = 0; i < block.vtx.size(); i++)
-                    GetMainSignals().SyncTransaction(*block.vtx[i], pair.first, i);
+                    GetMainSignals().SyncTransaction(block.vtx[i], pair.first, i);
+                GetMainSignals().BlockConnected(pair.second, pair.first);
             }
+
+            // Queue the new tip for the background listeners while holding
+            // cs_main, so the events of two concurrent callers cannot
+            // interleave.
+            QueueUpdatedBlockTip(pindexNewTip, pindexFork, fInitialDownload);
         }
         // When we reach this point, we switched to a new tip (stored in pindexNewTip).
 
@@ -2489,23 +2487,19 @@ bool ResetBlockFailureFlags(CBlockIndex *pindex) {
     return true;
 }
 
-CBlockIndex* AddToBlockIndex(const CBlockHeader& block)
+CBlockIndex* AddToBlockIndex(const CBlockHeader& block, const uint256& hash)
 {
     // Check for duplicate
-    uint256 hash = block.GetHash();
     BlockMap::iterator it = mapBlockIndex.find(hash);
     if (it != mapBlockIndex.end())
         return it->second;
 
     // Construct new block index object
-    CBlockIndex* pindexNew = new CBlockIndex(block);
-    assert(pindexNew);
+    CBlockIndex* pindexNew = mapBlockIndex.emplace(hash, block).first->second;
     // We assign the sequence id to blocks only when the full data is available,
     // to avoid miners withholding blocks but broadcasting headers, to get a
     // competitive advantage.
     pindexNew->nSequenceId = 0;
-    BlockMap::iterator mi = mapBlockIndex.insert(std::make_pair(hash, pindexNew)).first;
-    pindexNew->phashBlock = &((*mi).first);
     BlockMap::iterator miPrev = mapBlockIndex.find(block.hashPrevBlock);
     if (miPrev != mapBlockIndex.end())
     {
@@ -2670,6 +2664,37 @@ bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, bool f
     return true;
 }
 
+bool CHeaderCheck::operator()()
+{
+    *phash = pheader->GetHash();
+    return CheckProofOfWork(*phash, pheader->nBits, *params);
+}
+
+//! Smallest batch of headers that is worth handing to the header checking threads
+static const size_t MIN_PARALLEL_HEADER_CHECKS = 64;
+
+bool CheckBlockHeaders(const std::vector<CBlockHeader>& headers, std::vector<uint256>& vHashes, CValidationState& state, const Consensus::Params& consensusParams)
+{
+    vHashes.resize(headers.size());
+    bool fOk = true;
+    if (nScriptCheckThreads && headers.size() >= MIN_PARALLEL_HEADER_CHECKS) {
+        CCheckQueueControl<CHeaderCheck> control(&headercheckqueue);
+        std::vector<CHeaderCheck> vChecks(headers.size());
+        for (size_t i = 0; i < headers.size(); i++) {
+            CHeaderCheck check(headers[i], vHashes[i], consensusParams);
+            check.swap(vChecks[i]);
+        }
+        control.Add(vChecks);
+        fOk = control.Wait();
+    } else {
+        for (size_t i = 0; i < headers.size() && fOk; i++)
+            fOk = CHeaderCheck(headers[i], vHashes[i], consensusParams)();
+    }
+    if (!fOk)
+        return state.DoS(50, false, REJECT_INVALID, "high-hash", false, "proof of work failed");
+    return true;
+}
+
 bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bool fCheckMerkleRoot)
 {
     // These are checks that are independent of context.
@@ -2803,11 +2828,14 @@ bool ContextualCheckBlock(const CBlock& block, CValidationState& state, const CB
     return true;
 }
 
-static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
+/**
+ * Add a header whose hash is already known to the block index. If fCheckPOW
+ * is false, the caller has already checked its proof of work.
+ */
+static bool AcceptBlockHeader(const CBlockHeader& block, const uint256& hash, bool fCheckPOW, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
 {
     AssertLockHeld(cs_main);
     // Check for duplicate
-    uint256 hash = block.GetHash();
     BlockMap::iterator miSelf = mapBlockIndex.find(hash);
     CBlockIndex *pindex = NULL;
     if (hash != chainparams.GetConsensus().hashGenesisBlock) {
@@ -2822,7 +2850,7 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
             return true;
         }
 
-        if (!CheckBlockHeader(block, state))
+        if (!CheckBlockHeader(block, state, fCheckPOW))
             return error("%s: Consensus::CheckBlockHeader: %s, %s", __func__, hash.ToString(), FormatStateMessage(state));
 
         // Get prev block index
@@ -2859,7 +2887,7 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
         }
     }
     if (pindex == NULL)
-        pindex = AddToBlockIndex(block);
+        pindex = AddToBlockIndex(block, hash);
 
     if (ppindex)
         *ppindex = pindex;
@@ -2869,14 +2897,30 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
     return true;
 }
 
+static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
+{
+    return AcceptBlockHeader(block, block.GetHash(), true, state, chainparams, ppindex);
+}
+
 // Exposed wrapper for AcceptBlockHeader
 bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex)
 {
+    // Hash the headers and check their proof of work before taking cs_main,
+    // so that only the contextual checks and the index insertion hold it.
+    std::vector<uint256> vHashes;
+    if (!CheckBlockHeaders(headers, vHashes, state, chainparams.GetConsensus()))
+        return error("%s: Consensus::CheckBlockHeaders: %s", __func__, FormatStateMessage(state));
+    for (size_t i = 1; i < headers.size(); i++) {
+        if (headers[i].hashPrevBlock != vHashes[i - 1])
+            return state.DoS(20, error("%s: non-continuous headers sequence", __func__), REJECT_INVALID, "bad-prevblk");
+    }
+
     {
         LOCK(cs_main);
-        for (const CBlockHeader& header : headers) {
+        mapBlockIndex.reserve(mapBlockIndex.size() + headers.size());
+        for (size_t i = 0; i < headers.size(); i++) {
             CBlockIndex *pindex = NULL; // Use a temp pindex instead of ppindex to avoid a const_cast
-            if (!AcceptBlockHeader(header, state, chainparams, &pindex)) {
+            if (!AcceptBlockHeader(headers[i], vHashes[i], false, state, chainparams, &pindex)) {
                 return false;
             }
             if (ppindex) {
@@ -2993,6 +3037,9 @@ bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<cons
 
     NotifyHeaderTip();
 
+    // Don't let background listeners fall arbitrarily far behind
+    LimitValidationInterfaceQueue();
+
     CValidationState state; // Only used to report errors, not invalidity - ignore it
     if (!ActivateBestChain(state, chainparams, pblock))
         return error("%s: ActivateBestChain failed", __func__);
@@ -3216,55 +3263,86 @@ CBlockIndex * InsertBlockIndex(uint256 hash)
     if (hash.IsNull())
         return NULL;
 
-    // Return existing
-    BlockMap::iterator mi = mapBlockIndex.find(hash);
-    if (mi != mapBlockIndex.end())
-        return (*mi).second;
+    // Return existing or create new
+    return mapBlockIndex.emplace(hash).first->second;
+}
+
+static boost::filesystem::path GetBlockIndexSnapshotPath()
+{
+    return GetDataDir() / "blocks" / "index.snapshot";
+}
 
-    // Create new
-    CBlockIndex* pindexNew = new CBlockIndex();
-    if (!pindexNew)
-        throw std::runtime_error(std::string(__func__) + ": new CBlockIndex failed");
-    mi = mapBlockIndex.insert(std::make_pair(hash, pindexNew)).first;
-    pindexNew->phashBlock = &((*mi).first);
+/** Remove the block index snapshot, once the block tree database may move on from it */
+static void RemoveBlockIndexSnapshot()
+{
+    boost::system::error_code ec;
+    boost::filesystem::remove(GetBlockIndexSnapshotPath(), ec);
+}
 
-    return pindexNew;
+bool DumpBlockIndexSnapshot()
+{
+    LOCK(cs_main);
+    if (!GetBoolArg("-blockindexsnapshot", DEFAULT_BLOCKINDEX_SNAPSHOT) || fReindex || pcoinsTip == NULL)
+        return false;
+    // Only a snapshot of a fully flushed block index matches the database
+    if (!setDirtyBlockIndex.empty() || !setDirtyFileInfo.empty())
+        return false;
+    return WriteBlockIndexSnapshot(GetBlockIndexSnapshotPath(), mapBlockIndex, pcoinsTip->GetBestBlock());
 }
 
 bool static LoadBlockIndexDB(const CChainParams& chainparams)
 {
-    if (!pblocktree->LoadBlockIndexGuts(InsertBlockIndex))
-        return false;
+    // A snapshot from a clean shutdown already holds the linked entries in
+    // height order, together with their chain work, chain tx count and skip
+    // pointer.
+    std::vector<CBlockIndex*> vSortedByHeight;
+    int64_t nStart = GetTimeMillis();
+    bool fSnapshot = GetBoolArg("-blockindexsnapshot", DEFAULT_BLOCKINDEX_SNAPSHOT) &&
+                     ReadBlockIndexSnapshot(GetBlockIndexSnapshotPath(), mapBlockIndex, pcoinsTip->GetBestBlock(), vSortedByHeight);
+    RemoveBlockIndexSnapshot();
+
+    if (fSnapshot) {
+        LogPrintf("%s: loaded %u entries from block index snapshot in %dms\n", __func__, vSortedByHeight.size(), GetTimeMillis() - nStart);
+    } else {
+        if (!pblocktree->LoadBlockIndexGuts(InsertBlockIndex))
+            return false;
+
+        std::vector<std::pair<int, CBlockIndex*> > vHeights;
+        vHeights.reserve(mapBlockIndex.size());
+        BOOST_FOREACH(const PAIRTYPE(uint256, CBlockIndex*)& item, mapBlockIndex)
+        {
+            CBlockIndex* pindex = item.second;
+            vHeights.push_back(std::make_pair(pindex->nHeight, pindex));
+        }
+        sort(vHeights.begin(), vHeights.end());
+        vSortedByHeight.reserve(vHeights.size());
+        BOOST_FOREACH(const PAIRTYPE(int, CBlockIndex*)& item, vHeights)
+            vSortedByHeight.push_back(item.second);
+    }
 
     boost::this_thread::interruption_point();
 
     // Calculate nChainWork
-    std::vector<std::pair<int, CBlockIndex*> > vSortedByHeight;
-    vSortedByHeight.reserve(mapBlockIndex.size());
-    BOOST_FOREACH(const PAIRTYPE(uint256, CBlockIndex*)& item, mapBlockIndex)
-    {
-        CBlockIndex* pindex = item.second;
-        vSortedByHeight.push_back(std::make_pair(pindex->nHeight, pindex));
-    }
-    sort(vSortedByHeight.begin(), vSortedByHeight.end());
-    BOOST_FOREACH(const PAIRTYPE(int, CBlockIndex*)& item, vSortedByHeight)
+    BOOST_FOREACH(CBlockIndex* pindex, vSortedByHeight)
     {
-        CBlockIndex* pindex = item.second;
-        pindex->nChainWork = (pindex->pprev ? pindex->pprev->nChainWork : 0) + GetBlockProof(*pindex);
-        pindex->nTimeMax = (pindex->pprev ? std::max(pindex->pprev->nTimeMax, pindex->nTime) : pindex->nTime);
-        // We can link the chain of blocks for which we've received transactions at some point.
-        // Pruned nodes may have deleted the block.
-        if (pindex->nTx > 0) {
-            if (pindex->pprev) {
-                if (pindex->pprev->nChainTx) {
-                    pindex->nChainTx = pindex->pprev->nChainTx + pindex->nTx;
+        if (!fSnapshot) {
+            pindex->nChainWork = (pindex->pprev ? pindex->pprev->nChainWork : 0) + GetBlockProof(*pindex);
+            pindex->nTimeMax = (pindex->pprev ? std::max(pindex->pprev->nTimeMax, pindex->nTime) : pindex->nTime);
+            // We can link the chain of blocks for which we've received transactions at some point.
+            // Pruned nodes may have deleted the block.
+            if (pindex->nTx > 0) {
+                if (pindex->pprev) {
+                    pindex->nChainTx = pindex->pprev->nChainTx ? pindex->pprev->nChainTx + pindex->nTx : 0;
                 } else {
-                    pindex->nChainTx = 0;
-                    mapBlocksUnlinked.insert(std::make_pair(pindex->pprev, pindex));
+                    pindex->nChainTx = pindex->nTx;
                 }
-            } else {
-                pindex->nChainTx = pindex->nTx;
             }
+            if (pindex->pprev)
+                pindex->BuildSkip();
+        }
+        if (pindex->nTx > 0) {
+            if (pindex->pprev && !pindex->pprev->nChainTx)
+                mapBlocksUnlinked.insert(std::make_pair(pindex->pprev, pindex));
             if (!(pindex->nStatus & BLOCK_FAILED_MASK) && pindex->pprev && (pindex->pprev->nStatus & BLOCK_FAILED_MASK)) {
                 LogPrintf("Invalid Block %s.", pindex->GetBlockHash().ToString() );
                 pindex->nStatus |= BLOCK_FAILED_CHILD;
@@ -3275,8 +3353,6 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
             setBlockIndexCandidates.insert(pindex);
         if (pindex->nStatus & BLOCK_FAILED_MASK && (!pindexBestInvalid || pindex->nChainWork > pindexBestInvalid->nChainWork))
             pindexBestInvalid = pindex;
-        if (pindex->pprev)
-            pindex->BuildSkip();
         if (pindex->IsValid(BLOCK_VALID_TREE) && (pindexBestHeader == NULL || CBlockIndexWorkComparator()(pindexBestHeader, pindex)))
             pindexBestHeader = pindex;
     }
@@ -3326,10 +3402,6 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
     pblocktree->ReadReindexing(fReindexing);
     fReindex |= fReindexing;
 
-    // Check whether we have a transaction index
-    pblocktree->ReadFlag("txindex", fTxIndex);
-    LogPrintf("%s: transaction index %s\n", __func__, fTxIndex ? "enabled" : "disabled");
-
     // Load pointer to end of best chain
     BlockMap::iterator it = mapBlockIndex.find(pcoinsTip->GetBestBlock());
     if (it == mapBlockIndex.end())
@@ -3525,15 +3597,15 @@ void UnloadBlockIndex()
         warningcache[b].clear();
     }
 
-    BOOST_FOREACH(BlockMap::value_type& entry, mapBlockIndex) {
-        delete entry.second;
-    }
     mapBlockIndex.clear();
     fHavePruned = false;
 }
 
 bool LoadBlockIndex(const CChainParams& chainparams)
 {
+    // A reindex rebuilds the block tree database, which outdates any snapshot
+    if (fReindex)
+        RemoveBlockIndexSnapshot();
     // Load block index from databases
     if (!fReindex && !LoadBlockIndexDB(chainparams))
         return false;
@@ -3548,9 +3620,6 @@ bool InitBlockIndex(const CChainParams& chainparams)
     if (chainActive.Genesis() != NULL)
         return true;
 
-    // Use the provided setting for -txindex in the new database
-    fTxIndex = GetBoolArg("-txindex", DEFAULT_TXINDEX);
-    pblocktree->WriteFlag("txindex", fTxIndex);
     LogPrintf("Initializing databases...\n");
 
     // Only add the genesis block if not reindexing (in which case we reuse the one already on disk)
@@ -3565,7 +3634,7 @@ bool InitBlockIndex(const CChainParams& chainparams)
                 return error("LoadBlockIndex(): FindBlockPos failed");
             if (!WriteBlockToDisk(block, blockPos, chainparams.MessageStart()))
                 return error("LoadBlockIndex(): writing genesis block to disk failed");
-            CBlockIndex *pindex = AddToBlockIndex(block);
+            CBlockIndex *pindex = AddToBlockIndex(block, block.GetHash());
             if (!ReceivedBlockTransactions(block, state, pindex, blockPos))
                 return error("LoadBlockIndex(): genesis block not accepted");
             // Force a chainstate write so that when we VerifyDB in a moment, it doesn't check stale data
@@ -4043,9 +4112,6 @@ public:
     CMainCleanup() {}
     ~CMainCleanup() {
         // block headers
-        BlockMap::iterator it1 = mapBlockIndex.begin();
-        for (; it1 != mapBlockIndex.end(); it1++)
-            delete (*it1).second;
         mapBlockIndex.clear();
     }
 } instance_of_cmaincleanup;
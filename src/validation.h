@@ -11,6 +11,7 @@
 #endif
 
 #include "amount.h"
+#include "blockindexmap.h"
 #include "chain.h"
 #include "coins.h"
 #include "protocol.h" // For CMessageHeader::MessageStartChars
@@ -34,6 +35,7 @@
 
 class CBlockIndex;
 class CBlockTreeDB;
+class CBlockUndo;
 class CBloomFilter;
 class CChainParams;
 class CInv;
@@ -87,7 +89,8 @@ static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 static const int MAX_SCRIPTCHECK_THREADS = 64;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
-/** Number of blocks that can be requested at any given time from a single peer. */
+/** Number of blocks that can be requested at any given time from a single peer, until
+ *  its throughput is known (see CBlockDownloadEstimator). */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
 static const unsigned int BLOCK_STALLING_TIMEOUT = 10;
@@ -153,6 +156,7 @@ static const unsigned int MAX_BLOCKS_TO_ANNOUNCE = 8;
 static const int MAX_UNCONNECTING_HEADERS = 10;
 
 static const bool DEFAULT_PEERBLOOMFILTERS = true;
+static const bool DEFAULT_PEERBLOCKFILTERS = false;
 
 struct BlockHasher
 {
@@ -162,7 +166,7 @@ struct BlockHasher
 extern CScript COINBASE_FLAGS;
 extern CCriticalSection cs_main;
 extern CTxMemPool mempool;
-typedef boost::unordered_map<uint256, CBlockIndex*, BlockHasher> BlockMap;
+typedef CBlockIndexMap BlockMap;
 extern BlockMap mapBlockIndex;
 extern uint64_t nLastBlockTx;
 extern uint64_t nLastBlockSize;
@@ -270,6 +274,8 @@ bool LoadBlockIndex(const CChainParams& chainparams);
 void UnloadBlockIndex();
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the header checking thread */
+void ThreadHeaderCheck();
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
 /** Format a string that describes several potential problems detected by the core.
@@ -323,6 +329,8 @@ void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune);
 CBlockIndex * InsertBlockIndex(uint256 hash);
 /** Flush all state, indexes and buffers to disk. */
 void FlushStateToDisk();
+/** Write a block index snapshot for the next startup. Only succeeds after a complete FlushStateToDisk. */
+bool DumpBlockIndexSnapshot();
 /** Prune block files and flush state to disk. */
 void PruneAndFlush();
 /** Prune block files up to a given height */
@@ -443,16 +451,49 @@ public:
     ScriptError GetScriptError() const { return error; }
 };
 
+/**
+ * Closure representing the context-free check of one block header: it
+ * computes the header's hash and checks its proof of work.
+ */
+class CHeaderCheck
+{
+private:
+    const CBlockHeader *pheader;
+    uint256 *phash;
+    const Consensus::Params *params;
+
+public:
+    CHeaderCheck(): pheader(NULL), phash(NULL), params(NULL) {}
+    CHeaderCheck(const CBlockHeader& headerIn, uint256& hashOut, const Consensus::Params& paramsIn) :
+        pheader(&headerIn), phash(&hashOut), params(&paramsIn) { }
+
+    bool operator()();
+
+    void swap(CHeaderCheck &check) {
+        std::swap(pheader, check.pheader);
+        std::swap(phash, check.phash);
+        std::swap(params, check.params);
+    }
+};
+
 
 /** Functions for disk access for blocks */
 bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams, bool fCheckPOW = true);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams, bool fCheckPOW = true);
+/** Read the undo data of the block at pos, whose parent is hashBlock */
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock);
 
 /** Functions for validating blocks and updating the block tree */
 
 /** Context-independent validity checks */
 bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, bool fCheckPOW = true);
+/**
+ * Compute the hashes of a batch of headers into vHashes and check their proof
+ * of work. Large batches are spread over the header checking threads. Does
+ * not require cs_main.
+ */
+bool CheckBlockHeaders(const std::vector<CBlockHeader>& headers, std::vector<uint256>& vHashes, CValidationState& state, const Consensus::Params& consensusParams);
 bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW = true, bool fCheckMerkleRoot = true);
 
 /** Context-dependent validity checks.
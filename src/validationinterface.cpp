@@ -5,8 +5,25 @@
 
 #include "validationinterface.h"
 
+#include "chain.h"
+#include "primitives/transaction.h"
+#include "txmempool.h"
+#include "util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include <boost/bind/bind.hpp>
 
+/** Number of queued background callbacks above which LimitValidationInterfaceQueue waits */
+static const size_t MAX_QUEUED_VALIDATION_EVENTS = 10000;
+
 static CMainSignals g_signals;
 
 CMainSignals& GetMainSignals()
@@ -14,6 +31,265 @@ CMainSignals& GetMainSignals()
     return g_signals;
 }
 
+/**
+ * Listener that forwards the events it receives to the listeners registered
+ * with RegisterValidationInterfaceAsync, in order, on its own thread.
+ * Arguments are copied once per event no matter how many listeners there are,
+ * and nothing is queued while there are no asynchronous listeners.
+ */
+class CValidationInterfaceQueue : public CValidationInterface
+{
+public:
+    CValidationInterfaceQueue() : nListeners(0), pcalling(NULL), fRegistered(false), fBusy(false), fStop(false) {}
+    ~CValidationInterfaceQueue() { Stop(); }
+
+    void Add(CValidationInterface* pwalletIn)
+    {
+        {
+            std::lock_guard<std::mutex> lock(csListeners);
+            listeners.push_back(pwalletIn);
+            nListeners = listeners.size();
+        }
+        std::lock_guard<std::mutex> lock(csQueue);
+        if (!fRegistered) {
+            RegisterValidationInterface(this);
+            fRegistered = true;
+        }
+        if (!threadDispatch.joinable()) {
+            fStop = false;
+            threadDispatch = std::thread(&TraceThread<std::function<void()> >, "valnotify", std::function<void()>(std::bind(&CValidationInterfaceQueue::ThreadDispatch, this)));
+        }
+    }
+
+    // Once this returns, pwalletIn receives no further callbacks, unless it
+    // is called from one of pwalletIn's own callbacks.
+    void Remove(CValidationInterface* pwalletIn)
+    {
+        std::unique_lock<std::mutex> lock(csListeners);
+        listeners.erase(std::remove(listeners.begin(), listeners.end(), pwalletIn), listeners.end());
+        nListeners = listeners.size();
+        if (std::this_thread::get_id() != threadDispatch.get_id())
+            condCalled.wait(lock, [this, pwalletIn]{ return pcalling != pwalletIn; });
+    }
+
+    void RemoveAll()
+    {
+        {
+            std::unique_lock<std::mutex> lock(csListeners);
+            listeners.clear();
+            nListeners = 0;
+            if (std::this_thread::get_id() != threadDispatch.get_id())
+                condCalled.wait(lock, [this]{ return pcalling == NULL; });
+        }
+        // UnregisterAllValidationInterfaces also disconnected us
+        std::lock_guard<std::mutex> lock(csQueue);
+        fRegistered = false;
+    }
+
+    void Sync()
+    {
+        std::unique_lock<std::mutex> lock(csQueue);
+        condDrained.wait(lock, [this]{ return (queue.empty() && !fBusy) || !threadDispatch.joinable(); });
+    }
+
+    void Limit()
+    {
+        {
+            std::lock_guard<std::mutex> lock(csQueue);
+            if (queue.size() <= MAX_QUEUED_VALIDATION_EVENTS)
+                return;
+        }
+        Sync();
+    }
+
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(csQueue);
+            fStop = true;
+        }
+        condQueue.notify_all();
+        if (threadDispatch.joinable())
+            threadDispatch.join();
+        condDrained.notify_all();
+    }
+
+    void QueueUpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+    {
+        Enqueue([=](CValidationInterface* p) { p->UpdatedBlockTip(pindexNew, pindexFork, fInitialDownload); });
+    }
+
+protected:
+    // The UpdatedBlockTip signal is emitted without cs_main, which would let
+    // it be queued after events of later blocks: QueueUpdatedBlockTip is
+    // called under cs_main instead.
+    void SyncTransaction(const CTransactionRef &ptx, const CBlockIndex *pindex, int posInBlock)
+    {
+        if (!HaveListeners())
+            return;
+        Enqueue([=](CValidationInterface* p) { p->SyncTransaction(ptx, pindex, posInBlock); });
+    }
+    void SetBestChain(const CBlockLocator &locator)
+    {
+        Enqueue([=](CValidationInterface* p) { p->SetBestChain(locator); });
+    }
+    void UpdatedTransaction(const uint256 &hash)
+    {
+        Enqueue([=](CValidationInterface* p) { p->UpdatedTransaction(hash); });
+    }
+    void Inventory(const uint256 &hash)
+    {
+        Enqueue([=](CValidationInterface* p) { p->Inventory(hash); });
+    }
+    void ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman)
+    {
+        Enqueue([=](CValidationInterface* p) { p->ResendWalletTransactions(nBestBlockTime, connman); });
+    }
+    void ResetRequestCount(const uint256 &hash)
+    {
+        Enqueue([=](CValidationInterface* p) { p->ResetRequestCount(hash); });
+    }
+    void NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& block)
+    {
+        Enqueue([=](CValidationInterface* p) { p->NewPoWValidBlock(pindex, block); });
+    }
+    void BlockConnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex)
+    {
+        Enqueue([=](CValidationInterface* p) { p->BlockConnected(block, pindex); });
+    }
+    void BlockDisconnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex)
+    {
+        Enqueue([=](CValidationInterface* p) { p->BlockDisconnected(block, pindex); });
+    }
+    void TransactionAddedToMempool(const CTransactionRef &ptx)
+    {
+        Enqueue([=](CValidationInterface* p) { p->TransactionAddedToMempool(ptx); });
+    }
+    void TransactionRemovedFromMempool(const CTransactionRef &ptx, MemPoolRemovalReason reason)
+    {
+        Enqueue([=](CValidationInterface* p) { p->TransactionRemovedFromMempool(ptx, reason); });
+    }
+
+private:
+    typedef std::function<void(CValidationInterface*)> Event;
+
+    bool HaveListeners()
+    {
+        return nListeners != 0;
+    }
+
+    void Enqueue(Event&& event)
+    {
+        if (!HaveListeners())
+            return;
+        {
+            std::lock_guard<std::mutex> lock(csQueue);
+            queue.push_back(std::move(event));
+        }
+        condQueue.notify_one();
+    }
+
+    void ThreadDispatch()
+    {
+        while (true) {
+            Event event;
+            {
+                std::unique_lock<std::mutex> lock(csQueue);
+                fBusy = false;
+                if (queue.empty())
+                    condDrained.notify_all();
+                condQueue.wait(lock, [this]{ return fStop || !queue.empty(); });
+                // Deliver everything that was queued before stopping
+                if (queue.empty())
+                    return;
+                event = std::move(queue.front());
+                queue.pop_front();
+                fBusy = true;
+            }
+            // Call out without holding csListeners: callbacks may take locks
+            // (like cs_main) that are held by the threads queueing events.
+            // Each listener is checked to still be registered right before
+            // its callback, and Remove() waits for pcalling to move on.
+            std::vector<CValidationInterface*> vCall;
+            {
+                std::lock_guard<std::mutex> lock(csListeners);
+                vCall = listeners;
+            }
+            for (CValidationInterface* pwallet : vCall) {
+                {
+                    std::lock_guard<std::mutex> lock(csListeners);
+                    if (std::find(listeners.begin(), listeners.end(), pwallet) == listeners.end())
+                        continue;
+                    pcalling = pwallet;
+                }
+                event(pwallet);
+                {
+                    std::lock_guard<std::mutex> lock(csListeners);
+                    pcalling = NULL;
+                }
+                condCalled.notify_all();
+            }
+        }
+    }
+
+    std::mutex csListeners;
+    std::condition_variable condCalled;
+    std::vector<CValidationInterface*> listeners;
+    //! listeners.size(), readable without csListeners by the threads queueing events
+    std::atomic<size_t> nListeners;
+    //! The listener whose callback is running on the dispatch thread, if any
+    CValidationInterface* pcalling;
+
+    std::mutex csQueue;
+    std::condition_variable condQueue;
+    std::condition_variable condDrained;
+    std::deque<Event> queue;
+    bool fRegistered;
+    bool fBusy;
+    bool fStop;
+    std::thread threadDispatch;
+};
+
+static CValidationInterfaceQueue g_validationQueue;
+
+void RegisterValidationInterfaceAsync(CValidationInterface* pwalletIn) {
+    g_validationQueue.Add(pwalletIn);
+}
+
+void SyncWithValidationInterfaceQueue() {
+    g_validationQueue.Sync();
+}
+
+void LimitValidationInterfaceQueue() {
+    g_validationQueue.Limit();
+}
+
+void StopValidationInterfaceQueue() {
+    g_validationQueue.Stop();
+}
+
+void QueueUpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) {
+    g_validationQueue.QueueUpdatedBlockTip(pindexNew, pindexFork, fInitialDownload);
+}
+
+static void MempoolEntryAdded(CTransactionRef ptx) {
+    g_signals.TransactionAddedToMempool(ptx);
+}
+
+static void MempoolEntryRemoved(CTransactionRef ptx, MemPoolRemovalReason reason) {
+    g_signals.TransactionRemovedFromMempool(ptx, reason);
+}
+
+void RegisterWithMempoolSignals(CTxMemPool& pool) {
+    pool.NotifyEntryAdded.connect(&MempoolEntryAdded);
+    pool.NotifyEntryRemoved.connect(&MempoolEntryRemoved);
+}
+
+void UnregisterWithMempoolSignals(CTxMemPool& pool) {
+    pool.NotifyEntryAdded.disconnect(&MempoolEntryAdded);
+    pool.NotifyEntryRemoved.disconnect(&MempoolEntryRemoved);
+}
+
 void RegisterValidationInterface(CValidationInterface* pwalletIn) {
     g_signals.UpdatedBlockTip.connect(boost::bind(&CValidationInterface::UpdatedBlockTip,
                                                   pwalletIn, boost::placeholders::_1,
@@ -41,9 +317,21 @@ void RegisterValidationInterface(CValidationInterface* pwalletIn) {
     g_signals.NewPoWValidBlock.connect(boost::bind(&CValidationInterface::NewPoWValidBlock,
                                                    pwalletIn, boost::placeholders::_1,
                                                    boost::placeholders::_2));
+    g_signals.BlockConnected.connect(boost::bind(&CValidationInterface::BlockConnected,
+                                                 pwalletIn, boost::placeholders::_1,
+                                                 boost::placeholders::_2));
+    g_signals.BlockDisconnected.connect(boost::bind(&CValidationInterface::BlockDisconnected,
+                                                    pwalletIn, boost::placeholders::_1,
+                                                    boost::placeholders::_2));
+    g_signals.TransactionAddedToMempool.connect(boost::bind(&CValidationInterface::TransactionAddedToMempool,
+                                                            pwalletIn, boost::placeholders::_1));
+    g_signals.TransactionRemovedFromMempool.connect(boost::bind(&CValidationInterface::TransactionRemovedFromMempool,
+                                                                pwalletIn, boost::placeholders::_1,
+                                                                boost::placeholders::_2));
 }
 
 void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
+    g_validationQueue.Remove(pwalletIn);
     g_signals.BlockFound.disconnect(boost::bind(&CValidationInterface::ResetRequestCount,
                                                 pwalletIn, boost::placeholders::_1));
     g_signals.ScriptForMining.disconnect(boost::bind(&CValidationInterface::GetScriptForMining,
@@ -71,9 +359,21 @@ void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
     g_signals.NewPoWValidBlock.disconnect(boost::bind(&CValidationInterface::NewPoWValidBlock,
                                           pwalletIn, boost::placeholders::_1,
                                           boost::placeholders::_2));
+    g_signals.BlockConnected.disconnect(boost::bind(&CValidationInterface::BlockConnected,
+                                        pwalletIn, boost::placeholders::_1,
+                                        boost::placeholders::_2));
+    g_signals.BlockDisconnected.disconnect(boost::bind(&CValidationInterface::BlockDisconnected,
+                                           pwalletIn, boost::placeholders::_1,
+                                           boost::placeholders::_2));
+    g_signals.TransactionAddedToMempool.disconnect(boost::bind(&CValidationInterface::TransactionAddedToMempool,
+                                                   pwalletIn, boost::placeholders::_1));
+    g_signals.TransactionRemovedFromMempool.disconnect(boost::bind(&CValidationInterface::TransactionRemovedFromMempool,
+                                                       pwalletIn, boost::placeholders::_1,
+                                                       boost::placeholders::_2));
 }
 
 void UnregisterAllValidationInterfaces() {
+    g_validationQueue.RemoveAll();
     g_signals.BlockFound.disconnect_all_slots();
     g_signals.ScriptForMining.disconnect_all_slots();
     g_signals.BlockChecked.disconnect_all_slots();
@@ -84,4 +384,8 @@ void UnregisterAllValidationInterfaces() {
     g_signals.SyncTransaction.disconnect_all_slots();
     g_signals.UpdatedBlockTip.disconnect_all_slots();
     g_signals.NewPoWValidBlock.disconnect_all_slots();
+    g_signals.BlockConnected.disconnect_all_slots();
+    g_signals.BlockDisconnected.disconnect_all_slots();
+    g_signals.TransactionAddedToMempool.disconnect_all_slots();
+    g_signals.TransactionRemovedFromMempool.disconnect_all_slots();
 }
@@ -6,6 +6,8 @@
 #ifndef NOVO_VALIDATIONINTERFACE_H
 #define NOVO_VALIDATIONINTERFACE_H
 
+#include "primitives/transaction.h" // CTransactionRef
+
 #include <boost/signals2/signal.hpp>
 #include <boost/shared_ptr.hpp>
 #include <memory>
@@ -16,10 +18,11 @@ struct CBlockLocator;
 class CBlockIndex;
 class CConnman;
 class CReserveScript;
-class CTransaction;
+class CTxMemPool;
 class CValidationInterface;
 class CValidationState;
 class uint256;
+enum class MemPoolRemovalReason;
 
 // These functions dispatch to one or all registered wallets
 
@@ -29,11 +32,39 @@ void RegisterValidationInterface(CValidationInterface* pwalletIn);
 void UnregisterValidationInterface(CValidationInterface* pwalletIn);
 /** Unregister all wallets from core */
 void UnregisterAllValidationInterfaces();
+/**
+ * Register a listener whose callbacks are delivered in order on a background
+ * thread rather than synchronously by the thread emitting them. Chain and
+ * mempool events, including UpdatedBlockTip (see QueueUpdatedBlockTip), are
+ * all queued with cs_main held, so they arrive in the order the changes were
+ * made. Use this for listeners that neither need cs_main to be held nor need
+ * to have processed an event before the caller continues.
+ * BlockChecked and GetScriptForMining are only ever delivered synchronously.
+ */
+void RegisterValidationInterfaceAsync(CValidationInterface* pwalletIn);
+/** Wait until all queued background callbacks have been delivered. Must not be called with cs_main held. */
+void SyncWithValidationInterfaceQueue();
+/**
+ * Wait for the background callback queue to drain if it has fallen too far
+ * behind, so it cannot grow without bound. Must not be called with cs_main held.
+ */
+void LimitValidationInterfaceQueue();
+/** Deliver the remaining queued callbacks and stop the background thread */
+void StopValidationInterfaceQueue();
+/**
+ * Queue UpdatedBlockTip for the background listeners. Must be called with
+ * cs_main held, while the UpdatedBlockTip signal for the synchronous listeners
+ * is emitted after releasing it.
+ */
+void QueueUpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload);
+/** Forward pool's entry added/removed notifications to the validation interface listeners */
+void RegisterWithMempoolSignals(CTxMemPool& pool);
+void UnregisterWithMempoolSignals(CTxMemPool& pool);
 
 class CValidationInterface {
 protected:
     virtual void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) {}
-    virtual void SyncTransaction(const CTransaction &tx, const CBlockIndex *pindex, int posInBlock) {}
+    virtual void SyncTransaction(const CTransactionRef &ptx, const CBlockIndex *pindex, int posInBlock) {}
     virtual void SetBestChain(const CBlockLocator &locator) {}
     virtual void UpdatedTransaction(const uint256 &hash) {}
     virtual void Inventory(const uint256 &hash) {}
@@ -42,6 +73,11 @@ protected:
     virtual void GetScriptForMining(boost::shared_ptr<CReserveScript>&) {};
     virtual void ResetRequestCount(const uint256 &hash) {};
     virtual void NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& block) {};
+    virtual void BlockConnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex) {}
+    virtual void BlockDisconnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex) {}
+    virtual void TransactionAddedToMempool(const std::shared_ptr<const CTransaction> &ptx) {}
+    virtual void TransactionRemovedFromMempool(const std::shared_ptr<const CTransaction> &ptx, MemPoolRemovalReason reason) {}
+    friend class CValidationInterfaceQueue;
     friend void ::RegisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterAllValidationInterfaces();
@@ -60,7 +96,7 @@ struct CMainSignals {
      * transaction was accepted to mempool, removed from mempool (only when
      * removal was due to conflict from connected block), or appeared in a
      * disconnected block.*/
-    boost::signals2::signal<void (const CTransaction &, const CBlockIndex *pindex, int posInBlock)> SyncTransaction;
+    boost::signals2::signal<void (const CTransactionRef &, const CBlockIndex *pindex, int posInBlock)> SyncTransaction;
     /** Notifies listeners of an updated transaction without new data (for now: a coinbase potentially becoming visible). */
     boost::signals2::signal<void (const uint256 &)> UpdatedTransaction;
     /** Notifies listeners of a new active block chain. */
@@ -79,6 +115,17 @@ struct CMainSignals {
      * Notifies listeners that a block which builds directly on our current tip
      * has been received and connected to the headers tree, though not validated yet */
     boost::signals2::signal<void (const CBlockIndex *, const std::shared_ptr<const CBlock>&)> NewPoWValidBlock;
+    /**
+     * Notifies listeners of a block being connected to the active chain,
+     * with the in-memory block so that it does not have to be re-read from disk.
+     * Called after SyncTransaction for the block's transactions. */
+    boost::signals2::signal<void (const std::shared_ptr<const CBlock> &, const CBlockIndex *)> BlockConnected;
+    /** Notifies listeners of a block (with its index entry) being disconnected from the active chain */
+    boost::signals2::signal<void (const std::shared_ptr<const CBlock> &, const CBlockIndex *)> BlockDisconnected;
+    /** Notifies listeners of a transaction entering the mempool (see RegisterWithMempoolSignals) */
+    boost::signals2::signal<void (const std::shared_ptr<const CTransaction> &)> TransactionAddedToMempool;
+    /** Notifies listeners of a transaction leaving the mempool, and why */
+    boost::signals2::signal<void (const std::shared_ptr<const CTransaction> &, MemPoolRemovalReason)> TransactionRemovedFromMempool;
 };
 
 CMainSignals& GetMainSignals();
@@ -7,15 +7,19 @@
 
 #include "zmqconfig.h"
 
+#include <memory>
+
 class CBlockIndex;
 class CZMQAbstractNotifier;
+class CZMQPublishQueue;
+enum class MemPoolRemovalReason;
 
 typedef CZMQAbstractNotifier* (*CZMQNotifierFactory)();
 
 class CZMQAbstractNotifier
 {
 public:
-    CZMQAbstractNotifier() : psocket(0) { }
+    CZMQAbstractNotifier() : psocket(0), pqueue(0) { }
     virtual ~CZMQAbstractNotifier();
 
     template <typename T>
@@ -28,15 +32,24 @@ public:
     void SetType(const std::string &t) { type = t; }
     std::string GetAddress() const { return address; }
     void SetAddress(const std::string &a) { address = a; }
+    void SetPublishQueue(CZMQPublishQueue *q) { pqueue = q; }
 
     virtual bool Initialize(void *pcontext) = 0;
     virtual void Shutdown() = 0;
 
-    virtual bool NotifyBlock(const CBlockIndex *pindex);
+    /** pblock is the in-memory block for pindex if available, or null */
+    virtual bool NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock> &pblock);
     virtual bool NotifyTransaction(const CTransaction &transaction);
 
+    // Mempool and chain events, used by the sequence notifier
+    virtual bool NotifyTransactionAcceptance(const CTransaction &transaction);
+    virtual bool NotifyTransactionRemoval(const CTransaction &transaction, MemPoolRemovalReason reason);
+    virtual bool NotifyBlockConnect(const CBlockIndex *pindex);
+    virtual bool NotifyBlockDisconnect(const CBlockIndex *pindex);
+
 protected:
     void *psocket;
+    CZMQPublishQueue *pqueue;
     std::string type;
     std::string address;
 };
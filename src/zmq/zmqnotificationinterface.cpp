@@ -4,6 +4,7 @@
 
 #include "zmqnotificationinterface.h"
 #include "zmqpublishnotifier.h"
+#include "zmqpublishqueue.h"
 
 #include "version.h"
 #include "validation.h"
@@ -39,6 +40,7 @@ CZMQNotificationInterface* CZMQNotificationInterface::Create()
     factories["pubhashtx"] = CZMQAbstractNotifier::Create<CZMQPublishHashTransactionNotifier>;
     factories["pubrawblock"] = CZMQAbstractNotifier::Create<CZMQPublishRawBlockNotifier>;
     factories["pubrawtx"] = CZMQAbstractNotifier::Create<CZMQPublishRawTransactionNotifier>;
+    factories["pubsequence"] = CZMQAbstractNotifier::Create<CZMQPublishSequenceNotifier>;
 
     for (std::map<std::string, CZMQNotifierFactory>::const_iterator i=factories.begin(); i!=factories.end(); ++i)
     {
@@ -58,6 +60,7 @@ CZMQNotificationInterface* CZMQNotificationInterface::Create()
     {
         notificationInterface = new CZMQNotificationInterface();
         notificationInterface->notifiers = notifiers;
+        notificationInterface->queue.reset(new CZMQPublishQueue(GetArg("-zmqqueuesize", DEFAULT_ZMQ_QUEUE_SIZE) * 1000000));
 
         if (!notificationInterface->Initialize())
         {
@@ -87,6 +90,7 @@ bool CZMQNotificationInterface::Initialize()
     for (; i!=notifiers.end(); ++i)
     {
         CZMQAbstractNotifier *notifier = *i;
+        notifier->SetPublishQueue(queue.get());
         if (notifier->Initialize(pcontext))
         {
             LogPrint("zmq", "  Notifier %s ready (address = %s)\n", notifier->GetType(), notifier->GetAddress());
@@ -103,6 +107,8 @@ bool CZMQNotificationInterface::Initialize()
         return false;
     }
 
+    queue->Start();
+
     return true;
 }
 
@@ -112,6 +118,8 @@ void CZMQNotificationInterface::Shutdown()
     LogPrint("zmq", "zmq: Shutdown notification interface\n");
     if (pcontext)
     {
+        // The publishing thread uses the sockets, so it has to be gone before they are closed
+        queue->Stop();
         for (std::list<CZMQAbstractNotifier*>::iterator i=notifiers.begin(); i!=notifiers.end(); ++i)
         {
             CZMQAbstractNotifier *notifier = *i;
@@ -124,15 +132,16 @@ void CZMQNotificationInterface::Shutdown()
     }
 }
 
-void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
-{
-    if (fInitialDownload || pindexNew == pindexFork) // In IBD or blocks were disconnected without any new ones
-        return;
+namespace {
 
+// Call func on each notifier, shutting down and dropping the ones that fail
+template <typename Function>
+void TryForEachAndRemoveFailed(std::list<CZMQAbstractNotifier*>& notifiers, const Function& func)
+{
     for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
     {
         CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyBlock(pindexNew))
+        if (func(notifier))
         {
             i++;
         }
@@ -144,19 +153,61 @@ void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, co
     }
 }
 
-void CZMQNotificationInterface::SyncTransaction(const CTransaction& tx, const CBlockIndex* pindex, int posInBlock)
+} // anon namespace
+
+void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
 {
-    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
+    std::shared_ptr<const CBlock> pblock;
     {
-        CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyTransaction(tx))
-        {
-            i++;
-        }
-        else
-        {
-            notifier->Shutdown();
-            i = notifiers.erase(i);
-        }
+        std::lock_guard<std::mutex> lock(csBlockConnected);
+        pblock.swap(pblockConnected);
+    }
+
+    if (fInitialDownload || pindexNew == pindexFork) // In IBD or blocks were disconnected without any new ones
+        return;
+
+    TryForEachAndRemoveFailed(notifiers, [pindexNew, &pblock](CZMQAbstractNotifier* notifier) {
+        return notifier->NotifyBlock(pindexNew, pblock);
+    });
+}
+
+void CZMQNotificationInterface::BlockConnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex)
+{
+    {
+        std::lock_guard<std::mutex> lock(csBlockConnected);
+        pblockConnected = block;
     }
+
+    TryForEachAndRemoveFailed(notifiers, [pindex](CZMQAbstractNotifier* notifier) {
+        return notifier->NotifyBlockConnect(pindex);
+    });
+}
+
+void CZMQNotificationInterface::BlockDisconnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex)
+{
+    TryForEachAndRemoveFailed(notifiers, [pindex](CZMQAbstractNotifier* notifier) {
+        return notifier->NotifyBlockDisconnect(pindex);
+    });
+}
+
+void CZMQNotificationInterface::SyncTransaction(const CTransactionRef& ptx, const CBlockIndex* pindex, int posInBlock)
+{
+    const CTransaction& tx = *ptx;
+    TryForEachAndRemoveFailed(notifiers, [&tx](CZMQAbstractNotifier* notifier) {
+        return notifier->NotifyTransaction(tx);
+    });
+}
+
+void CZMQNotificationInterface::TransactionAddedToMempool(const CTransactionRef &ptx)
+{
+    TryForEachAndRemoveFailed(notifiers, [&ptx](CZMQAbstractNotifier* notifier) {
+        return notifier->NotifyTransactionAcceptance(*ptx);
+    });
+}
+
+void CZMQNotificationInterface::TransactionRemovedFromMempool(const CTransactionRef &ptx, MemPoolRemovalReason reason)
+{
+    TryForEachAndRemoveFailed(notifiers, [&ptx, reason](CZMQAbstractNotifier* notifier) {
+        return notifier->NotifyTransactionRemoval(*ptx, reason);
+    });
 }
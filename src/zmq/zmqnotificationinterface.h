@@ -6,11 +6,16 @@
 #define NOVO_ZMQ_ZMQNOTIFICATIONINTERFACE_H
 
 #include "validationinterface.h"
+#include "primitives/transaction.h"
+#include <list>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <map>
 
 class CBlockIndex;
 class CZMQAbstractNotifier;
+class CZMQPublishQueue;
 
 class CZMQNotificationInterface : public CValidationInterface
 {
@@ -24,14 +29,22 @@ protected:
     void Shutdown();
 
     // CValidationInterface
-    void SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex, int posInBlock);
+    void SyncTransaction(const CTransactionRef& ptx, const CBlockIndex *pindex, int posInBlock);
     void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload);
+    void BlockConnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex);
+    void BlockDisconnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex);
+    void TransactionAddedToMempool(const CTransactionRef &ptx);
+    void TransactionRemovedFromMempool(const CTransactionRef &ptx, MemPoolRemovalReason reason);
 
 private:
     CZMQNotificationInterface();
 
     void *pcontext;
     std::list<CZMQAbstractNotifier*> notifiers;
+    std::unique_ptr<CZMQPublishQueue> queue;
+    //! Last connected block, handed to notifiers on the following tip update
+    std::shared_ptr<const CBlock> pblockConnected;
+    std::mutex csBlockConnected;
 };
 
 #endif // NOVO_ZMQ_ZMQNOTIFICATIONINTERFACE_H
@@ -5,6 +5,7 @@
 #include "chainparams.h"
 #include "streams.h"
 #include "zmqpublishnotifier.h"
+#include "txmempool.h"
 #include "validation.h"
 #include "util.h"
 #include "rpc/server.h"
@@ -15,49 +16,13 @@ static const char *MSG_HASHBLOCK = "hashblock";
 static const char *MSG_HASHTX    = "hashtx";
 static const char *MSG_RAWBLOCK  = "rawblock";
 static const char *MSG_RAWTX     = "rawtx";
+static const char *MSG_SEQUENCE  = "sequence";
 
-// Internal function to send multipart message
-static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
-{
-    va_list args;
-    va_start(args, size);
-
-    while (1)
-    {
-        zmq_msg_t msg;
-
-        int rc = zmq_msg_init_size(&msg, size);
-        if (rc != 0)
-        {
-            zmqError("Unable to initialize ZMQ msg");
-            va_end(args);
-            return -1;
-        }
-
-        void *buf = zmq_msg_data(&msg);
-        memcpy(buf, data, size);
-
-        data = va_arg(args, const void*);
-
-        rc = zmq_msg_send(&msg, sock, data ? ZMQ_SNDMORE : 0);
-        if (rc == -1)
-        {
-            zmqError("Unable to send ZMQ msg");
-            zmq_msg_close(&msg);
-            va_end(args);
-            return -1;
-        }
-
-        zmq_msg_close(&msg);
-
-        if (!data)
-            break;
-
-        size = va_arg(args, size_t);
-    }
-    va_end(args);
-    return 0;
-}
+// Event labels of the sequence topic
+static const char SEQUENCE_BLOCK_CONNECT    = 'C';
+static const char SEQUENCE_BLOCK_DISCONNECT = 'D';
+static const char SEQUENCE_MEMPOOL_ACCEPT   = 'A';
+static const char SEQUENCE_MEMPOOL_REMOVE   = 'R';
 
 bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
 {
@@ -128,24 +93,36 @@ void CZMQAbstractPublishNotifier::Shutdown()
     psocket = 0;
 }
 
-bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* data, size_t size)
+bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const ZMQMessagePart& data)
 {
     assert(psocket);
+    assert(pqueue);
 
     /* send three parts, command & data & a LE 4byte sequence number */
-    unsigned char msgseq[sizeof(uint32_t)];
-    WriteLE32(&msgseq[0], nSequence);
-    int rc = zmq_send_multipart(psocket, command, strlen(command), data, size, msgseq, (size_t)sizeof(uint32_t), (void*)0);
-    if (rc == -1)
-        return false;
-
-    /* increment memory only sequence number after sending */
+    std::shared_ptr<std::vector<unsigned char> > msgseq = std::make_shared<std::vector<unsigned char> >(sizeof(uint32_t));
+    WriteLE32(msgseq->data(), nSequence);
+
+    std::vector<ZMQMessagePart> parts;
+    parts.reserve(3);
+    parts.push_back(std::make_shared<const std::vector<unsigned char> >(command, command + strlen(command)));
+    parts.push_back(data);
+    parts.push_back(msgseq);
+
+    /* a notification dropped at the queue's high water mark still consumes its
+       sequence number, so subscribers can detect the gap */
+    pqueue->Push(psocket, std::move(parts));
     nSequence++;
 
     return true;
 }
 
-bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
+bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* data, size_t size)
+{
+    const unsigned char *begin = static_cast<const unsigned char*>(data);
+    return SendMessage(command, std::make_shared<const std::vector<unsigned char> >(begin, begin + size));
+}
+
+bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock> & /*pblock*/)
 {
     uint256 hash = pindex->GetBlockHash();
     LogPrint("zmq", "zmq: Publish hashblock %s\n", hash.GetHex());
@@ -165,32 +142,77 @@ bool CZMQPublishHashTransactionNotifier::NotifyTransaction(const CTransaction &t
     return SendMessage(MSG_HASHTX, data, 32);
 }
 
-bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
+bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock> &pblock)
 {
     LogPrint("zmq", "zmq: Publish rawblock %s\n", pindex->GetBlockHash().GetHex());
 
-    const Consensus::Params& consensusParams = Params().GetConsensus();
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-    {
-        LOCK(cs_main);
+    std::shared_ptr<std::vector<unsigned char> > data = std::make_shared<std::vector<unsigned char> >();
+    if (pblock && pblock->GetHash() == pindex->GetBlockHash()) {
+        // Serialize the block we were handed directly, no disk access or cs_main needed
+        data->reserve(::GetSerializeSize(*pblock, SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags()));
+        CVectorWriter(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags(), *data, 0, *pblock);
+    } else {
+        const Consensus::Params& consensusParams = Params().GetConsensus();
         CBlock block;
+        // A stored block does not change, so reading it needs no cs_main
         if(!ReadBlockFromDisk(block, pindex, consensusParams))
         {
             zmqError("Can't read block from disk");
             return false;
         }
-
-        ss << block;
+        CVectorWriter(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags(), *data, 0, block);
     }
 
-    return SendMessage(MSG_RAWBLOCK, &(*ss.begin()), ss.size());
+    return SendMessage(MSG_RAWBLOCK, data);
 }
 
 bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &transaction)
 {
     uint256 hash = transaction.GetHash();
     LogPrint("zmq", "zmq: Publish rawtx %s\n", hash.GetHex());
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-    ss << transaction;
-    return SendMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
+    std::shared_ptr<std::vector<unsigned char> > data = std::make_shared<std::vector<unsigned char> >();
+    CVectorWriter(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags(), *data, 0, transaction);
+    return SendMessage(MSG_RAWTX, data);
+}
+
+// Sequence body: 32 byte hash in display order, 1 byte label, and for
+// removals 1 byte MemPoolRemovalReason
+static bool SendSequenceMsg(CZMQAbstractPublishNotifier& notifier, const uint256& hash, char label, int reason = -1)
+{
+    unsigned char data[34];
+    for (unsigned int i = 0; i < 32; i++)
+        data[31 - i] = hash.begin()[i];
+    data[32] = label;
+    size_t size = 33;
+    if (reason >= 0)
+        data[size++] = reason;
+    return notifier.SendMessage(MSG_SEQUENCE, data, size);
+}
+
+bool CZMQPublishSequenceNotifier::NotifyBlockConnect(const CBlockIndex *pindex)
+{
+    uint256 hash = pindex->GetBlockHash();
+    LogPrint("zmq", "zmq: Publish sequence block connect %s\n", hash.GetHex());
+    return SendSequenceMsg(*this, hash, SEQUENCE_BLOCK_CONNECT);
+}
+
+bool CZMQPublishSequenceNotifier::NotifyBlockDisconnect(const CBlockIndex *pindex)
+{
+    uint256 hash = pindex->GetBlockHash();
+    LogPrint("zmq", "zmq: Publish sequence block disconnect %s\n", hash.GetHex());
+    return SendSequenceMsg(*this, hash, SEQUENCE_BLOCK_DISCONNECT);
+}
+
+bool CZMQPublishSequenceNotifier::NotifyTransactionAcceptance(const CTransaction &transaction)
+{
+    uint256 hash = transaction.GetHash();
+    LogPrint("zmq", "zmq: Publish sequence mempool acceptance %s\n", hash.GetHex());
+    return SendSequenceMsg(*this, hash, SEQUENCE_MEMPOOL_ACCEPT);
+}
+
+bool CZMQPublishSequenceNotifier::NotifyTransactionRemoval(const CTransaction &transaction, MemPoolRemovalReason reason)
+{
+    uint256 hash = transaction.GetHash();
+    LogPrint("zmq", "zmq: Publish sequence mempool removal %s\n", hash.GetHex());
+    return SendSequenceMsg(*this, hash, SEQUENCE_MEMPOOL_REMOVE, static_cast<int>(reason));
 }
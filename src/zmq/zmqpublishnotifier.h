@@ -6,6 +6,7 @@
 #define NOVO_ZMQ_ZMQPUBLISHNOTIFIER_H
 
 #include "zmqabstractnotifier.h"
+#include "zmqpublishqueue.h"
 
 class CBlockIndex;
 
@@ -15,13 +16,15 @@ private:
     uint32_t nSequence; //!< upcounting per message sequence number
 
 public:
+    CZMQAbstractPublishNotifier() : nSequence(0) { }
 
-    /* send zmq multipart message
+    /* queue zmq multipart message for the publishing thread
        parts:
           * command
           * data
           * message sequence number
     */
+    bool SendMessage(const char *command, const ZMQMessagePart& data);
     bool SendMessage(const char *command, const void* data, size_t size);
 
     bool Initialize(void *pcontext);
@@ -31,7 +34,7 @@ public:
 class CZMQPublishHashBlockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
-    bool NotifyBlock(const CBlockIndex *pindex);
+    bool NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock> &pblock);
 };
 
 class CZMQPublishHashTransactionNotifier : public CZMQAbstractPublishNotifier
@@ -43,7 +46,7 @@ public:
 class CZMQPublishRawBlockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
-    bool NotifyBlock(const CBlockIndex *pindex);
+    bool NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock> &pblock);
 };
 
 class CZMQPublishRawTransactionNotifier : public CZMQAbstractPublishNotifier
@@ -52,4 +55,18 @@ public:
     bool NotifyTransaction(const CTransaction &transaction);
 };
 
+/**
+ * Publishes mempool acceptance/removal and block connect/disconnect events in
+ * the order they happen, so subscribers can mirror the mempool incrementally.
+ * The sequence number of the message orders events across all four kinds.
+ */
+class CZMQPublishSequenceNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyTransactionAcceptance(const CTransaction &transaction);
+    bool NotifyTransactionRemoval(const CTransaction &transaction, MemPoolRemovalReason reason);
+    bool NotifyBlockConnect(const CBlockIndex *pindex);
+    bool NotifyBlockDisconnect(const CBlockIndex *pindex);
+};
+
 #endif // NOVO_ZMQ_ZMQPUBLISHNOTIFIER_H
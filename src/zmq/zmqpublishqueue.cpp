@@ -0,0 +1,138 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "zmqpublishqueue.h"
+#include "zmqconfig.h"
+#include "util.h"
+
+#include <functional>
+
+// Called by zmq once it no longer needs a buffer handed over with zmq_msg_init_data
+static void zmq_release_part(void * /*data*/, void *hint)
+{
+    delete static_cast<ZMQMessagePart*>(hint);
+}
+
+// Internal function to send multipart message without copying the payloads
+static int zmq_send_multipart(void *sock, const std::vector<ZMQMessagePart>& parts)
+{
+    for (size_t i = 0; i < parts.size(); i++)
+    {
+        zmq_msg_t msg;
+        const ZMQMessagePart& part = parts[i];
+
+        ZMQMessagePart *hint = new ZMQMessagePart(part);
+        int rc = zmq_msg_init_data(&msg, const_cast<unsigned char*>(part->data()), part->size(), zmq_release_part, hint);
+        if (rc != 0)
+        {
+            zmqError("Unable to initialize ZMQ msg");
+            delete hint;
+            return -1;
+        }
+
+        rc = zmq_msg_send(&msg, sock, i + 1 < parts.size() ? ZMQ_SNDMORE : 0);
+        if (rc == -1)
+        {
+            zmqError("Unable to send ZMQ msg");
+            zmq_msg_close(&msg);
+            return -1;
+        }
+
+        zmq_msg_close(&msg);
+    }
+    return 0;
+}
+
+CZMQPublishQueue::CZMQPublishQueue(size_t nMaxBytesIn) : nQueuedBytes(0), nMaxBytes(nMaxBytesIn), nDropped(0), fStop(false)
+{
+}
+
+CZMQPublishQueue::~CZMQPublishQueue()
+{
+    Stop();
+}
+
+void CZMQPublishQueue::Start()
+{
+    assert(!threadPublish.joinable());
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        fStop = false;
+    }
+    threadPublish = std::thread(&TraceThread<std::function<void()> >, "zmqpub", std::function<void()>(std::bind(&CZMQPublishQueue::ThreadPublish, this)));
+}
+
+void CZMQPublishQueue::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        fStop = true;
+    }
+    cond.notify_all();
+    if (threadPublish.joinable())
+        threadPublish.join();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!queue.empty())
+        LogPrint("zmq", "zmq: Discarding %u queued notifications\n", queue.size());
+    queue.clear();
+    nQueuedBytes = 0;
+}
+
+bool CZMQPublishQueue::Push(void *psocket, std::vector<ZMQMessagePart>&& parts)
+{
+    QueuedMessage message;
+    message.psocket = psocket;
+    message.nBytes = 0;
+    for (const ZMQMessagePart& part : parts)
+        message.nBytes += part->size();
+    message.parts = std::move(parts);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // An empty queue always accepts one message, so a single block larger
+        // than the high water mark is still published.
+        if (!queue.empty() && nQueuedBytes + message.nBytes > nMaxBytes) {
+            nDropped++;
+            LogPrint("zmq", "zmq: Queue full (%u bytes), dropping notification\n", nQueuedBytes);
+            return false;
+        }
+        nQueuedBytes += message.nBytes;
+        queue.push_back(std::move(message));
+    }
+    cond.notify_one();
+    return true;
+}
+
+size_t CZMQPublishQueue::GetQueuedBytes()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return nQueuedBytes;
+}
+
+uint64_t CZMQPublishQueue::GetDropped()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return nDropped;
+}
+
+void CZMQPublishQueue::ThreadPublish()
+{
+    while (true)
+    {
+        QueuedMessage message;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [this]{ return fStop || !queue.empty(); });
+            if (fStop)
+                return;
+            message = std::move(queue.front());
+            queue.pop_front();
+            nQueuedBytes -= message.nBytes;
+        }
+
+        if (zmq_send_multipart(message.psocket, message.parts) == -1)
+            LogPrint("zmq", "zmq: Failed to publish notification\n");
+    }
+}
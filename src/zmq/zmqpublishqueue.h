@@ -0,0 +1,67 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef NOVO_ZMQ_ZMQPUBLISHQUEUE_H
+#define NOVO_ZMQ_ZMQPUBLISHQUEUE_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** Default for -zmqqueuesize, maximum size of queued notifications in megabytes */
+static const unsigned int DEFAULT_ZMQ_QUEUE_SIZE = 100;
+
+/** An already-serialized message part. The buffer is handed to zmq without
+ *  copying and kept alive until zmq has transmitted it. */
+typedef std::shared_ptr<const std::vector<unsigned char> > ZMQMessagePart;
+
+/**
+ * Bounded queue of multipart messages with a dedicated publishing thread.
+ *
+ * zmq sockets must not be shared between threads, so all sends for all
+ * notifiers happen on the thread owned by this queue. Validation callbacks
+ * only serialize and enqueue, so block connection does not wait on
+ * subscribers. Messages that would take the queue beyond its high water
+ * mark are dropped; subscribers can detect that through the per-notifier
+ * sequence number.
+ */
+class CZMQPublishQueue
+{
+public:
+    explicit CZMQPublishQueue(size_t nMaxBytesIn);
+    ~CZMQPublishQueue();
+
+    void Start();
+    /** Stop the publishing thread. Messages still queued are discarded. */
+    void Stop();
+
+    /** Queue a multipart message for psocket. Returns false if it was dropped. */
+    bool Push(void *psocket, std::vector<ZMQMessagePart>&& parts);
+
+    size_t GetQueuedBytes();
+    uint64_t GetDropped();
+
+private:
+    struct QueuedMessage {
+        void *psocket;
+        std::vector<ZMQMessagePart> parts;
+        size_t nBytes;
+    };
+
+    void ThreadPublish();
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<QueuedMessage> queue;
+    size_t nQueuedBytes;
+    const size_t nMaxBytes;
+    uint64_t nDropped;
+    bool fStop;
+    std::thread threadPublish;
+};
+
+#endif // NOVO_ZMQ_ZMQPUBLISHQUEUE_H